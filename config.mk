@@ -17,6 +17,11 @@ LIBS=\
 	-lSDL2_mixer\
 	-lxml2 -lz -llzma -lm
 
+# shm_open() lives in librt before glibc 2.34.
+ifeq ($(UNAME_S),Linux)
+	LIBS+=-lrt
+endif
+
 CFLAGS=\
 	-D_REENTRANT\
 	-DSDL_MAIN_HANDLED\
@@ -52,3 +57,70 @@ SRCS=\
 	$(wildcard src/inih/*.c)
 
 OBJS=$(patsubst %.c, %.o, $(SRCS))
+
+# Walks Sam to the right edge of the first level, which swaps the level.
+CHECK_LOG=res/replays/walk.bsil
+
+BENCH_OUT=$(PROJECT)-bench
+
+BENCH_SRCS=\
+	src/bench/Bench.c\
+	src/bench/PerfCounters.c\
+	src/bench/StressMap.c\
+	src/AABB.c\
+	src/Audio.c\
+	src/Blit.c\
+	src/Entity.c\
+	src/Job.c\
+	src/Map.c\
+	src/Memory.c\
+	src/MusicCache.c\
+	src/Resource.c\
+	src/SpriteBatch.c\
+	src/Swarm.c\
+	src/Trace.c\
+	src/Video.c\
+	src/Voice.c\
+	$(wildcard src/inih/*.c)\
+	$(wildcard src/tmx/*.c)
+
+STRESS_OUT=$(PROJECT)-stress
+
+STRESS_SRCS=\
+	src/bench/Stress.c\
+	src/bench/StressMap.c\
+	src/AABB.c\
+	src/Audio.c\
+	src/Background.c\
+	src/Blit.c\
+	src/Entity.c\
+	src/Job.c\
+	src/Map.c\
+	src/Memory.c\
+	src/MusicCache.c\
+	src/Profiler.c\
+	src/Resource.c\
+	src/SpriteBatch.c\
+	src/Trace.c\
+	src/Video.c\
+	src/Voice.c\
+	$(wildcard src/inih/*.c)\
+	$(wildcard src/tmx/*.c)
+
+ATLAS_OUT=$(PROJECT)-atlas
+
+ATLAS_SRCS=\
+	src/tools/AtlasPacker.c
+
+ATLAS_DIR=res/atlas
+
+ATLAS_IMAGES=\
+	$(wildcard res/sprites/*.png)\
+	$(wildcard res/backgrounds/*.png)\
+	$(wildcard res/tilesets/*.png)
+
+METRICS_OUT=$(PROJECT)-metrics
+
+METRICS_SRCS=\
+	src/tools/MetricsCli.c\
+	src/Metrics.c
@@ -3,6 +3,8 @@
  * @ingroup   Audio
  * @defgroup  Audio
  * @brief     Audio handler to playback music and sound effects.
+ *            Music is streamed by SDL_mixer or, with the music cache
+ *            enabled, played from decoded PCM.  See @ref MusicCache.
  * @author    Michael Fitzmayer
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
@@ -11,7 +13,307 @@
 #include <SDL2/SDL_mixer.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "Audio.h"
+#include "Memory.h"
+#include "MusicCache.h"
+#include "Trace.h"
+#include "Voice.h"
+
+#define AUDIO_PROBE_SETTLE_MS  50
+#define AUDIO_PROBE_MS        300
+
+/* The cached music currently playing.  Changed only while the hook is
+ * removed, i.e. while the audio thread can't use it. */
+typedef struct CachedMusicPlayback_t
+{
+    const MusicCache *pstCache;
+    SDL_atomic_t      stPaused;
+    uint32_t          u32Position;
+    uint32_t          u32FadeFrames;
+    uint32_t          u32FadePosition;
+    int8_t            s8Loops;
+    uint8_t           u8Finished;
+} CachedMusicPlayback;
+
+static uint8_t      _u8Headless;
+static AudioStats   _stStats;
+static VoicePool   *_pstVoices;
+static SDL_atomic_t _stCallbacks;
+static SDL_atomic_t _stLateCallbacks;
+static SDL_atomic_t _stUnderruns;
+static SDL_atomic_t _stResync;
+static uint64_t     _u64Period;
+static uint64_t     _u64Deadline; // Audio thread only.
+
+static CachedMusicPlayback _stPlayback;
+static uint64_t            _u64MusicCacheBudget;
+static uint64_t            _u64CachedNs;       // Audio thread only.
+static uint64_t            _u64DecodeSavedNs;  // Audio thread only.
+static uint64_t            _u64CopyTicks;      // Audio thread only.
+static uint8_t             _u8MusicPaused;
+
+/* Called by SDL_mixer on the audio thread once per chunk.  The device
+ * drains a chunk every period, so each callback should arrive about one
+ * period after the previous one.  A callback more than half a period
+ * behind schedule is late; one more than a whole period behind means
+ * the device ran dry in the meantime.  The engine's voices are mixed
+ * into the output of SDL_mixer here as well. */
+static void _PostMix(void *pUserData, Uint8 *pu8Stream, int s32Length)
+{
+    uint64_t u64Now = SDL_GetPerformanceCounter();
+
+    if (pUserData)
+    {
+        MixVoices((VoicePool *)pUserData, pu8Stream, s32Length);
+    }
+
+    SDL_AtomicAdd(&_stCallbacks, 1);
+
+    if (SDL_AtomicSet(&_stResync, 0))
+    {
+        _u64Deadline = u64Now + _u64Period;
+        return;
+    }
+
+    if (u64Now > _u64Deadline + _u64Period)
+    {
+        SDL_AtomicAdd(&_stUnderruns, 1);
+        _u64Deadline = u64Now + _u64Period;
+        return;
+    }
+
+    if (u64Now > _u64Deadline + _u64Period / 2)
+    {
+        SDL_AtomicAdd(&_stLateCallbacks, 1);
+    }
+
+    // Some backends ask for several chunks in a row; don't let that
+    // build up credit which would hide a later stall.
+    _u64Deadline += _u64Period;
+    if (_u64Deadline > u64Now + 2 * _u64Period)
+    {
+        _u64Deadline = u64Now + _u64Period;
+    }
+}
+
+static void _ResetCallbackCounters()
+{
+    SDL_AtomicSet(&_stCallbacks,     0);
+    SDL_AtomicSet(&_stLateCallbacks, 0);
+    SDL_AtomicSet(&_stUnderruns,     0);
+    SDL_AtomicSet(&_stResync,        1);
+}
+
+static int8_t _OpenAudio(Mixer *pstMixer, uint16_t u16ChunkSize)
+{
+    int      s32Frequency;
+    Uint16   u16Format;
+    int      s32Channels;
+    int32_t  s32Status;
+
+    TRACE_BEGIN("Mix_OpenAudio");
+    s32Status = Mix_OpenAudio(
+        pstMixer->u16SamplingFrequency,
+        pstMixer->u16AudioFormat,
+        pstMixer->u8NumChannels,
+        u16ChunkSize);
+    TRACE_END("Mix_OpenAudio");
+
+    if (-1 == s32Status)
+    {
+        fprintf(stderr, "%s\n", Mix_GetError());
+        return -1;
+    }
+
+    // The device may not support what we asked for.
+    if (Mix_QuerySpec(&s32Frequency, &u16Format, &s32Channels))
+    {
+        pstMixer->u16SamplingFrequency = s32Frequency;
+        pstMixer->u16AudioFormat       = u16Format;
+        pstMixer->u8NumChannels        = s32Channels;
+    }
+    pstMixer->u16ChunkSize = u16ChunkSize;
+
+    _u64Period = SDL_GetPerformanceFrequency() * u16ChunkSize / pstMixer->u16SamplingFrequency;
+    _ResetCallbackCounters();
+    Mix_SetPostMix(_PostMix, NULL);
+
+    return 0;
+}
+
+/* Open the device with increasingly large chunks until one plays for a
+ * while without underrunning.  Falls back to the configured size. */
+static int8_t _OpenAudioLowLatency(Mixer *pstMixer, uint16_t u16MaxChunkSize)
+{
+    #ifndef __EMSCRIPTEN__
+    // Smallest first.
+    static const uint16_t _u16ProbeSizes[] = { 256, 512, 1024, 2048, 4096, 0 };
+
+    uint16_t u16Frequency = pstMixer->u16SamplingFrequency;
+    uint16_t u16Format    = pstMixer->u16AudioFormat;
+    uint8_t  u8Channels   = pstMixer->u8NumChannels;
+
+    for (uint8_t u8Index = 0; _u16ProbeSizes[u8Index] && _u16ProbeSizes[u8Index] < u16MaxChunkSize; u8Index++)
+    {
+        if (-1 == _OpenAudio(pstMixer, _u16ProbeSizes[u8Index]))
+        {
+            return -1;
+        }
+
+        // Opening the device causes a few irregular callbacks.
+        SDL_Delay(AUDIO_PROBE_SETTLE_MS);
+        _ResetCallbackCounters();
+        SDL_Delay(AUDIO_PROBE_MS);
+
+        if (SDL_AtomicGet(&_stCallbacks) > 0 && 0 == SDL_AtomicGet(&_stUnderruns))
+        {
+            _ResetCallbackCounters();
+            return 0;
+        }
+
+        Mix_SetPostMix(NULL, NULL);
+        Mix_CloseAudio();
+        pstMixer->u16SamplingFrequency = u16Frequency;
+        pstMixer->u16AudioFormat       = u16Format;
+        pstMixer->u8NumChannels        = u8Channels;
+    }
+    #endif
+
+    return _OpenAudio(pstMixer, u16MaxChunkSize);
+}
+
+/* Replaces SDL_mixer's music player while cached music is playing.
+ * Copying the samples is all that is left to do. */
+static void _PlayCachedMusic(void *pUserData, Uint8 *pu8Stream, int s32Length)
+{
+    CachedMusicPlayback *pstPlayback = (CachedMusicPlayback *)pUserData;
+    const MusicCache    *pstCache    = pstPlayback->pstCache;
+    int16_t             *ps16Stream  = (int16_t *)pu8Stream;
+    uint32_t             u32Frames   = s32Length / (sizeof(int16_t) * pstCache->u8Channels);
+    uint64_t             u64Start    = SDL_GetPerformanceCounter();
+
+    if (SDL_AtomicGet(&pstPlayback->stPaused) || pstPlayback->u8Finished)
+    {
+        memset(pu8Stream, 0, s32Length);
+        return;
+    }
+
+    while (u32Frames)
+    {
+        uint32_t       u32Count   = pstCache->u32Frames - pstPlayback->u32Position;
+        uint32_t       u32Samples;
+        const int16_t *ps16Source = pstCache->ps16Samples + pstPlayback->u32Position * pstCache->u8Channels;
+
+        if (u32Count > u32Frames)
+        {
+            u32Count = u32Frames;
+        }
+        u32Samples = u32Count * pstCache->u8Channels;
+
+        if (pstPlayback->u32FadePosition < pstPlayback->u32FadeFrames)
+        {
+            for (uint32_t u32Index = 0; u32Index < u32Samples; u32Index++)
+            {
+                uint32_t u32Frame = pstPlayback->u32FadePosition + u32Index / pstCache->u8Channels;
+
+                if (u32Frame > pstPlayback->u32FadeFrames)
+                {
+                    u32Frame = pstPlayback->u32FadeFrames;
+                }
+                ps16Stream[u32Index] = (int32_t)ps16Source[u32Index] * u32Frame / pstPlayback->u32FadeFrames;
+            }
+            pstPlayback->u32FadePosition += u32Count;
+        }
+        else
+        {
+            memcpy(ps16Stream, ps16Source, u32Samples * sizeof(int16_t));
+        }
+
+        _u64CachedNs             += (uint64_t)u32Count * 1000000000ULL / pstCache->u32Frequency;
+        _u64DecodeSavedNs        += (uint64_t)u32Count * pstCache->u64DecodeNs / pstCache->u32Frames;
+        ps16Stream               += u32Samples;
+        u32Frames                -= u32Count;
+        pstPlayback->u32Position += u32Count;
+
+        if (pstPlayback->u32Position == pstCache->u32Frames)
+        {
+            if (0 == pstPlayback->s8Loops)
+            {
+                pstPlayback->u8Finished = 1;
+                memset(ps16Stream, 0, u32Frames * sizeof(int16_t) * pstCache->u8Channels);
+                break;
+            }
+            if (0 < pstPlayback->s8Loops)
+            {
+                pstPlayback->s8Loops--;
+            }
+            pstPlayback->u32Position = 0;
+        }
+    }
+
+    _u64CopyTicks += SDL_GetPerformanceCounter() - u64Start;
+}
+
+static void _StopCachedMusic()
+{
+    if (_stPlayback.pstCache)
+    {
+        // Returns once the audio thread is done with the playback.
+        Mix_HookMusic(NULL, NULL);
+        _stPlayback.pstCache = NULL;
+    }
+}
+
+static void _StartCachedMusic(const MusicCache *pstCache, int8_t s8Loops, uint16_t u16FadeInMS)
+{
+    _StopCachedMusic();
+    Mix_HaltMusic();
+
+    _stPlayback.pstCache        = pstCache;
+    _stPlayback.u32Position     = 0;
+    _stPlayback.u32FadeFrames   = (uint64_t)pstCache->u32Frequency * u16FadeInMS / 1000;
+    _stPlayback.u32FadePosition = 0;
+    _stPlayback.s8Loops         = s8Loops;
+    _stPlayback.u8Finished      = 0;
+    SDL_AtomicSet(&_stPlayback.stPaused, _u8MusicPaused);
+
+    Mix_HookMusic(_PlayCachedMusic, &_stPlayback);
+}
+
+/* Decoding costs about the same on every playback, so the time the
+ * cached part of the music took to decode once is what was saved. */
+static void _PrintMusicCacheStats()
+{
+    double dPlayed = _u64CachedNs / 1e9;
+    double dSaved  = _u64DecodeSavedNs / 1e6;
+    double dCopy   = _u64CopyTicks * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if (0 == _u64CachedNs)
+    {
+        return;
+    }
+
+    printf("Music cache: played %.1f s from PCM; decoding would have taken %.1f ms"
+        " (%.2f%% of a core), copying took %.1f ms, saving %.1f ms.\n",
+        dPlayed,
+        dSaved,
+        dSaved / 10.0 / dPlayed,
+        dCopy,
+        dSaved - dCopy);
+}
+
+/**
+ * @brief   Play music loaded from now on from decoded PCM instead of
+ *          streaming it.  See @ref MusicCache.
+ * @param   u32BudgetMiB the maximum size of all mapped music in MiB.
+ *                       Music which doesn't fit is streamed.
+ * @ingroup Audio
+ */
+void EnableMusicCache(const uint32_t u32BudgetMiB)
+{
+    _u64MusicCacheBudget = (uint64_t)u32BudgetMiB * 1024 * 1024;
+}
 
 /**
  * @brief   Play music in using a fade-in effect.
@@ -26,6 +328,16 @@ int8_t FadeInMusic(
     int8_t    s8Loops,
     uint16_t  u16TimeInMS)
 {
+    _stStats.u32MusicPlayed++;
+    if (_u8Headless) { return 0; }
+
+    if (pstMusic->pstCache)
+    {
+        _StartCachedMusic(pstMusic->pstCache, s8Loops, u16TimeInMS);
+        return 0;
+    }
+    _StopCachedMusic();
+
     if (-1 == Mix_FadeInMusic(pstMusic->pstMusic, s8Loops, u16TimeInMS))
     {
         fprintf(stderr, "%s\n", Mix_GetError());
@@ -42,49 +354,189 @@ int8_t FadeInMusic(
  */
 void FreeMixer(Mixer *pstMixer)
 {
-    free(pstMixer);
+    FreeMemory(pstMixer);
+    if (_u8Headless) { return; }
+
+    _StopCachedMusic();
+    Mix_SetPostMix(NULL, NULL);
     Mix_CloseAudio();
     while(Mix_Init(0)) Mix_Quit();
+
+    FreeVoicePool(_pstVoices);
+    _pstVoices = NULL;
+
+    _PrintMusicCacheStats();
+}
+
+/**
+ * @brief   Free Music from memory.
+ * @param   pstMusic the Music.  See @ref struct Music.
+ * @ingroup Audio
+ */
+void FreeMusic(Music *pstMusic)
+{
+    if (NULL == pstMusic)
+    {
+        return;
+    }
+
+    if (pstMusic->pstCache)
+    {
+        if (_stPlayback.pstCache == pstMusic->pstCache)
+        {
+            _StopCachedMusic();
+        }
+        FreeMusicCache(pstMusic->pstCache);
+    }
+
+    Mix_FreeMusic(pstMusic->pstMusic);
+    FreeMemory(pstMusic);
+}
+
+/**
+ * @brief   Free a sound effect.  Voices which are still playing it are
+ *          stopped first.
+ * @param   pstSfx the sound effect, may be NULL.  See @ref struct Sfx.
+ * @ingroup Audio
+ */
+void FreeSfx(Sfx *pstSfx)
+{
+    if (NULL == pstSfx)
+    {
+        return;
+    }
+
+    if ((_pstVoices) && (pstSfx->pstSfx))
+    {
+        // Removing the callback locks the device, so no voice is being
+        // mixed while the ones reading these samples are stopped.
+        Mix_SetPostMix(NULL, NULL);
+        StopVoices(_pstVoices, (const int16_t *)pstSfx->pstSfx->abuf);
+        Mix_SetPostMix(_PostMix, _pstVoices);
+    }
+
+    // Halts the SDL_mixer channels playing it.
+    Mix_FreeChunk(pstSfx->pstSfx);
+    FreeMemory(pstSfx);
+}
+
+/**
+ * @brief   Get the playback statistics.
+ * @return  The statistics.  See @ref struct AudioStats.
+ * @ingroup Audio
+ */
+AudioStats GetAudioStats()
+{
+    AudioStats stStats = _stStats;
+
+    stStats.u32Callbacks     = SDL_AtomicGet(&_stCallbacks);
+    stStats.u32LateCallbacks = SDL_AtomicGet(&_stLateCallbacks);
+    stStats.u32Underruns     = SDL_AtomicGet(&_stUnderruns);
+
+    if (_pstVoices)
+    {
+        stStats.u32VoicesActive  = SDL_AtomicGet(&_pstVoices->stActive);
+        stStats.u32VoicesStolen  = SDL_AtomicGet(&_pstVoices->stStolen);
+        stStats.u32VoicesDropped = SDL_AtomicGet(&_pstVoices->stDropped);
+    }
+
+    return stStats;
 }
 
 /**
  * @brief   Initialise Mixer.
+ * @param   u16Frequency   sampling frequency in Hz.
+ * @param   u16ChunkSize   samples per audio callback.  With
+ *                         u8LowLatency set, the largest size tried.
+ * @param   u8Channels     output channels.
+ * @param   u16MixChannels number of SDL_mixer channels, used if the
+ *                         engine can't mix the device format itself.
+ * @param   u16Voices      number of sound effects which can play at
+ *                         once.
+ * @param   u8LowLatency   boolean value to pick the smallest chunk size
+ *                         which doesn't underrun on this machine.
+ * @param   u8Headless     boolean value to skip opening an audio device.
+ *                         Music and sound effects are counted but neither
+ *                         loaded nor played.
  * @return  Mixer on success, NULL on error.  See @ref struct Mixer.
  * @ingroup Audio
  */
-Mixer *InitMixer()
+Mixer *InitMixer(
+    const uint16_t u16Frequency,
+    const uint16_t u16ChunkSize,
+    const uint8_t  u8Channels,
+    const uint16_t u16MixChannels,
+    const uint16_t u16Voices,
+    const uint8_t  u8LowLatency,
+    const uint8_t  u8Headless)
 {
+    int8_t        s8Status;
     static Mixer *pstMixer;
-    pstMixer = malloc(sizeof(struct Mixer_t));
+    pstMixer = AllocMemory(MEMORY_AUDIO, sizeof(struct Mixer_t));
     if (NULL == pstMixer)
     {
         fprintf(stderr, "InitMixer(): error allocating memory.\n");
         return NULL;
     }
 
+    _u8Headless = u8Headless;
+    if (u8Headless)
+    {
+        pstMixer->u16AudioFormat       = MIX_DEFAULT_FORMAT;
+        pstMixer->u16ChunkSize         = 0;
+        pstMixer->u8NumChannels        = 0;
+        pstMixer->u16SamplingFrequency = 0;
+        pstMixer->u16MixChannels       = 0;
+        return pstMixer;
+    }
+
     if (-1 == SDL_Init(SDL_INIT_AUDIO))
     {
         fprintf(stderr, "Couldn't initialise SDL: %s\n", SDL_GetError());
-        free(pstMixer);
+        FreeMemory(pstMixer);
         return NULL;
     }
 
     pstMixer->u16AudioFormat       = MIX_DEFAULT_FORMAT;
-    pstMixer->u16ChunkSize         = 4096;
-    pstMixer->u8NumChannels        = 2;
-    pstMixer->u16SamplingFrequency = 44100;
+    pstMixer->u16ChunkSize         = u16ChunkSize;
+    pstMixer->u8NumChannels        = u8Channels;
+    pstMixer->u16SamplingFrequency = u16Frequency;
 
-    if (-1 == Mix_OpenAudio(
-            pstMixer->u16SamplingFrequency,
-            pstMixer->u16AudioFormat,
-            pstMixer->u8NumChannels,
-            pstMixer->u16ChunkSize))
+    if (u8LowLatency)
     {
-        fprintf(stderr, "%s\n", Mix_GetError());
-        free(pstMixer);
+        s8Status = _OpenAudioLowLatency(pstMixer, u16ChunkSize);
+    }
+    else
+    {
+        s8Status = _OpenAudio(pstMixer, u16ChunkSize);
+    }
+
+    if (-1 == s8Status)
+    {
+        FreeMemory(pstMixer);
         return NULL;
     }
-    Mix_AllocateChannels(16);
+    pstMixer->u16MixChannels = Mix_AllocateChannels(u16MixChannels);
+
+    // Sound effects are loaded in the device format, which the voice
+    // mixer has to understand.
+    if ((AUDIO_S16SYS == pstMixer->u16AudioFormat) && (2 >= pstMixer->u8NumChannels))
+    {
+        _pstVoices = InitVoicePool(u16Voices, pstMixer->u8NumChannels);
+    }
+
+    if (_pstVoices)
+    {
+        Mix_SetPostMix(_PostMix, _pstVoices);
+    }
+
+    printf("Audio: %u Hz, %u channel(s), %u samples per chunk (%.1f ms), %u voices (%s).\n",
+        pstMixer->u16SamplingFrequency,
+        pstMixer->u8NumChannels,
+        pstMixer->u16ChunkSize,
+        1000.0 * pstMixer->u16ChunkSize / pstMixer->u16SamplingFrequency,
+        _pstVoices ? _pstVoices->u16Voices : pstMixer->u16MixChannels,
+        _pstVoices ? GetVoiceMixerName() : "SDL_mixer");
 
     return pstMixer;
 }
@@ -98,19 +550,51 @@ Mixer *InitMixer()
 Music *InitMusic(const char *pacFilename)
 {
     static Music *pstMusic;
-    pstMusic = malloc(sizeof(struct Music_t));
+    pstMusic = AllocMemory(MEMORY_AUDIO, sizeof(struct Music_t));
     if (NULL == pstMusic)
     {
         fprintf(stderr, "InitMusic(): error allocating memory.\n");
         return NULL;
     }
 
+    pstMusic->pstMusic = NULL;
+    pstMusic->pstCache = NULL;
+
+    if (_u8Headless)
+    {
+        return pstMusic;
+    }
+
+    if (_u64MusicCacheBudget)
+    {
+        int    s32Frequency;
+        Uint16 u16Format;
+        int    s32Channels;
+
+        if (Mix_QuerySpec(&s32Frequency, &u16Format, &s32Channels))
+        {
+            pstMusic->pstCache = InitMusicCache(
+                pacFilename,
+                s32Frequency,
+                u16Format,
+                s32Channels,
+                _u64MusicCacheBudget);
+        }
+
+        if (pstMusic->pstCache)
+        {
+            return pstMusic;
+        }
+    }
+
+    TRACE_BEGIN("Mix_LoadMUS");
     pstMusic->pstMusic = Mix_LoadMUS(pacFilename);
+    TRACE_END("Mix_LoadMUS");
 
     if (NULL == pstMusic->pstMusic)
     {
         fprintf(stderr, "%s\n", Mix_GetError());
-        free(pstMusic);
+        FreeMemory(pstMusic);
         return NULL;
     }
 
@@ -126,25 +610,44 @@ Music *InitMusic(const char *pacFilename)
 Sfx *InitSfx(const char *pacFilename)
 {
     static Sfx *pstSfx;
-    pstSfx = malloc(sizeof(struct Sfx_t));
+    pstSfx = AllocMemory(MEMORY_AUDIO, sizeof(struct Sfx_t));
     if (NULL == pstSfx)
     {
         fprintf(stderr, "InitSfx(): error allocating memory.\n");
         return NULL;
     }
 
+    if (_u8Headless)
+    {
+        pstSfx->pstSfx = NULL;
+        return pstSfx;
+    }
+
+    TRACE_BEGIN("Mix_LoadWAV");
     pstSfx->pstSfx = Mix_LoadWAV(pacFilename);
+    TRACE_END("Mix_LoadWAV");
 
     if (NULL == pstSfx->pstSfx)
     {
         fprintf(stderr, "%s\n", Mix_GetError());
-        free(pstSfx);
+        FreeMemory(pstSfx);
         return NULL;
     }
 
     return pstSfx;
 }
 
+/**
+ * @brief   Pause Music playback.
+ * @ingroup Audio
+ */
+void PauseMusic()
+{
+    _u8MusicPaused = 1;
+    SDL_AtomicSet(&_stPlayback.stPaused, 1);
+    Mix_PauseMusic();
+}
+
 /**
  * @brief   Play Music.
  * @param   pstMusic the Music.  See @ref struct Music.
@@ -154,6 +657,16 @@ Sfx *InitSfx(const char *pacFilename)
  */
 int8_t PlayMusic(Music *pstMusic, int8_t s8Loops)
 {
+    _stStats.u32MusicPlayed++;
+    if (_u8Headless) { return 0; }
+
+    if (pstMusic->pstCache)
+    {
+        _StartCachedMusic(pstMusic->pstCache, s8Loops, 0);
+        return 0;
+    }
+    _StopCachedMusic();
+
     if (-1 == Mix_PlayMusic(pstMusic->pstMusic, s8Loops))
     {
         fprintf(stderr, "%s\n", Mix_GetError());
@@ -164,42 +677,71 @@ int8_t PlayMusic(Music *pstMusic, int8_t s8Loops)
 }
 
 /**
- * @brief   Play Sfx.
- * @param   pstSfx    a Sfx.  See @ref struct Sfx.
- * @param   s8Channel the mixer channel to use.
- * @param   s8Loops   number of loops, -1 plays the effect forever.
+ * @brief   Play Sfx.  Sound effects overlap; when too many are playing,
+ *          the oldest one of the lowest priority is cut off.
+ * @param   pstSfx     a Sfx.  See @ref struct Sfx.
+ * @param   fGain      the volume, 1.0 plays the effect unchanged.
+ * @param   fPan       -1.0 is left, 0.0 is centre and 1.0 is right.
+ * @param   u8Priority see @ref enum SfxPriority.
  * @return  0 on success, -1 on error.
  * @ingroup Audio
  */
 int8_t PlaySfx(
-    Sfx    *pstSfx,
-    int8_t  s8Channel,
-    int8_t  s8Loops)
+    Sfx           *pstSfx,
+    const float    fGain,
+    const float    fPan,
+    const uint8_t  u8Priority)
 {
-    if (0 == Mix_Playing(s8Channel))
+    int32_t s32Channel;
+
+    _stStats.u32SfxPlayed++;
+    if (_u8Headless) { return 0; }
+
+    if (_pstVoices)
     {
-        if (-1 == Mix_PlayChannel(s8Channel, pstSfx->pstSfx, s8Loops))
-        {
-            fprintf(stderr, "%s\n", Mix_GetError());
-            return -1;
-        }
+        return PlayVoice(
+            _pstVoices,
+            (const int16_t *)pstSfx->pstSfx->abuf,
+            pstSfx->pstSfx->alen / (sizeof(int16_t) * _pstVoices->u8Channels),
+            fGain,
+            fPan,
+            u8Priority,
+            0);
+    }
+
+    // SDL_mixer picks a free channel and neither pans nor steals.
+    s32Channel = Mix_PlayChannel(-1, pstSfx->pstSfx, 0);
+    if (-1 != s32Channel)
+    {
+        Mix_Volume(s32Channel, fGain * MIX_MAX_VOLUME);
     }
 
     return 0;
 }
 
+/**
+ * @brief   Resume Music playback.
+ * @ingroup Audio
+ */
+void ResumeMusic()
+{
+    _u8MusicPaused = 0;
+    SDL_AtomicSet(&_stPlayback.stPaused, 0);
+    Mix_ResumeMusic();
+}
+
 /**
  * @brief   Toggle Music playback.
  * @ingroup Audio
  */
 void ToggleMusic()
 {
-    if (Mix_PausedMusic())
+    if (_u8MusicPaused)
     {
-        Mix_ResumeMusic();
+        ResumeMusic();
     }
     else
     {
-        Mix_PauseMusic();
+        PauseMusic();
     }
 }
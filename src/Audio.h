@@ -8,6 +8,17 @@
 
 #include <SDL2/SDL_mixer.h>
 #include <stdint.h>
+#include "MusicCache.h"
+
+/**
+ * @ingroup Audio
+ */
+enum SfxPriority
+{
+    SFX_PRIORITY_LOW    = 0,
+    SFX_PRIORITY_NORMAL = 1,
+    SFX_PRIORITY_HIGH   = 2
+};
 
 /**
  * @ingroup Audio
@@ -17,13 +28,32 @@ typedef struct Mixer_t {
     uint16_t u16ChunkSize;
     uint8_t  u8NumChannels;
     uint16_t u16SamplingFrequency;
+    uint16_t u16MixChannels;
 } Mixer;
 
+/**
+ * @ingroup Audio
+ * @brief   Playback statistics.  A late callback arrived more than half
+ *          a chunk behind schedule, an underrun more than a whole chunk,
+ *          i.e. the device had nothing left to play.
+ */
+typedef struct AudioStats_t {
+    uint32_t u32MusicPlayed;
+    uint32_t u32SfxPlayed;
+    uint32_t u32Callbacks;
+    uint32_t u32LateCallbacks;
+    uint32_t u32Underruns;
+    uint32_t u32VoicesActive;
+    uint32_t u32VoicesStolen;
+    uint32_t u32VoicesDropped;
+} AudioStats;
+
 /**
  * @ingroup Audio
  */
 typedef struct Music_t {
-    Mix_Music *pstMusic;
+    Mix_Music  *pstMusic;
+    MusicCache *pstCache;
 } Music;
 
 /**
@@ -33,25 +63,43 @@ typedef struct Sfx_t {
     Mix_Chunk *pstSfx;
 } Sfx;
 
+void EnableMusicCache(const uint32_t u32BudgetMiB);
+
 int8_t FadeInMusic(
     Music    *pstMusic,
     int8_t    s8Loops,
     uint16_t  u16TimeInMS);
 
-void   FreeMixer(Mixer *pstMixer);
-Mixer *InitMixer();
+void       FreeMixer(Mixer *pstMixer);
+void       FreeMusic(Music *pstMusic);
+void       FreeSfx(Sfx *pstSfx);
+AudioStats GetAudioStats();
+
+Mixer *InitMixer(
+    const uint16_t u16Frequency,
+    const uint16_t u16ChunkSize,
+    const uint8_t  u8Channels,
+    const uint16_t u16MixChannels,
+    const uint16_t u16Voices,
+    const uint8_t  u8LowLatency,
+    const uint8_t  u8Headless);
+
 Music *InitMusic(const char *pacFilename);
 Sfx   *InitSfx(const char *pacFilename);
 
+void PauseMusic();
+
 int8_t PlayMusic(
     Music  *pstMusic,
     int8_t  s8Loops);
 
 int8_t PlaySfx(
-    Sfx    *pstSfx,
-    int8_t  s8Channel,
-    int8_t  s8Loops);
+    Sfx           *pstSfx,
+    const float    fGain,
+    const float    fPan,
+    const uint8_t  u8Priority);
 
+void ResumeMusic();
 void ToggleMusic();
 
 #endif // _AUDIO_H_
@@ -2,7 +2,11 @@
  * @file      Background.c
  * @ingroup   Background
  * @defgroup  Background
- * @brief     A handler to manage parallax scrolling backgrounds.
+ * @brief     A handler to manage parallax scrolling backgrounds.  The
+ *            images are drawn through a SpriteBatch, straight from the
+ *            texture atlas if they have been packed.  The images of
+ *            several backgrounds which haven't can be decoded in
+ *            parallel, see InitBackgrounds().
  * @author    Michael Fitzmayer
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
@@ -11,165 +15,187 @@
 #include <SDL2/SDL_image.h>
 #include <stdint.h>
 #include "Background.h"
+#include "Job.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "SpriteBatch.h"
+#include "Trace.h"
+#include "Video.h"
 
-static SDL_Texture *_RenderLayer(
-    SDL_Renderer  *pstRenderer,
-    const char    *pacFilename,
-    const int32_t  s32WindowWidth)
+/* What the jobs of InitBackgrounds() work on. */
+typedef struct BackgroundImages_t
 {
-    SDL_Texture *pstImage       = NULL;
-    SDL_Texture *pstLayer       = NULL;
-    int32_t      s32ImageWidth  = 0;
-    int32_t      s32ImageHeight = 0;
-    int32_t      s32LayerHeight = 0;
-    int32_t      s32LayerWidth  = 0;
-    uint8_t      u8WidthFactor  = 0;
-
-    pstImage = IMG_LoadTexture(pstRenderer, pacFilename);
-    if (NULL == pstImage)
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return NULL;
-    }
+    const char  **ppacFilenames;
+    SDL_Surface **ppstImages;
+} BackgroundImages;
 
-    if (0 != SDL_QueryTexture(pstImage, NULL, NULL, &s32ImageWidth, &s32ImageHeight))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstImage);
-        return NULL;
-    }
-
-    u8WidthFactor  = ceil((double)s32WindowWidth / (double)s32ImageWidth);
-    s32LayerWidth  = s32ImageWidth * u8WidthFactor;
-    s32LayerHeight = s32ImageHeight;
-    pstLayer       = SDL_CreateTexture(
-        pstRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_TARGET,
-        s32LayerWidth,
-        s32LayerHeight);
+static uint8_t _IsPacked(const char *pacFilename)
+{
+    const char *pacPage;
+    SDL_Rect    stRect;
 
-    if (NULL == pstLayer)
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstImage);
-        return 0;
-    }
+    return FindAtlasImage(pacFilename, &pacPage, &stRect);
+}
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, pstLayer))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
-    }
+/* Decoding doesn't need the renderer, so it can happen on any thread.
+ * Images in the atlas are left out. */
+static void _DecodeImages(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    BackgroundImages *pstImages = (BackgroundImages *)pData;
 
-    SDL_Rect stDst;
-    stDst.x = 0;
-    for (uint8_t u8Index = 0; u8Index < u8WidthFactor; u8Index++)
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
     {
-        stDst.y  = 0;
-        stDst.w  = s32ImageWidth;
-        stDst.h  = s32ImageHeight;
-        SDL_RenderCopy(pstRenderer, pstImage, NULL, &stDst);
-        stDst.x += s32ImageWidth;
-    }
+        pstImages->ppstImages[u32Index] = NULL;
+        if (_IsPacked(pstImages->ppacFilenames[u32Index]))
+        {
+            continue;
+        }
 
-    if (0 != SDL_SetTextureBlendMode(pstLayer, SDL_BLENDMODE_BLEND))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
-    }
+        TRACE_BEGIN("IMG_Load");
+        pstImages->ppstImages[u32Index] = IMG_Load(pstImages->ppacFilenames[u32Index]);
+        TRACE_END("IMG_Load");
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, NULL))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
+        if (NULL == pstImages->ppstImages[u32Index])
+        {
+            fprintf(stderr, "%s\n", IMG_GetError());
+        }
     }
-
-    return pstLayer;
 }
 
 /**
- * @brief   Draw Background on screen.
- * @param   pstRenderer     a SDL rendering context.  See @ref struct Video.
+ * @brief   Queue Background for drawing.  Doesn't modify it, so a copy
+ *          can be drawn while the original is being updated.
+ * @param   pstBatch        a SpriteBatch.  See @ref struct SpriteBatch.
  * @param   pstBackground   the Background to render.  See @ref struct Background.
- * @param   dCameraPosX     camera position along the x-axis.
+ * @param   u8Layer         the layer of the SpriteBatch to draw on.
  * @param   dCameraPosY     camera position along the y-axis.
  * @return  0 on success, -1 on failure.
  * @ingroup Background
  */
 int8_t DrawBackground(
-    SDL_Renderer *pstRenderer,
-    Background   *pstBackground,
-    double        dCameraPosY)
+    SpriteBatch      *pstBatch,
+    const Background *pstBackground,
+    const uint8_t     u8Layer,
+    double            dCameraPosY)
 {
-    int32_t  s32Width = 0;
-    double   dPosXa;
-    double   dPosXb;
+    double   dPosX[2];
     SDL_Rect stDst;
 
-    if (0 != SDL_QueryTexture(pstBackground->pstLayer, NULL, NULL, &s32Width, NULL))
+    dPosX[0] = pstBackground->dWorldPosX;
+    if (dPosX[0] > 0)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        dPosX[1] = dPosX[0] - pstBackground->s32Width;
+    }
+    else
+    {
+        dPosX[1] = dPosX[0] + pstBackground->s32Width;
     }
 
-    if (pstBackground->dWorldPosX < -s32Width)
+    stDst.y = pstBackground->dWorldPosY - dCameraPosY;
+    stDst.w = pstBackground->stImageRect.w;
+    stDst.h = pstBackground->stImageRect.h;
+
+    for (uint8_t u8Half = 0; u8Half < 2; u8Half++)
     {
-        pstBackground->dWorldPosX = +s32Width;
+        stDst.x = dPosX[u8Half];
+        for (uint8_t u8Index = 0; u8Index < pstBackground->u8WidthFactor; u8Index++)
+        {
+            if (-1 == AddSprite(
+                    pstBatch,
+                    pstBackground->pstImage,
+                    u8Layer,
+                    &pstBackground->stImageRect,
+                    &stDst,
+                    SDL_FLIP_NONE))
+            {
+                return -1;
+            }
+            stDst.x += stDst.w;
+        }
     }
 
-    if (pstBackground->dWorldPosX > +s32Width)
+    return 0;
+}
+
+/**
+ * @brief   Free Background from memory and release its image.
+ * @param   pstBackground a Background, may be NULL.  See @ref struct Background.
+ * @ingroup Background
+ */
+void FreeBackground(Background *pstBackground)
+{
+    if (NULL == pstBackground)
     {
-        pstBackground->dWorldPosX = -s32Width;
+        return;
     }
 
-    dPosXa = pstBackground->dWorldPosX;
-    if (dPosXa > 0)
+    if (pstBackground->stImage.u32Id)
     {
-        dPosXb = dPosXa - s32Width;
+        ReleaseTexture(pstBackground->stImage);
     }
     else
     {
-        dPosXb = dPosXa + s32Width;
+        DestroyTexture(pstBackground->pstImage);
     }
+    FreeMemory(pstBackground);
+}
 
-    if (pstBackground->dVelocity > 0)
+/* Create a Background from a decoded image, which is owned by the
+ * caller, or from the atlas if pstImage is NULL. */
+static Background *_CreateBackground(
+    SDL_Renderer *pstRenderer,
+    const char   *pacFilename,
+    SDL_Surface  *pstImage,
+    int32_t       s32WindowWidth)
+{
+    static Background *pstBackground;
+    pstBackground = CallocMemory(MEMORY_BACKGROUND, 1, sizeof(struct Background_t));
+
+    if (NULL == pstBackground)
     {
-        if ((pstBackground->u16Flags >> BACKGROUND_SCROLL_DIRECTION) & 1)
+        fprintf(stderr, "InitBackground(): error allocating memory.\n");
+        return NULL;
+    }
+
+    if (NULL == pstImage)
+    {
+        pstBackground->stImage = AcquireImage(
+            pstRenderer,
+            pacFilename,
+            &pstBackground->stImageRect);
+
+        pstBackground->pstImage = GetTexture(pstBackground->stImage);
+    }
+    else
+    {
+        pstBackground->pstImage = CreateTextureFromSurface(pstRenderer, pstImage);
+        pstBackground->stImageRect.w = pstImage->w;
+        pstBackground->stImageRect.h = pstImage->h;
+
+        if ((pstBackground->pstImage) &&
+            (0 != SDL_SetTextureBlendMode(pstBackground->pstImage, SDL_BLENDMODE_BLEND)))
         {
-            pstBackground->dWorldPosX -= pstBackground->dVelocity;
+            DestroyTexture(pstBackground->pstImage);
+            pstBackground->pstImage = NULL;
         }
-        else
+
+        if (NULL == pstBackground->pstImage)
         {
-            pstBackground->dWorldPosX += pstBackground->dVelocity;
+            fprintf(stderr, "%s\n", SDL_GetError());
         }
     }
 
-    stDst.x = dPosXa;
-    stDst.y = pstBackground->dWorldPosY - dCameraPosY;
-    stDst.w = s32Width;
-    stDst.h = pstBackground->s32Height;
-
-    if (-1 == SDL_RenderCopyEx(pstRenderer, pstBackground->pstLayer, NULL, &stDst, 0, NULL, SDL_FLIP_NONE))
+    if ((NULL == pstBackground->pstImage) || (0 == pstBackground->stImageRect.w))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        FreeBackground(pstBackground);
+        return NULL;
     }
 
-    stDst.x = dPosXb;
-    if (-1 == SDL_RenderCopyEx(pstRenderer, pstBackground->pstLayer, NULL, &stDst, 0, NULL, SDL_FLIP_NONE))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
-    }
+    pstBackground->u8WidthFactor = ceil((double)s32WindowWidth / (double)pstBackground->stImageRect.w);
+    pstBackground->s32Width      = pstBackground->stImageRect.w * pstBackground->u8WidthFactor;
+    pstBackground->s32Height     = pstBackground->stImageRect.h;
 
-    return 0;
+    return pstBackground;
 }
 
 /**
@@ -185,42 +211,121 @@ Background *InitBackground(
     const char   *pacFilename,
     int32_t       s32WindowWidth)
 {
-    static Background *pstBackground;
-    pstBackground = malloc(sizeof(struct Background_t));
+    BackgroundImages  stImages;
+    Background       *pstBackground;
+    SDL_Surface      *pstImage;
+    const char       *ppacFilenames[1] = { pacFilename };
 
-    if (NULL == pstBackground)
+    stImages.ppacFilenames = ppacFilenames;
+    stImages.ppstImages    = &pstImage;
+    _DecodeImages(&stImages, 0, 1);
+    if ((NULL == pstImage) && (0 == _IsPacked(pacFilename)))
     {
-        fprintf(stderr, "InitBackground(): error allocating memory.\n");
         return NULL;
     }
 
-    pstBackground->u16Flags = 0;
-    pstBackground->pstLayer = _RenderLayer(
-        pstRenderer,
-        pacFilename,
-        s32WindowWidth);
+    pstBackground = _CreateBackground(pstRenderer, pacFilename, pstImage, s32WindowWidth);
+    if (pstImage)
+    {
+        SDL_FreeSurface(pstImage);
+    }
+
+    return pstBackground;
+}
+
+/**
+ * @brief   Initialise several Backgrounds at once.  The images which
+ *          aren't part of the atlas are decoded in parallel, the
+ *          textures are created on the calling thread.
+ * @param   pstRenderer    a SDL rendering context.  See @ref struct Video.
+ * @param   pstJobs        a JobSystem, may be NULL.  See @ref struct JobSystem.
+ * @param   ppacFilenames  the filenames of the images.
+ * @param   u8Count        the number of Backgrounds.
+ * @param   s32WindowWidth the width of the window.  See @ref struct Video.
+ * @param   ppstBackgrounds set to u8Count Backgrounds on success, to
+ *                          NULL on failure.  See @ref struct Background.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Background
+ */
+int8_t InitBackgrounds(
+    SDL_Renderer *pstRenderer,
+    JobSystem    *pstJobs,
+    const char   *ppacFilenames[],
+    uint8_t       u8Count,
+    int32_t       s32WindowWidth,
+    Background   *ppstBackgrounds[])
+{
+    SDL_Surface     *pstImages[UINT8_MAX] = { NULL };
+    BackgroundImages stImages;
+    int8_t           s8Status = 0;
+
+    stImages.ppacFilenames = ppacFilenames;
+    stImages.ppstImages    = pstImages;
+    ParallelFor(pstJobs, u8Count, 1, _DecodeImages, &stImages);
 
-    if (NULL == pstBackground->pstLayer)
+    for (uint8_t u8Index = 0; u8Index < u8Count; u8Index++)
     {
-        free(pstBackground);
-        return NULL;
+        ppstBackgrounds[u8Index] = NULL;
+        if ((0 == s8Status) &&
+            ((pstImages[u8Index]) || (_IsPacked(ppacFilenames[u8Index]))))
+        {
+            ppstBackgrounds[u8Index] = _CreateBackground(
+                pstRenderer,
+                ppacFilenames[u8Index],
+                pstImages[u8Index],
+                s32WindowWidth);
+        }
+
+        if (NULL == ppstBackgrounds[u8Index])
+        {
+            s8Status = -1;
+        }
+
+        if (pstImages[u8Index])
+        {
+            SDL_FreeSurface(pstImages[u8Index]);
+        }
     }
 
-    if (0 != SDL_QueryTexture(
-            pstBackground->pstLayer,
-            NULL,
-            NULL,
-            &pstBackground->s32Width,
-            &pstBackground->s32Height))
+    if (-1 == s8Status)
     {
-        fprintf(stderr, "InitBackground(): Couldn't query SDL_Texture.\n");
-        free(pstBackground);
-        return NULL;
+        for (uint8_t u8Index = 0; u8Index < u8Count; u8Index++)
+        {
+            FreeBackground(ppstBackgrounds[u8Index]);
+            ppstBackgrounds[u8Index] = NULL;
+        }
     }
 
-    pstBackground->dWorldPosX = 0;
-    pstBackground->dWorldPosY = 0;
-    pstBackground->dVelocity  = 0;
+    return s8Status;
+}
 
-    return pstBackground;
+/**
+ * @brief   Scroll Background by its velocity.  This function has to
+ *          be called every frame.
+ * @param   pstBackground a Background.  See @ref struct Background.
+ * @ingroup Background
+ */
+void UpdateBackground(Background *pstBackground)
+{
+    if (pstBackground->dWorldPosX < -pstBackground->s32Width)
+    {
+        pstBackground->dWorldPosX = +pstBackground->s32Width;
+    }
+
+    if (pstBackground->dWorldPosX > +pstBackground->s32Width)
+    {
+        pstBackground->dWorldPosX = -pstBackground->s32Width;
+    }
+
+    if (pstBackground->dVelocity > 0)
+    {
+        if ((pstBackground->u16Flags >> BACKGROUND_SCROLL_DIRECTION) & 1)
+        {
+            pstBackground->dWorldPosX -= pstBackground->dVelocity;
+        }
+        else
+        {
+            pstBackground->dWorldPosX += pstBackground->dVelocity;
+        }
+    }
 }
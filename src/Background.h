@@ -8,6 +8,9 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include "Job.h"
+#include "Resource.h"
+#include "SpriteBatch.h"
 
 /**
  * @ingroup Background
@@ -18,28 +21,47 @@ enum BackgroundFlags
 };
 
 /**
- * @file    Background.h
  * @ingroup Background
+ * @brief   A background layer.  The image is repeated u8WidthFactor
+ *          times to cover the window.  It's either part of an atlas
+ *          page held by stImage, or a texture of its own if the
+ *          handle is invalid.
  */
 typedef struct Background_t
 {
-    SDL_Texture *pstLayer;
-    uint16_t     u16Flags;
-    int32_t      s32Width;
-    int32_t      s32Height;
-    double       dWorldPosX;
-    double       dWorldPosY;
-    double       dVelocity;
+    SDL_Texture   *pstImage;
+    TextureHandle  stImage;
+    SDL_Rect       stImageRect;
+    uint8_t        u8WidthFactor;
+    uint16_t       u16Flags;
+    int32_t        s32Width;
+    int32_t        s32Height;
+    double         dWorldPosX;
+    double         dWorldPosY;
+    double         dVelocity;
 } Background;
 
 int8_t DrawBackground(
-    SDL_Renderer *pstRenderer,
-    Background   *pstBackground,
-    double        dCameraPosY);
+    SpriteBatch      *pstBatch,
+    const Background *pstBackground,
+    const uint8_t     u8Layer,
+    double            dCameraPosY);
+
+void FreeBackground(Background *pstBackground);
 
 Background *InitBackground(
     SDL_Renderer *pstRenderer,
     const char   *pacFilename,
     int32_t       s32WindowWidth);
 
+int8_t InitBackgrounds(
+    SDL_Renderer *pstRenderer,
+    JobSystem    *pstJobs,
+    const char   *ppacFilenames[],
+    uint8_t       u8Count,
+    int32_t       s32WindowWidth,
+    Background   *ppstBackgrounds[]);
+
+void UpdateBackground(Background *pstBackground);
+
 #endif // _BACKGROUND_H_
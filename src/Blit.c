@@ -0,0 +1,430 @@
+/**
+ * @file      Blit.c
+ * @ingroup   Blit
+ * @defgroup  Blit
+ * @brief     Blitters for the software renderer, which write straight
+ *            into ARGB8888 pixels: unscaled copies and alpha blended
+ *            blits, optionally flipped horizontally, and the upscale of
+ *            the frame to the window.  Blending follows
+ *            SDL_BLENDMODE_BLEND and uses AVX2 or SSE2 where available;
+ *            runs of opaque or transparent pixels are copied or skipped.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <string.h>
+#include "Blit.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define BLIT_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+#include <immintrin.h>
+#define BLIT_AVX2
+#endif
+
+#define ALPHA_MASK 0xff000000
+
+/* Blend s32Count pixels of a row.  If flipped, pu32Src points to the
+ * rightmost source pixel and is read from right to left. */
+typedef void (*BlendFunc)(
+    uint32_t       *pu32Dst,
+    const uint32_t *pu32Src,
+    int32_t         s32Count,
+    uint8_t         u8Flip);
+
+static BlendFunc   _pfnBlend;
+static const char *_pacKernelName;
+
+/* x / 255 for x <= 255 * 255, rounded. */
+static uint32_t _Div255(uint32_t u32Value)
+{
+    u32Value += 128;
+    return (u32Value + (u32Value >> 8)) >> 8;
+}
+
+/* dstRGB = srcRGB * srcA + dstRGB * (1 - srcA)
+ * dstA   = srcA + dstA * (1 - srcA) */
+static uint32_t _BlendPixel(uint32_t u32Dst, uint32_t u32Src)
+{
+    uint32_t u32Alpha   = u32Src >> 24;
+    uint32_t u32Inverse = 255 - u32Alpha;
+
+    if (255 == u32Alpha)
+    {
+        return u32Src;
+    }
+
+    if (0 == u32Alpha)
+    {
+        return u32Dst;
+    }
+
+    return
+        (_Div255(u32Alpha * 255                   + (u32Dst >> 24)         * u32Inverse) << 24) |
+        (_Div255(((u32Src >> 16) & 0xff) * u32Alpha + ((u32Dst >> 16) & 0xff) * u32Inverse) << 16) |
+        (_Div255(((u32Src >>  8) & 0xff) * u32Alpha + ((u32Dst >>  8) & 0xff) * u32Inverse) <<  8) |
+        (_Div255(( u32Src        & 0xff) * u32Alpha + ( u32Dst        & 0xff) * u32Inverse));
+}
+
+static void _BlendScalar(
+    uint32_t       *pu32Dst,
+    const uint32_t *pu32Src,
+    int32_t         s32Count,
+    uint8_t         u8Flip)
+{
+    int32_t s32Step = u8Flip ? -1 : 1;
+
+    for (int32_t s32Index = 0; s32Index < s32Count; s32Index++)
+    {
+        pu32Dst[s32Index] = _BlendPixel(pu32Dst[s32Index], *pu32Src);
+        pu32Src          += s32Step;
+    }
+}
+
+#ifdef BLIT_SSE2
+/* Two pixels widened to 16 bits per channel. */
+static __m128i _Blend2SSE2(__m128i stDst, __m128i stSrc)
+{
+    const __m128i stAlphaLane = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m128i st255       = _mm_set1_epi16(255);
+    const __m128i st128       = _mm_set1_epi16(128);
+    __m128i       stAlpha;
+    __m128i       stFactor;
+    __m128i       stValue;
+
+    stAlpha  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(stSrc, 0xff), 0xff);
+    stFactor = _mm_or_si128(_mm_andnot_si128(stAlphaLane, stAlpha), _mm_and_si128(stAlphaLane, st255));
+    stValue  = _mm_add_epi16(
+        _mm_mullo_epi16(stSrc, stFactor),
+        _mm_mullo_epi16(stDst, _mm_sub_epi16(st255, stAlpha)));
+
+    stValue = _mm_add_epi16(stValue, st128);
+    return _mm_srli_epi16(_mm_add_epi16(stValue, _mm_srli_epi16(stValue, 8)), 8);
+}
+
+static void _BlendSSE2(
+    uint32_t       *pu32Dst,
+    const uint32_t *pu32Src,
+    int32_t         s32Count,
+    uint8_t         u8Flip)
+{
+    const __m128i stMask  = _mm_set1_epi32((int)ALPHA_MASK);
+    const __m128i stZero  = _mm_setzero_si128();
+    int32_t       s32Index = 0;
+
+    for (; s32Index + 4 <= s32Count; s32Index += 4)
+    {
+        __m128i stSrc;
+        __m128i stDst;
+        __m128i stAlpha;
+
+        if (u8Flip)
+        {
+            stSrc = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(pu32Src - s32Index - 3)), 0x1b);
+        }
+        else
+        {
+            stSrc = _mm_loadu_si128((const __m128i *)(pu32Src + s32Index));
+        }
+
+        stAlpha = _mm_and_si128(stSrc, stMask);
+        if (0xffff == _mm_movemask_epi8(_mm_cmpeq_epi32(stAlpha, stMask)))
+        {
+            _mm_storeu_si128((__m128i *)(pu32Dst + s32Index), stSrc);
+            continue;
+        }
+
+        if (0xffff == _mm_movemask_epi8(_mm_cmpeq_epi32(stAlpha, stZero)))
+        {
+            continue;
+        }
+
+        stDst = _mm_loadu_si128((const __m128i *)(pu32Dst + s32Index));
+        _mm_storeu_si128((__m128i *)(pu32Dst + s32Index), _mm_packus_epi16(
+            _Blend2SSE2(_mm_unpacklo_epi8(stDst, stZero), _mm_unpacklo_epi8(stSrc, stZero)),
+            _Blend2SSE2(_mm_unpackhi_epi8(stDst, stZero), _mm_unpackhi_epi8(stSrc, stZero))));
+    }
+
+    _BlendScalar(
+        pu32Dst + s32Index,
+        u8Flip ? pu32Src - s32Index : pu32Src + s32Index,
+        s32Count - s32Index,
+        u8Flip);
+}
+#endif
+
+#ifdef BLIT_AVX2
+__attribute__((target("avx2")))
+static __m256i _Blend4AVX2(__m256i stDst, __m256i stSrc)
+{
+    const __m256i stAlphaLane = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256i st255       = _mm256_set1_epi16(255);
+    const __m256i st128       = _mm256_set1_epi16(128);
+    __m256i       stAlpha;
+    __m256i       stFactor;
+    __m256i       stValue;
+
+    stAlpha  = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(stSrc, 0xff), 0xff);
+    stFactor = _mm256_blendv_epi8(stAlpha, st255, stAlphaLane);
+    stValue  = _mm256_add_epi16(
+        _mm256_mullo_epi16(stSrc, stFactor),
+        _mm256_mullo_epi16(stDst, _mm256_sub_epi16(st255, stAlpha)));
+
+    stValue = _mm256_add_epi16(stValue, st128);
+    return _mm256_srli_epi16(_mm256_add_epi16(stValue, _mm256_srli_epi16(stValue, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static void _BlendAVX2(
+    uint32_t       *pu32Dst,
+    const uint32_t *pu32Src,
+    int32_t         s32Count,
+    uint8_t         u8Flip)
+{
+    const __m256i stMask    = _mm256_set1_epi32((int)ALPHA_MASK);
+    const __m256i stZero    = _mm256_setzero_si256();
+    const __m256i stReverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int32_t       s32Index  = 0;
+
+    for (; s32Index + 8 <= s32Count; s32Index += 8)
+    {
+        __m256i stSrc;
+        __m256i stDst;
+        __m256i stAlpha;
+
+        if (u8Flip)
+        {
+            stSrc = _mm256_permutevar8x32_epi32(
+                _mm256_loadu_si256((const __m256i *)(pu32Src - s32Index - 7)),
+                stReverse);
+        }
+        else
+        {
+            stSrc = _mm256_loadu_si256((const __m256i *)(pu32Src + s32Index));
+        }
+
+        stAlpha = _mm256_and_si256(stSrc, stMask);
+        if (-1 == _mm256_movemask_epi8(_mm256_cmpeq_epi32(stAlpha, stMask)))
+        {
+            _mm256_storeu_si256((__m256i *)(pu32Dst + s32Index), stSrc);
+            continue;
+        }
+
+        if (-1 == _mm256_movemask_epi8(_mm256_cmpeq_epi32(stAlpha, stZero)))
+        {
+            continue;
+        }
+
+        // Unpacking works within 128-bit lanes, packing undoes it.
+        stDst = _mm256_loadu_si256((const __m256i *)(pu32Dst + s32Index));
+        _mm256_storeu_si256((__m256i *)(pu32Dst + s32Index), _mm256_packus_epi16(
+            _Blend4AVX2(_mm256_unpacklo_epi8(stDst, stZero), _mm256_unpacklo_epi8(stSrc, stZero)),
+            _Blend4AVX2(_mm256_unpackhi_epi8(stDst, stZero), _mm256_unpackhi_epi8(stSrc, stZero))));
+    }
+
+    _BlendScalar(
+        pu32Dst + s32Index,
+        u8Flip ? pu32Src - s32Index : pu32Src + s32Index,
+        s32Count - s32Index,
+        u8Flip);
+}
+#endif
+
+static void _SelectKernels()
+{
+    _pfnBlend      = _BlendScalar;
+    _pacKernelName = "scalar";
+
+    #ifdef BLIT_SSE2
+    _pfnBlend      = _BlendSSE2;
+    _pacKernelName = "SSE2";
+    #endif
+
+    #ifdef BLIT_AVX2
+    if (SDL_HasAVX2())
+    {
+        _pfnBlend      = _BlendAVX2;
+        _pacKernelName = "AVX2";
+    }
+    #endif
+}
+
+/**
+ * @brief   Draw (a part of) one image into another, unscaled.
+ * @param   pstDst     the pixels to draw into.  See @ref struct Pixels.
+ * @param   pstClip    the part of pstDst which may be changed, NULL for
+ *                     all of it.
+ * @param   pstSrc     the pixels to draw.  See @ref struct Pixels.
+ * @param   pstSrcRect the part of pstSrc to draw, NULL for all of it.
+ * @param   s32X       where the left edge of pstSrcRect ends up.
+ * @param   s32Y       where the top edge of pstSrcRect ends up.
+ * @param   u8Blend    boolean value to blend using the source alpha
+ *                     instead of copying the pixels as they are.
+ * @param   u8Flip     boolean value to flip horizontally.
+ * @ingroup Blit
+ */
+void BlitPixels(
+    const Pixels   *pstDst,
+    const SDL_Rect *pstClip,
+    const Pixels   *pstSrc,
+    const SDL_Rect *pstSrcRect,
+    const int32_t   s32X,
+    const int32_t   s32Y,
+    const uint8_t   u8Blend,
+    const uint8_t   u8Flip)
+{
+    SDL_Rect stSrc    = { 0, 0, pstSrc->s32Width, pstSrc->s32Height };
+    SDL_Rect stBounds = { 0, 0, pstDst->s32Width, pstDst->s32Height };
+    SDL_Rect stDst;
+    int32_t  s32SrcX;
+
+    if (NULL == _pfnBlend)
+    {
+        _SelectKernels();
+    }
+
+    if (pstSrcRect)
+    {
+        stSrc = *pstSrcRect;
+    }
+
+    if ((pstClip) && (SDL_FALSE == SDL_IntersectRect(pstClip, &stBounds, &stBounds)))
+    {
+        return;
+    }
+
+    stDst.x = s32X;
+    stDst.y = s32Y;
+    stDst.w = stSrc.w;
+    stDst.h = stSrc.h;
+    if (SDL_FALSE == SDL_IntersectRect(&stDst, &stBounds, &stDst))
+    {
+        return;
+    }
+
+    // The first source pixel to read; the rightmost one if flipped.
+    s32SrcX = stSrc.x + stDst.x - s32X;
+    if (u8Flip)
+    {
+        s32SrcX = stSrc.x + stSrc.w - 1 - (stDst.x - s32X);
+    }
+
+    for (int32_t s32Row = 0; s32Row < stDst.h; s32Row++)
+    {
+        uint32_t       *pu32Dst = pstDst->pu32Pixels + (stDst.y + s32Row) * pstDst->s32Pitch + stDst.x;
+        const uint32_t *pu32Src = pstSrc->pu32Pixels + (stSrc.y + stDst.y - s32Y + s32Row) * pstSrc->s32Pitch + s32SrcX;
+
+        if (u8Blend)
+        {
+            _pfnBlend(pu32Dst, pu32Src, stDst.w, u8Flip);
+        }
+        else if (u8Flip)
+        {
+            for (int32_t s32Index = 0; s32Index < stDst.w; s32Index++)
+            {
+                pu32Dst[s32Index] = pu32Src[-s32Index];
+            }
+        }
+        else
+        {
+            memcpy(pu32Dst, pu32Src, stDst.w * sizeof(uint32_t));
+        }
+    }
+}
+
+/**
+ * @brief   Fill a part of an image with a colour, without blending.
+ * @param   pstDst    the pixels to fill.  See @ref struct Pixels.
+ * @param   pstRect   the part to fill, NULL for all of it.
+ * @param   u32Colour the ARGB8888 colour.
+ * @ingroup Blit
+ */
+void FillPixels(const Pixels *pstDst, const SDL_Rect *pstRect, const uint32_t u32Colour)
+{
+    SDL_Rect stRect = { 0, 0, pstDst->s32Width, pstDst->s32Height };
+
+    if ((pstRect) && (SDL_FALSE == SDL_IntersectRect(pstRect, &stRect, &stRect)))
+    {
+        return;
+    }
+
+    for (int32_t s32Row = 0; s32Row < stRect.h; s32Row++)
+    {
+        uint32_t *pu32Dst = pstDst->pu32Pixels + (stRect.y + s32Row) * pstDst->s32Pitch + stRect.x;
+
+        if (0 == u32Colour)
+        {
+            memset(pu32Dst, 0, stRect.w * sizeof(uint32_t));
+            continue;
+        }
+
+        for (int32_t s32Index = 0; s32Index < stRect.w; s32Index++)
+        {
+            pu32Dst[s32Index] = u32Colour;
+        }
+    }
+}
+
+/**
+ * @brief   Get the name of the blending kernel in use.
+ * @return  "AVX2", "SSE2" or "scalar".
+ * @ingroup Blit
+ */
+const char *GetBlitKernelName()
+{
+    if (NULL == _pacKernelName)
+    {
+        _SelectKernels();
+    }
+
+    return _pacKernelName;
+}
+
+/**
+ * @brief   Scale an image up to a part of a larger one, picking the
+ *          nearest pixel.  Rows which come from the same source row
+ *          are copied from the one above.
+ * @param   pstDst       the pixels to draw into.  See @ref struct Pixels.
+ * @param   pstDstRect   the part of pstDst to draw.
+ * @param   pstSrc       the pixels to scale.  See @ref struct Pixels.
+ * @param   ps32Columns  the source column of every column of pstDst.
+ * @param   s32SrcHeight the number of source rows which are scaled to
+ *                       the height of pstDst.
+ * @ingroup Blit
+ */
+void ScalePixels(
+    const Pixels   *pstDst,
+    const SDL_Rect *pstDstRect,
+    const Pixels   *pstSrc,
+    const int32_t  *ps32Columns,
+    const int32_t   s32SrcHeight)
+{
+    int32_t s32PrevRow = -1;
+
+    for (int32_t s32Y = pstDstRect->y; s32Y < pstDstRect->y + pstDstRect->h; s32Y++)
+    {
+        int32_t         s32Row  = (int64_t)s32Y * s32SrcHeight / pstDst->s32Height;
+        uint32_t       *pu32Dst = pstDst->pu32Pixels + s32Y * pstDst->s32Pitch;
+        const uint32_t *pu32Src = pstSrc->pu32Pixels + s32Row * pstSrc->s32Pitch;
+
+        if (s32Row == s32PrevRow)
+        {
+            memcpy(
+                pu32Dst + pstDstRect->x,
+                pu32Dst - pstDst->s32Pitch + pstDstRect->x,
+                pstDstRect->w * sizeof(uint32_t));
+            continue;
+        }
+
+        for (int32_t s32X = pstDstRect->x; s32X < pstDstRect->x + pstDstRect->w; s32X++)
+        {
+            pu32Dst[s32X] = pu32Src[ps32Columns[s32X]];
+        }
+        s32PrevRow = s32Row;
+    }
+}
@@ -0,0 +1,46 @@
+/**
+ * @file    Blit.h
+ * @ingroup Blit
+ */
+
+#ifndef _BLIT_H_
+#define _BLIT_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Blit
+ * @brief   ARGB8888 pixels, e.g. of a surface or a locked texture.
+ *          s32Pitch is the distance between two rows in pixels.
+ */
+typedef struct Pixels_t
+{
+    uint32_t *pu32Pixels;
+    int32_t   s32Pitch;
+    int32_t   s32Width;
+    int32_t   s32Height;
+} Pixels;
+
+void BlitPixels(
+    const Pixels   *pstDst,
+    const SDL_Rect *pstClip,
+    const Pixels   *pstSrc,
+    const SDL_Rect *pstSrcRect,
+    const int32_t   s32X,
+    const int32_t   s32Y,
+    const uint8_t   u8Blend,
+    const uint8_t   u8Flip);
+
+void FillPixels(const Pixels *pstDst, const SDL_Rect *pstRect, const uint32_t u32Colour);
+
+const char *GetBlitKernelName();
+
+void ScalePixels(
+    const Pixels   *pstDst,
+    const SDL_Rect *pstDstRect,
+    const Pixels   *pstSrc,
+    const int32_t  *ps32Columns,
+    const int32_t   s32SrcHeight);
+
+#endif // _BLIT_H_
@@ -13,6 +13,30 @@
 #include "Config.h"
 #include "inih/ini.h"
 
+/* Command line options which are followed by a value. */
+static const char *_pacValueOptions[] = {
+    "--entities",
+    "--frames",
+    "--jobs",
+    "--record",
+    "--replay",
+    "--trace",
+    NULL
+};
+
+static uint8_t _TakesValue(const char *pacArg)
+{
+    for (uint8_t u8Index = 0; _pacValueOptions[u8Index]; u8Index++)
+    {
+        if (0 == strcmp(pacArg, _pacValueOptions[u8Index]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 static int32_t _Handler(
     void* pConfig,
     const char *pacSection,
@@ -24,11 +48,22 @@ static int32_t _Handler(
 
     #define MATCH(pacS, pacN) strcmp(pacSection, pacS) == 0 && strcmp(pacName, pacN) == 0
 
-    if      (MATCH("Video", "width"))      { pstConfig->stVideo.s32Width     = s32Value; }
-    else if (MATCH("Video", "height"))     { pstConfig->stVideo.s32Height    = s32Value; }
-    else if (MATCH("Video", "fullscreen")) { pstConfig->stVideo.s8Fullscreen = s32Value; }
-    else if (MATCH("Video", "fps"))        { pstConfig->stVideo.s8FPS        = s32Value; }
-    else if (MATCH("Video", "limitFPS"))   { pstConfig->stVideo.s8LimitFPS   = s32Value; }
+    if      (MATCH("Video", "width"))       { pstConfig->stVideo.s32Width       = s32Value; }
+    else if (MATCH("Video", "height"))      { pstConfig->stVideo.s32Height      = s32Value; }
+    else if (MATCH("Video", "fullscreen"))  { pstConfig->stVideo.s8Fullscreen   = s32Value; }
+    else if (MATCH("Video", "software"))    { pstConfig->stVideo.s8Software     = s32Value; }
+    else if (MATCH("Video", "native"))      { pstConfig->stVideo.s8Native       = s32Value; }
+    else if (MATCH("Video", "fps"))         { pstConfig->stVideo.s8FPS          = s32Value; }
+    else if (MATCH("Video", "limitFPS"))    { pstConfig->stVideo.s8LimitFPS     = s32Value; }
+    else if (MATCH("Audio", "frequency"))   { pstConfig->stAudio.s32Frequency   = s32Value; }
+    else if (MATCH("Audio", "chunkSize"))   { pstConfig->stAudio.s32ChunkSize   = s32Value; }
+    else if (MATCH("Audio", "channels"))    { pstConfig->stAudio.s8Channels     = s32Value; }
+    else if (MATCH("Audio", "mixChannels")) { pstConfig->stAudio.s16MixChannels = s32Value; }
+    else if (MATCH("Audio", "voices"))      { pstConfig->stAudio.s32Voices      = s32Value; }
+    else if (MATCH("Audio", "musicCache"))  { pstConfig->stAudio.s32MusicCache  = s32Value; }
+    else if (MATCH("Audio", "lowLatency"))  { pstConfig->stAudio.s8LowLatency   = s32Value; }
+    else if (MATCH("Dev",   "hotReload"))   { pstConfig->stDev.s8HotReload      = s32Value; }
+    else if (MATCH("Dev",   "metrics"))     { pstConfig->stDev.s8Metrics        = s32Value; }
     else
     {
         return 0;
@@ -37,6 +72,37 @@ static int32_t _Handler(
     return 1;
 }
 
+/**
+ * @brief   Get the filename of the configuration file from the
+ *          command line, i.e. the first argument which isn't an option.
+ * @param   s32ArgC argument count.
+ * @param   pacArgV argument vector.
+ * @return  The filename or the platform's default configuration file.
+ * @ingroup Config
+ */
+const char *GetConfigFilename(int32_t s32ArgC, char *pacArgV[])
+{
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        if ('-' != pacArgV[s32Index][0])
+        {
+            return pacArgV[s32Index];
+        }
+
+        // Skip the value of options which expect one.
+        if (_TakesValue(pacArgV[s32Index]))
+        {
+            s32Index++;
+        }
+    }
+
+    #ifndef __EMSCRIPTEN__
+    return "default.ini";
+    #else
+    return "emscripten.ini";
+    #endif
+}
+
 /**
  * @brief   Initialise Config.
  * @param   pacFilename the filename of the configuration file.
@@ -50,8 +116,30 @@ Config InitConfig(const char *pacFilename)
     stConfig.stVideo.s32Width      = 800;
     stConfig.stVideo.s32Height     = 600;
     stConfig.stVideo.s8Fullscreen  =   0;
+    stConfig.stVideo.s8Software    =   0;
+    stConfig.stVideo.s8Native      =   0;
     stConfig.stVideo.s8FPS         =  60;
     stConfig.stVideo.s8LimitFPS    =   1;
+    stConfig.stAudio.s32Frequency  = 44100;
+    stConfig.stAudio.s32ChunkSize  = 4096;
+    stConfig.stAudio.s8Channels    =   2;
+    stConfig.stAudio.s16MixChannels =  16;
+    stConfig.stAudio.s32Voices     = 256;
+    stConfig.stAudio.s32MusicCache =   0;
+    stConfig.stAudio.s8LowLatency  =   0;
+    stConfig.stDev.s8HotReload     =   0;
+    stConfig.stDev.s8Metrics       =   0;
+    stConfig.stRun.s8Headless      =   0;
+    stConfig.stRun.s8FixedStep     =   0;
+    stConfig.stRun.s8TrackMemory   =   0;
+    stConfig.stRun.s8AssertNoAlloc =   0;
+    stConfig.stRun.s8SimThread     =   0;
+    stConfig.stRun.s32Jobs         =  -1;
+    stConfig.stRun.u32MaxFrames    =   0;
+    stConfig.stRun.u32Entities     =   0;
+    stConfig.stRun.pacRecordFilename = NULL;
+    stConfig.stRun.pacReplayFilename = NULL;
+    stConfig.stRun.pacTraceFilename  = NULL;
 
     if (0 > ini_parse(pacFilename, _Handler, &stConfig))
     {
@@ -62,5 +150,135 @@ Config InitConfig(const char *pacFilename)
     if (0 > stConfig.stVideo.s32Height) { stConfig.stVideo.s32Height = abs(stConfig.stVideo.s32Height); }
     if (0 > stConfig.stVideo.s32Width)  { stConfig.stVideo.s32Width  = abs(stConfig.stVideo.s32Width);  }
 
+    // SDL_mixer wants a power of two; round down.  The chunk size is
+    // passed on as uint16_t, and 65536 would wrap around to 0.
+    if (0     >= stConfig.stAudio.s32ChunkSize) { stConfig.stAudio.s32ChunkSize = 4096;  }
+    if (256   >  stConfig.stAudio.s32ChunkSize) { stConfig.stAudio.s32ChunkSize = 256;   }
+    if (32768 <  stConfig.stAudio.s32ChunkSize) { stConfig.stAudio.s32ChunkSize = 32768; }
+    while (stConfig.stAudio.s32ChunkSize & (stConfig.stAudio.s32ChunkSize - 1))
+    {
+        stConfig.stAudio.s32ChunkSize &= stConfig.stAudio.s32ChunkSize - 1;
+    }
+    if (0 >= stConfig.stAudio.s32Frequency || 65535 < stConfig.stAudio.s32Frequency)
+    {
+        stConfig.stAudio.s32Frequency = 44100;
+    }
+    if (1 > stConfig.stAudio.s8Channels || 2 < stConfig.stAudio.s8Channels)
+    {
+        stConfig.stAudio.s8Channels = 2;
+    }
+    // SDL_mixer channels only play sound effects if the voice pool
+    // can't handle the device format; keep at least SDL_mixer's own
+    // default of 8 so that the fallback drops no more overlapping
+    // sounds than plain SDL_mixer would.
+    if (8 > stConfig.stAudio.s16MixChannels) { stConfig.stAudio.s16MixChannels = 8; }
+    if (0 > stConfig.stAudio.s32MusicCache) { stConfig.stAudio.s32MusicCache = 0; }
+    if (1 > stConfig.stAudio.s32Voices || UINT16_MAX < stConfig.stAudio.s32Voices)
+    {
+        stConfig.stAudio.s32Voices = 256;
+    }
+
     return stConfig;
 }
+
+/**
+ * @brief   Apply command line options to Config.
+ * @param   pstConfig the Config.  See @ref struct Config.
+ * @param   s32ArgC   argument count.
+ * @param   pacArgV   argument vector.
+ * @return  0 on success, -1 on unknown or incomplete options.
+ * @ingroup Config
+ */
+int8_t ParseArguments(
+    Config  *pstConfig,
+    int32_t  s32ArgC,
+    char    *pacArgV[])
+{
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        const char *pacArg = pacArgV[s32Index];
+
+        if ('-' != pacArg[0])
+        {
+            continue;
+        }
+
+        if (0 == strcmp(pacArg, "--headless"))
+        {
+            pstConfig->stRun.s8Headless = 1;
+        }
+        else if (0 == strcmp(pacArg, "--fixed-step"))
+        {
+            pstConfig->stRun.s8FixedStep = 1;
+        }
+        else if (0 == strcmp(pacArg, "--track-memory"))
+        {
+            pstConfig->stRun.s8TrackMemory = 1;
+        }
+        else if (0 == strcmp(pacArg, "--metrics"))
+        {
+            pstConfig->stDev.s8Metrics = 1;
+        }
+        else if (0 == strcmp(pacArg, "--assert-no-alloc"))
+        {
+            // Allocations are counted by the tracker.
+            pstConfig->stRun.s8TrackMemory   = 1;
+            pstConfig->stRun.s8AssertNoAlloc = 1;
+        }
+        else if (0 == strcmp(pacArg, "--sim-thread"))
+        {
+            pstConfig->stRun.s8SimThread = 1;
+        }
+        else if (0 == strcmp(pacArg, "--software"))
+        {
+            pstConfig->stVideo.s8Software = 1;
+        }
+        else if (0 == strcmp(pacArg, "--native"))
+        {
+            pstConfig->stVideo.s8Native = 1;
+        }
+        else if ((0 == strcmp(pacArg, "--jobs")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.s32Jobs = atoi(pacArgV[++s32Index]);
+        }
+        else if ((0 == strcmp(pacArg, "--frames")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.u32MaxFrames = strtoul(pacArgV[++s32Index], NULL, 10);
+        }
+        else if ((0 == strcmp(pacArg, "--entities")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.u32Entities = strtoul(pacArgV[++s32Index], NULL, 10);
+        }
+        else if ((0 == strcmp(pacArg, "--record")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.pacRecordFilename = pacArgV[++s32Index];
+        }
+        else if ((0 == strcmp(pacArg, "--replay")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.pacReplayFilename = pacArgV[++s32Index];
+        }
+        else if ((0 == strcmp(pacArg, "--trace")) && (s32Index + 1 < s32ArgC))
+        {
+            pstConfig->stRun.pacTraceFilename = pacArgV[++s32Index];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", pacArg);
+            fprintf(stderr,
+                "Usage: %s [config.ini] [--headless] [--fixed-step] [--frames N]"
+                " [--record FILE | --replay FILE] [--trace FILE] [--entities N]"
+                " [--track-memory] [--assert-no-alloc] [--metrics] [--sim-thread]"
+                " [--jobs N] [--software] [--native]\n",
+                pacArgV[0]);
+            return -1;
+        }
+    }
+
+    if (pstConfig->stRun.pacRecordFilename && pstConfig->stRun.pacReplayFilename)
+    {
+        fprintf(stderr, "--record and --replay can't be combined.\n");
+        return -1;
+    }
+
+    return 0;
+}
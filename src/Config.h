@@ -15,17 +15,67 @@ typedef struct VideoConfig_t {
     int32_t s32Height;
     int32_t s32Width;
     int8_t  s8Fullscreen;
+    int8_t  s8Software;
+    int8_t  s8Native;
     int8_t  s8LimitFPS;
     int8_t  s8FPS;
 } VideoConfig;
 
+/**
+ * @ingroup Config
+ */
+typedef struct AudioConfig_t {
+    int32_t s32Frequency;
+    int32_t s32ChunkSize;
+    int8_t  s8Channels;
+    int16_t s16MixChannels;
+    int32_t s32Voices;
+    int32_t s32MusicCache;
+    int8_t  s8LowLatency;
+} AudioConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct DevConfig_t {
+    int8_t s8HotReload;
+    int8_t s8Metrics;
+} DevConfig;
+
+/**
+ * @ingroup Config
+ * @brief   Settings passed on the command line.
+ */
+typedef struct RunConfig_t {
+    int8_t      s8Headless;
+    int8_t      s8FixedStep;
+    int8_t      s8TrackMemory;
+    int8_t      s8AssertNoAlloc;
+    int8_t      s8SimThread;
+    int32_t     s32Jobs;
+    uint32_t    u32MaxFrames;
+    uint32_t    u32Entities;
+    const char *pacRecordFilename;
+    const char *pacReplayFilename;
+    const char *pacTraceFilename;
+} RunConfig;
+
 /**
  * @ingroup Config
  */
 typedef struct Config_t {
     VideoConfig stVideo;
+    AudioConfig stAudio;
+    DevConfig   stDev;
+    RunConfig   stRun;
 } Config;
 
-Config InitConfig(const char *pcFilename);
+const char *GetConfigFilename(int32_t s32ArgC, char *pacArgV[]);
+Config      InitConfig(const char *pcFilename);
+
+int8_t ParseArguments(
+    Config  *pstConfig,
+    int32_t  s32ArgC,
+    char    *pacArgV[]);
 
 #endif // _CONFIG_H_
@@ -9,12 +9,80 @@
  */
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
 #include <stdint.h>
 #include <stdio.h>
 #include "AABB.h"
 #include "Entity.h"
 #include "Macros.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "SpriteBatch.h"
+#include "Video.h"
+
+static void _GetSpriteRects(
+    const EntitySprite *pstSprite,
+    double              dCameraPosX,
+    double              dCameraPosY,
+    SDL_Rect           *pstSrc,
+    SDL_Rect           *pstDst)
+{
+    double dRenderPosX = pstSprite->dWorldPosX - dCameraPosX;
+    double dRenderPosY = pstSprite->dWorldPosY - dCameraPosY;
+
+    pstDst->x = dRenderPosX;
+    pstDst->y = dRenderPosY;
+    pstDst->w = pstSprite->u8Width;
+    pstDst->h = pstSprite->u8Height;
+    pstSrc->x = pstSprite->s32SpriteX + pstSprite->u8Frame        * pstSprite->u8Width;
+    pstSrc->y = pstSprite->s32SpriteY + pstSprite->u8FrameOffsetY * pstSprite->u8Height;
+    pstSrc->w = pstSprite->u8Width;
+    pstSrc->h = pstSprite->u8Height;
+}
+
+/**
+ * @brief   Add an Entity to a SpriteBatch, from a copy.
+ * @param   pstBatch    the SpriteBatch.  See @ref struct SpriteBatch.
+ * @param   pstSprite   the copy.  See @ref struct EntitySprite.
+ * @param   u8Layer     the layer.  See @ref AddSprite().
+ * @param   dCameraPosX the camera position along the x-axis.
+ * @param   dCameraPosY the camera position along the y-axis.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Entity
+ */
+int8_t BatchEntitySprite(
+    SpriteBatch        *pstBatch,
+    const EntitySprite *pstSprite,
+    const uint8_t       u8Layer,
+    double              dCameraPosX,
+    double              dCameraPosY)
+{
+    SDL_Rect stDst;
+    SDL_Rect stSrc;
+
+    _GetSpriteRects(pstSprite, dCameraPosX, dCameraPosY, &stSrc, &stDst);
+
+    return AddSprite(pstBatch, pstSprite->pstSprite, u8Layer, &stSrc, &stDst, pstSprite->u8Flip);
+}
+
+/**
+ * @brief   Copy what is needed to draw an Entity.
+ * @param   pstEntity an Entity.  See @ref struct Entity.
+ * @param   pstSprite the copy.  See @ref struct EntitySprite.
+ * @ingroup Entity
+ */
+void CopyEntitySprite(const Entity *pstEntity, EntitySprite *pstSprite)
+{
+    pstSprite->pstSprite      = pstEntity->pstSprite;
+    pstSprite->s32SpriteX     = pstEntity->stSpriteRect.x;
+    pstSprite->s32SpriteY     = pstEntity->stSpriteRect.y;
+    pstSprite->dWorldPosX     = pstEntity->dWorldPosX;
+    pstSprite->dWorldPosY     = pstEntity->dWorldPosY;
+    pstSprite->u8Width        = pstEntity->u8Width;
+    pstSprite->u8Height       = pstEntity->u8Height;
+    pstSprite->u8Frame        = pstEntity->u8Frame;
+    pstSprite->u8FrameOffsetY = pstEntity->u8FrameOffsetY;
+    pstSprite->u8Flip         = (pstEntity->u16Flags >> ENTITY_DIRECTION) & 1;
+}
 
 /**
  * @brief   Draw Entity on screen.
@@ -31,30 +99,41 @@ int8_t DrawEntity(
     double        dCameraPosX,
     double        dCameraPosY)
 {
-    double           dRenderPosX;
-    double           dRenderPosY;
+    EntitySprite stSprite;
+
+    CopyEntitySprite(pstEntity, &stSprite);
+
+    return DrawEntitySprite(pstRenderer, &stSprite, dCameraPosX, dCameraPosY);
+}
+
+/**
+ * @brief   Draw an Entity from a copy.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstSprite   the copy.  See @ref struct EntitySprite.
+ * @param   dCameraPosX the camera position along the x-axis.
+ * @param   dCameraPosY the camera position along the y-axis.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Entity
+ */
+int8_t DrawEntitySprite(
+    SDL_Renderer       *pstRenderer,
+    const EntitySprite *pstSprite,
+    double              dCameraPosX,
+    double              dCameraPosY)
+{
     SDL_Rect         stDst;
     SDL_Rect         stSrc;
     SDL_RendererFlip s8Flip;
 
-    if (NULL == pstEntity->pstSprite)
+    if (NULL == pstSprite->pstSprite)
     {
         fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
-    dRenderPosX = pstEntity->dWorldPosX - dCameraPosX;
-    dRenderPosY = pstEntity->dWorldPosY - dCameraPosY;
-    stDst.x     = dRenderPosX;
-    stDst.y     = dRenderPosY;
-    stDst.w     = pstEntity->u8Width;
-    stDst.h     = pstEntity->u8Height;
-    stSrc.x     = pstEntity->u8Frame        * pstEntity->u8Width;
-    stSrc.y     = pstEntity->u8FrameOffsetY * pstEntity->u8Height;
-    stSrc.w     = pstEntity->u8Width;
-    stSrc.h     = pstEntity->u8Height;
-
-    if ((pstEntity->u16Flags >> ENTITY_DIRECTION) & 1)
+    _GetSpriteRects(pstSprite, dCameraPosX, dCameraPosY, &stSrc, &stDst);
+
+    if (pstSprite->u8Flip)
     {
         s8Flip = SDL_FLIP_HORIZONTAL;
     }
@@ -63,13 +142,11 @@ int8_t DrawEntity(
         s8Flip = SDL_FLIP_NONE;
     }
 
-    if (-1 == SDL_RenderCopyEx(
+    if (-1 == DrawTexture(
             pstRenderer,
-            pstEntity->pstSprite,
+            pstSprite->pstSprite,
             &stSrc,
             &stDst,
-            0,
-            NULL,
             s8Flip))
     {
         fprintf(stderr, "%s\n", SDL_GetError());
@@ -93,6 +170,22 @@ void FixEntityPositionY(Entity *pstEntity)
     }
 }
 
+/**
+ * @brief   Free Entity from memory and release its sprite.
+ * @param   pstEntity an Entity, may be NULL.  See @ref struct Entity.
+ * @ingroup Entity
+ */
+void FreeEntity(Entity *pstEntity)
+{
+    if (NULL == pstEntity)
+    {
+        return;
+    }
+
+    ReleaseTexture(pstEntity->stSprite);
+    FreeMemory(pstEntity);
+}
+
 /**
  * @brief   Initialise Entity.
  * @param   u8Width      width  of the Entity in pixel.
@@ -113,7 +206,7 @@ Entity *InitEntity(
     const uint32_t u32MapHeight)
 {
     static Entity *pstEntity;
-    pstEntity = malloc(sizeof(struct Entity_t));
+    pstEntity = AllocMemory(MEMORY_ENTITY, sizeof(struct Entity_t));
     if (NULL == pstEntity)
     {
         fprintf(stderr, "InitEntity(): error allocating memory.\n");
@@ -139,6 +232,11 @@ Entity *InitEntity(
     pstEntity->dWorldPosY               = dPosY;
 
     pstEntity->pstSprite                = NULL;
+    pstEntity->stSprite.u32Id           =   0;
+    pstEntity->stSpriteRect.x           =   0;
+    pstEntity->stSpriteRect.y           =   0;
+    pstEntity->stSpriteRect.w           =   0;
+    pstEntity->stSpriteRect.h           =   0;
     pstEntity->u8Frame                  =   0;
     pstEntity->dFrameDuration           =   0.0;
     pstEntity->stBB.dBottom             =   0;
@@ -174,7 +272,8 @@ int8_t IsEntityJumping(Entity *pstEntity)
 }
 
 /**
- * @brief   Load the entity's sprite image.
+ * @brief   Load the entity's sprite image.  Entities using the same
+ *          image, or images on the same atlas page, share one texture.
  * @param   pstEntity   an Entity.  See @ref struct Entity.
  * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
  * @param   pacFilename the filename of the image.
@@ -186,15 +285,15 @@ int8_t LoadEntitySprite(
     SDL_Renderer *pstRenderer,
     const char   *pacFilename)
 {
-    if (NULL != pstEntity->pstSprite)
-    {
-        SDL_DestroyTexture(pstEntity->pstSprite);
-    }
+    SDL_Rect      stSpriteRect;
+    TextureHandle stSprite = AcquireImage(pstRenderer, pacFilename, &stSpriteRect);
 
-    pstEntity->pstSprite = IMG_LoadTexture(pstRenderer, pacFilename);
+    ReleaseTexture(pstEntity->stSprite);
+    pstEntity->stSpriteRect = stSpriteRect;
+    pstEntity->stSprite  = stSprite;
+    pstEntity->pstSprite = GetTexture(stSprite);
     if (NULL == pstEntity->pstSprite)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
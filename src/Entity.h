@@ -8,6 +8,8 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include "AABB.h"
+#include "Resource.h"
+#include "SpriteBatch.h"
 
 /**
  * @ingroup Entity
@@ -27,39 +29,71 @@ enum EntityFlags
  */
 typedef struct Entity_t
 {
-    double       dAcceleration;
-    double       dDeceleration;
-    double       dJumpForce;
-    uint16_t     u16Flags;
-    uint8_t      u8Height;
-    uint8_t      u8Width;
-    uint32_t     u32MapWidth;
-    uint32_t     u32MapHeight;
-    double       dFrameAnimationFPS;
-    uint8_t      u8FrameStart;
-    uint8_t      u8FrameEnd;
-    uint8_t      u8FrameOffsetY;
-    double       dMaxVelocityX;
-    double       dWorldMeterInPixel;
-    double       dWorldGravitation;
-    double       dWorldPosX;
-    double       dWorldPosY;
+    double         dAcceleration;
+    double         dDeceleration;
+    double         dJumpForce;
+    uint16_t       u16Flags;
+    uint8_t        u8Height;
+    uint8_t        u8Width;
+    uint32_t       u32MapWidth;
+    uint32_t       u32MapHeight;
+    double         dFrameAnimationFPS;
+    uint8_t        u8FrameStart;
+    uint8_t        u8FrameEnd;
+    uint8_t        u8FrameOffsetY;
+    double         dMaxVelocityX;
+    double         dWorldMeterInPixel;
+    double         dWorldGravitation;
+    double         dWorldPosX;
+    double         dWorldPosY;
     /* Remark: the following variables are used internally to store
      * volatile values and usually do not have to be changed
      * manually. */
+    SDL_Texture   *pstSprite;
+    TextureHandle  stSprite;
+    SDL_Rect       stSpriteRect;
+    uint8_t        u8Frame;
+    double         dFrameDuration;
+    AABB           stBB;
+    double         dInitialJumpVelocity;
+    double         dInitialWorldPosX;
+    double         dInitialWorldPosY;
+    double         dInitialWorldGravitation;
+    double         dVelocityX;
+    double         dVelocityY;
+    double         dDistanceX;
+    double         dDistanceY;
+} Entity;
+
+/**
+ * @ingroup Entity
+ * @brief   Everything needed to draw an Entity, so it can be drawn
+ *          while the Entity itself is being updated on another thread.
+ *          s32SpriteX and s32SpriteY locate the sprite sheet on its
+ *          texture, which may be an atlas page.
+ */
+typedef struct EntitySprite_t
+{
     SDL_Texture *pstSprite;
+    int32_t      s32SpriteX;
+    int32_t      s32SpriteY;
+    double       dWorldPosX;
+    double       dWorldPosY;
+    uint8_t      u8Width;
+    uint8_t      u8Height;
     uint8_t      u8Frame;
-    double       dFrameDuration;
-    AABB         stBB;
-    double       dInitialJumpVelocity;
-    double       dInitialWorldPosX;
-    double       dInitialWorldPosY;
-    double       dInitialWorldGravitation;
-    double       dVelocityX;
-    double       dVelocityY;
-    double       dDistanceX;
-    double       dDistanceY;
-} Entity;
+    uint8_t      u8FrameOffsetY;
+    uint8_t      u8Flip;
+} EntitySprite;
+
+int8_t BatchEntitySprite(
+    SpriteBatch        *pstBatch,
+    const EntitySprite *pstSprite,
+    const uint8_t       u8Layer,
+    double              dCameraPosX,
+    double              dCameraPosY);
+
+void CopyEntitySprite(const Entity *pstEntity, EntitySprite *pstSprite);
 
 int8_t DrawEntity(
     SDL_Renderer *pstRenderer,
@@ -67,7 +101,14 @@ int8_t DrawEntity(
     double        dCameraPosX,
     double        dCameraPosY);
 
+int8_t DrawEntitySprite(
+    SDL_Renderer       *pstRenderer,
+    const EntitySprite *pstSprite,
+    double              dCameraPosX,
+    double              dCameraPosY);
+
 void FixEntityPositionY(Entity *pstEntity);
+void FreeEntity(Entity *pstEntity);
 
 Entity *InitEntity(
     const uint8_t  u8Width,
@@ -0,0 +1,249 @@
+/**
+ * @file      HotReload.c
+ * @ingroup   HotReload
+ * @defgroup  HotReload
+ * @brief     Development mode which watches the files of the loaded
+ *            map using inotify, so changes made in the Tiled Map Editor
+ *            show up without restarting the game.  Linux only.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HotReload.h"
+#include "Macros.h"
+#include "Map.h"
+#include "Memory.h"
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define HOT_RELOAD_SUPPORTED
+#endif
+
+#ifdef HOT_RELOAD_SUPPORTED
+
+/* Split pacPath into a newly allocated directory name and a pointer to
+ * the file name within pacPath. */
+static char *_SplitPath(const char *pacPath, const char **pacName)
+{
+    const char *pacSlash = strrchr(pacPath, '/');
+    size_t      sLength  = 1;
+    char       *pacDir;
+
+    if (pacSlash)
+    {
+        sLength  = pacSlash - pacPath;
+        *pacName = pacSlash + 1;
+    }
+    else
+    {
+        *pacName = pacPath;
+    }
+
+    pacDir = AllocMemory(MEMORY_ENGINE, sLength + 1);
+    if (NULL == pacDir)
+    {
+        return NULL;
+    }
+
+    if (pacSlash)
+    {
+        memcpy(pacDir, pacPath, sLength);
+    }
+    else
+    {
+        pacDir[0] = '.';
+    }
+    pacDir[sLength] = '\0';
+
+    return pacDir;
+}
+
+static char *_CopyString(const char *pacString)
+{
+    char *pacCopy = AllocMemory(MEMORY_ENGINE, strlen(pacString) + 1);
+    if (NULL == pacCopy)
+    {
+        return NULL;
+    }
+    memcpy(pacCopy, pacString, strlen(pacString) + 1);
+
+    return pacCopy;
+}
+
+/* Watch the directory instead of the file itself: most editors save by
+ * writing a temporary file and renaming it, which would silently drop
+ * a watch on the file. */
+static int32_t _WatchDirectory(int32_t s32Fd, const char *pacPath, char **pacName)
+{
+    const char *pacFileName;
+    char       *pacDir = _SplitPath(pacPath, &pacFileName);
+    int32_t     s32Watch;
+
+    if (NULL == pacDir)
+    {
+        return -1;
+    }
+
+    *pacName = _CopyString(pacFileName);
+    if (NULL == *pacName)
+    {
+        FreeMemory(pacDir);
+        return -1;
+    }
+
+    s32Watch = inotify_add_watch(s32Fd, pacDir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (-1 == s32Watch)
+    {
+        fprintf(stderr, "HotReload: couldn't watch %s: %s\n", pacDir, strerror(errno));
+    }
+    FreeMemory(pacDir);
+
+    return s32Watch;
+}
+
+static uint8_t _HasSuffix(const char *pacName, const char *pacSuffix)
+{
+    size_t sNameLength   = strlen(pacName);
+    size_t sSuffixLength = strlen(pacSuffix);
+
+    if (sNameLength < sSuffixLength)
+    {
+        return 0;
+    }
+
+    return 0 == strcmp(pacName + sNameLength - sSuffixLength, pacSuffix);
+}
+
+#endif // HOT_RELOAD_SUPPORTED
+
+/**
+ * @brief   Free HotReload from memory.
+ * @param   pstHotReload HotReload.  See @ref struct HotReload.
+ * @ingroup HotReload
+ */
+void FreeHotReload(HotReload *pstHotReload)
+{
+    if (NULL == pstHotReload)
+    {
+        return;
+    }
+
+    #ifdef HOT_RELOAD_SUPPORTED
+    close(pstHotReload->s32Fd);
+    #endif
+
+    FreeMemory(pstHotReload->pacMapName);
+    FreeMemory(pstHotReload->pacImageName);
+    FreeMemory(pstHotReload);
+}
+
+/**
+ * @brief   Initialise HotReload and start watching the TMX map, the
+ *          tilesets next to the tileset image and the image itself.
+ * @param   pstMap the Map to watch.  See @ref struct Map.
+ * @return  HotReload on success, NULL on error or if the platform
+ *          isn't supported.  See @ref struct HotReload.
+ * @ingroup HotReload
+ */
+HotReload *InitHotReload(const Map *pstMap)
+{
+    #ifdef HOT_RELOAD_SUPPORTED
+    static HotReload *pstHotReload;
+    pstHotReload = AllocMemory(MEMORY_ENGINE, sizeof(struct HotReload_t));
+    if (NULL == pstHotReload)
+    {
+        fprintf(stderr, "InitHotReload(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstHotReload->pacMapName   = NULL;
+    pstHotReload->pacImageName = NULL;
+    pstHotReload->s32Fd        = inotify_init1(IN_NONBLOCK);
+    if (-1 == pstHotReload->s32Fd)
+    {
+        fprintf(stderr, "HotReload: %s\n", strerror(errno));
+        FreeMemory(pstHotReload);
+        return NULL;
+    }
+
+    pstHotReload->s32Watch[0] = _WatchDirectory(
+        pstHotReload->s32Fd,
+        pstMap->pacFilename,
+        &pstHotReload->pacMapName);
+    pstHotReload->s32Watch[1] = _WatchDirectory(
+        pstHotReload->s32Fd,
+        pstMap->pacTilesetImageFilename,
+        &pstHotReload->pacImageName);
+
+    if ((-1 == pstHotReload->s32Watch[0]) || (-1 == pstHotReload->s32Watch[1]))
+    {
+        FreeHotReload(pstHotReload);
+        return NULL;
+    }
+
+    return pstHotReload;
+    #else
+    (void)pstMap;
+    fprintf(stderr, "HotReload: not supported on this platform.\n");
+    return NULL;
+    #endif
+}
+
+/**
+ * @brief   Check whether any of the watched files have changed.  Never
+ *          blocks, so it can be called once per frame.
+ * @param   pstHotReload HotReload.  See @ref struct HotReload.
+ * @return  The files which have changed.  See @ref enum MapReloadFlags.
+ * @ingroup HotReload
+ */
+uint16_t PollHotReload(HotReload *pstHotReload)
+{
+    uint16_t u16Flags = 0;
+
+    #ifdef HOT_RELOAD_SUPPORTED
+    char    acBuffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t sLength;
+
+    while (0 < (sLength = read(pstHotReload->s32Fd, acBuffer, sizeof(acBuffer))))
+    {
+        ssize_t sOffset = 0;
+        while (sOffset < sLength)
+        {
+            struct inotify_event *pstEvent =
+                (struct inotify_event *)(acBuffer + sOffset);
+
+            if (pstEvent->len)
+            {
+                if ((pstEvent->wd == pstHotReload->s32Watch[0]) &&
+                    (0 == strcmp(pstEvent->name, pstHotReload->pacMapName)))
+                {
+                    FLAG_SET(u16Flags, MAP_RELOAD_MAP);
+                }
+
+                if (_HasSuffix(pstEvent->name, ".tsx"))
+                {
+                    FLAG_SET(u16Flags, MAP_RELOAD_TILESET);
+                }
+
+                if ((pstEvent->wd == pstHotReload->s32Watch[1]) &&
+                    (0 == strcmp(pstEvent->name, pstHotReload->pacImageName)))
+                {
+                    FLAG_SET(u16Flags, MAP_RELOAD_IMAGE);
+                }
+            }
+
+            sOffset += sizeof(struct inotify_event) + pstEvent->len;
+        }
+    }
+    #else
+    (void)pstHotReload;
+    #endif
+
+    return u16Flags;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file    HotReload.h
+ * @ingroup HotReload
+ */
+
+#ifndef _HOTRELOAD_H_
+#define _HOTRELOAD_H_
+
+#include <stdint.h>
+#include "Map.h"
+
+/**
+ * @ingroup HotReload
+ */
+enum HotReloadLimits
+{
+    HOT_RELOAD_MAX_WATCHES = 2
+};
+
+/**
+ * @ingroup HotReload
+ */
+typedef struct HotReload_t
+{
+    int32_t  s32Fd;
+    int32_t  s32Watch[HOT_RELOAD_MAX_WATCHES];
+    char    *pacMapName;
+    char    *pacImageName;
+} HotReload;
+
+void       FreeHotReload(HotReload *pstHotReload);
+HotReload *InitHotReload(const Map *pstMap);
+uint16_t   PollHotReload(HotReload *pstHotReload);
+
+#endif // _HOTRELOAD_H_
@@ -0,0 +1,273 @@
+/**
+ * @file      Input.c
+ * @ingroup   Input
+ * @defgroup  Input
+ * @brief     Translates the keyboard state into a bitmask of game keys,
+ *            so the main loop doesn't care where its input comes from.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Input.h"
+#include "Macros.h"
+#include "Memory.h"
+
+#define INPUT_LOG_VERSION     1
+#define INPUT_LOG_HEADER_SIZE 16
+#define INPUT_LOG_RECORD_SIZE 6
+
+static void _WriteU16(uint8_t *pu8Buffer, uint16_t u16Value)
+{
+    pu8Buffer[0] = u16Value        & 0xFF;
+    pu8Buffer[1] = (u16Value >> 8) & 0xFF;
+}
+
+static void _WriteU32(uint8_t *pu8Buffer, uint32_t u32Value)
+{
+    _WriteU16(pu8Buffer,     u32Value         & 0xFFFF);
+    _WriteU16(pu8Buffer + 2, (u32Value >> 16) & 0xFFFF);
+}
+
+static uint16_t _ReadU16(const uint8_t *pu8Buffer)
+{
+    return pu8Buffer[0] | (pu8Buffer[1] << 8);
+}
+
+static uint32_t _ReadU32(const uint8_t *pu8Buffer)
+{
+    return _ReadU16(pu8Buffer) | ((uint32_t)_ReadU16(pu8Buffer + 2) << 16);
+}
+
+static int8_t _WriteHeader(InputLog *pstInputLog)
+{
+    uint8_t au8Header[INPUT_LOG_HEADER_SIZE] = { 'B', 'S', 'I', 'L' };
+
+    _WriteU16(&au8Header[4], INPUT_LOG_VERSION);
+    _WriteU32(&au8Header[8], pstInputLog->u32Frames);
+
+    if ((0 != fseek(pstInputLog->pstFile, 0, SEEK_SET)) ||
+        (1 != fwrite(au8Header, sizeof(au8Header), 1, pstInputLog->pstFile)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Free InputLog from memory.  A recorded log is completed by
+ *          writing the final frame count to its header.
+ * @param   pstInputLog an InputLog.  See @ref struct InputLog.
+ * @ingroup Input
+ */
+void FreeInputLog(InputLog *pstInputLog)
+{
+    if (NULL == pstInputLog)
+    {
+        return;
+    }
+
+    if (INPUT_LOG_RECORD == pstInputLog->u8Mode)
+    {
+        if (-1 == _WriteHeader(pstInputLog))
+        {
+            fprintf(stderr, "FreeInputLog(): couldn't finalise input log.\n");
+        }
+    }
+
+    fclose(pstInputLog->pstFile);
+    FreeMemory(pstInputLog);
+}
+
+/**
+ * @brief   Initialise InputLog.
+ * @param   pacFilename the filename of the log.
+ * @param   u8Mode      record or replay.  See @ref enum InputLogMode.
+ * @return  InputLog on success, NULL on error.  See @ref struct InputLog.
+ * @ingroup Input
+ */
+InputLog *InitInputLog(const char *pacFilename, const uint8_t u8Mode)
+{
+    uint8_t          au8Header[INPUT_LOG_HEADER_SIZE];
+    static InputLog *pstInputLog;
+    pstInputLog = AllocMemory(MEMORY_ENGINE, sizeof(struct InputLog_t));
+    if (NULL == pstInputLog)
+    {
+        fprintf(stderr, "InitInputLog(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstInputLog->u8Mode    = u8Mode;
+    pstInputLog->u32Frames = 0;
+    pstInputLog->u32Frame  = 0;
+    pstInputLog->pstFile   = fopen(pacFilename, INPUT_LOG_RECORD == u8Mode ? "wb" : "rb");
+    if (NULL == pstInputLog->pstFile)
+    {
+        fprintf(stderr, "Couldn't open input log: %s\n", pacFilename);
+        FreeMemory(pstInputLog);
+        return NULL;
+    }
+
+    if (INPUT_LOG_RECORD == u8Mode)
+    {
+        // Reserve the header, the frame count is filled in on exit.
+        if (-1 == _WriteHeader(pstInputLog))
+        {
+            fprintf(stderr, "Couldn't write input log: %s\n", pacFilename);
+            fclose(pstInputLog->pstFile);
+            FreeMemory(pstInputLog);
+            return NULL;
+        }
+        return pstInputLog;
+    }
+
+    if ((1 != fread(au8Header, sizeof(au8Header), 1, pstInputLog->pstFile)) ||
+        ('B' != au8Header[0]) || ('S' != au8Header[1])  ||
+        ('I' != au8Header[2]) || ('L' != au8Header[3])  ||
+        (INPUT_LOG_VERSION != _ReadU16(&au8Header[4])))
+    {
+        fprintf(stderr, "Invalid input log: %s\n", pacFilename);
+        fclose(pstInputLog->pstFile);
+        FreeMemory(pstInputLog);
+        return NULL;
+    }
+    pstInputLog->u32Frames = _ReadU32(&au8Header[8]);
+
+    return pstInputLog;
+}
+
+/**
+ * @brief   Generate scripted input, e.g. for the headless mode.  The
+ *          player walks back and forth and jumps in regular intervals.
+ * @param   u32Frame the current frame number.
+ * @return  Bitmask of pressed keys.  See @ref enum InputKeys.
+ * @ingroup Input
+ */
+uint16_t InjectInput(const uint32_t u32Frame)
+{
+    uint16_t u16Keys = 0;
+
+    if ((u32Frame / 600) % 2)
+    {
+        FLAG_SET(u16Keys, INPUT_LEFT);
+    }
+    else
+    {
+        FLAG_SET(u16Keys, INPUT_RIGHT);
+    }
+
+    if (0 == (u32Frame % 90))
+    {
+        FLAG_SET(u16Keys, INPUT_JUMP);
+    }
+
+    return u16Keys;
+}
+
+/**
+ * @brief   Round a frame delta time to what can be stored in an input
+ *          log.  Recording runs use the rounded value as well, so they
+ *          behave exactly like their replays.
+ * @param   dDeltaTime time since last frame in seconds.
+ * @return  The delta time rounded to microseconds.
+ * @ingroup Input
+ */
+double QuantiseDeltaTime(const double dDeltaTime)
+{
+    if (dDeltaTime <= 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(dDeltaTime * 1000000.0 + 0.5) / 1000000.0;
+}
+
+/**
+ * @brief   Read the current keyboard state.  SDL_PumpEvents() has to be
+ *          called beforehand.
+ * @return  Bitmask of pressed keys.  See @ref enum InputKeys.
+ * @ingroup Input
+ */
+uint16_t ReadInput()
+{
+    const uint8_t *u8KeyState = SDL_GetKeyboardState(NULL);
+    uint16_t       u16Keys    = 0;
+
+    if (u8KeyState[SDL_SCANCODE_P])     { FLAG_SET(u16Keys, INPUT_PAUSE);      }
+    if (u8KeyState[SDL_SCANCODE_C])     { FLAG_SET(u16Keys, INPUT_UNPAUSE);    }
+    if (u8KeyState[SDL_SCANCODE_Q])     { FLAG_SET(u16Keys, INPUT_QUIT);       }
+    if (u8KeyState[SDL_SCANCODE_0])     { FLAG_SET(u16Keys, INPUT_ZOOM_RESET); }
+    if (u8KeyState[SDL_SCANCODE_1])     { FLAG_SET(u16Keys, INPUT_ZOOM_OUT);   }
+    if (u8KeyState[SDL_SCANCODE_2])     { FLAG_SET(u16Keys, INPUT_ZOOM_IN);    }
+    if (u8KeyState[SDL_SCANCODE_LEFT])  { FLAG_SET(u16Keys, INPUT_LEFT);       }
+    if (u8KeyState[SDL_SCANCODE_RIGHT]) { FLAG_SET(u16Keys, INPUT_RIGHT);      }
+    if (u8KeyState[SDL_SCANCODE_SPACE]) { FLAG_SET(u16Keys, INPUT_JUMP);       }
+    if (u8KeyState[SDL_SCANCODE_F3])    { FLAG_SET(u16Keys, INPUT_PROFILER);   }
+
+    return u16Keys;
+}
+
+/**
+ * @brief   Append a frame to a recorded InputLog.
+ * @param   pstInputLog an InputLog.  See @ref struct InputLog.
+ * @param   u16Keys     bitmask of pressed keys.  See @ref enum InputKeys.
+ * @param   dDeltaTime  time since last frame in seconds.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Input
+ */
+int8_t RecordInput(
+    InputLog       *pstInputLog,
+    const uint16_t  u16Keys,
+    const double    dDeltaTime)
+{
+    uint8_t au8Record[INPUT_LOG_RECORD_SIZE];
+
+    _WriteU16(&au8Record[0], u16Keys);
+    _WriteU32(&au8Record[2], (uint32_t)(QuantiseDeltaTime(dDeltaTime) * 1000000.0 + 0.5));
+
+    if (1 != fwrite(au8Record, sizeof(au8Record), 1, pstInputLog->pstFile))
+    {
+        fprintf(stderr, "RecordInput(): couldn't write input log.\n");
+        return -1;
+    }
+    pstInputLog->u32Frames++;
+
+    return 0;
+}
+
+/**
+ * @brief   Read the next frame from a replayed InputLog.
+ * @param   pstInputLog an InputLog.  See @ref struct InputLog.
+ * @param   pu16Keys    bitmask of pressed keys.  See @ref enum InputKeys.
+ * @param   pdDeltaTime time since last frame in seconds.
+ * @return  0 on success, -1 when the end of the log has been reached.
+ * @ingroup Input
+ */
+int8_t ReplayInput(
+    InputLog *pstInputLog,
+    uint16_t *pu16Keys,
+    double   *pdDeltaTime)
+{
+    uint8_t au8Record[INPUT_LOG_RECORD_SIZE];
+
+    if (pstInputLog->u32Frame >= pstInputLog->u32Frames)
+    {
+        return -1;
+    }
+
+    if (1 != fread(au8Record, sizeof(au8Record), 1, pstInputLog->pstFile))
+    {
+        fprintf(stderr, "ReplayInput(): input log is truncated.\n");
+        return -1;
+    }
+    pstInputLog->u32Frame++;
+
+    *pu16Keys    = _ReadU16(&au8Record[0]);
+    *pdDeltaTime = _ReadU32(&au8Record[2]) / 1000000.0;
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file    Input.h
+ * @ingroup Input
+ */
+
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @ingroup Input
+ */
+enum InputKeys
+{
+    INPUT_PAUSE      = 0,
+    INPUT_UNPAUSE    = 1,
+    INPUT_QUIT       = 2,
+    INPUT_ZOOM_RESET = 3,
+    INPUT_ZOOM_OUT   = 4,
+    INPUT_ZOOM_IN    = 5,
+    INPUT_LEFT       = 6,
+    INPUT_RIGHT      = 7,
+    INPUT_JUMP       = 8,
+    INPUT_PROFILER   = 9
+};
+
+/**
+ * @ingroup Input
+ */
+enum InputLogMode
+{
+    INPUT_LOG_RECORD = 0,
+    INPUT_LOG_REPLAY = 1
+};
+
+/**
+ * @ingroup Input
+ * @brief   A recorded input log.  The file starts with a 16 byte
+ *          header (magic "BSIL", version, frame count) followed by
+ *          one 6 byte record per frame: the key bitmask and the frame
+ *          delta time in microseconds, both little-endian.
+ */
+typedef struct InputLog_t
+{
+    FILE     *pstFile;
+    uint8_t   u8Mode;
+    uint32_t  u32Frames;
+    uint32_t  u32Frame;
+} InputLog;
+
+void      FreeInputLog(InputLog *pstInputLog);
+InputLog *InitInputLog(const char *pacFilename, const uint8_t u8Mode);
+uint16_t  InjectInput(const uint32_t u32Frame);
+double    QuantiseDeltaTime(const double dDeltaTime);
+uint16_t  ReadInput();
+
+int8_t RecordInput(
+    InputLog       *pstInputLog,
+    const uint16_t  u16Keys,
+    const double    dDeltaTime);
+
+int8_t ReplayInput(
+    InputLog *pstInputLog,
+    uint16_t *pu16Keys,
+    double   *pdDeltaTime);
+
+#endif // _INPUT_H_
@@ -0,0 +1,321 @@
+/**
+ * @file      Job.c
+ * @ingroup   Job
+ * @defgroup  Job
+ * @brief     Work-stealing job system.  ParallelFor() splits a range of
+ *            items into jobs, pushes them onto the queue of the calling
+ *            thread and helps running them until all are done; idle
+ *            workers steal jobs from the top of the other queues.
+ *            Without workers, e.g. in the Emscripten build or on a
+ *            single core, the jobs are run inline.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "Job.h"
+#include "Memory.h"
+#include "Trace.h"
+
+// Every thread gets about this many jobs per ParallelFor() call, so
+// workers which finish early have something left to steal.
+#define JOB_SPLIT 4
+
+static int8_t _PushJob(JobQueue *pstQueue, const Job *pstJob)
+{
+    int8_t s8Status = -1;
+
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom - pstQueue->u32Top < JOB_QUEUE_SIZE)
+    {
+        pstQueue->stJobs[pstQueue->u32Bottom % JOB_QUEUE_SIZE] = *pstJob;
+        pstQueue->u32Bottom++;
+        s8Status = 0;
+    }
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return s8Status;
+}
+
+static uint8_t _PopJob(JobQueue *pstQueue, Job *pstJob)
+{
+    uint8_t u8Found = 0;
+
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom != pstQueue->u32Top)
+    {
+        pstQueue->u32Bottom--;
+        *pstJob = pstQueue->stJobs[pstQueue->u32Bottom % JOB_QUEUE_SIZE];
+        u8Found = 1;
+    }
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return u8Found;
+}
+
+static uint8_t _StealJob(JobQueue *pstQueue, Job *pstJob)
+{
+    uint8_t u8Found = 0;
+
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom != pstQueue->u32Top)
+    {
+        *pstJob = pstQueue->stJobs[pstQueue->u32Top % JOB_QUEUE_SIZE];
+        pstQueue->u32Top++;
+        u8Found = 1;
+    }
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return u8Found;
+}
+
+/* The newest job of the own queue comes first, since its data is most
+ * likely still in the cache; otherwise the oldest job of another. */
+static uint8_t _FindJob(JobSystem *pstJobs, uint8_t u8Queue, Job *pstJob)
+{
+    if (_PopJob(&pstJobs->stQueues[u8Queue], pstJob))
+    {
+        return 1;
+    }
+
+    for (uint8_t u8Offset = 1; u8Offset <= pstJobs->u8Workers; u8Offset++)
+    {
+        uint8_t u8Victim = (u8Queue + u8Offset) % (pstJobs->u8Workers + 1);
+
+        if (_StealJob(&pstJobs->stQueues[u8Victim], pstJob))
+        {
+            SDL_AtomicIncRef(&pstJobs->stJobsStolen);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void _RunJob(JobSystem *pstJobs, const Job *pstJob)
+{
+    pstJob->pfnJob(pstJob->pData, pstJob->u32Begin, pstJob->u32End);
+    SDL_AtomicIncRef(&pstJobs->stJobsRun);
+
+    // Publishes the job's results to the thread waiting for it.
+    SDL_AtomicAdd(pstJob->pstPending, -1);
+}
+
+static int _RunWorker(void *pArg)
+{
+    JobWorker *pstWorker = (JobWorker *)pArg;
+    JobSystem *pstJobs   = pstWorker->pstJobs;
+    Job        stJob;
+    char       acName[TRACE_NAME_LENGTH];
+
+    SDL_TLSSet(pstJobs->stTls, pstWorker, NULL);
+    snprintf(acName, sizeof(acName), "JobWorker %u", pstWorker->u8Index);
+    TRACE_THREAD(acName);
+
+    while (SDL_AtomicGet(&pstJobs->stRunning))
+    {
+        if (_FindJob(pstJobs, pstWorker->u8Index, &stJob))
+        {
+            _RunJob(pstJobs, &stJob);
+        }
+        else
+        {
+            SDL_SemWait(pstJobs->pstWakeUp);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Stop the workers and free JobSystem from memory.
+ * @param   pstJobs a JobSystem, may be NULL.  See @ref struct JobSystem.
+ * @ingroup Job
+ */
+void FreeJobSystem(JobSystem *pstJobs)
+{
+    if (NULL == pstJobs)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&pstJobs->stRunning, 0);
+    for (uint8_t u8Index = 0; u8Index < pstJobs->u8Workers; u8Index++)
+    {
+        SDL_SemPost(pstJobs->pstWakeUp);
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstJobs->u8Workers; u8Index++)
+    {
+        if (pstJobs->stWorkers[u8Index].pstThread)
+        {
+            SDL_WaitThread(pstJobs->stWorkers[u8Index].pstThread, NULL);
+        }
+    }
+
+    if (pstJobs->pstWakeUp)
+    {
+        SDL_DestroySemaphore(pstJobs->pstWakeUp);
+    }
+
+    FreeMemory(pstJobs);
+}
+
+/**
+ * @brief   Initialise JobSystem and start its workers.
+ * @param   s32Workers the number of worker threads, -1 for one per
+ *                     additional CPU core.  0 runs all jobs inline.
+ * @return  JobSystem on success, NULL on failure.
+ *          See @ref struct JobSystem.
+ * @ingroup Job
+ */
+JobSystem *InitJobSystem(int32_t s32Workers)
+{
+    static JobSystem *pstJobs;
+
+    #ifdef __EMSCRIPTEN__
+    s32Workers = 0;
+    #endif
+
+    if (s32Workers < 0)
+    {
+        s32Workers = SDL_GetCPUCount() - 1;
+    }
+
+    if (s32Workers > JOB_WORKERS_MAX)
+    {
+        s32Workers = JOB_WORKERS_MAX;
+    }
+
+    pstJobs = CallocMemory(MEMORY_ENGINE, 1, sizeof(struct JobSystem_t));
+    if (NULL == pstJobs)
+    {
+        fprintf(stderr, "InitJobSystem(): error allocating memory.\n");
+        return NULL;
+    }
+
+    if (0 == s32Workers)
+    {
+        return pstJobs;
+    }
+
+    pstJobs->pstWakeUp = SDL_CreateSemaphore(0);
+    pstJobs->stTls     = SDL_TLSCreate();
+    if ((NULL == pstJobs->pstWakeUp) || (0 == pstJobs->stTls))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        FreeJobSystem(pstJobs);
+        return NULL;
+    }
+
+    // Set before the first worker starts looking at the queues.
+    pstJobs->u8Workers = s32Workers;
+    SDL_AtomicSet(&pstJobs->stRunning, 1);
+
+    for (uint8_t u8Index = 0; u8Index < pstJobs->u8Workers; u8Index++)
+    {
+        JobWorker *pstWorker = &pstJobs->stWorkers[u8Index];
+
+        // Queue 0 is the one of the threads which aren't workers.
+        pstWorker->pstJobs   = pstJobs;
+        pstWorker->u8Index   = u8Index + 1;
+        pstWorker->pstThread = SDL_CreateThread(_RunWorker, "JobWorker", (void *)pstWorker);
+
+        if (NULL == pstWorker->pstThread)
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            FreeJobSystem(pstJobs);
+            return NULL;
+        }
+    }
+
+    return pstJobs;
+}
+
+/**
+ * @brief   Call a function for all items of a range, split into jobs
+ *          which are run in parallel.  Returns once all jobs are done.
+ *          The jobs must not depend on each other.  Can be called from
+ *          within a job.
+ * @param   pstJobs  a JobSystem, NULL runs everything inline.
+ *                   See @ref struct JobSystem.
+ * @param   u32Count the number of items.
+ * @param   u32Grain the minimum number of items per job.
+ * @param   pfnJob   the function.  See @ref JobFunction.
+ * @param   pData    passed on to the function.
+ * @ingroup Job
+ */
+void ParallelFor(
+    JobSystem      *pstJobs,
+    const uint32_t  u32Count,
+    const uint32_t  u32Grain,
+    JobFunction     pfnJob,
+    void           *pData)
+{
+    SDL_atomic_t stPending;
+    JobWorker   *pstWorker;
+    Job          stJob;
+    uint32_t     u32Size;
+    uint32_t     u32Jobs = 0;
+    uint8_t      u8Queue = 0;
+
+    if ((NULL == pstJobs) || (0 == pstJobs->u8Workers) || (u32Count <= u32Grain))
+    {
+        pfnJob(pData, 0, u32Count);
+        return;
+    }
+
+    pstWorker = SDL_TLSGet(pstJobs->stTls);
+    if (pstWorker)
+    {
+        u8Queue = pstWorker->u8Index;
+    }
+
+    u32Size = u32Count / (JOB_SPLIT * (pstJobs->u8Workers + 1));
+    if (u32Size < u32Grain)
+    {
+        u32Size = u32Grain;
+    }
+    if (0 == u32Size)
+    {
+        u32Size = 1;
+    }
+
+    SDL_AtomicSet(&stPending, 0);
+    stJob.pfnJob     = pfnJob;
+    stJob.pData      = pData;
+    stJob.pstPending = &stPending;
+
+    for (uint32_t u32Begin = 0; u32Begin < u32Count; u32Begin += u32Size)
+    {
+        stJob.u32Begin = u32Begin;
+        stJob.u32End   = u32Count - u32Begin < u32Size ? u32Count : u32Begin + u32Size;
+
+        SDL_AtomicIncRef(&stPending);
+        if (-1 == _PushJob(&pstJobs->stQueues[u8Queue], &stJob))
+        {
+            // The queue is full.
+            _RunJob(pstJobs, &stJob);
+        }
+        else
+        {
+            u32Jobs++;
+        }
+    }
+
+    for (uint32_t u32Index = 0; (u32Index < u32Jobs) && (u32Index < pstJobs->u8Workers); u32Index++)
+    {
+        SDL_SemPost(pstJobs->pstWakeUp);
+    }
+
+    // Help out instead of waiting; this may run jobs of other calls.
+    while (SDL_AtomicGet(&stPending) > 0)
+    {
+        if (_FindJob(pstJobs, u8Queue, &stJob))
+        {
+            _RunJob(pstJobs, &stJob);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    Job.h
+ * @ingroup Job
+ */
+
+#ifndef _JOB_H_
+#define _JOB_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Job
+ */
+enum JobLimits
+{
+    JOB_QUEUE_SIZE  = 256,
+    JOB_WORKERS_MAX = 32
+};
+
+/**
+ * @ingroup Job
+ * @brief   A job processes the items u32Begin to u32End - 1 of
+ *          whatever pData points to.
+ */
+typedef void (*JobFunction)(void *pData, uint32_t u32Begin, uint32_t u32End);
+
+/**
+ * @ingroup Job
+ */
+typedef struct Job_t
+{
+    JobFunction   pfnJob;
+    void         *pData;
+    uint32_t      u32Begin;
+    uint32_t      u32End;
+    SDL_atomic_t *pstPending;
+} Job;
+
+/**
+ * @ingroup Job
+ * @brief   A double-ended queue.  Its owner pushes and pops jobs at the
+ *          bottom, other threads steal them from the top.
+ */
+typedef struct JobQueue_t
+{
+    Job          stJobs[JOB_QUEUE_SIZE];
+    uint32_t     u32Top;
+    uint32_t     u32Bottom;
+    SDL_SpinLock stLock;
+} JobQueue;
+
+struct JobSystem_t;
+
+/**
+ * @ingroup Job
+ */
+typedef struct JobWorker_t
+{
+    struct JobSystem_t *pstJobs;
+    SDL_Thread         *pstThread;
+    uint8_t             u8Index;
+} JobWorker;
+
+/**
+ * @ingroup Job
+ * @brief   Every worker has a queue of its own; stQueues[0] belongs to
+ *          all other threads, e.g. the main thread.  Counters are
+ *          totals since InitJobSystem().
+ */
+typedef struct JobSystem_t
+{
+    JobQueue     stQueues[JOB_WORKERS_MAX + 1];
+    JobWorker    stWorkers[JOB_WORKERS_MAX];
+    SDL_sem     *pstWakeUp;
+    SDL_TLSID    stTls;
+    SDL_atomic_t stRunning;
+    SDL_atomic_t stJobsRun;
+    SDL_atomic_t stJobsStolen;
+    uint8_t      u8Workers;
+} JobSystem;
+
+void       FreeJobSystem(JobSystem *pstJobs);
+JobSystem *InitJobSystem(int32_t s32Workers);
+
+void ParallelFor(
+    JobSystem      *pstJobs,
+    const uint32_t  u32Count,
+    const uint32_t  u32Grain,
+    JobFunction     pfnJob,
+    void           *pData);
+
+#endif // _JOB_H_
@@ -0,0 +1,320 @@
+/**
+ * @file      Level.c
+ * @ingroup   Level
+ * @defgroup  Level
+ * @brief     Level manager to load the next level in the background
+ *            while the current one is still being played.  A single
+ *            loader thread lives as long as the LevelManager and waits
+ *            for the next request between loads.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Level.h"
+#include "Map.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "Trace.h"
+
+static char *_CopyString(const char *pacString)
+{
+    char *pacCopy = AllocMemory(MEMORY_ENGINE, strlen(pacString) + 1);
+    if (NULL == pacCopy)
+    {
+        return NULL;
+    }
+    memcpy(pacCopy, pacString, strlen(pacString) + 1);
+
+    return pacCopy;
+}
+
+static void _FreeFilenames(LevelManager *pstLevelManager)
+{
+    FreeMemory(pstLevelManager->pacMapFilename);
+    FreeMemory(pstLevelManager->pacTilesetImageFilename);
+    FreeMemory(pstLevelManager->pacMusicFilename);
+
+    pstLevelManager->pacMapFilename          = NULL;
+    pstLevelManager->pacTilesetImageFilename = NULL;
+    pstLevelManager->pacMusicFilename        = NULL;
+}
+
+static void _FreePendingLevel(LevelManager *pstLevelManager)
+{
+    if (pstLevelManager->pstMap)
+    {
+        FreeMap(pstLevelManager->pstMap);
+    }
+    ReleaseMusic(pstLevelManager->stMusic);
+
+    pstLevelManager->pstMap        = NULL;
+    pstLevelManager->stMusic.u32Id = 0;
+}
+
+/* Runs on the loader thread: everything that does not require the
+ * rendering context (XML parsing, decoding the GID arrays, decoding
+ * the tileset image and opening the music) is done here, so the main
+ * thread is only left with the texture upload. */
+static int _LoadLevelFiles(LevelManager *pstLevelManager)
+{
+    pstLevelManager->pstMap = InitMap(
+        pstLevelManager->pacMapFilename,
+        pstLevelManager->pacTilesetImageFilename);
+    if (NULL == pstLevelManager->pstMap)
+    {
+        SDL_AtomicSet(&pstLevelManager->stState, LEVEL_FAILED);
+        return -1;
+    }
+
+    if (-1 == LoadMapTilesetImage(pstLevelManager->pstMap))
+    {
+        _FreePendingLevel(pstLevelManager);
+        SDL_AtomicSet(&pstLevelManager->stState, LEVEL_FAILED);
+        return -1;
+    }
+
+    // Shared with the current level if it plays the same music.
+    pstLevelManager->stMusic = AcquireMusic(pstLevelManager->pacMusicFilename);
+    if (NULL == GetMusic(pstLevelManager->stMusic))
+    {
+        _FreePendingLevel(pstLevelManager);
+        SDL_AtomicSet(&pstLevelManager->stState, LEVEL_FAILED);
+        return -1;
+    }
+
+    SDL_AtomicSet(&pstLevelManager->stState, LEVEL_READY);
+    return 0;
+}
+
+static int _RunLoader(void *pArg)
+{
+    LevelManager *pstLevelManager = (LevelManager *)pArg;
+
+    TRACE_THREAD("LevelLoader");
+
+    // Loading is allowed to allocate while a level is being played.
+    ExemptMemoryThread();
+
+    while (SDL_AtomicGet(&pstLevelManager->stRunning))
+    {
+        SDL_SemWait(pstLevelManager->pstRequest);
+        if (0 == SDL_AtomicGet(&pstLevelManager->stRunning))
+        {
+            break;
+        }
+
+        TRACE_BEGIN("LoadLevel");
+        _LoadLevelFiles(pstLevelManager);
+        TRACE_END("LoadLevel");
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Stop the loader thread and free LevelManager from memory.
+ *          Blocks until a pending preload has finished.
+ * @param   pstLevelManager a LevelManager.  See @ref struct LevelManager.
+ * @ingroup Level
+ */
+void FreeLevelManager(LevelManager *pstLevelManager)
+{
+    if (NULL == pstLevelManager)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&pstLevelManager->stRunning, 0);
+    if (pstLevelManager->pstThread)
+    {
+        SDL_SemPost(pstLevelManager->pstRequest);
+        SDL_WaitThread(pstLevelManager->pstThread, NULL);
+    }
+
+    if (pstLevelManager->pstRequest)
+    {
+        SDL_DestroySemaphore(pstLevelManager->pstRequest);
+    }
+
+    _FreePendingLevel(pstLevelManager);
+    _FreeFilenames(pstLevelManager);
+    FreeMemory(pstLevelManager);
+}
+
+/**
+ * @brief   Initialise LevelManager and start its loader thread.
+ * @return  LevelManager on success, NULL on error.
+ *          See @ref struct LevelManager.
+ * @ingroup Level
+ */
+LevelManager *InitLevelManager()
+{
+    static LevelManager *pstLevelManager;
+    pstLevelManager = AllocMemory(MEMORY_ENGINE, sizeof(struct LevelManager_t));
+    if (NULL == pstLevelManager)
+    {
+        fprintf(stderr, "InitLevelManager(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstLevelManager->pstThread               = NULL;
+    pstLevelManager->pacMapFilename          = NULL;
+    pstLevelManager->pacTilesetImageFilename = NULL;
+    pstLevelManager->pacMusicFilename        = NULL;
+    pstLevelManager->pstMap                  = NULL;
+    pstLevelManager->stMusic.u32Id           = 0;
+    SDL_AtomicSet(&pstLevelManager->stState, LEVEL_IDLE);
+    SDL_AtomicSet(&pstLevelManager->stRunning, 1);
+
+    pstLevelManager->pstRequest = SDL_CreateSemaphore(0);
+    if (NULL == pstLevelManager->pstRequest)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        FreeLevelManager(pstLevelManager);
+        return NULL;
+    }
+
+    /* One thread for all loads, so that it keeps its trace buffer and
+     * isn't created anew in the middle of a level. */
+    pstLevelManager->pstThread = SDL_CreateThread(
+        _RunLoader,
+        "LevelLoader",
+        (void *)pstLevelManager);
+
+    if (NULL == pstLevelManager->pstThread)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        FreeLevelManager(pstLevelManager);
+        return NULL;
+    }
+
+    return pstLevelManager;
+}
+
+/**
+ * @brief   Check whether the preloaded level is ready to be swapped in.
+ * @param   pstLevelManager a LevelManager.  See @ref struct LevelManager.
+ * @return  1 if the level is ready, 0 if not.
+ * @ingroup Level
+ */
+uint8_t IsLevelReady(LevelManager *pstLevelManager)
+{
+    if (LEVEL_READY == SDL_AtomicGet(&pstLevelManager->stState))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Start loading a level on the loader thread.
+ * @param   pstLevelManager         a LevelManager.  See @ref struct LevelManager.
+ * @param   pacMapFilename          the filename of the TMX map.
+ * @param   pacTilesetImageFilename the filename of the tileset image.
+ * @param   pacMusicFilename        the filename of the ogg music file.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Level
+ */
+int8_t PreloadLevel(
+    LevelManager *pstLevelManager,
+    const char   *pacMapFilename,
+    const char   *pacTilesetImageFilename,
+    const char   *pacMusicFilename)
+{
+    if (LEVEL_LOADING == SDL_AtomicGet(&pstLevelManager->stState))
+    {
+        fprintf(stderr, "PreloadLevel(): a level is already being loaded.\n");
+        return -1;
+    }
+
+    // Discard a level which has been preloaded but never swapped in.
+    _FreePendingLevel(pstLevelManager);
+    _FreeFilenames(pstLevelManager);
+
+    pstLevelManager->pacMapFilename          = _CopyString(pacMapFilename);
+    pstLevelManager->pacTilesetImageFilename = _CopyString(pacTilesetImageFilename);
+    pstLevelManager->pacMusicFilename        = _CopyString(pacMusicFilename);
+
+    if ((NULL == pstLevelManager->pacMapFilename)          ||
+        (NULL == pstLevelManager->pacTilesetImageFilename) ||
+        (NULL == pstLevelManager->pacMusicFilename))
+    {
+        fprintf(stderr, "PreloadLevel(): error allocating memory.\n");
+        _FreeFilenames(pstLevelManager);
+        return -1;
+    }
+
+    // The semaphore publishes the filenames to the loader thread.
+    SDL_AtomicSet(&pstLevelManager->stState, LEVEL_LOADING);
+    SDL_SemPost(pstLevelManager->pstRequest);
+
+    return 0;
+}
+
+/**
+ * @brief   Swap the current level with the preloaded one.  Does not
+ *          block: if the preloaded level isn't ready yet, nothing
+ *          happens.  The previous Map is freed and the previous
+ *          Music released.
+ * @param   pstLevelManager a LevelManager.  See @ref struct LevelManager.
+ * @param   pstRenderer     a SDL rendering context.  See @ref struct Video.
+ * @param   pstMap          the current Map, replaced on success.
+ * @param   pstMusic        the handle of the current Music, replaced on
+ *                          success.
+ * @return  0 on success, -1 if no level is ready or on failure.
+ * @ingroup Level
+ */
+int8_t SwapLevel(
+    LevelManager  *pstLevelManager,
+    SDL_Renderer  *pstRenderer,
+    Map          **pstMap,
+    MusicHandle   *pstMusic)
+{
+    if (0 == IsLevelReady(pstLevelManager))
+    {
+        return -1;
+    }
+
+    // Only the GPU upload is left to do on the main thread.
+    if (-1 == UploadMapTileset(pstRenderer, pstLevelManager->pstMap))
+    {
+        _FreePendingLevel(pstLevelManager);
+        SDL_AtomicSet(&pstLevelManager->stState, LEVEL_FAILED);
+        return -1;
+    }
+
+    FreeMap(*pstMap);
+    ReleaseMusic(*pstMusic);
+
+    *pstMap                        = pstLevelManager->pstMap;
+    *pstMusic                      = pstLevelManager->stMusic;
+    pstLevelManager->pstMap        = NULL;
+    pstLevelManager->stMusic.u32Id = 0;
+
+    SDL_AtomicSet(&pstLevelManager->stState, LEVEL_IDLE);
+
+    return 0;
+}
+
+/**
+ * @brief   Block until the level which is being preloaded has either
+ *          been loaded or failed to load.
+ * @param   pstLevelManager a LevelManager.  See @ref struct LevelManager.
+ * @return  1 if the level is ready to be swapped in, 0 otherwise.
+ * @ingroup Level
+ */
+uint8_t WaitForLevel(LevelManager *pstLevelManager)
+{
+    while (LEVEL_LOADING == SDL_AtomicGet(&pstLevelManager->stState))
+    {
+        SDL_Delay(1);
+    }
+
+    return IsLevelReady(pstLevelManager);
+}
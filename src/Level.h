@@ -0,0 +1,60 @@
+/**
+ * @file    Level.h
+ * @ingroup Level
+ */
+
+#ifndef _LEVEL_H_
+#define _LEVEL_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Map.h"
+#include "Resource.h"
+
+/**
+ * @ingroup Level
+ */
+enum LevelState
+{
+    LEVEL_IDLE    = 0,
+    LEVEL_LOADING = 1,
+    LEVEL_READY   = 2,
+    LEVEL_FAILED  = 3
+};
+
+/**
+ * @ingroup Level
+ */
+typedef struct LevelManager_t
+{
+    SDL_Thread   *pstThread;
+    SDL_sem      *pstRequest;
+    SDL_atomic_t  stRunning;
+    SDL_atomic_t  stState;
+    char         *pacMapFilename;
+    char         *pacTilesetImageFilename;
+    char         *pacMusicFilename;
+    /* Remark: the following variables are owned by the loader thread
+     * as long as stState is set to LEVEL_LOADING. */
+    Map          *pstMap;
+    MusicHandle   stMusic;
+} LevelManager;
+
+void          FreeLevelManager(LevelManager *pstLevelManager);
+LevelManager *InitLevelManager();
+uint8_t       IsLevelReady(LevelManager *pstLevelManager);
+uint8_t       WaitForLevel(LevelManager *pstLevelManager);
+
+int8_t PreloadLevel(
+    LevelManager *pstLevelManager,
+    const char   *pacMapFilename,
+    const char   *pacTilesetImageFilename,
+    const char   *pacMusicFilename);
+
+int8_t SwapLevel(
+    LevelManager  *pstLevelManager,
+    SDL_Renderer  *pstRenderer,
+    Map          **pstMap,
+    MusicHandle   *pstMusic);
+
+#endif // _LEVEL_H_
@@ -12,18 +12,58 @@
 #include "Background.h"
 #include "Config.h"
 #include "Entity.h"
+#include "HotReload.h"
+#include "Input.h"
+#include "Job.h"
+#include "Level.h"
 #include "Macros.h"
 #include "Map.h"
+#include "Memory.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "Resource.h"
+#include "SpriteBatch.h"
+#include "Swarm.h"
+#include "Trace.h"
+#include "TripleBuffer.h"
 #include "Video.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-#define CAMERA_IS_LOCKED 0
-#define EXIT_UNSET       2
+#define CAMERA_IS_LOCKED    0
+#define EXIT_UNSET          2
+#define ALLOC_WARMUP_FRAMES 60
 static  int32_t _s32ExecStatus = EXIT_UNSET;
 
+/**
+ * @brief The list of levels, played in a loop.  The next level is
+ * loaded in the background while the current one is being played and
+ * swapped in as soon as the player walks off its right edge.
+ */
+static const char *_pacLevelList[][3] = {
+    { "res/maps/demo.tmx", "res/tilesets/jungle.png", "res/music/cheap_4track.ogg" }
+};
+#define LEVEL_COUNT (sizeof(_pacLevelList) / sizeof(_pacLevelList[0]))
+
+/**
+ * @brief Everything needed to draw a frame.  The simulation fills one
+ * after every step and hands it to the renderer through a TripleBuffer,
+ * so drawing never has to look at the state being updated.
+ * u32StageTime holds the profiler stages measured by the simulation
+ * thread.
+ */
+typedef struct RenderSnapshot_t
+{
+    Background    stBG[5];
+    EntitySprite  stSam;
+    EntitySprite *pstSwarm;
+    double        dCameraPosX;
+    double        dCameraPosY;
+    uint32_t      u32StageTime[PROFILER_STAGES];
+} RenderSnapshot;
+
 /**
  * @brief This structure is used to avoid redundant global variables.
  * It works as a carrier between the main() and the _MainLoop() function
@@ -31,105 +71,244 @@ static  int32_t _s32ExecStatus = EXIT_UNSET;
  */
 typedef struct MainLoopBundle_t
 {
-    Background *pstBG[5];
-    Map        *pstMap;
-    Music      *pstMusic;
-    Entity     *pstSam;
-    Sfx        *pstSfx[5];
-    Video      *pstVideo;
-    double      dDeltaTime;
-    double      dCameraPosX;
-    double      dCameraPosY;
-    double      dCameraMaxPosX;
-    double      dCameraMaxPosY;
-    uint8_t     u8GameIsPaused;
-    double      dTimeA;
-    double      dTimeB;
+    Background     *pstBG[5];
+    HotReload      *pstHotReload;
+    InputLog       *pstInputLog;
+    JobSystem      *pstJobs;
+    LevelManager   *pstLevelManager;
+    Map            *pstMap;
+    MetricsBlock   *pstMetrics;
+    MusicHandle    stMusic;
+    Profiler       *pstProfiler;
+    Entity         *pstSam;
+    Sfx            *pstSfx[5];
+    SpriteBatch    *pstBGSprites;
+    SpriteBatch    *pstSprites;
+    Swarm          *pstSwarm;
+    Video          *pstVideo;
+    RenderSnapshot stSnapshot[3];
+    TripleBuffer   *pstSnapshots;
+    Profiler       *pstSimProfiler;
+    SDL_Thread     *pstSimThread;
+    SDL_mutex      *pstWorldLock;
+    SDL_atomic_t   stSimRunning;
+    SDL_atomic_t   stKeys;
+    SDL_atomic_t   stKeysPressed;
+    SDL_atomic_t   stAtExit;
+    double         dSimStep;
+    double         dDeltaTime;
+    double         dCameraPosX;
+    double         dCameraPosY;
+    double         dCameraMaxPosX;
+    double         dCameraMaxPosY;
+    double         dDrawnCameraPosX;
+    double         dDrawnCameraPosY;
+    uint8_t        u8GameIsPaused;
+    uint8_t        u8LevelIndex;
+    uint8_t        u8Headless;
+    uint8_t        u8AssertNoAlloc;
+    uint16_t       u16PrevKeys;
+    uint32_t       u32Frame;
+    uint32_t       u32MaxFrames;
+    uint32_t       u32SteadyFrame;
+    uint64_t       u64LastPublish;
+    double         dFixedStep;
+    double         dFrameBudget;
+    double         dTimeA;
+    double         dTimeB;
 } MainLoopBundle;
 
-static void _MainLoop(void *pArg);
+static void    _LockWorld(MainLoopBundle *pstBundle);
+static void    _MainLoop(void *pArg);
+static void    _NextLevel(MainLoopBundle *pstBundle);
+static void    _PublishMetrics(MainLoopBundle *pstBundle);
+static void    _PrintFrameAllocs(uint32_t u32Frame, uint32_t u32Allocs);
+static void    _PrintHeadlessStats(const Profiler *pstProfiler, JobSystem *pstJobs, double dSeconds);
+static void    _PrintSwarmStats(const Swarm *pstSwarm);
+static void    _Render(MainLoopBundle *pstBundle);
+static int     _RunSimulation(void *pArg);
+static uint8_t _Simulate(MainLoopBundle *pstBundle, uint16_t u16Keys, double dDeltaTime);
+static int8_t  _StartSimulation(MainLoopBundle *pstBundle);
+static void    _StopSimulation(MainLoopBundle *pstBundle);
+static void    _UnlockWorld(MainLoopBundle *pstBundle);
+static void    _UpdateMapBoundaries(MainLoopBundle *pstBundle);
 
 int32_t main(int32_t s32ArgC, char *pacArgV[])
 {
-    Background     *pstBG[5]  = { NULL };
-    MainLoopBundle *pstBundle = NULL;
-    Map            *pstMap    = NULL;
-    Mixer          *pstMixer  = NULL;
-    Music          *pstMusic  = NULL;
-    Entity         *pstSam    = NULL;
-    Sfx            *pstSfx[5] = { NULL };
-    Video          *pstVideo  = NULL;
+    Background     *pstBG[5]        = { NULL };
+    HotReload      *pstHotReload    = NULL;
+    InputLog       *pstInputLog     = NULL;
+    JobSystem      *pstJobs         = NULL;
+    MainLoopBundle *pstBundle       = NULL;
+    LevelManager   *pstLevelManager = NULL;
+    Map            *pstMap          = NULL;
+    MetricsBlock   *pstMetrics      = NULL;
+    Mixer          *pstMixer        = NULL;
+    MusicHandle     stMusic         = { 0 };
+    Profiler       *pstProfiler     = NULL;
+    Entity         *pstSam          = NULL;
+    SfxHandle       stSfx[5]        = { { 0 } };
+    SpriteBatch    *pstBGSprites    = NULL;
+    SpriteBatch    *pstSprites      = NULL;
+    Swarm          *pstSwarm        = NULL;
+    Video          *pstVideo        = NULL;
+    uint32_t        u32BGSprites    = 0;
+    uint64_t        u64StartTicks   = 0;
     Config          stConfig;
 
-    if (s32ArgC > 1)
+    stConfig = InitConfig(GetConfigFilename(s32ArgC, pacArgV));
+    if (-1 == ParseArguments(&stConfig, s32ArgC, pacArgV))
     {
-        stConfig = InitConfig(pacArgV[1]);
+        return EXIT_FAILURE;
     }
-    else
+
+    // Has to happen before anything is allocated.
+    if (-1 == InitMemory(stConfig.stRun.s8TrackMemory))
     {
-        #ifndef __EMSCRIPTEN__
-        stConfig = InitConfig("default.ini");
-        #else
-        stConfig = InitConfig("emscripten.ini");
-        #endif
+        return EXIT_FAILURE;
     }
 
+    if (stConfig.stRun.pacTraceFilename)
+    {
+        if (-1 == InitTrace(stConfig.stRun.pacTraceFilename))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    TRACE_BEGIN("InitVideo");
     pstVideo = InitVideo(
         "Boondock Sam",
         stConfig.stVideo.s32Width,
         stConfig.stVideo.s32Height,
         stConfig.stVideo.s8Fullscreen,
-        1 + stConfig.stVideo.s32Height / 216); // 216 = Background height.
+        stConfig.stVideo.s8Software,
+        stConfig.stVideo.s8Native,
+        1 + stConfig.stVideo.s32Height / VIDEO_NATIVE_HEIGHT,
+        stConfig.stRun.s8Headless);
+    TRACE_END("InitVideo");
     if (NULL == pstVideo)
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
+    // Runs after SDL_Quit(), so anything still live has leaked.
+    if (IsMemoryTracked())
+    {
+        atexit(PrintMemoryStats);
+    }
     atexit(SDL_Quit);
 
-    pstMap = InitMap("res/maps/demo.tmx", "res/tilesets/jungle.png");
+    if ((-1 == InitResources()) || (-1 == LoadAtlas("res/atlas/atlas.ini")))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstJobs = InitJobSystem(stConfig.stRun.s32Jobs);
+    if (NULL == pstJobs)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+    SetVideoJobSystem(pstJobs);
+
+    pstMap = InitMap(_pacLevelList[0][0], _pacLevelList[0][1]);
     if (NULL == pstMap)
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
 
-    pstMixer = InitMixer();
+    if (stConfig.stDev.s8HotReload)
+    {
+        pstHotReload = InitHotReload(pstMap);
+    }
+
+    // Monitoring is optional; the game runs without it.
+    if (stConfig.stDev.s8Metrics)
+    {
+        pstMetrics = InitMetrics();
+    }
+
+    if (stConfig.stRun.pacRecordFilename)
+    {
+        pstInputLog = InitInputLog(stConfig.stRun.pacRecordFilename, INPUT_LOG_RECORD);
+    }
+    else if (stConfig.stRun.pacReplayFilename)
+    {
+        pstInputLog = InitInputLog(stConfig.stRun.pacReplayFilename, INPUT_LOG_REPLAY);
+    }
+
+    if ((stConfig.stRun.pacRecordFilename || stConfig.stRun.pacReplayFilename) &&
+        (NULL == pstInputLog))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstMixer = InitMixer(
+        stConfig.stAudio.s32Frequency,
+        stConfig.stAudio.s32ChunkSize,
+        stConfig.stAudio.s8Channels,
+        stConfig.stAudio.s16MixChannels,
+        stConfig.stAudio.s32Voices,
+        stConfig.stAudio.s8LowLatency,
+        stConfig.stRun.s8Headless);
     if (NULL == pstMixer)
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
-    pstMusic = InitMusic("res/music/cheap_4track.ogg");
-    if (NULL == pstMusic)
+    if (stConfig.stAudio.s32MusicCache)
+    {
+        EnableMusicCache(stConfig.stAudio.s32MusicCache);
+    }
+
+    stMusic = AcquireMusic(_pacLevelList[0][2]);
+    if (NULL == GetMusic(stMusic))
     {
 
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
-    if (pstMixer) { PlayMusic(pstMusic, -1); }
+    if (pstMixer) { PlayMusic(GetMusic(stMusic), -1); }
 
-    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    // Start loading the next level while the first one is played.
+    pstLevelManager = InitLevelManager();
+    if (NULL == pstLevelManager)
     {
-        const char *pacBackgroundList[5] = {
-            "res/backgrounds/plx-1.png",
-            "res/backgrounds/plx-2.png",
-            "res/backgrounds/plx-3.png",
-            "res/backgrounds/plx-4.png",
-            "res/backgrounds/plx-5.png"
-        };
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+    PreloadLevel(
+        pstLevelManager,
+        _pacLevelList[1 % LEVEL_COUNT][0],
+        _pacLevelList[1 % LEVEL_COUNT][1],
+        _pacLevelList[1 % LEVEL_COUNT][2]);
 
-        pstBG[u8Index] = InitBackground(
-            pstVideo->pstRenderer,
-            pacBackgroundList[u8Index],
-            pstVideo->s32WindowWidth);
+    const char *pacBackgroundList[5] = {
+        "res/backgrounds/plx-1.png",
+        "res/backgrounds/plx-2.png",
+        "res/backgrounds/plx-3.png",
+        "res/backgrounds/plx-4.png",
+        "res/backgrounds/plx-5.png"
+    };
 
-        if (NULL == pstBG[u8Index])
-        {
-            _s32ExecStatus = EXIT_FAILURE;
-            goto quit;
-        }
+    if (-1 == InitBackgrounds(
+            pstVideo->pstRenderer,
+            pstJobs,
+            pacBackgroundList,
+            5,
+            pstVideo->s32WindowWidth,
+            pstBG))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
 
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
         pstBG[u8Index]->dWorldPosY = pstMap->u32Height - pstBG[u8Index]->s32Height;
 
         const char *pacSfxList[5] = {
@@ -140,9 +319,9 @@ int32_t main(int32_t s32ArgC, char *pacArgV[])
             "res/sfx/unpause.wav"
         };
 
-        pstSfx[u8Index] = InitSfx(pacSfxList[u8Index]);
+        stSfx[u8Index] = AcquireSfx(pacSfxList[u8Index]);
 
-        if (NULL == pstSfx[u8Index])
+        if (NULL == GetSfx(stSfx[u8Index]))
         {
             _s32ExecStatus = EXIT_FAILURE;
             goto quit;
@@ -161,7 +340,46 @@ int32_t main(int32_t s32ArgC, char *pacArgV[])
         goto quit;
     }
 
-    pstBundle = malloc(sizeof(struct MainLoopBundle_t));
+    // Scripted entities sharing Sam's sprite to stress the entity code.
+    if (stConfig.stRun.u32Entities)
+    {
+        pstSwarm = InitSwarm(
+            stConfig.stRun.u32Entities,
+            pstMap,
+            pstVideo->pstRenderer,
+            "res/sprites/sam.png");
+        if (NULL == pstSwarm)
+        {
+            _s32ExecStatus = EXIT_FAILURE;
+            goto quit;
+        }
+    }
+
+    /* Sam and the swarm share a texture and are drawn at once, and so
+     * are the backgrounds once they have been packed into the atlas.
+     * Both are collected before anything is drawn, so the software
+     * renderer knows what has changed, see _Render(). */
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        u32BGSprites += 2 * pstBG[u8Index]->u8WidthFactor;
+    }
+
+    pstBGSprites = InitSpriteBatch(pstVideo->pstRenderer, u32BGSprites);
+    pstSprites   = InitSpriteBatch(pstVideo->pstRenderer, 1 + (pstSwarm ? pstSwarm->u32Count : 0));
+    if ((NULL == pstBGSprites) || (NULL == pstSprites))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstProfiler = InitProfiler();
+    if (NULL == pstProfiler)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstBundle = CallocMemory(MEMORY_ENGINE, 1, sizeof(struct MainLoopBundle_t));
     if (NULL == pstBundle)
     {
         fprintf(stderr, "stBundle: error allocating memory.\n");
@@ -174,142 +392,819 @@ int32_t main(int32_t s32ArgC, char *pacArgV[])
     pstBundle->dCameraMaxPosX = 0;
     pstBundle->dCameraMaxPosY = 0;
     pstBundle->dTimeA         = SDL_GetTicks();
-    pstBundle->u8GameIsPaused = 0;
-    pstBundle->pstMap         = pstMap;
-    pstBundle->pstMusic       = pstMusic;
-    pstBundle->pstSam         = pstSam;
-    pstBundle->pstVideo       = pstVideo;
+    pstBundle->u8GameIsPaused  = 0;
+    pstBundle->u8LevelIndex    = 0;
+    pstBundle->u8Headless      = stConfig.stRun.s8Headless;
+    pstBundle->u16PrevKeys     = 0;
+    pstBundle->u32Frame        = 0;
+    pstBundle->u32MaxFrames    = stConfig.stRun.u32MaxFrames;
+    pstBundle->u32SteadyFrame  = ALLOC_WARMUP_FRAMES;
+    pstBundle->u8AssertNoAlloc = stConfig.stRun.s8AssertNoAlloc;
+    pstBundle->u64LastPublish  = 0;
+    pstBundle->dFixedStep      = 0;
+    pstBundle->dFrameBudget    = stConfig.stVideo.s8FPS ? 1.0 / stConfig.stVideo.s8FPS : 0;
+    pstBundle->pstHotReload    = pstHotReload;
+    pstBundle->pstInputLog     = pstInputLog;
+    pstBundle->pstJobs         = pstJobs;
+    pstBundle->pstLevelManager = pstLevelManager;
+    pstBundle->pstMap          = pstMap;
+    pstBundle->pstMetrics      = pstMetrics;
+    pstBundle->stMusic         = stMusic;
+    pstBundle->pstProfiler     = pstProfiler;
+    pstBundle->pstSimProfiler  = pstProfiler;
+    pstBundle->pstSam          = pstSam;
+    pstBundle->pstBGSprites    = pstBGSprites;
+    pstBundle->pstSprites      = pstSprites;
+    pstBundle->pstSwarm        = pstSwarm;
+    pstBundle->pstVideo        = pstVideo;
 
     for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
     {
         pstBundle->pstBG[u8Index]  = pstBG[u8Index];
-        pstBundle->pstSfx[u8Index] = pstSfx[u8Index];
+        pstBundle->pstSfx[u8Index] = GetSfx(stSfx[u8Index]);
+    }
+
+    // Advance the simulation by a fixed virtual time step per frame.
+    if ((stConfig.stRun.s8FixedStep) && (stConfig.stVideo.s8FPS))
+    {
+        pstBundle->dFixedStep = 1.0 / stConfig.stVideo.s8FPS;
+    }
+
+    // The renderer draws from these while the simulation fills the next.
+    for (uint8_t u8Index = 0; u8Index < 3; u8Index++)
+    {
+        if (pstSwarm)
+        {
+            pstBundle->stSnapshot[u8Index].pstSwarm = CallocMemory(
+                MEMORY_ENTITY,
+                pstSwarm->u32Count,
+                sizeof(EntitySprite));
+
+            if (NULL == pstBundle->stSnapshot[u8Index].pstSwarm)
+            {
+                fprintf(stderr, "stSnapshot: error allocating memory.\n");
+                _s32ExecStatus = EXIT_FAILURE;
+                goto quit;
+            }
+        }
+    }
+
+    pstBundle->pstSnapshots = InitTripleBuffer(
+        &pstBundle->stSnapshot[0],
+        &pstBundle->stSnapshot[1],
+        &pstBundle->stSnapshot[2]);
+    if (NULL == pstBundle->pstSnapshots)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    /* The simulation thread steps at the frame rate and doesn't know
+     * about the frames, so input logs, which store a delta time per
+     * frame, keep the simulation on the main thread. */
+    if (stConfig.stRun.s8SimThread)
+    {
+        pstBundle->dSimStep = 1.0 / (stConfig.stVideo.s8FPS ? stConfig.stVideo.s8FPS : 60);
+
+        #ifdef __EMSCRIPTEN__
+        fprintf(stderr, "--sim-thread is not supported here, simulating on the main thread.\n");
+        #else
+        if (pstInputLog)
+        {
+            fprintf(stderr, "--sim-thread is ignored while recording or replaying input.\n");
+        }
+        else if (-1 == _StartSimulation(pstBundle))
+        {
+            _s32ExecStatus = EXIT_FAILURE;
+            goto quit;
+        }
+        #endif
     }
 
     #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop_arg(_MainLoop, (void *)pstBundle, 0, 1);
     #else
+    u64StartTicks = SDL_GetPerformanceCounter();
     while(1)
     {
-        if (EXIT_UNSET != _s32ExecStatus) goto quit;
+        if (EXIT_UNSET != _s32ExecStatus) break;
+        TRACE_BEGIN("Frame");
         _MainLoop((void *)pstBundle);
+        TRACE_END("Frame");
 
-        if (stConfig.stVideo.s8LimitFPS)
+        // Headless runs as fast as possible.
+        if ((stConfig.stVideo.s8LimitFPS) && (0 == pstBundle->u8Headless))
         {
             SDL_Delay((1000 / stConfig.stVideo.s8FPS) - pstBundle->dDeltaTime);
         }
     }
+    _StopSimulation(pstBundle);
+
+    if (pstBundle->u8Headless)
+    {
+        _PrintHeadlessStats(
+            pstProfiler,
+            pstJobs,
+            (double)(SDL_GetPerformanceCounter() - u64StartTicks)
+            / SDL_GetPerformanceFrequency());
+    }
+
+    if (pstSwarm)
+    {
+        _PrintSwarmStats(pstSwarm);
+    }
     #endif
 
 quit:
+    // Nothing may be freed while the simulation is still running.
+    if (pstBundle)
+    {
+        _StopSimulation(pstBundle);
+    }
+
+    if (IsMemoryTracked())
+    {
+        PrintResourceStats();
+    }
+
     for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
     {
-        free(pstBG[u8Index]);
-        free(pstSfx[u8Index]);
+        FreeBackground(pstBG[u8Index]);
+        ReleaseSfx(stSfx[u8Index]);
     }
 
-    free(pstBundle);
+    // The current level might have been swapped in the meantime.
+    if (pstBundle)
+    {
+        pstHotReload = pstBundle->pstHotReload;
+        pstMap       = pstBundle->pstMap;
+        stMusic      = pstBundle->stMusic;
+
+        FreeTripleBuffer(pstBundle->pstSnapshots);
+        for (uint8_t u8Index = 0; u8Index < 3; u8Index++)
+        {
+            FreeMemory(pstBundle->stSnapshot[u8Index].pstSwarm);
+        }
+    }
+
+    FreeMemory(pstBundle);
+    FreeHotReload(pstHotReload);
+    FreeInputLog(pstInputLog);
+    FreeLevelManager(pstLevelManager);
     FreeMap(pstMap);
+    FreeMetrics(pstMetrics);
+    ReleaseMusic(stMusic);
+    FreeSwarm(pstSwarm);
+    FreeSpriteBatch(pstSprites);
+    FreeSpriteBatch(pstBGSprites);
+    FreeEntity(pstSam);
+    SetVideoJobSystem(NULL);
+    FreeJobSystem(pstJobs);
+
+    // Everything has been released, so this only reports leaks.  Has
+    // to happen while the mixer and the renderer are still around.
+    FreeResources();
     FreeMixer(pstMixer);
-    free(pstMusic);
-    free(pstSam);
+    FreeProfiler(pstProfiler);
+    FreeTrace();
     TerminateVideo(pstVideo);
 
     return _s32ExecStatus;
 }
 
+/* Hold while changing anything the simulation reads, e.g. the Map or
+ * the zoom level.  Does nothing without the simulation thread. */
+static void _LockWorld(MainLoopBundle *pstBundle)
+{
+    if (pstBundle->pstWorldLock)
+    {
+        SDL_LockMutex(pstBundle->pstWorldLock);
+    }
+}
+
 static void _MainLoop(void *pArg)
 {
-    uint16_t        u16Flags   = 0;
-    const uint8_t  *u8KeyState = 0;
-    MainLoopBundle *pstBundle  = (MainLoopBundle *)pArg;
-    pstBundle->dTimeB          = SDL_GetTicks();
-    pstBundle->dDeltaTime      = (pstBundle->dTimeB - pstBundle->dTimeA) / 1000;
-    pstBundle->dTimeA          = pstBundle->dTimeB;
+    uint16_t        u16Keys   = 0;
+    uint16_t        u16Prev   = 0;
+    uint32_t        u32Allocs = 0;
+    MainLoopBundle *pstBundle = (MainLoopBundle *)pArg;
+    pstBundle->dTimeB         = SDL_GetTicks();
+    pstBundle->dDeltaTime     = (pstBundle->dTimeB - pstBundle->dTimeA) / 1000;
+    pstBundle->dTimeA         = pstBundle->dTimeB;
+
+    /* Once the game is up and running, frames must not allocate: the
+     * time malloc() takes is unpredictable.  Level swaps and hot
+     * reloads are allowed to, and so are the frames right after them. */
+    u32Allocs = BeginMemoryFrame();
+    if ((pstBundle->u8AssertNoAlloc) && (u32Allocs) &&
+        (pstBundle->u32Frame > pstBundle->u32SteadyFrame))
+    {
+        _PrintFrameAllocs(pstBundle->u32Frame, u32Allocs);
+        _s32ExecStatus = EXIT_FAILURE;
+        return;
+    }
+
+    if (pstBundle->pstMetrics)
+    {
+        _PublishMetrics(pstBundle);
+    }
+
+    if (pstBundle->dFixedStep)
+    {
+        pstBundle->dDeltaTime = pstBundle->dFixedStep;
+    }
 
-    // Process keyboard input.
+    pstBundle->u32Frame++;
+    if ((pstBundle->u32MaxFrames) && (pstBundle->u32Frame > pstBundle->u32MaxFrames))
+    {
+        _s32ExecStatus = EXIT_SUCCESS;
+        return;
+    }
+
+    /* An input log stores the delta time in microseconds, so recorded
+     * runs use exactly the same time steps as their replays. */
+    if (pstBundle->pstInputLog)
+    {
+        pstBundle->dDeltaTime = QuantiseDeltaTime(pstBundle->dDeltaTime);
+    }
+
+    BeginProfilerFrame(pstBundle->pstProfiler);
+
+    // Process input.
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_INPUT);
     SDL_PumpEvents();
     if (SDL_PeepEvents(0, 0, SDL_PEEKEVENT, SDL_QUIT, SDL_QUIT) > 0)
     {
         _s32ExecStatus = EXIT_FAILURE;
     }
-    u8KeyState = SDL_GetKeyboardState(NULL);
 
-    // Reset ENTITY_IS_TRAVELING flag (in case no key is pressed).
-    FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_IS_TRAVELING);
+    if ((pstBundle->pstInputLog) && (INPUT_LOG_REPLAY == pstBundle->pstInputLog->u8Mode))
+    {
+        if (-1 == ReplayInput(pstBundle->pstInputLog, &u16Keys, &pstBundle->dDeltaTime))
+        {
+            // End of the log.
+            PROFILE_END(pstBundle->pstProfiler, PROFILER_INPUT);
+            _s32ExecStatus = EXIT_SUCCESS;
+            return;
+        }
+    }
+    else if (pstBundle->u8Headless)
+    {
+        u16Keys = InjectInput(pstBundle->u32Frame);
+    }
+    else
+    {
+        u16Keys = ReadInput();
+    }
+
+    if ((pstBundle->pstInputLog) && (INPUT_LOG_RECORD == pstBundle->pstInputLog->u8Mode))
+    {
+        RecordInput(pstBundle->pstInputLog, u16Keys, pstBundle->dDeltaTime);
+    }
+
+    if ((FLAG_IS_SET(u16Keys, INPUT_PROFILER)) &&
+        (FLAG_IS_NOT_SET(pstBundle->u16PrevKeys, INPUT_PROFILER)))
+    {
+        pstBundle->pstProfiler->u8IsVisible ^= 1;
+        MarkDirtyRect(NULL);
+    }
+    pstBundle->u16PrevKeys = u16Keys;
 
     #ifndef __EMSCRIPTEN__
-    if (u8KeyState[SDL_SCANCODE_Q])
+    if (FLAG_IS_SET(u16Keys, INPUT_QUIT))
     {
         _s32ExecStatus = EXIT_SUCCESS;
     }
     #endif
 
-    if (u8KeyState[SDL_SCANCODE_P])
+    // The zoom level is renderer state, so it's changed here.
+    if (FLAG_IS_SET(u16Keys, INPUT_ZOOM_RESET) ||
+        FLAG_IS_SET(u16Keys, INPUT_ZOOM_OUT)   ||
+        FLAG_IS_SET(u16Keys, INPUT_ZOOM_IN))
     {
-        if (0 == pstBundle->u8GameIsPaused)
+        _LockWorld(pstBundle);
+        if (FLAG_IS_SET(u16Keys, INPUT_ZOOM_RESET))
         {
-            Mix_PauseMusic();
-            PlaySfx(pstBundle->pstSfx[3], 3, 0);
-            pstBundle->u8GameIsPaused = 1;
+            SetVideoZoomLevel(
+                pstBundle->pstVideo,
+                pstBundle->pstVideo->dZoomLevelInitial);
         }
+
+        if (FLAG_IS_SET(u16Keys, INPUT_ZOOM_OUT))
+        {
+            pstBundle->pstVideo->dZoomLevel -= pstBundle->dDeltaTime;
+            SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
+        }
+
+        if (FLAG_IS_SET(u16Keys, INPUT_ZOOM_IN))
+        {
+            pstBundle->pstVideo->dZoomLevel += pstBundle->dDeltaTime;
+            SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
+        }
+        _UnlockWorld(pstBundle);
     }
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_INPUT);
 
-    if (u8KeyState[SDL_SCANCODE_C])
+    // Pick up changes made to the map files while in development mode.
+    if (pstBundle->pstHotReload)
     {
-        if (1 == pstBundle->u8GameIsPaused)
+        uint16_t u16Changed = PollHotReload(pstBundle->pstHotReload);
+        if (u16Changed)
         {
-            PlaySfx(pstBundle->pstSfx[4], 4, 0);
-            Mix_ResumeMusic();
-            pstBundle->u8GameIsPaused = 0;
+            _LockWorld(pstBundle);
+            ReloadMap(
+                pstBundle->pstVideo->pstRenderer,
+                pstBundle->pstMap,
+                u16Changed);
+            _UpdateMapBoundaries(pstBundle);
+            _UnlockWorld(pstBundle);
+            pstBundle->u32SteadyFrame = pstBundle->u32Frame + ALLOC_WARMUP_FRAMES;
+        }
+    }
+
+    if (pstBundle->pstSimThread)
+    {
+        /* Keys which are pressed and released again before the next
+         * step mustn't get lost, e.g. a short tap on jump. */
+        SDL_AtomicSet(&pstBundle->stKeys, u16Keys);
+        do
+        {
+            u16Prev = SDL_AtomicGet(&pstBundle->stKeysPressed);
         }
+        while (SDL_FALSE == SDL_AtomicCAS(&pstBundle->stKeysPressed, u16Prev, u16Prev | u16Keys));
+    }
+    else if (_Simulate(pstBundle, u16Keys, pstBundle->dDeltaTime))
+    {
+        PublishWriteBuffer(pstBundle->pstSnapshots);
     }
 
-    if (1 == pstBundle->u8GameIsPaused) { return; };
+    /* Swap in the next level once the player reaches the right edge.
+     * The new Map has to be uploaded to the GPU, so it happens here. */
+    if (SDL_AtomicGet(&pstBundle->stAtExit))
+    {
+        _LockWorld(pstBundle);
+        _NextLevel(pstBundle);
+        _UnlockWorld(pstBundle);
+    }
 
-    if (u8KeyState[SDL_SCANCODE_0])
+    _Render(pstBundle);
+
+    EndProfilerFrame(pstBundle->pstProfiler);
+
+    #ifdef __EMSCRIPTEN__
+    if (EXIT_UNSET != _s32ExecStatus)
     {
-        SetVideoZoomLevel(
-            pstBundle->pstVideo,
-            pstBundle->pstVideo->dZoomLevelInitial);
+        emscripten_cancel_main_loop();
     }
+    #endif
+}
+
+static void _NextLevel(MainLoopBundle *pstBundle)
+{
+    static uint64_t u64PrevLiveBytes;
+    uint64_t        u64LiveBytes;
+    uint8_t         u8NextIndex;
 
-    if (u8KeyState[SDL_SCANCODE_1])
+    if (pstBundle->pstInputLog)
+    {
+        // The transition must happen on the same frame in every run.
+        if (0 == WaitForLevel(pstBundle->pstLevelManager))
+        {
+            return;
+        }
+    }
+    else if (0 == IsLevelReady(pstBundle->pstLevelManager))
     {
-        pstBundle->pstVideo->dZoomLevel -= pstBundle->dDeltaTime;
-        SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
+        // Keep on playing; the transition happens once it's loaded.
+        return;
     }
 
-    if (u8KeyState[SDL_SCANCODE_2])
+    if (-1 == SwapLevel(
+            pstBundle->pstLevelManager,
+            pstBundle->pstVideo->pstRenderer,
+            &pstBundle->pstMap,
+            &pstBundle->stMusic))
     {
-        pstBundle->pstVideo->dZoomLevel += pstBundle->dDeltaTime;
-        SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
+        return;
     }
 
-    if (u8KeyState[SDL_SCANCODE_LEFT])
+    // The player starts over at the left edge of the new level.
+    SDL_AtomicSet(&pstBundle->stAtExit, 0);
+    MarkDirtyRect(NULL);
+
+    pstBundle->u8LevelIndex   = (pstBundle->u8LevelIndex + 1) % LEVEL_COUNT;
+    pstBundle->u32SteadyFrame = pstBundle->u32Frame + ALLOC_WARMUP_FRAMES;
+    u8NextIndex               = (pstBundle->u8LevelIndex + 1) % LEVEL_COUNT;
+
+    /* The previous level has been freed and the next one isn't being
+     * loaded yet, so this should be the same after every swap to the
+     * same level. */
+    if (IsMemoryTracked())
+    {
+        u64LiveBytes = GetLiveMemory();
+        fprintf(stderr, "Level %u: %.1f KiB live after swap (%+lld bytes)\n",
+            pstBundle->u8LevelIndex,
+            u64LiveBytes / 1024.0,
+            u64PrevLiveBytes ? (long long)(u64LiveBytes - u64PrevLiveBytes) : 0);
+        u64PrevLiveBytes = u64LiveBytes;
+    }
+
+    PlayMusic(GetMusic(pstBundle->stMusic), -1);
+    _UpdateMapBoundaries(pstBundle);
+    ResurrectEntity(pstBundle->pstSam);
+
+    if (pstBundle->pstHotReload)
+    {
+        FreeHotReload(pstBundle->pstHotReload);
+        pstBundle->pstHotReload = InitHotReload(pstBundle->pstMap);
+    }
+
+    PreloadLevel(
+        pstBundle->pstLevelManager,
+        _pacLevelList[u8NextIndex][0],
+        _pacLevelList[u8NextIndex][1],
+        _pacLevelList[u8NextIndex][2]);
+}
+
+/* Publish the previous frame, from the start of one _MainLoop() call
+ * to the next, so paused frames and the frame limiter are included. */
+static void _PublishMetrics(MainLoopBundle *pstBundle)
+{
+    uint64_t      u64Now   = SDL_GetPerformanceCounter();
+    VideoStats    stVideo;
+    MetricsSample stSample;
+
+    if (0 == pstBundle->u64LastPublish)
+    {
+        pstBundle->u64LastPublish = u64Now;
+        return;
+    }
+
+    stVideo                    = GetVideoStats();
+    stSample.u64FrameTimeNs    =
+        (u64Now - pstBundle->u64LastPublish) * 1e9 / SDL_GetPerformanceFrequency();
+    stSample.u64TextureBytes   = stVideo.u64TextureBytes;
+    stSample.u32Textures       = stVideo.u32Textures;
+    stSample.u32Entities       = 1 + (pstBundle->pstSwarm ? pstBundle->pstSwarm->u32Count : 0);
+    stSample.u32AudioUnderruns = GetAudioStats().u32Underruns;
+
+    PublishMetrics(pstBundle->pstMetrics, &stSample);
+    pstBundle->u64LastPublish = u64Now;
+}
+
+static void _UpdateMapBoundaries(MainLoopBundle *pstBundle)
+{
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        pstBundle->pstBG[u8Index]->dWorldPosY =
+            pstBundle->pstMap->u32Height - pstBundle->pstBG[u8Index]->s32Height;
+    }
+
+    pstBundle->pstSam->u32MapWidth  = pstBundle->pstMap->u32Width;
+    pstBundle->pstSam->u32MapHeight = pstBundle->pstMap->u32Height;
+}
+
+static void _PrintFrameAllocs(uint32_t u32Frame, uint32_t u32Allocs)
+{
+    MemoryStats stStats = GetMemoryStats();
+
+    fprintf(stderr, "Frame %u allocated memory %u time(s) after warm-up:", u32Frame, u32Allocs);
+    for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAGS; u8Tag++)
+    {
+        if (stStats.u32FrameCheckedAllocs[u8Tag])
+        {
+            fprintf(stderr, " %s %u", GetMemoryTagName(u8Tag), stStats.u32FrameCheckedAllocs[u8Tag]);
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+static void _PrintHeadlessStats(const Profiler *pstProfiler, JobSystem *pstJobs, double dSeconds)
+{
+    AudioStats stAudio = GetAudioStats();
+    VideoStats stVideo = GetVideoStats();
+    double     dFrames = stVideo.u64Frames ? (double)stVideo.u64Frames : 1.0;
+
+    printf("frames:          %llu\n", (unsigned long long)stVideo.u64Frames);
+    printf("wall time:       %.3f s\n", dSeconds);
+    printf("frame time:      %.4f ms\n", dSeconds * 1000.0 / dFrames);
+    printf("frames/s:        %.1f\n", dFrames / dSeconds);
+    printf("draw calls:      %llu (%.1f per frame)\n",
+        (unsigned long long)stVideo.u64DrawCalls,
+        stVideo.u64DrawCalls / dFrames);
+    printf("textures:        %u (%.1f MiB)\n",
+        stVideo.u32Textures,
+        stVideo.u64TextureBytes / (1024.0 * 1024.0));
+    printf("sfx triggered:   %u\n", stAudio.u32SfxPlayed);
+    printf("music triggered: %u\n", stAudio.u32MusicPlayed);
+    printf("jobs:            %d (%d stolen, %u workers)\n",
+        SDL_AtomicGet(&pstJobs->stJobsRun),
+        SDL_AtomicGet(&pstJobs->stJobsStolen),
+        pstJobs->u8Workers);
+
+    printf("\n%-8s %9s %9s %9s (ms, last %u frames)\n",
+        "stage", "min", "avg", "p99", pstProfiler->u16Count);
+    for (uint8_t u8Stage = 0; u8Stage <= PROFILER_STAGES; u8Stage++)
+    {
+        ProfilerStats stStats = GetProfilerStats(pstProfiler, u8Stage);
+
+        printf("%-8s %9.4f %9.4f %9.4f\n",
+            GetProfilerStageName(u8Stage),
+            stStats.u32Min / 1000000.0,
+            stStats.u32Avg / 1000000.0,
+            stStats.u32P99 / 1000000.0);
+    }
+}
+
+static void _PrintSwarmStats(const Swarm *pstSwarm)
+{
+    double dFrequency = SDL_GetPerformanceFrequency();
+    double dTotalMs   = 0;
+    double dTotalNs   = 0;
+
+    if ((0 == pstSwarm->u64Frames) || (0 == pstSwarm->u64Draws))
+    {
+        return;
+    }
+
+    printf("\n%u entities, %llu frames\n",
+        pstSwarm->u32Count, (unsigned long long)pstSwarm->u64Frames);
+    printf("%-10s %12s %12s\n", "stage", "ms/frame", "ns/entity");
+    for (uint8_t u8Stage = 0; u8Stage < SWARM_STAGES; u8Stage++)
+    {
+        // With the simulation thread, frames are drawn independently
+        // of the updates.
+        double dCount   = SWARM_DRAW == u8Stage ? pstSwarm->u64Draws : pstSwarm->u64Frames;
+        double dSeconds = pstSwarm->u64Ticks[u8Stage] / dFrequency;
+
+        dTotalMs += dSeconds * 1e3 / dCount;
+        dTotalNs += dSeconds * 1e9 / (dCount * pstSwarm->u32Count);
+        printf("%-10s %12.4f %12.2f\n",
+            GetSwarmStageName(u8Stage),
+            dSeconds * 1e3 / dCount,
+            dSeconds * 1e9 / (dCount * pstSwarm->u32Count));
+    }
+    printf("%-10s %12.4f %12.2f\n", "total", dTotalMs, dTotalNs);
+}
+
+/* Draw the latest snapshot.  Nothing here may touch the state the
+ * simulation updates, except for the Map, which it only reads. */
+static void _Render(MainLoopBundle *pstBundle)
+{
+    RenderSnapshot *pstSnapshot;
+    uint8_t         u8IsNew = 0;
+
+    pstSnapshot = GetReadBuffer(pstBundle->pstSnapshots, &u8IsNew);
+    if (NULL == pstSnapshot)
+    {
+        // Nothing has been simulated yet, e.g. paused right away.
+        return;
+    }
+
+    // Account for the simulation step once, in the frame showing it.
+    if ((u8IsNew) && (pstBundle->pstSimThread))
+    {
+        for (uint8_t u8Stage = 0; u8Stage < PROFILER_STAGES; u8Stage++)
+        {
+            AddProfilerStageTime(
+                pstBundle->pstProfiler,
+                u8Stage,
+                pstSnapshot->u32StageTime[u8Stage]);
+        }
+    }
+
+    /* Render scene.  The sprites are collected first: the software
+     * renderer only redraws what has changed since the last frame,
+     * which has to be known before anything is drawn. */
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_BG);
+    #ifdef __EMSCRIPTEN__
+    SDL_RenderClear(pstBundle->pstVideo->pstRenderer);
+    #endif
+
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        DrawBackground(
+            pstBundle->pstBGSprites,
+            &pstSnapshot->stBG[u8Index],
+            u8Index,
+            pstSnapshot->dCameraPosY);
+    }
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_BG);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_ENTITY);
+    BatchEntitySprite(
+        pstBundle->pstSprites,
+        &pstSnapshot->stSam,
+        0,
+        pstSnapshot->dCameraPosX,
+        pstSnapshot->dCameraPosY);
+
+    if (pstBundle->pstSwarm)
+    {
+        DrawSwarm(
+            pstBundle->pstSprites,
+            pstBundle->pstSwarm,
+            pstSnapshot->pstSwarm,
+            pstSnapshot->dCameraPosX,
+            pstSnapshot->dCameraPosY);
+    }
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_ENTITY);
+
+    // Everything moves along with the camera.
+    if ((pstSnapshot->dCameraPosX != pstBundle->dDrawnCameraPosX) ||
+        (pstSnapshot->dCameraPosY != pstBundle->dDrawnCameraPosY) ||
+        (pstBundle->pstProfiler->u8IsVisible))
+    {
+        MarkDirtyRect(NULL);
+    }
+    pstBundle->dDrawnCameraPosX = pstSnapshot->dCameraPosX;
+    pstBundle->dDrawnCameraPosY = pstSnapshot->dCameraPosY;
+
+    MarkChangedSprites(pstBundle->pstBGSprites);
+    MarkChangedSprites(pstBundle->pstSprites);
+    ClearVideo(pstBundle->pstVideo->pstRenderer);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_BG);
+    FlushSpriteBatch(pstBundle->pstBGSprites);
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_BG);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_MAP_BG);
+    DrawMap(
+        pstBundle->pstVideo->pstRenderer,
+        pstBundle->pstMap,
+        "Background",
+        1,
+        0,
+        pstSnapshot->dCameraPosX,
+        pstSnapshot->dCameraPosY);
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_MAP_BG);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_ENTITY);
+    FlushSpriteBatch(pstBundle->pstSprites);
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_ENTITY);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_DRAW_MAP_FG);
+    DrawMap(
+        pstBundle->pstVideo->pstRenderer,
+        pstBundle->pstMap,
+        "Foreground",
+        0,
+        2,
+        pstSnapshot->dCameraPosX,
+        pstSnapshot->dCameraPosY);
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_DRAW_MAP_FG);
+
+    if (pstBundle->pstProfiler->u8IsVisible)
+    {
+        AudioStats stAudio = GetAudioStats();
+
+        pstBundle->pstProfiler->u32AudioLateCallbacks = stAudio.u32LateCallbacks;
+        pstBundle->pstProfiler->u32AudioUnderruns     = stAudio.u32Underruns;
+    }
+
+    // The profiler draws with SDL's renderer, on top of the frame.
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_PRESENT);
+    FlushVideo();
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_PRESENT);
+
+    DrawProfiler(
+        pstBundle->pstVideo->pstRenderer,
+        pstBundle->pstProfiler,
+        pstBundle->dFrameBudget);
+
+    PROFILE_BEGIN(pstBundle->pstProfiler, PROFILER_PRESENT);
+    UpdateVideo(pstBundle->pstVideo->pstRenderer);
+    PROFILE_END(pstBundle->pstProfiler, PROFILER_PRESENT);
+}
+
+/* The simulation thread: steps at dSimStep until _StopSimulation() is
+ * called, independently of the frame rate. */
+static int _RunSimulation(void *pArg)
+{
+    MainLoopBundle *pstBundle  = (MainLoopBundle *)pArg;
+    uint64_t        u64Period  = SDL_GetPerformanceFrequency() * pstBundle->dSimStep;
+    uint64_t        u64Next    = SDL_GetPerformanceCounter();
+    uint64_t        u64Now;
+    uint16_t        u16Keys;
+    uint8_t         u8IsWritten;
+
+    TRACE_THREAD("Simulation");
+
+    while (SDL_AtomicGet(&pstBundle->stSimRunning))
+    {
+        u16Keys =
+            SDL_AtomicGet(&pstBundle->stKeys) |
+            SDL_AtomicSet(&pstBundle->stKeysPressed, 0);
+
+        TRACE_BEGIN("Simulate");
+        SDL_LockMutex(pstBundle->pstWorldLock);
+        BeginProfilerFrame(pstBundle->pstSimProfiler);
+        u8IsWritten = _Simulate(pstBundle, u16Keys, pstBundle->dSimStep);
+        EndProfilerFrame(pstBundle->pstSimProfiler);
+        SDL_UnlockMutex(pstBundle->pstWorldLock);
+
+        if (u8IsWritten)
+        {
+            RenderSnapshot *pstSnapshot = GetWriteBuffer(pstBundle->pstSnapshots);
+
+            for (uint8_t u8Stage = 0; u8Stage < PROFILER_STAGES; u8Stage++)
+            {
+                pstSnapshot->u32StageTime[u8Stage] =
+                    GetProfilerStageTime(pstBundle->pstSimProfiler, u8Stage);
+            }
+            PublishWriteBuffer(pstBundle->pstSnapshots);
+        }
+        TRACE_END("Simulate");
+
+        // Headless runs as fast as possible.
+        if (pstBundle->u8Headless)
+        {
+            continue;
+        }
+
+        u64Next += u64Period;
+        u64Now   = SDL_GetPerformanceCounter();
+        if (u64Now < u64Next)
+        {
+            SDL_Delay((u64Next - u64Now) * 1000 / SDL_GetPerformanceFrequency());
+        }
+        else if (u64Now - u64Next > 4 * u64Period)
+        {
+            // Too far behind, e.g. after a level swap: don't catch up.
+            u64Next = u64Now;
+        }
+    }
+
+    return 0;
+}
+
+/* Advance the game by one step and fill the write buffer of the
+ * snapshots.  Runs on the simulation thread holding the world lock, or
+ * as part of _MainLoop().  Returns 1 if the snapshot has to be
+ * published, 0 while the game is paused. */
+static uint8_t _Simulate(MainLoopBundle *pstBundle, uint16_t u16Keys, double dDeltaTime)
+{
+    Profiler       *pstProfiler = pstBundle->pstSimProfiler;
+    RenderSnapshot *pstSnapshot;
+    uint16_t        u16Flags    = 0;
+
+    PROFILE_BEGIN(pstProfiler, PROFILER_INPUT);
+
+    // Reset ENTITY_IS_TRAVELING flag (in case no key is pressed).
+    FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_IS_TRAVELING);
+
+    if (FLAG_IS_SET(u16Keys, INPUT_PAUSE))
+    {
+        if (0 == pstBundle->u8GameIsPaused)
+        {
+            PauseMusic();
+            PlaySfx(pstBundle->pstSfx[3], 1.0f, 0.0f, SFX_PRIORITY_HIGH);
+            pstBundle->u8GameIsPaused = 1;
+        }
+    }
+
+    if (FLAG_IS_SET(u16Keys, INPUT_UNPAUSE))
+    {
+        if (1 == pstBundle->u8GameIsPaused)
+        {
+            PlaySfx(pstBundle->pstSfx[4], 1.0f, 0.0f, SFX_PRIORITY_HIGH);
+            ResumeMusic();
+            pstBundle->u8GameIsPaused = 0;
+        }
+    }
+
+    if (1 == pstBundle->u8GameIsPaused)
+    {
+        PROFILE_END(pstProfiler, PROFILER_INPUT);
+        return 0;
+    }
+
+    if (FLAG_IS_SET(u16Keys, INPUT_LEFT))
     {
         FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_TRAVELING);
         FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION);
     }
 
-    if (u8KeyState[SDL_SCANCODE_RIGHT])
+    if (FLAG_IS_SET(u16Keys, INPUT_RIGHT))
     {
         FLAG_SET(pstBundle->pstSam->u16Flags,   ENTITY_IS_TRAVELING);
         FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION);
     }
 
-    if (u8KeyState[SDL_SCANCODE_SPACE])
+    if (FLAG_IS_SET(u16Keys, INPUT_JUMP))
     {
         if (
             (FLAG_IS_NOT_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_JUMPING)) &&
             (FLAG_IS_NOT_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IN_MID_AIR)) )
         {
-                PlaySfx(pstBundle->pstSfx[2], 2, 0);
+                PlaySfx(pstBundle->pstSfx[2], 1.0f, 0.0f, SFX_PRIORITY_NORMAL);
                 FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_JUMPING);
         }
     }
+    PROFILE_END(pstProfiler, PROFILER_INPUT);
 
     // Set camera position.
+    PROFILE_BEGIN(pstProfiler, PROFILER_CAMERA);
     pstBundle->dCameraPosX =
         pstBundle->pstSam->dWorldPosX
         - pstBundle->pstVideo->s32WindowWidth
@@ -352,7 +1247,10 @@ static void _MainLoop(void *pArg)
         pstBundle->dCameraPosY = pstBundle->dCameraMaxPosY;
     }
 
+    PROFILE_END(pstProfiler, PROFILER_CAMERA);
+
     // Set background scroll direction.
+    PROFILE_BEGIN(pstProfiler, PROFILER_BG_SCROLL);
     if (FLAG_IS_NOT_SET(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION))
     {
         for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
@@ -387,7 +1285,14 @@ static void _MainLoop(void *pArg)
     pstBundle->pstBG[1]->dVelocity = pstBundle->pstBG[4]->dVelocity / 4;
     pstBundle->pstBG[0]->dVelocity = pstBundle->pstBG[4]->dVelocity / 5;
 
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        UpdateBackground(pstBundle->pstBG[u8Index]);
+    }
+    PROFILE_END(pstProfiler, PROFILER_BG_SCROLL);
+
     // Set sprite animation.
+    PROFILE_BEGIN(pstProfiler, PROFILER_ENTITY_UPDATE);
     FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IDLING);
 
     if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IDLING))
@@ -414,7 +1319,10 @@ static void _MainLoop(void *pArg)
         }
     }
 
+    PROFILE_END(pstProfiler, PROFILER_ENTITY_UPDATE);
+
     // Set up collision detection.
+    PROFILE_BEGIN(pstProfiler, PROFILER_COLLISION);
     if (IsMapCoordOfType(
             pstBundle->pstMap,
             "Floor",
@@ -428,59 +1336,122 @@ static void _MainLoop(void *pArg)
         FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IN_MID_AIR);
     }
 
+    /* The exit is the last column of tiles, where the player would wrap
+     * around to the left edge otherwise.  The level is swapped by the
+     * main thread, which also resets the flag.  See _MainLoop(). */
+    if ((FLAG_IS_NOT_SET(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION)) &&
+        (pstBundle->pstSam->dWorldPosX + pstBundle->pstSam->u8Width >=
+         pstBundle->pstMap->u32Width - pstBundle->pstMap->pstTmxMap->tile_width))
+    {
+        SDL_AtomicSet(&pstBundle->stAtExit, 1);
+    }
+    PROFILE_END(pstProfiler, PROFILER_COLLISION);
+
     // Resurrect dead player entity if necessary.
+    PROFILE_BEGIN(pstProfiler, PROFILER_ENTITY_UPDATE);
     if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_DEAD))
     {
-        PlaySfx(pstBundle->pstSfx[1], 1, 0);
+        PlaySfx(pstBundle->pstSfx[1], 1.0f, 0.0f, SFX_PRIORITY_HIGH);
         ResurrectEntity(pstBundle->pstSam);
     }
 
     // Update player entity.
-    UpdateEntity(pstBundle->pstSam, pstBundle->dDeltaTime);
+    UpdateEntity(pstBundle->pstSam, dDeltaTime);
 
-    // Render scene.
-    #ifdef __EMSCRIPTEN__
-    SDL_RenderClear(pstBundle->pstVideo->pstRenderer);
-    #endif
+    if (pstBundle->pstSwarm)
+    {
+        UpdateSwarm(
+            pstBundle->pstSwarm,
+            pstBundle->pstMap,
+            pstBundle->pstJobs,
+            dDeltaTime);
+    }
 
+    // Take the snapshot the renderer is going to draw.
+    pstSnapshot = GetWriteBuffer(pstBundle->pstSnapshots);
     for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
     {
-        DrawBackground(
-            pstBundle->pstVideo->pstRenderer,
-            pstBundle->pstBG[u8Index],
-            pstBundle->dCameraPosY);
+        pstSnapshot->stBG[u8Index] = *pstBundle->pstBG[u8Index];
     }
+    CopyEntitySprite(pstBundle->pstSam, &pstSnapshot->stSam);
+    if (pstBundle->pstSwarm)
+    {
+        CopySwarmSprites(pstBundle->pstSwarm, pstSnapshot->pstSwarm);
+    }
+    pstSnapshot->dCameraPosX = pstBundle->dCameraPosX;
+    pstSnapshot->dCameraPosY = pstBundle->dCameraPosY;
+    PROFILE_END(pstProfiler, PROFILER_ENTITY_UPDATE);
 
-    DrawMap(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstMap,
-        "Background",
-        1,
-        0,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
+    return 1;
+}
 
-    DrawEntity(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstSam,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
+/* Start the simulation thread.  The simulation gets its own Profiler;
+ * its stage times are added to the frame which draws its result. */
+static int8_t _StartSimulation(MainLoopBundle *pstBundle)
+{
+    pstBundle->pstSimProfiler = InitProfiler();
+    if (NULL == pstBundle->pstSimProfiler)
+    {
+        return -1;
+    }
 
-    DrawMap(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstMap,
-        "Foreground",
-        0,
-        2,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
+    pstBundle->pstWorldLock = SDL_CreateMutex();
+    if (NULL == pstBundle->pstWorldLock)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
 
-    UpdateVideo(pstBundle->pstVideo->pstRenderer);
+    SDL_AtomicSet(&pstBundle->stSimRunning, 1);
+    pstBundle->pstSimThread = SDL_CreateThread(
+        _RunSimulation,
+        "Simulation",
+        (void *)pstBundle);
 
-    #ifdef __EMSCRIPTEN__
-    if (EXIT_UNSET != _s32ExecStatus)
+    if (NULL == pstBundle->pstSimThread)
     {
-        emscripten_cancel_main_loop();
+        fprintf(stderr, "%s\n", SDL_GetError());
+        SDL_AtomicSet(&pstBundle->stSimRunning, 0);
+        return -1;
+    }
+
+    /* Otherwise the first frames draw nothing, which would e.g. count
+     * towards --frames in headless runs. */
+    while (NULL == GetReadBuffer(pstBundle->pstSnapshots, NULL))
+    {
+        SDL_Delay(1);
+    }
+
+    return 0;
+}
+
+/* Stop the simulation thread, if any, and free what it used. */
+static void _StopSimulation(MainLoopBundle *pstBundle)
+{
+    if (pstBundle->pstSimThread)
+    {
+        SDL_AtomicSet(&pstBundle->stSimRunning, 0);
+        SDL_WaitThread(pstBundle->pstSimThread, NULL);
+        pstBundle->pstSimThread = NULL;
+    }
+
+    if (pstBundle->pstWorldLock)
+    {
+        SDL_DestroyMutex(pstBundle->pstWorldLock);
+        pstBundle->pstWorldLock = NULL;
+    }
+
+    if (pstBundle->pstSimProfiler != pstBundle->pstProfiler)
+    {
+        FreeProfiler(pstBundle->pstSimProfiler);
+        pstBundle->pstSimProfiler = pstBundle->pstProfiler;
+    }
+}
+
+static void _UnlockWorld(MainLoopBundle *pstBundle)
+{
+    if (pstBundle->pstWorldLock)
+    {
+        SDL_UnlockMutex(pstBundle->pstWorldLock);
     }
-    #endif
 }
@@ -12,67 +12,151 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "tmx/tmx.h"
+#include "Macros.h"
 #include "Map.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "Trace.h"
+#include "Video.h"
 
-/**
- * @brief   Draw Map.
- * @param   pstRenderer      a SDL rendering context.  See @ref struct Video.
- * @param   pstMap           the Map.  See @ref struct Map.
- * @param   pacLayerName     substring of the layer(s) to render.
- * @param   u8RenderBgColour a boolean value to set whether the background
- *                           colour should be rendered or not.
- * @param   u8Index          the layer index.  The total amount of layers per map
- *                           is defined by MAP_MAX_LAYERS.  Not to confused with
-                             the layers used by Tiled which can be grouped by name.
- * @param   dCameraPosX      camera position along the x-axis.
- * @param   dCameraPosY      camera position along the y-axis.
- * @return  0 on success, -1 on failure.
- * @ingroup Map
- */
-int8_t DrawMap(
-    SDL_Renderer  *pstRenderer,
-    Map           *pstMap,
-    const char    *pacLayerName,
-    const uint8_t  u8RenderBgColour,
-    const uint8_t  u8Index,
-    const double   dCameraPosX,
-    const double   dCameraPosY)
+static void _RenderTiles(
+    SDL_Renderer   *pstRenderer,
+    const Map      *pstMap,
+    const char     *pacLayerName,
+    const SDL_Rect *pstRegion)
 {
-    SDL_Texture *pstTileset = NULL;
-    tmx_layer   *pstLayers  = pstMap->pstTmxMap->ly_head;
+    tmx_layer *pstLayers = pstMap->pstTmxMap->ly_head;
 
-    // Draw layer in case it has already been rendered.
-    if (pstMap->pstLayer[u8Index])
+    while(pstLayers)
     {
-        double dRenderPosX = pstMap->dWorldPosX - dCameraPosX;
-        double dRenderPosY = pstMap->dWorldPosY - dCameraPosY;
+        uint32_t     u32Gid;
+        SDL_Rect     stDst;
+        SDL_Rect     stSrc;
+        tmx_tileset *pstTS;
 
-        SDL_Rect stDst =
-        {
-            dRenderPosX,
-            dRenderPosY,
-            pstMap->pstTmxMap->width  * pstMap->pstTmxMap->tile_width,
-            pstMap->pstTmxMap->height * pstMap->pstTmxMap->tile_height
-        };
-        if (-1 == SDL_RenderCopyEx(
-                pstRenderer,
-                pstMap->pstLayer[u8Index],
-                NULL,
-                &stDst,
-                0,
-                NULL,
-                SDL_FLIP_NONE))
+        if ((L_LAYER == pstLayers->type) &&
+            (pstLayers->visible) &&
+            (NULL != strstr(pstLayers->name, pacLayerName)))
         {
-            fprintf(stderr, "%s\n", SDL_GetError());
-            return -1;
+            for (int32_t s32IndexH = pstRegion->y; s32IndexH < pstRegion->y + pstRegion->h; s32IndexH++)
+            {
+                for (int32_t s32IndexW = pstRegion->x; s32IndexW < pstRegion->x + pstRegion->w; s32IndexW++)
+                {
+                    u32Gid = pstLayers->content.gids[
+                        (s32IndexH * pstMap->pstTmxMap->width) + s32IndexW]
+                        & TMX_FLIP_BITS_REMOVAL;
+                    if (NULL != pstMap->pstTmxMap->tiles[u32Gid])
+                    {
+                        pstTS    = pstMap->pstTmxMap->tiles[u32Gid]->tileset;
+                        stSrc.x  = pstMap->pstTmxMap->tiles[u32Gid]->ul_x + pstMap->stTilesetRect.x;
+                        stSrc.y  = pstMap->pstTmxMap->tiles[u32Gid]->ul_y + pstMap->stTilesetRect.y;
+                        stSrc.w  = stDst.w   = pstTS->tile_width;
+                        stSrc.h  = stDst.h   = pstTS->tile_height;
+                        stDst.x  = s32IndexW * pstTS->tile_width;
+                        stDst.y  = s32IndexH * pstTS->tile_height;
+                        DrawTexture(pstRenderer, pstMap->pstTileset, &stSrc, &stDst, SDL_FLIP_NONE);
+                    }
+                }
+            }
         }
-        return 0;
+        pstLayers = pstLayers->next;
+    }
+}
+
+/* Release the tileset, either the atlas page or its own texture. */
+static void _ReleaseTileset(Map *pstMap)
+{
+    if (pstMap->stTileset.u32Id)
+    {
+        ReleaseTexture(pstMap->stTileset);
+    }
+    else
+    {
+        DestroyTexture(pstMap->pstTileset);
+    }
+
+    pstMap->pstTileset      = NULL;
+    pstMap->stTileset.u32Id = 0;
+    pstMap->stTilesetRect.x = 0;
+    pstMap->stTilesetRect.y = 0;
+}
+
+/* Clear and re-render a region (in tiles) of an already baked layer. */
+static int8_t _RebakeLayer(
+    SDL_Renderer   *pstRenderer,
+    Map            *pstMap,
+    const uint8_t   u8Index,
+    const SDL_Rect *pstRegion)
+{
+    SDL_Rect stClear =
+    {
+        pstRegion->x * pstMap->pstTmxMap->tile_width,
+        pstRegion->y * pstMap->pstTmxMap->tile_height,
+        pstRegion->w * pstMap->pstTmxMap->tile_width,
+        pstRegion->h * pstMap->pstTmxMap->tile_height
+    };
+
+    if (0 != SetDrawTarget(pstRenderer, pstMap->pstLayer[u8Index]))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    EraseRect(pstRenderer, &stClear);
+    _RenderTiles(pstRenderer, pstMap, pstMap->pacLayerName[u8Index], pstRegion);
+
+    if (0 != SetDrawTarget(pstRenderer, NULL))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Extend pstRegion to contain the tile at (s32X, s32Y). */
+static void _ExtendRegion(SDL_Rect *pstRegion, int32_t s32X, int32_t s32Y)
+{
+    if (0 == pstRegion->w)
+    {
+        pstRegion->x = s32X;
+        pstRegion->y = s32Y;
+        pstRegion->w = 1;
+        pstRegion->h = 1;
+        return;
+    }
+
+    if (s32X < pstRegion->x)
+    {
+        pstRegion->w += pstRegion->x - s32X;
+        pstRegion->x  = s32X;
+    }
+    else if (s32X >= pstRegion->x + pstRegion->w)
+    {
+        pstRegion->w = s32X - pstRegion->x + 1;
     }
-    // Else: render layer once.
-    pstMap->pstLayer[u8Index] = SDL_CreateTexture(
+
+    if (s32Y < pstRegion->y)
+    {
+        pstRegion->h += pstRegion->y - s32Y;
+        pstRegion->y  = s32Y;
+    }
+    else if (s32Y >= pstRegion->y + pstRegion->h)
+    {
+        pstRegion->h = s32Y - pstRegion->y + 1;
+    }
+}
+
+/* Create the texture of a layer and render its tiles into it. */
+static int8_t _BakeLayer(
+    SDL_Renderer  *pstRenderer,
+    Map           *pstMap,
+    const char    *pacLayerName,
+    const uint8_t  u8RenderBgColour,
+    const uint8_t  u8Index)
+{
+    pstMap->pstLayer[u8Index] = CreateTargetTexture(
         pstRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_TARGET,
         pstMap->pstTmxMap->width  * pstMap->pstTmxMap->tile_width,
         pstMap->pstTmxMap->height * pstMap->pstTmxMap->tile_height);
 
@@ -82,16 +166,12 @@ int8_t DrawMap(
         return -1;
     }
 
-    pstTileset = IMG_LoadTexture(
-        pstRenderer,
-        pstMap->pacTilesetImageFilename);
-    if (NULL == pstTileset)
+    if (-1 == UploadMapTileset(pstRenderer, pstMap))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, pstMap->pstLayer[u8Index]))
+    if (0 != SetDrawTarget(pstRenderer, pstMap->pstLayer[u8Index]))
     {
         fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
@@ -107,41 +187,14 @@ int8_t DrawMap(
             255);
     }
 
-    while(pstLayers)
-    {
-        uint32_t     u32Gid;
-        SDL_Rect     stDst;
-        SDL_Rect     stSrc;
-        tmx_tileset *pstTS;
-
-        if ((pstLayers->visible) && (NULL != strstr(pstLayers->name, pacLayerName)))
-        {
-            for (uint32_t u32IndexH = 0; u32IndexH < pstMap->pstTmxMap->height; u32IndexH++)
-            {
-                for (uint32_t u32IndexW = 0; u32IndexW < pstMap->pstTmxMap->width; u32IndexW++)
-                {
-                    u32Gid = pstLayers->content.gids[
-                        (u32IndexH * pstMap->pstTmxMap->width) + u32IndexW]
-                        & TMX_FLIP_BITS_REMOVAL;
-                    if (NULL != pstMap->pstTmxMap->tiles[u32Gid])
-                    {
-                        pstTS    = pstMap->pstTmxMap->tiles[u32Gid]->tileset;
-                        stSrc.x  = pstMap->pstTmxMap->tiles[u32Gid]->ul_x;
-                        stSrc.y  = pstMap->pstTmxMap->tiles[u32Gid]->ul_y;
-                        stSrc.w  = stDst.w   = pstTS->tile_width;
-                        stSrc.h  = stDst.h   = pstTS->tile_height;
-                        stDst.x  = u32IndexW * pstTS->tile_width;
-                        stDst.y  = u32IndexH * pstTS->tile_height;
-                        SDL_RenderCopy(pstRenderer, pstTileset, &stSrc, &stDst);
-                    }
-                }
-            }
-        }
-        pstLayers = pstLayers->next;
-    }
+    SDL_Rect stRegion = { 0, 0, pstMap->pstTmxMap->width, pstMap->pstTmxMap->height };
+    TRACE_BEGIN("DrawMap bake");
+    _RenderTiles(pstRenderer, pstMap, pacLayerName, &stRegion);
+    TRACE_END("DrawMap bake");
+    pstMap->pacLayerName[u8Index] = pacLayerName;
 
     // Switch back to default render target.
-    if (0 != SDL_SetRenderTarget(pstRenderer, NULL))
+    if (0 != SetDrawTarget(pstRenderer, NULL))
     {
         fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
@@ -156,6 +209,61 @@ int8_t DrawMap(
     return 0;
 }
 
+/**
+ * @brief   Draw Map.
+ * @param   pstRenderer      a SDL rendering context.  See @ref struct Video.
+ * @param   pstMap           the Map.  See @ref struct Map.
+ * @param   pacLayerName     substring of the layer(s) to render.
+ * @param   u8RenderBgColour a boolean value to set whether the background
+ *                           colour should be rendered or not.
+ * @param   u8Index          the layer index.  The total amount of layers per map
+ *                           is defined by MAP_MAX_LAYERS.  Not to confused with
+                             the layers used by Tiled which can be grouped by name.
+ * @param   dCameraPosX      camera position along the x-axis.
+ * @param   dCameraPosY      camera position along the y-axis.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t DrawMap(
+    SDL_Renderer  *pstRenderer,
+    Map           *pstMap,
+    const char    *pacLayerName,
+    const uint8_t  u8RenderBgColour,
+    const uint8_t  u8Index,
+    const double   dCameraPosX,
+    const double   dCameraPosY)
+{
+    double   dRenderPosX = pstMap->dWorldPosX - dCameraPosX;
+    double   dRenderPosY = pstMap->dWorldPosY - dCameraPosY;
+    SDL_Rect stDst       =
+    {
+        dRenderPosX,
+        dRenderPosY,
+        pstMap->pstTmxMap->width  * pstMap->pstTmxMap->tile_width,
+        pstMap->pstTmxMap->height * pstMap->pstTmxMap->tile_height
+    };
+
+    // Render layer once, it's drawn right away.
+    if ((NULL == pstMap->pstLayer[u8Index]) &&
+        (-1 == _BakeLayer(pstRenderer, pstMap, pacLayerName, u8RenderBgColour, u8Index)))
+    {
+        return -1;
+    }
+
+    if (-1 == DrawTexture(
+            pstRenderer,
+            pstMap->pstLayer[u8Index],
+            NULL,
+            &stDst,
+            SDL_FLIP_NONE))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  * @brief   Free Map from memory.
  * @param   pstMap a Map.  See @ref struct Map.
@@ -163,9 +271,23 @@ int8_t DrawMap(
  */
 void FreeMap(Map *pstMap)
 {
+    if (NULL == pstMap)
+    {
+        return;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+    {
+        DestroyTexture(pstMap->pstLayer[u8Index]);
+    }
+
+    _ReleaseTileset(pstMap);
+    SDL_FreeSurface(pstMap->pstTilesetImage);
+
     tmx_map_free(pstMap->pstTmxMap);
-    free(pstMap->pacTilesetImageFilename);
-    free(pstMap);
+    FreeMemory(pstMap->pacFilename);
+    FreeMemory(pstMap->pacTilesetImageFilename);
+    FreeMemory(pstMap);
 }
 
 /**
@@ -180,26 +302,40 @@ Map *InitMap(
     const char *pacTilesetImageFilename)
 {
     static Map *pstMap;
-    pstMap = malloc(sizeof(struct Map_t));
+    pstMap = AllocMemory(MEMORY_MAP, sizeof(struct Map_t));
     if (NULL == pstMap)
     {
         fprintf(stderr, "InitMap(): error allocating memory.\n");
         return NULL;
     }
 
+    TRACE_BEGIN("tmx_load");
     pstMap->pstTmxMap = tmx_load(pacFilename);
+    TRACE_END("tmx_load");
     if (NULL == pstMap->pstTmxMap)
     {
-        free(pstMap);
+        FreeMemory(pstMap);
         fprintf(stderr, "%s\n", tmx_strerr());
         return NULL;
     }
 
+    pstMap->pacFilename = AllocMemory(MEMORY_MAP, strlen(pacFilename) + 1);
+    if (NULL == pstMap->pacFilename)
+    {
+        tmx_map_free(pstMap->pstTmxMap);
+        FreeMemory(pstMap);
+        fprintf(stderr, "InitMap(): error allocating memory.\n");
+        return NULL;
+    }
+    memcpy(pstMap->pacFilename, pacFilename, strlen(pacFilename) + 1);
+
     pstMap->pacTilesetImageFilename =
-        malloc(strlen(pacTilesetImageFilename) + 1);
+        AllocMemory(MEMORY_MAP, strlen(pacTilesetImageFilename) + 1);
     if (NULL == pstMap->pacTilesetImageFilename)
     {
-        free(pstMap);
+        tmx_map_free(pstMap->pstTmxMap);
+        FreeMemory(pstMap->pacFilename);
+        FreeMemory(pstMap);
         fprintf(stderr, "InitMap(): error allocating memory.\n");
         return NULL;
     }
@@ -213,14 +349,192 @@ Map *InitMap(
     pstMap->dWorldPosX = 0;
     pstMap->dWorldPosY = 0;
 
+    pstMap->pstTilesetImage = NULL;
+    pstMap->pstTileset      = NULL;
+    pstMap->stTileset.u32Id = 0;
+    pstMap->stTilesetRect.x = 0;
+    pstMap->stTilesetRect.y = 0;
+    pstMap->stTilesetRect.w = 0;
+    pstMap->stTilesetRect.h = 0;
+
     for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
     {
-        pstMap->pstLayer[u8Index] = NULL;
+        pstMap->pstLayer[u8Index]     = NULL;
+        pstMap->pacLayerName[u8Index] = NULL;
     }
 
     return pstMap;
 }
 
+/**
+ * @brief   Reload Map from disk and re-render only what has changed.
+ *          If only GIDs have changed, just the affected regions of the
+ *          affected layers are re-rendered.  A changed tileset leads to
+ *          re-rendering all layers and a changed map size to re-creating
+ *          them.  If the map can't be parsed, e.g. because it is
+ *          still being written, the Map is left untouched.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstMap      a Map.  See @ref struct Map.
+ * @param   u16Flags    what has changed.  See @ref enum MapReloadFlags.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t ReloadMap(
+    SDL_Renderer   *pstRenderer,
+    Map            *pstMap,
+    const uint16_t  u16Flags)
+{
+    SDL_Rect stRegion[MAP_MAX_LAYERS] = { { 0, 0, 0, 0 } };
+    uint8_t  u8FullRebake             = 0;
+    uint8_t  u8Recreate               = 0;
+
+    if (FLAG_IS_SET(u16Flags, MAP_RELOAD_TILESET) ||
+        FLAG_IS_SET(u16Flags, MAP_RELOAD_IMAGE))
+    {
+        u8FullRebake = 1;
+    }
+
+    if (FLAG_IS_SET(u16Flags, MAP_RELOAD_MAP) ||
+        FLAG_IS_SET(u16Flags, MAP_RELOAD_TILESET))
+    {
+        tmx_map   *pstTmxMap;
+        tmx_layer *pstOld;
+        tmx_layer *pstNew;
+
+        TRACE_BEGIN("tmx_load");
+        pstTmxMap = tmx_load(pstMap->pacFilename);
+        TRACE_END("tmx_load");
+
+        if (NULL == pstTmxMap)
+        {
+            fprintf(stderr, "%s\n", tmx_strerr());
+            return -1;
+        }
+
+        if ((pstTmxMap->width       != pstMap->pstTmxMap->width)       ||
+            (pstTmxMap->height      != pstMap->pstTmxMap->height)      ||
+            (pstTmxMap->tile_width  != pstMap->pstTmxMap->tile_width)  ||
+            (pstTmxMap->tile_height != pstMap->pstTmxMap->tile_height))
+        {
+            u8Recreate = 1;
+        }
+
+        pstOld = pstMap->pstTmxMap->ly_head;
+        pstNew = pstTmxMap->ly_head;
+        while ((0 == u8Recreate) && (0 == u8FullRebake) && (pstOld || pstNew))
+        {
+            SDL_Rect stLayerRegion = { 0, 0, 0, 0 };
+
+            if ((NULL == pstOld) || (NULL == pstNew) ||
+                (pstOld->type    != pstNew->type)    ||
+                (pstOld->visible != pstNew->visible) ||
+                (0 != strcmp(pstOld->name, pstNew->name)))
+            {
+                u8FullRebake = 1;
+                break;
+            }
+
+            if (L_LAYER == pstNew->type)
+            {
+                for (uint32_t u32IndexH = 0; u32IndexH < pstTmxMap->height; u32IndexH++)
+                {
+                    for (uint32_t u32IndexW = 0; u32IndexW < pstTmxMap->width; u32IndexW++)
+                    {
+                        uint32_t u32Offset = (u32IndexH * pstTmxMap->width) + u32IndexW;
+                        if (pstOld->content.gids[u32Offset] != pstNew->content.gids[u32Offset])
+                        {
+                            _ExtendRegion(&stLayerRegion, u32IndexW, u32IndexH);
+                        }
+                    }
+                }
+            }
+
+            if (stLayerRegion.w)
+            {
+                for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+                {
+                    if ((pstMap->pacLayerName[u8Index]) &&
+                        (NULL != strstr(pstNew->name, pstMap->pacLayerName[u8Index])))
+                    {
+                        _ExtendRegion(
+                            &stRegion[u8Index],
+                            stLayerRegion.x,
+                            stLayerRegion.y);
+                        _ExtendRegion(
+                            &stRegion[u8Index],
+                            stLayerRegion.x + stLayerRegion.w - 1,
+                            stLayerRegion.y + stLayerRegion.h - 1);
+                    }
+                }
+            }
+
+            pstOld = pstOld->next;
+            pstNew = pstNew->next;
+        }
+
+        tmx_map_free(pstMap->pstTmxMap);
+        pstMap->pstTmxMap = pstTmxMap;
+        pstMap->u32Height = pstTmxMap->height * pstTmxMap->tile_height;
+        pstMap->u32Width  = pstTmxMap->width  * pstTmxMap->tile_width;
+    }
+
+    if (FLAG_IS_SET(u16Flags, MAP_RELOAD_IMAGE))
+    {
+        // The atlas is out of date now, so the file is used directly.
+        SDL_Texture *pstTileset;
+
+        TRACE_BEGIN("LoadTexture");
+        pstTileset = LoadTexture(pstRenderer, pstMap->pacTilesetImageFilename);
+        TRACE_END("LoadTexture");
+
+        if (NULL == pstTileset)
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return -1;
+        }
+
+        _ReleaseTileset(pstMap);
+        pstMap->pstTileset = pstTileset;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+    {
+        if (NULL == pstMap->pstLayer[u8Index])
+        {
+            continue;
+        }
+
+        if (u8Recreate)
+        {
+            // The size has changed: re-create layer on next DrawMap().
+            DestroyTexture(pstMap->pstLayer[u8Index]);
+            pstMap->pstLayer[u8Index] = NULL;
+            continue;
+        }
+
+        if (u8FullRebake)
+        {
+            stRegion[u8Index].x = 0;
+            stRegion[u8Index].y = 0;
+            stRegion[u8Index].w = pstMap->pstTmxMap->width;
+            stRegion[u8Index].h = pstMap->pstTmxMap->height;
+        }
+
+        if (stRegion[u8Index].w)
+        {
+            if (-1 == _RebakeLayer(pstRenderer, pstMap, u8Index, &stRegion[u8Index]))
+            {
+                return -1;
+            }
+        }
+    }
+
+    // The software renderer would keep showing the old tiles.
+    MarkDirtyRect(NULL);
+
+    return 0;
+}
+
 /**
  * @brief   Check whether a map tile is of a specific type.
  * @param   pstMap  a Map.  See @ref struct Map.
@@ -271,3 +585,86 @@ uint8_t IsMapCoordOfType(
 
     return 0;
 }
+
+/**
+ * @brief   Decode the tileset image without uploading it.  Unlike the
+ *          other Map functions this one doesn't require the rendering
+ *          context and can therefore be called from a loader thread.
+ *          Nothing to do if the tileset has been packed into the atlas.
+ * @param   pstMap a Map.  See @ref struct Map.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t LoadMapTilesetImage(Map *pstMap)
+{
+    const char *pacPage;
+    SDL_Rect    stRect;
+
+    if ((pstMap->pstTilesetImage) ||
+        (FindAtlasImage(pstMap->pacTilesetImageFilename, &pacPage, &stRect)))
+    {
+        return 0;
+    }
+
+    TRACE_BEGIN("IMG_Load");
+    pstMap->pstTilesetImage = IMG_Load(pstMap->pacTilesetImageFilename);
+    TRACE_END("IMG_Load");
+    if (NULL == pstMap->pstTilesetImage)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Upload the tileset image to the GPU.  Uses the image decoded
+ *          by LoadMapTilesetImage() if available, or the atlas page the
+ *          tileset has been packed into.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstMap      a Map.  See @ref struct Map.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t UploadMapTileset(SDL_Renderer *pstRenderer, Map *pstMap)
+{
+    const char *pacPage;
+
+    if (pstMap->pstTileset)
+    {
+        return 0;
+    }
+
+    if (pstMap->pstTilesetImage)
+    {
+        TRACE_BEGIN("CreateTextureFromSurface");
+        pstMap->pstTileset = CreateTextureFromSurface(pstRenderer, pstMap->pstTilesetImage);
+        TRACE_END("CreateTextureFromSurface");
+
+        SDL_FreeSurface(pstMap->pstTilesetImage);
+        pstMap->pstTilesetImage = NULL;
+    }
+    else if (FindAtlasImage(pstMap->pacTilesetImageFilename, &pacPage, &pstMap->stTilesetRect))
+    {
+        pstMap->stTileset  = AcquireImage(
+            pstRenderer,
+            pstMap->pacTilesetImageFilename,
+            &pstMap->stTilesetRect);
+        pstMap->pstTileset = GetTexture(pstMap->stTileset);
+    }
+    else
+    {
+        TRACE_BEGIN("LoadTexture");
+        pstMap->pstTileset = LoadTexture(pstRenderer, pstMap->pacTilesetImageFilename);
+        TRACE_END("LoadTexture");
+    }
+
+    if (NULL == pstMap->pstTileset)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include "tmx/tmx.h"
+#include "Resource.h"
 
 /**
  * @ingroup Map
@@ -20,15 +21,34 @@ enum MapLimits
 /**
  * @ingroup Map
  */
+enum MapReloadFlags
+{
+    MAP_RELOAD_MAP     = 0,
+    MAP_RELOAD_TILESET = 1,
+    MAP_RELOAD_IMAGE   = 2
+};
+
+/**
+ * @ingroup Map
+ * @brief   A map.  If the tileset image has been packed into the
+ *          atlas, pstTileset is the atlas page held by stTileset and
+ *          stTilesetRect where the tileset is on it.
+ */
 typedef struct Map_t
 {
-    tmx_map     *pstTmxMap;
-    char        *pacTilesetImageFilename;
-    SDL_Texture *pstLayer[MAP_MAX_LAYERS];
-    uint32_t     u32Height;
-    uint32_t     u32Width;
-    double       dWorldPosX;
-    double       dWorldPosY;
+    tmx_map       *pstTmxMap;
+    char          *pacFilename;
+    char          *pacTilesetImageFilename;
+    SDL_Surface   *pstTilesetImage;
+    SDL_Texture   *pstTileset;
+    TextureHandle  stTileset;
+    SDL_Rect       stTilesetRect;
+    SDL_Texture   *pstLayer[MAP_MAX_LAYERS];
+    const char    *pacLayerName[MAP_MAX_LAYERS];
+    uint32_t       u32Height;
+    uint32_t       u32Width;
+    double         dWorldPosX;
+    double         dWorldPosY;
 } Map;
 
 int8_t DrawMap(
@@ -52,4 +72,13 @@ uint8_t IsMapCoordOfType(
     double      dPosX,
     double      dPosY);
 
+int8_t LoadMapTilesetImage(Map *pstMap);
+
+int8_t ReloadMap(
+    SDL_Renderer   *pstRenderer,
+    Map            *pstMap,
+    const uint16_t  u16Flags);
+
+int8_t UploadMapTileset(SDL_Renderer *pstRenderer, Map *pstMap);
+
 #endif // _MAP_H_
@@ -0,0 +1,485 @@
+/**
+ * @file      Memory.c
+ * @ingroup   Memory
+ * @defgroup  Memory
+ * @brief     Optional allocation tracker.  Engine code allocates
+ *            through AllocMemory(), CallocMemory() and ReallocMemory()
+ *            with a tag naming the subsystem; libtmx, libxml2 and SDL
+ *            are hooked so that their allocations are tagged as well.
+ *            Every block is prefixed with a header holding its size and
+ *            tag, which is why tracking has to be set up before the
+ *            first allocation and can't be switched on or off
+ *            afterwards.  Without tracking, all functions map to the C
+ *            library.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <libxml/xmlmemory.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Memory.h"
+#include "tmx/tmx.h"
+
+/* 16 bytes keep the alignment malloc() guarantees on all supported
+ * platforms. */
+typedef union MemoryHeader_t
+{
+    struct
+    {
+        size_t  sSize;
+        uint8_t u8Tag;
+    } stBlock;
+    uint8_t au8Align[16];
+} MemoryHeader;
+
+static const char *_pacTagNames[MEMORY_TAGS] = {
+    "engine",
+    "map",
+    "entity",
+    "background",
+    "audio",
+    "tmx",
+    "xml",
+    "sdl"
+};
+
+static uint8_t      _u8Tracked;
+static SDL_TLSID    _stExemptTls;
+static uint8_t      _u8FrameStarted;
+static SDL_SpinLock _stLock;
+static MemoryStats  _stStats;
+static uint32_t     _u32CurAllocs[MEMORY_TAGS];
+static uint32_t     _u32CurCheckedAllocs[MEMORY_TAGS];
+static uint64_t     _u64CurBytes[MEMORY_TAGS];
+
+static void _Count(const uint8_t u8Tag, const size_t sOldSize, const size_t sNewSize)
+{
+    uint8_t u8IsChecked = NULL == SDL_TLSGet(_stExemptTls);
+
+    SDL_AtomicLock(&_stLock);
+    _stStats.u64LiveBytes[u8Tag] += sNewSize;
+    _stStats.u64LiveBytes[u8Tag] -= sOldSize;
+    if (_stStats.u64LiveBytes[u8Tag] > _stStats.u64PeakBytes[u8Tag])
+    {
+        _stStats.u64PeakBytes[u8Tag] = _stStats.u64LiveBytes[u8Tag];
+    }
+
+    if (sNewSize)
+    {
+        _stStats.u64Allocs[u8Tag]++;
+        _u32CurAllocs[u8Tag]++;
+        _u32CurCheckedAllocs[u8Tag] += u8IsChecked;
+        _u64CurBytes[u8Tag] += sNewSize;
+    }
+    else
+    {
+        _stStats.u64Frees[u8Tag]++;
+    }
+    SDL_AtomicUnlock(&_stLock);
+}
+
+static void *_Alloc(const uint8_t u8Tag, const size_t sSize, const uint8_t u8Zero)
+{
+    MemoryHeader *pstHeader;
+
+    if (sSize > SIZE_MAX - sizeof(MemoryHeader))
+    {
+        return NULL;
+    }
+
+    if (u8Zero)
+    {
+        pstHeader = calloc(1, sizeof(MemoryHeader) + sSize);
+    }
+    else
+    {
+        pstHeader = malloc(sizeof(MemoryHeader) + sSize);
+    }
+
+    if (NULL == pstHeader)
+    {
+        return NULL;
+    }
+
+    pstHeader->stBlock.sSize = sSize;
+    pstHeader->stBlock.u8Tag = u8Tag;
+    _Count(u8Tag, 0, sSize);
+
+    return pstHeader + 1;
+}
+
+static void *_Realloc(const uint8_t u8Tag, void *pMemory, const size_t sSize)
+{
+    MemoryHeader *pstHeader;
+    MemoryHeader *pstResized;
+    size_t        sOldSize;
+
+    if (NULL == pMemory)
+    {
+        return _Alloc(u8Tag, sSize, 0);
+    }
+
+    if (sSize > SIZE_MAX - sizeof(MemoryHeader))
+    {
+        return NULL;
+    }
+
+    // The block stays with the subsystem which allocated it.
+    pstHeader  = (MemoryHeader *)pMemory - 1;
+    sOldSize   = pstHeader->stBlock.sSize;
+    pstResized = realloc(pstHeader, sizeof(MemoryHeader) + sSize);
+    if (NULL == pstResized)
+    {
+        return NULL;
+    }
+
+    pstResized->stBlock.sSize = sSize;
+    _Count(pstResized->stBlock.u8Tag, sOldSize, sSize);
+
+    return pstResized + 1;
+}
+
+static void *_TmxRealloc(void *pMemory, size_t sSize)
+{
+    return _Realloc(MEMORY_TMX, pMemory, sSize);
+}
+
+static void *_XmlMalloc(size_t sSize)
+{
+    return _Alloc(MEMORY_XML, sSize, 0);
+}
+
+static void *_XmlRealloc(void *pMemory, size_t sSize)
+{
+    return _Realloc(MEMORY_XML, pMemory, sSize);
+}
+
+static char *_XmlStrdup(const char *pacString)
+{
+    size_t  sLength = strlen(pacString) + 1;
+    char   *pacCopy = _Alloc(MEMORY_XML, sLength, 0);
+
+    if (pacCopy)
+    {
+        memcpy(pacCopy, pacString, sLength);
+    }
+
+    return pacCopy;
+}
+
+static void *SDLCALL _SdlMalloc(size_t sSize)
+{
+    return _Alloc(MEMORY_SDL, sSize, 0);
+}
+
+static void *SDLCALL _SdlCalloc(size_t sCount, size_t sSize)
+{
+    if ((sSize) && (sCount > SIZE_MAX / sSize))
+    {
+        return NULL;
+    }
+
+    return _Alloc(MEMORY_SDL, sCount * sSize, 1);
+}
+
+static void *SDLCALL _SdlRealloc(void *pMemory, size_t sSize)
+{
+    return _Realloc(MEMORY_SDL, pMemory, sSize);
+}
+
+static void SDLCALL _SdlFree(void *pMemory)
+{
+    FreeMemory(pMemory);
+}
+
+/**
+ * @brief   Allocate memory.
+ * @param   u8Tag the subsystem.  See @ref enum MemoryTag.
+ * @param   sSize the size in bytes.
+ * @return  the memory on success, NULL on failure.
+ * @ingroup Memory
+ */
+void *AllocMemory(const uint8_t u8Tag, const size_t sSize)
+{
+    if (0 == _u8Tracked)
+    {
+        return malloc(sSize);
+    }
+
+    return _Alloc(u8Tag, sSize, 0);
+}
+
+/**
+ * @brief   Complete the current frame and start the next one.  The
+ *          allocations between the first call and the second one are
+ *          counted as the first frame, and so on.
+ * @return  the number of allocations all threads but the exempt ones
+ *          made during the completed frame; always 0 on the first call
+ *          or if tracking is disabled.  See ExemptMemoryThread().
+ * @ingroup Memory
+ */
+uint32_t BeginMemoryFrame()
+{
+    uint32_t u32CheckedAllocs = 0;
+    uint8_t  u8Allocated      = 0;
+
+    if (0 == _u8Tracked)
+    {
+        return 0;
+    }
+
+    SDL_AtomicLock(&_stLock);
+    if (_u8FrameStarted)
+    {
+        for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAGS; u8Tag++)
+        {
+            _stStats.u32FrameAllocs[u8Tag]        = _u32CurAllocs[u8Tag];
+            _stStats.u32FrameCheckedAllocs[u8Tag] = _u32CurCheckedAllocs[u8Tag];
+            _stStats.u64FrameBytes[u8Tag]         = _u64CurBytes[u8Tag];
+            _stStats.u64TotalFrameAllocs[u8Tag]  += _u32CurAllocs[u8Tag];
+            if (_u32CurAllocs[u8Tag] > _stStats.u32MaxFrameAllocs[u8Tag])
+            {
+                _stStats.u32MaxFrameAllocs[u8Tag] = _u32CurAllocs[u8Tag];
+            }
+            u8Allocated      |= 0 != _u32CurAllocs[u8Tag];
+            u32CheckedAllocs += _u32CurCheckedAllocs[u8Tag];
+        }
+
+        _stStats.u64Frames++;
+        _stStats.u64FramesWithAllocs += u8Allocated;
+    }
+
+    // Startup allocations don't count as a frame.
+    _u8FrameStarted = 1;
+    memset(_u32CurAllocs,        0, sizeof(_u32CurAllocs));
+    memset(_u32CurCheckedAllocs, 0, sizeof(_u32CurCheckedAllocs));
+    memset(_u64CurBytes,         0, sizeof(_u64CurBytes));
+    SDL_AtomicUnlock(&_stLock);
+
+    return u32CheckedAllocs;
+}
+
+/**
+ * @brief   Allocate zero-initialised memory for an array.
+ * @param   u8Tag  the subsystem.  See @ref enum MemoryTag.
+ * @param   sCount the number of elements.
+ * @param   sSize  the size of an element in bytes.
+ * @return  the memory on success, NULL on failure.
+ * @ingroup Memory
+ */
+void *CallocMemory(const uint8_t u8Tag, const size_t sCount, const size_t sSize)
+{
+    if (0 == _u8Tracked)
+    {
+        return calloc(sCount, sSize);
+    }
+
+    if ((sSize) && (sCount > SIZE_MAX / sSize))
+    {
+        return NULL;
+    }
+
+    return _Alloc(u8Tag, sCount * sSize, 1);
+}
+
+/**
+ * @brief   Exempt the calling thread's allocations from the ones
+ *          BeginMemoryFrame() returns, e.g. those of a thread which
+ *          loads assets in the background.  They are still tracked.
+ * @ingroup Memory
+ */
+void ExemptMemoryThread()
+{
+    if (0 == _u8Tracked)
+    {
+        return;
+    }
+
+    // Any non-NULL value will do.
+    SDL_TLSSet(_stExemptTls, &_stExemptTls, NULL);
+}
+
+/**
+ * @brief   Free memory allocated by AllocMemory(), CallocMemory(),
+ *          ReallocMemory() or one of the hooked libraries.
+ * @param   pMemory the memory; NULL is ignored.
+ * @ingroup Memory
+ */
+void FreeMemory(void *pMemory)
+{
+    MemoryHeader *pstHeader;
+
+    if (0 == _u8Tracked)
+    {
+        free(pMemory);
+        return;
+    }
+
+    if (NULL == pMemory)
+    {
+        return;
+    }
+
+    pstHeader = (MemoryHeader *)pMemory - 1;
+    _Count(pstHeader->stBlock.u8Tag, pstHeader->stBlock.sSize, 0);
+    free(pstHeader);
+}
+
+/**
+ * @brief   Get the number of live bytes over all tags.
+ * @return  the number of bytes, 0 if tracking is disabled.
+ * @ingroup Memory
+ */
+uint64_t GetLiveMemory()
+{
+    uint64_t u64Bytes = 0;
+
+    SDL_AtomicLock(&_stLock);
+    for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAGS; u8Tag++)
+    {
+        u64Bytes += _stStats.u64LiveBytes[u8Tag];
+    }
+    SDL_AtomicUnlock(&_stLock);
+
+    return u64Bytes;
+}
+
+/**
+ * @brief   Get the allocation statistics.
+ * @return  a copy of the statistics.  See @ref struct MemoryStats.
+ * @ingroup Memory
+ */
+MemoryStats GetMemoryStats()
+{
+    MemoryStats stStats;
+
+    SDL_AtomicLock(&_stLock);
+    stStats = _stStats;
+    SDL_AtomicUnlock(&_stLock);
+
+    return stStats;
+}
+
+/**
+ * @brief   Get the name of a tag.
+ * @param   u8Tag the tag.  See @ref enum MemoryTag.
+ * @return  the name.
+ * @ingroup Memory
+ */
+const char *GetMemoryTagName(const uint8_t u8Tag)
+{
+    if (u8Tag >= MEMORY_TAGS)
+    {
+        return "";
+    }
+
+    return _pacTagNames[u8Tag];
+}
+
+/**
+ * @brief   Initialise the allocation tracker.  Has to be called before
+ *          anything is allocated through SDL, libtmx, libxml2 or this
+ *          module, i.e. first thing in main().
+ * @param   u8Track 1 to track allocations, 0 to pass them through.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Memory
+ */
+int8_t InitMemory(const uint8_t u8Track)
+{
+    if (0 == u8Track)
+    {
+        return 0;
+    }
+
+    _stExemptTls = SDL_TLSCreate();
+    if (0 == _stExemptTls)
+    {
+        fprintf(stderr, "InitMemory(): %s\n", SDL_GetError());
+        return -1;
+    }
+
+    if (0 != SDL_SetMemoryFunctions(_SdlMalloc, _SdlCalloc, _SdlRealloc, _SdlFree))
+    {
+        fprintf(stderr, "InitMemory(): %s\n", SDL_GetError());
+        return -1;
+    }
+
+    if (0 != xmlMemSetup(FreeMemory, _XmlMalloc, _XmlRealloc, _XmlStrdup))
+    {
+        fprintf(stderr, "InitMemory(): couldn't set up libxml2's memory functions.\n");
+        return -1;
+    }
+
+    tmx_alloc_func      = _TmxRealloc;
+    tmx_free_func       = FreeMemory;
+    tmx_keep_libxml_mem = 1;
+    _u8Tracked          = 1;
+
+    return 0;
+}
+
+/**
+ * @brief   Check whether allocations are tracked.
+ * @return  1 if they are, 0 if not.
+ * @ingroup Memory
+ */
+uint8_t IsMemoryTracked()
+{
+    return _u8Tracked;
+}
+
+/**
+ * @brief   Print the allocation statistics per tag to stdout.
+ * @ingroup Memory
+ */
+void PrintMemoryStats()
+{
+    MemoryStats stStats = GetMemoryStats();
+    double      dFrames = stStats.u64Frames ? (double)stStats.u64Frames : 1.0;
+
+    if (0 == _u8Tracked)
+    {
+        return;
+    }
+
+    printf("\n%-10s %10s %10s %10s %10s %12s %10s\n",
+        "memory", "live KiB", "peak KiB", "allocs", "frees", "allocs/frame", "max/frame");
+    for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAGS; u8Tag++)
+    {
+        printf("%-10s %10.1f %10.1f %10llu %10llu %12.2f %10u\n",
+            GetMemoryTagName(u8Tag),
+            stStats.u64LiveBytes[u8Tag] / 1024.0,
+            stStats.u64PeakBytes[u8Tag] / 1024.0,
+            (unsigned long long)stStats.u64Allocs[u8Tag],
+            (unsigned long long)stStats.u64Frees[u8Tag],
+            stStats.u64TotalFrameAllocs[u8Tag] / dFrames,
+            stStats.u32MaxFrameAllocs[u8Tag]);
+    }
+    printf("frames with allocations: %llu of %llu\n",
+        (unsigned long long)stStats.u64FramesWithAllocs,
+        (unsigned long long)stStats.u64Frames);
+}
+
+/**
+ * @brief   Resize memory like realloc().  The block keeps the tag it
+ *          was allocated with; u8Tag is only used if pMemory is NULL.
+ * @param   u8Tag   the subsystem.  See @ref enum MemoryTag.
+ * @param   pMemory the memory, may be NULL.
+ * @param   sSize   the new size in bytes.
+ * @return  the memory on success, NULL on failure, in which case
+ *          pMemory is left untouched.
+ * @ingroup Memory
+ */
+void *ReallocMemory(const uint8_t u8Tag, void *pMemory, const size_t sSize)
+{
+    if (0 == _u8Tracked)
+    {
+        return realloc(pMemory, sSize);
+    }
+
+    return _Realloc(u8Tag, pMemory, sSize);
+}
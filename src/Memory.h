@@ -0,0 +1,65 @@
+/**
+ * @file    Memory.h
+ * @ingroup Memory
+ */
+
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Memory
+ */
+enum MemoryTag
+{
+    MEMORY_ENGINE     = 0,
+    MEMORY_MAP        = 1,
+    MEMORY_ENTITY     = 2,
+    MEMORY_BACKGROUND = 3,
+    MEMORY_AUDIO      = 4,
+    MEMORY_TMX        = 5,
+    MEMORY_XML        = 6,
+    MEMORY_SDL        = 7,
+    MEMORY_TAGS       = 8
+};
+
+/**
+ * @ingroup Memory
+ * @brief   Allocation statistics per tag.  u64Allocs counts malloc,
+ *          calloc and realloc calls.  The frame counters describe the
+ *          last completed frame, the Max and Total counters all frames
+ *          since the first call of BeginMemoryFrame().  CheckedAllocs
+ *          counts the allocations of all threads but the ones which
+ *          called ExemptMemoryThread(), i.e. the level loader.
+ */
+typedef struct MemoryStats_t
+{
+    uint64_t u64LiveBytes[MEMORY_TAGS];
+    uint64_t u64PeakBytes[MEMORY_TAGS];
+    uint64_t u64Allocs[MEMORY_TAGS];
+    uint64_t u64Frees[MEMORY_TAGS];
+    uint32_t u32FrameAllocs[MEMORY_TAGS];
+    uint32_t u32FrameCheckedAllocs[MEMORY_TAGS];
+    uint64_t u64FrameBytes[MEMORY_TAGS];
+    uint32_t u32MaxFrameAllocs[MEMORY_TAGS];
+    uint64_t u64TotalFrameAllocs[MEMORY_TAGS];
+    uint64_t u64Frames;
+    uint64_t u64FramesWithAllocs;
+} MemoryStats;
+
+void       *AllocMemory(const uint8_t u8Tag, const size_t sSize);
+uint32_t    BeginMemoryFrame();
+void       *CallocMemory(const uint8_t u8Tag, const size_t sCount, const size_t sSize);
+void        ExemptMemoryThread();
+void        FreeMemory(void *pMemory);
+uint64_t    GetLiveMemory();
+MemoryStats GetMemoryStats();
+const char *GetMemoryTagName(const uint8_t u8Tag);
+int8_t      InitMemory(const uint8_t u8Track);
+uint8_t     IsMemoryTracked();
+void        PrintMemoryStats();
+void       *ReallocMemory(const uint8_t u8Tag, void *pMemory, const size_t sSize);
+
+#endif // _MEMORY_H_
@@ -0,0 +1,267 @@
+/**
+ * @file      Metrics.c
+ * @ingroup   Metrics
+ * @defgroup  Metrics
+ * @brief     Live metrics in POSIX shared memory.  The game publishes
+ *            a fixed-layout block every frame which other processes,
+ *            e.g. boondock-sam-metrics, can map and read at any time.
+ *            Updates are guarded by a sequence lock: the game never
+ *            waits for a reader, readers retry if they raced with an
+ *            update.  Linux and macOS only.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define _POSIX_C_SOURCE 200112L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define METRICS_SUPPORTED
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Metrics.h"
+
+#define METRICS_READ_RETRIES 1000
+
+/* Upper bounds of the frame time histogram in microseconds, around the
+ * budgets of 144, 120, 60 and 30 FPS. */
+static const uint32_t _u32BucketUs[METRICS_BUCKETS] = {
+    1000, 2000, 4000, 6944, 8333, 12000, 16667, 20000, 25000, 33333, 50000, UINT32_MAX
+};
+
+static double _dAvgFrameTimeNs;
+
+/**
+ * @brief   Unmap a block opened by OpenMetrics().
+ * @param   pstMetrics the block.  See @ref struct MetricsBlock.
+ * @ingroup Metrics
+ */
+void CloseMetrics(MetricsBlock *pstMetrics)
+{
+    #ifdef METRICS_SUPPORTED
+    if (pstMetrics)
+    {
+        munmap(pstMetrics, sizeof(struct MetricsBlock_t));
+    }
+    #else
+    (void)pstMetrics;
+    #endif
+}
+
+/**
+ * @brief   Unmap and remove the block created by InitMetrics().
+ * @param   pstMetrics the block.  See @ref struct MetricsBlock.
+ * @ingroup Metrics
+ */
+void FreeMetrics(MetricsBlock *pstMetrics)
+{
+    #ifdef METRICS_SUPPORTED
+    if (NULL == pstMetrics)
+    {
+        return;
+    }
+
+    munmap(pstMetrics, sizeof(struct MetricsBlock_t));
+    shm_unlink(METRICS_SHM_NAME);
+    #else
+    (void)pstMetrics;
+    #endif
+}
+
+/**
+ * @brief   Create the shared memory block the game publishes to.  An
+ *          existing block, e.g. one left behind by a crash, is reused.
+ * @return  the block on success, NULL on failure.  See
+ *          @ref struct MetricsBlock.
+ * @ingroup Metrics
+ */
+MetricsBlock *InitMetrics()
+{
+    #ifdef METRICS_SUPPORTED
+    MetricsBlock *pstMetrics;
+    int32_t       s32Fd;
+
+    s32Fd = shm_open(METRICS_SHM_NAME, O_CREAT | O_RDWR, 0644);
+    if (-1 == s32Fd)
+    {
+        perror("InitMetrics(): shm_open");
+        return NULL;
+    }
+
+    if (-1 == ftruncate(s32Fd, sizeof(struct MetricsBlock_t)))
+    {
+        perror("InitMetrics(): ftruncate");
+        close(s32Fd);
+        return NULL;
+    }
+
+    pstMetrics = mmap(
+        NULL,
+        sizeof(struct MetricsBlock_t),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        s32Fd,
+        0);
+    close(s32Fd);
+
+    if (MAP_FAILED == pstMetrics)
+    {
+        perror("InitMetrics(): mmap");
+        return NULL;
+    }
+
+    // Readers see an odd sequence until the header is complete.
+    pstMetrics->u32Sequence = 1;
+    __sync_synchronize();
+
+    memset(&pstMetrics->u32Entities, 0,
+        sizeof(struct MetricsBlock_t) - offsetof(struct MetricsBlock_t, u32Entities));
+    memcpy(pstMetrics->u32BucketUs, _u32BucketUs, sizeof(_u32BucketUs));
+    pstMetrics->u32Magic   = METRICS_MAGIC;
+    pstMetrics->u32Version = METRICS_VERSION;
+    pstMetrics->u32Size    = sizeof(struct MetricsBlock_t);
+    pstMetrics->u32Pid     = getpid();
+    _dAvgFrameTimeNs       = 0;
+
+    __sync_synchronize();
+    pstMetrics->u32Sequence = 2;
+
+    return pstMetrics;
+    #else
+    fprintf(stderr, "Metrics are only supported on Linux and macOS.\n");
+    return NULL;
+    #endif
+}
+
+/**
+ * @brief   Map the block published by a running game, read-only.
+ * @return  the block on success, NULL if there is none or it has an
+ *          incompatible layout.  See @ref struct MetricsBlock.
+ * @ingroup Metrics
+ */
+MetricsBlock *OpenMetrics()
+{
+    #ifdef METRICS_SUPPORTED
+    MetricsBlock *pstMetrics;
+    struct stat   stStat;
+    int32_t       s32Fd;
+
+    s32Fd = shm_open(METRICS_SHM_NAME, O_RDONLY, 0);
+    if (-1 == s32Fd)
+    {
+        perror("OpenMetrics(): shm_open");
+        return NULL;
+    }
+
+    if ((-1 == fstat(s32Fd, &stStat)) || (stStat.st_size < (off_t)sizeof(struct MetricsBlock_t)))
+    {
+        fprintf(stderr, "OpenMetrics(): the block is too small.\n");
+        close(s32Fd);
+        return NULL;
+    }
+
+    pstMetrics = mmap(NULL, sizeof(struct MetricsBlock_t), PROT_READ, MAP_SHARED, s32Fd, 0);
+    close(s32Fd);
+
+    if (MAP_FAILED == pstMetrics)
+    {
+        perror("OpenMetrics(): mmap");
+        return NULL;
+    }
+
+    if ((METRICS_MAGIC != pstMetrics->u32Magic) ||
+        (METRICS_VERSION != pstMetrics->u32Version) ||
+        (sizeof(struct MetricsBlock_t) != pstMetrics->u32Size))
+    {
+        fprintf(stderr, "OpenMetrics(): unknown layout (version %u).\n", pstMetrics->u32Version);
+        CloseMetrics(pstMetrics);
+        return NULL;
+    }
+
+    return pstMetrics;
+    #else
+    fprintf(stderr, "Metrics are only supported on Linux and macOS.\n");
+    return NULL;
+    #endif
+}
+
+/**
+ * @brief   Publish the measurements of a frame.  Never blocks.
+ * @param   pstMetrics the block.  See @ref struct MetricsBlock.
+ * @param   pstSample  the measurements.  See @ref struct MetricsSample.
+ * @ingroup Metrics
+ */
+void PublishMetrics(
+    MetricsBlock        *pstMetrics,
+    const MetricsSample *pstSample)
+{
+    uint32_t u32FrameTimeUs = pstSample->u64FrameTimeNs / 1000;
+    uint8_t  u8Bucket       = 0;
+
+    while ((u8Bucket < METRICS_BUCKETS - 1) && (u32FrameTimeUs > _u32BucketUs[u8Bucket]))
+    {
+        u8Bucket++;
+    }
+
+    // Smooth the FPS over roughly the last second at 60 FPS.
+    if (0 == _dAvgFrameTimeNs)
+    {
+        _dAvgFrameTimeNs = pstSample->u64FrameTimeNs;
+    }
+    _dAvgFrameTimeNs += (pstSample->u64FrameTimeNs - _dAvgFrameTimeNs) / 64.0;
+
+    pstMetrics->u32Sequence++;
+    __sync_synchronize();
+
+    pstMetrics->u64Frames++;
+    pstMetrics->u64FrameTimeNs     = pstSample->u64FrameTimeNs;
+    pstMetrics->u64FpsMilli        = _dAvgFrameTimeNs > 0 ? 1e12 / _dAvgFrameTimeNs : 0;
+    pstMetrics->u32Entities        = pstSample->u32Entities;
+    pstMetrics->u32Textures        = pstSample->u32Textures;
+    pstMetrics->u64TextureBytes    = pstSample->u64TextureBytes;
+    pstMetrics->u32AudioUnderruns  = pstSample->u32AudioUnderruns;
+    pstMetrics->u64HistogramSumNs += pstSample->u64FrameTimeNs;
+    pstMetrics->u64Histogram[u8Bucket]++;
+
+    __sync_synchronize();
+    pstMetrics->u32Sequence++;
+}
+
+/**
+ * @brief   Take a consistent copy of a block.
+ * @param   pstMetrics the shared block.  See @ref struct MetricsBlock.
+ * @param   pstCopy    the copy.
+ * @return  0 on success, -1 if the game kept writing while reading.
+ * @ingroup Metrics
+ */
+int8_t ReadMetrics(
+    const MetricsBlock *pstMetrics,
+    MetricsBlock       *pstCopy)
+{
+    for (uint32_t u32Try = 0; u32Try < METRICS_READ_RETRIES; u32Try++)
+    {
+        uint32_t u32Before = pstMetrics->u32Sequence;
+
+        __sync_synchronize();
+        if (u32Before & 1)
+        {
+            continue;
+        }
+
+        memcpy(pstCopy, (const void *)pstMetrics, sizeof(struct MetricsBlock_t));
+        __sync_synchronize();
+
+        if (u32Before == pstMetrics->u32Sequence)
+        {
+            return 0;
+        }
+    }
+
+    return -1;
+}
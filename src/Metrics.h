@@ -0,0 +1,78 @@
+/**
+ * @file    Metrics.h
+ * @ingroup Metrics
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdint.h>
+
+#define METRICS_SHM_NAME "/boondock-sam-metrics"
+
+/**
+ * @ingroup Metrics
+ */
+enum MetricsLimits
+{
+    METRICS_MAGIC   = 0x4d415342, // "BSAM" in memory on little endian.
+    METRICS_VERSION = 1,
+    METRICS_BUCKETS = 12
+};
+
+/**
+ * @ingroup Metrics
+ * @brief   What the game measured during one frame.
+ */
+typedef struct MetricsSample_t
+{
+    uint64_t u64FrameTimeNs;
+    uint64_t u64TextureBytes;
+    uint32_t u32Entities;
+    uint32_t u32Textures;
+    uint32_t u32AudioUnderruns;
+} MetricsSample;
+
+/**
+ * @ingroup Metrics
+ * @brief   The shared memory block.  The layout only uses fixed-size
+ *          types and is versioned, so other programs can read it.
+ *          u32Sequence is odd while the game is writing; a reader
+ *          copies the block and retries if the sequence was odd or
+ *          changed in the meantime.  The histogram counts frames per
+ *          frame time bucket (not cumulative); u32BucketUs holds the
+ *          upper bounds in microseconds, the last bucket is unbounded.
+ */
+typedef struct MetricsBlock_t
+{
+    uint32_t          u32Magic;
+    uint32_t          u32Version;
+    uint32_t          u32Size;
+    uint32_t          u32Pid;
+    volatile uint32_t u32Sequence;
+    uint32_t          u32Entities;
+    uint32_t          u32Textures;
+    uint32_t          u32AudioUnderruns;
+    uint64_t          u64Frames;
+    uint64_t          u64FrameTimeNs;
+    uint64_t          u64FpsMilli;
+    uint64_t          u64TextureBytes;
+    uint64_t          u64HistogramSumNs;
+    uint64_t          u64Histogram[METRICS_BUCKETS];
+    uint32_t          u32BucketUs[METRICS_BUCKETS];
+} MetricsBlock;
+
+void          CloseMetrics(MetricsBlock *pstMetrics);
+void          FreeMetrics(MetricsBlock *pstMetrics);
+MetricsBlock *InitMetrics();
+MetricsBlock *OpenMetrics();
+
+void PublishMetrics(
+    MetricsBlock        *pstMetrics,
+    const MetricsSample *pstSample);
+
+int8_t ReadMetrics(
+    const MetricsBlock *pstMetrics,
+    MetricsBlock       *pstCopy);
+
+#endif // _METRICS_H_
@@ -0,0 +1,327 @@
+/**
+ * @file      MusicCache.c
+ * @ingroup   MusicCache
+ * @defgroup  MusicCache
+ * @brief     Decodes music once to raw PCM in the format of the audio
+ *            device and keeps it in a cache file in the user's
+ *            preference directory.  Later runs map the file instead of
+ *            decoding the Ogg Vorbis stream while playing.  The cache
+ *            is rebuilt when the source file or the device format
+ *            changes.  Linux and macOS only.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define _POSIX_C_SOURCE 200112L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MUSIC_CACHE_SUPPORTED
+#endif
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Memory.h"
+#include "MusicCache.h"
+#include "Trace.h"
+
+#define MUSIC_CACHE_MAGIC   0x43505342 // "BSPC" in memory on little endian.
+#define MUSIC_CACHE_VERSION 1
+
+/* The header of a cache file, followed by the samples. */
+typedef struct MusicCacheHeader_t
+{
+    uint32_t u32Magic;
+    uint32_t u32Version;
+    uint32_t u32Frequency;
+    uint32_t u32Channels;
+    uint64_t u64SourceSize;
+    int64_t  s64SourceTime;
+    uint64_t u64DecodeNs;
+    uint64_t u64Bytes;
+} MusicCacheHeader;
+
+static SDL_SpinLock _stLock;
+static uint64_t     _u64Mapped;
+
+#ifdef MUSIC_CACHE_SUPPORTED
+static int8_t _BuildCache(
+    const char             *pacFilename,
+    const char             *pacCacheFilename,
+    const MusicCacheHeader *pstExpected)
+{
+    MusicCacheHeader stHeader = *pstExpected;
+    Mix_Chunk       *pstChunk;
+    uint64_t         u64Start = SDL_GetPerformanceCounter();
+    char             acTempFilename[4096];
+    FILE            *pstFile;
+    int8_t           s8Status = 0;
+
+    // SDL_mixer decodes the whole file and converts it to the format
+    // the device was opened with.
+    TRACE_BEGIN("Mix_LoadWAV");
+    pstChunk = Mix_LoadWAV(pacFilename);
+    TRACE_END("Mix_LoadWAV");
+
+    if (NULL == pstChunk)
+    {
+        fprintf(stderr, "%s\n", Mix_GetError());
+        return -1;
+    }
+
+    stHeader.u64DecodeNs =
+        (SDL_GetPerformanceCounter() - u64Start) * 1000000000ULL / SDL_GetPerformanceFrequency();
+    stHeader.u64Bytes    = pstChunk->alen;
+
+    // Written under a temporary name, so a crash never leaves a
+    // truncated cache behind.
+    snprintf(acTempFilename, sizeof(acTempFilename), "%s.tmp", pacCacheFilename);
+    pstFile = fopen(acTempFilename, "wb");
+    if (NULL == pstFile)
+    {
+        perror("_BuildCache(): fopen");
+        Mix_FreeChunk(pstChunk);
+        return -1;
+    }
+
+    if ((1 != fwrite(&stHeader, sizeof(stHeader), 1, pstFile)) ||
+        (1 != fwrite(pstChunk->abuf, pstChunk->alen, 1, pstFile)))
+    {
+        perror("_BuildCache(): fwrite");
+        s8Status = -1;
+    }
+
+    if ((0 != fclose(pstFile)) || (-1 == s8Status) || (0 != rename(acTempFilename, pacCacheFilename)))
+    {
+        remove(acTempFilename);
+        s8Status = -1;
+    }
+
+    Mix_FreeChunk(pstChunk);
+
+    if (0 == s8Status)
+    {
+        printf("Decoded %s to %s in %.1f ms.\n",
+            pacFilename,
+            pacCacheFilename,
+            stHeader.u64DecodeNs / 1e6);
+    }
+
+    return s8Status;
+}
+
+static uint8_t _IsCacheValid(const MusicCacheHeader *pstHeader, const MusicCacheHeader *pstExpected, off_t lSize)
+{
+    return
+        (MUSIC_CACHE_MAGIC            == pstHeader->u32Magic)      &&
+        (MUSIC_CACHE_VERSION          == pstHeader->u32Version)    &&
+        (pstExpected->u32Frequency    == pstHeader->u32Frequency)  &&
+        (pstExpected->u32Channels     == pstHeader->u32Channels)   &&
+        (pstExpected->u64SourceSize   == pstHeader->u64SourceSize) &&
+        (pstExpected->s64SourceTime   == pstHeader->s64SourceTime) &&
+        ((uint64_t)lSize == sizeof(MusicCacheHeader) + pstHeader->u64Bytes);
+}
+
+/* Returns 0 on success, 1 if the file is missing or stale, -1 if
+ * mapping it would exceed the budget or failed. */
+static int8_t _MapCache(
+    MusicCache             *pstCache,
+    const char             *pacCacheFilename,
+    const MusicCacheHeader *pstExpected,
+    uint64_t                u64Budget)
+{
+    MusicCacheHeader stHeader;
+    struct stat      stStat;
+    int32_t          s32Fd;
+    uint8_t          u8IsOverBudget;
+
+    s32Fd = open(pacCacheFilename, O_RDONLY);
+    if (-1 == s32Fd)
+    {
+        return 1;
+    }
+
+    if ((-1 == fstat(s32Fd, &stStat)) ||
+        ((ssize_t)sizeof(stHeader) != read(s32Fd, &stHeader, sizeof(stHeader))) ||
+        (0 == _IsCacheValid(&stHeader, pstExpected, stStat.st_size)))
+    {
+        close(s32Fd);
+        return 1;
+    }
+
+    SDL_AtomicLock(&_stLock);
+    u8IsOverBudget = _u64Mapped + stStat.st_size > u64Budget;
+    if (0 == u8IsOverBudget)
+    {
+        _u64Mapped += stStat.st_size;
+    }
+    SDL_AtomicUnlock(&_stLock);
+
+    if (u8IsOverBudget)
+    {
+        close(s32Fd);
+        return -1;
+    }
+
+    pstCache->pMapping = mmap(NULL, stStat.st_size, PROT_READ, MAP_PRIVATE, s32Fd, 0);
+    close(s32Fd);
+
+    if (MAP_FAILED == pstCache->pMapping)
+    {
+        perror("_MapCache(): mmap");
+        SDL_AtomicLock(&_stLock);
+        _u64Mapped -= stStat.st_size;
+        SDL_AtomicUnlock(&_stLock);
+        return -1;
+    }
+
+    pstCache->u64MappingSize = stStat.st_size;
+    pstCache->ps16Samples    = (const int16_t *)((const uint8_t *)pstCache->pMapping + sizeof(stHeader));
+    pstCache->u64DecodeNs    = stHeader.u64DecodeNs;
+    pstCache->u32Frequency   = stHeader.u32Frequency;
+    pstCache->u8Channels     = stHeader.u32Channels;
+    pstCache->u32Frames      = stHeader.u64Bytes / (sizeof(int16_t) * stHeader.u32Channels);
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief   Unmap a MusicCache and free it from memory.
+ * @param   pstCache the MusicCache.  See @ref struct MusicCache.
+ * @ingroup MusicCache
+ */
+void FreeMusicCache(MusicCache *pstCache)
+{
+    if (NULL == pstCache)
+    {
+        return;
+    }
+
+    #ifdef MUSIC_CACHE_SUPPORTED
+    munmap(pstCache->pMapping, pstCache->u64MappingSize);
+    SDL_AtomicLock(&_stLock);
+    _u64Mapped -= pstCache->u64MappingSize;
+    SDL_AtomicUnlock(&_stLock);
+    #endif
+
+    FreeMemory(pstCache);
+}
+
+/**
+ * @brief   Get the size of all mapped cache files.
+ * @return  The size in bytes.
+ * @ingroup MusicCache
+ */
+uint64_t GetMusicCacheBytes()
+{
+    uint64_t u64Mapped;
+
+    SDL_AtomicLock(&_stLock);
+    u64Mapped = _u64Mapped;
+    SDL_AtomicUnlock(&_stLock);
+
+    return u64Mapped;
+}
+
+/**
+ * @brief   Initialise MusicCache: map the cache file of a music file,
+ *          decoding the music first if there is no valid one.  Must be
+ *          called after the audio device has been opened.
+ * @param   pacFilename  the filename of the music file.
+ * @param   u32Frequency the sampling frequency of the device.
+ * @param   u16Format    the sample format of the device.
+ * @param   u8Channels   the number of channels of the device.
+ * @param   u64Budget    the maximum size of all mapped cache files in
+ *                       bytes.
+ * @return  MusicCache on success, NULL if the music has to be streamed
+ *          instead.  See @ref struct MusicCache.
+ * @ingroup MusicCache
+ */
+MusicCache *InitMusicCache(
+    const char     *pacFilename,
+    const uint32_t  u32Frequency,
+    const uint16_t  u16Format,
+    const uint8_t   u8Channels,
+    const uint64_t  u64Budget)
+{
+    #ifdef MUSIC_CACHE_SUPPORTED
+    static MusicCache *pstCache;
+    MusicCacheHeader   stExpected;
+    struct stat        stStat;
+    const char        *pacBasename = strrchr(pacFilename, '/');
+    char              *pacPrefPath;
+    char               acCacheFilename[4096];
+    int8_t             s8Status;
+
+    if (AUDIO_S16SYS != u16Format)
+    {
+        return NULL;
+    }
+
+    if (-1 == stat(pacFilename, &stStat))
+    {
+        perror("InitMusicCache(): stat");
+        return NULL;
+    }
+
+    memset(&stExpected, 0, sizeof(stExpected));
+    stExpected.u32Magic      = MUSIC_CACHE_MAGIC;
+    stExpected.u32Version    = MUSIC_CACHE_VERSION;
+    stExpected.u32Frequency  = u32Frequency;
+    stExpected.u32Channels   = u8Channels;
+    stExpected.u64SourceSize = stStat.st_size;
+    stExpected.s64SourceTime = stStat.st_mtime;
+
+    pacPrefPath = SDL_GetPrefPath(NULL, "boondock-sam");
+    if (NULL == pacPrefPath)
+    {
+        fprintf(stderr, "InitMusicCache(): %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    snprintf(acCacheFilename, sizeof(acCacheFilename), "%s%s.%u-%u.pcm",
+        pacPrefPath,
+        pacBasename ? pacBasename + 1 : pacFilename,
+        u32Frequency,
+        u8Channels);
+    SDL_free(pacPrefPath);
+
+    pstCache = CallocMemory(MEMORY_AUDIO, 1, sizeof(struct MusicCache_t));
+    if (NULL == pstCache)
+    {
+        fprintf(stderr, "InitMusicCache(): error allocating memory.\n");
+        return NULL;
+    }
+
+    s8Status = _MapCache(pstCache, acCacheFilename, &stExpected, u64Budget);
+    if (1 == s8Status)
+    {
+        if (0 == _BuildCache(pacFilename, acCacheFilename, &stExpected))
+        {
+            s8Status = _MapCache(pstCache, acCacheFilename, &stExpected, u64Budget);
+        }
+    }
+
+    if (0 != s8Status)
+    {
+        fprintf(stderr, "Streaming %s: its cache would exceed the budget or isn't available.\n", pacFilename);
+        FreeMemory(pstCache);
+        return NULL;
+    }
+
+    return pstCache;
+    #else
+    (void)pacFilename;
+    (void)u32Frequency;
+    (void)u16Format;
+    (void)u8Channels;
+    (void)u64Budget;
+    return NULL;
+    #endif
+}
@@ -0,0 +1,40 @@
+/**
+ * @file    MusicCache.h
+ * @ingroup MusicCache
+ */
+
+#ifndef _MUSIC_CACHE_H_
+#define _MUSIC_CACHE_H_
+
+#include <stdint.h>
+
+/**
+ * @ingroup MusicCache
+ * @brief   Music decoded to the format of the audio device, mapped from
+ *          a cache file.  ps16Samples holds u32Frames frames of
+ *          interleaved signed 16-bit samples.  u64DecodeNs is how long
+ *          decoding the source took, which streaming spends again on
+ *          every playback.
+ */
+typedef struct MusicCache_t
+{
+    const int16_t *ps16Samples;
+    void          *pMapping;
+    uint64_t       u64MappingSize;
+    uint64_t       u64DecodeNs;
+    uint32_t       u32Frames;
+    uint32_t       u32Frequency;
+    uint8_t        u8Channels;
+} MusicCache;
+
+void     FreeMusicCache(MusicCache *pstCache);
+uint64_t GetMusicCacheBytes();
+
+MusicCache *InitMusicCache(
+    const char     *pacFilename,
+    const uint32_t  u32Frequency,
+    const uint16_t  u16Format,
+    const uint8_t   u8Channels,
+    const uint64_t  u64Budget);
+
+#endif // _MUSIC_CACHE_H_
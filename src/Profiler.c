@@ -0,0 +1,445 @@
+/**
+ * @file      Profiler.c
+ * @ingroup   Profiler
+ * @defgroup  Profiler
+ * @brief     Lightweight frame profiler.  Each stage of the main loop is
+ *            timed with the performance counter, the timings are kept
+ *            in a ring buffer and shown in a toggleable overlay.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Memory.h"
+#include "Profiler.h"
+
+#define GLYPH_WIDTH   3
+#define GLYPH_HEIGHT  5
+#define LINE_HEIGHT   (GLYPH_HEIGHT + 1)
+#define COLUMN_WIDTH  (GLYPH_WIDTH  + 1)
+#define MAX_TEXT      32
+#define BAR_WIDTH     40
+#define GRAPH_FRAMES  128
+#define GRAPH_HEIGHT  32
+
+static const char *_pacStageNames[PROFILER_STAGES + 1] = {
+    "INPUT",
+    "CAMERA",
+    "SCROLL",
+    "COLLIS",
+    "UPDATE",
+    "DRW BG",
+    "MAP BG",
+    "ENTITY",
+    "MAP FG",
+    "PRESNT",
+    "FRAME"
+};
+
+static const SDL_Color _stStageColors[PROFILER_STAGES + 1] = {
+    { 0xe6, 0x19, 0x4b, 0xff },
+    { 0x3c, 0xb4, 0x4b, 0xff },
+    { 0xff, 0xe1, 0x19, 0xff },
+    { 0x43, 0x63, 0xd8, 0xff },
+    { 0xf5, 0x82, 0x31, 0xff },
+    { 0x91, 0x1e, 0xb4, 0xff },
+    { 0x42, 0xd4, 0xf4, 0xff },
+    { 0xf0, 0x32, 0xe6, 0xff },
+    { 0xbf, 0xef, 0x45, 0xff },
+    { 0xfa, 0xbe, 0xd4, 0xff },
+    { 0xff, 0xff, 0xff, 0xff }
+};
+
+/* 3x5 pixel font for the characters ' ' to 'Z'.  Each glyph is stored
+ * row by row, starting with the most significant of 15 bits. */
+static const uint16_t _u16Font[] = {
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x52A5, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x01C0, 0x0002, 0x12A4,
+    0x7B6F, 0x2C97, 0x73E7, 0x72CF, 0x5BC9, 0x79CF, 0x79EF, 0x7292,
+    0x7BEF, 0x7BCF, 0x0410, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B,
+    0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A,
+    0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD,
+    0x5AAD, 0x5A92, 0x72A7
+};
+
+static int32_t _CompareU32(const void *pA, const void *pB)
+{
+    uint32_t u32A = *(const uint32_t *)pA;
+    uint32_t u32B = *(const uint32_t *)pB;
+
+    return (u32A > u32B) - (u32A < u32B);
+}
+
+static uint32_t _GetTime(const Profiler *pstProfiler, uint16_t u16Slot, uint8_t u8Stage)
+{
+    if (PROFILER_STAGES == u8Stage)
+    {
+        return pstProfiler->u32FrameTime[u16Slot];
+    }
+
+    return pstProfiler->u32StageTime[u16Slot][u8Stage];
+}
+
+static uint32_t _ToNanoseconds(const Profiler *pstProfiler, uint64_t u64Ticks)
+{
+    uint64_t u64Time = u64Ticks * 1000000000ULL / pstProfiler->u64Frequency;
+
+    return u64Time > UINT32_MAX ? UINT32_MAX : (uint32_t)u64Time;
+}
+
+static void _DrawText(SDL_Renderer *pstRenderer, int32_t s32X, int32_t s32Y, const char *pacText)
+{
+    SDL_Rect stPixels[MAX_TEXT * GLYPH_WIDTH * GLYPH_HEIGHT];
+    int32_t  s32Count = 0;
+
+    for (uint8_t u8Index = 0; pacText[u8Index] && u8Index < MAX_TEXT; u8Index++)
+    {
+        char     cChar   = pacText[u8Index];
+        uint16_t u16Glyph;
+
+        if ((cChar < ' ') || (cChar > 'Z'))
+        {
+            continue;
+        }
+        u16Glyph = _u16Font[cChar - ' '];
+
+        for (uint8_t u8Bit = 0; u8Bit < GLYPH_WIDTH * GLYPH_HEIGHT; u8Bit++)
+        {
+            if (u16Glyph & (1 << (GLYPH_WIDTH * GLYPH_HEIGHT - 1 - u8Bit)))
+            {
+                stPixels[s32Count].x = s32X + u8Index * COLUMN_WIDTH + u8Bit % GLYPH_WIDTH;
+                stPixels[s32Count].y = s32Y + u8Bit / GLYPH_WIDTH;
+                stPixels[s32Count].w = 1;
+                stPixels[s32Count].h = 1;
+                s32Count++;
+            }
+        }
+    }
+
+    if (s32Count)
+    {
+        SDL_RenderFillRects(pstRenderer, stPixels, s32Count);
+    }
+}
+
+/**
+ * @brief   Add time measured elsewhere, e.g. by the Profiler of
+ *          another thread, to a stage of the current frame.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   u8Stage     the stage.  See @ref enum ProfilerStage.
+ * @param   u32Time     the time in nanoseconds.
+ * @ingroup Profiler
+ */
+void AddProfilerStageTime(
+    Profiler       *pstProfiler,
+    const uint8_t   u8Stage,
+    const uint32_t  u32Time)
+{
+    pstProfiler->u32StageTime[pstProfiler->u16Head][u8Stage] += u32Time;
+}
+
+/**
+ * @brief   Start measuring a new frame.  A frame which isn't finished
+ *          with EndProfilerFrame() is discarded.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @ingroup Profiler
+ */
+void BeginProfilerFrame(Profiler *pstProfiler)
+{
+    for (uint8_t u8Stage = 0; u8Stage < PROFILER_STAGES; u8Stage++)
+    {
+        pstProfiler->u32StageTime[pstProfiler->u16Head][u8Stage] = 0;
+    }
+    pstProfiler->u64FrameStart = SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief   Start measuring a stage of the current frame.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   u8Stage     the stage.  See @ref enum ProfilerStage.
+ * @ingroup Profiler
+ */
+void BeginProfilerStage(Profiler *pstProfiler, const uint8_t u8Stage)
+{
+    pstProfiler->u64StageStart[u8Stage] = SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief   Draw the profiler overlay: min, avg and p99 of every stage
+ *          in milliseconds, the audio callback counters and a graph of
+ *          the recent frame times.
+ * @param   pstRenderer a SDL rendering context.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   dBudget     the frame time budget in seconds, e.g. 1/fps.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Profiler
+ */
+int8_t DrawProfiler(
+    SDL_Renderer *pstRenderer,
+    Profiler     *pstProfiler,
+    const double  dBudget)
+{
+    SDL_Rect      stBars[GRAPH_FRAMES];
+    SDL_Rect      stPanel;
+    SDL_BlendMode stBlendMode;
+    uint8_t       u8Red, u8Green, u8Blue, u8Alpha;
+    uint32_t      u32Budget = dBudget * 1000000000.0;
+    char          acLine[MAX_TEXT + 1];
+    int32_t       s32GraphY = 2 + (PROFILER_STAGES + 3) * LINE_HEIGHT + 2;
+    int32_t       s32Count  = 0;
+
+    if ((0 == pstProfiler->u8IsVisible) || (0 == pstProfiler->u16Count))
+    {
+        return 0;
+    }
+
+    if (0 == u32Budget)
+    {
+        u32Budget = 1;
+    }
+
+    SDL_GetRenderDrawColor(pstRenderer, &u8Red, &u8Green, &u8Blue, &u8Alpha);
+    SDL_GetRenderDrawBlendMode(pstRenderer, &stBlendMode);
+
+    stPanel.x = 0;
+    stPanel.y = 0;
+    stPanel.w = 4 + 24 * COLUMN_WIDTH + BAR_WIDTH;
+    stPanel.h = s32GraphY + GRAPH_HEIGHT + 2;
+
+    SDL_SetRenderDrawBlendMode(pstRenderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(pstRenderer, 0x00, 0x00, 0x00, 0xa0);
+    if (0 != SDL_RenderFillRect(pstRenderer, &stPanel))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    SDL_SetRenderDrawColor(pstRenderer, 0xff, 0xff, 0xff, 0xff);
+    _DrawText(pstRenderer, 2, 2, "STAGE    MIN   AVG   P99");
+
+    // One row per stage plus the total frame time.
+    for (uint8_t u8Stage = 0; u8Stage <= PROFILER_STAGES; u8Stage++)
+    {
+        ProfilerStats stStats = GetProfilerStats(pstProfiler, u8Stage);
+        int32_t       s32Y    = 2 + (u8Stage + 1) * LINE_HEIGHT;
+        SDL_Rect      stBar;
+
+        snprintf(acLine, sizeof(acLine), "%-6s %5.2f %5.2f %5.2f",
+            _pacStageNames[u8Stage],
+            stStats.u32Min / 1000000.0,
+            stStats.u32Avg / 1000000.0,
+            stStats.u32P99 / 1000000.0);
+
+        SDL_SetRenderDrawColor(
+            pstRenderer,
+            _stStageColors[u8Stage].r,
+            _stStageColors[u8Stage].g,
+            _stStageColors[u8Stage].b,
+            0xff);
+        _DrawText(pstRenderer, 2, s32Y, acLine);
+
+        // The bar spans the entire budget, the marker is the p99.
+        stBar.x = 2 + 24 * COLUMN_WIDTH;
+        stBar.y = s32Y;
+        stBar.w = (uint64_t)stStats.u32Avg * BAR_WIDTH / u32Budget;
+        stBar.h = GLYPH_HEIGHT;
+        if (stBar.w > BAR_WIDTH) { stBar.w = BAR_WIDTH; }
+        SDL_RenderFillRect(pstRenderer, &stBar);
+
+        stBar.x += (uint64_t)stStats.u32P99 * BAR_WIDTH / u32Budget;
+        stBar.w  = 1;
+        if (stBar.x > 2 + 24 * COLUMN_WIDTH + BAR_WIDTH) { stBar.x = 2 + 24 * COLUMN_WIDTH + BAR_WIDTH; }
+        SDL_RenderFillRect(pstRenderer, &stBar);
+    }
+
+    if (pstProfiler->u32AudioUnderruns)
+    {
+        SDL_SetRenderDrawColor(pstRenderer, 0xe6, 0x19, 0x4b, 0xff);
+    }
+    else
+    {
+        SDL_SetRenderDrawColor(pstRenderer, 0xff, 0xff, 0xff, 0xff);
+    }
+    snprintf(acLine, sizeof(acLine), "AUDIO LATE %-5u UNDERRUN %u",
+        pstProfiler->u32AudioLateCallbacks,
+        pstProfiler->u32AudioUnderruns);
+    _DrawText(pstRenderer, 2, 2 + (PROFILER_STAGES + 2) * LINE_HEIGHT, acLine);
+
+    // Frame time graph, the budget is at half of its height.
+    for (uint16_t u16Index = 0; u16Index < GRAPH_FRAMES; u16Index++)
+    {
+        uint16_t u16Age  = GRAPH_FRAMES - u16Index;
+        uint16_t u16Slot = (pstProfiler->u16Head + PROFILER_FRAMES - u16Age) % PROFILER_FRAMES;
+        uint64_t u64Height;
+
+        if (u16Age > pstProfiler->u16Count)
+        {
+            continue;
+        }
+
+        u64Height = (uint64_t)pstProfiler->u32FrameTime[u16Slot] * (GRAPH_HEIGHT / 2) / u32Budget;
+        if (u64Height > GRAPH_HEIGHT) { u64Height = GRAPH_HEIGHT; }
+
+        stBars[s32Count].x = 2 + u16Index;
+        stBars[s32Count].y = s32GraphY + GRAPH_HEIGHT - u64Height;
+        stBars[s32Count].w = 1;
+        stBars[s32Count].h = u64Height;
+        s32Count++;
+    }
+
+    SDL_SetRenderDrawColor(pstRenderer, 0x3c, 0xb4, 0x4b, 0xff);
+    if (s32Count)
+    {
+        SDL_RenderFillRects(pstRenderer, stBars, s32Count);
+    }
+
+    SDL_SetRenderDrawColor(pstRenderer, 0xe6, 0x19, 0x4b, 0xff);
+    SDL_RenderDrawLine(
+        pstRenderer,
+        2,                s32GraphY + GRAPH_HEIGHT / 2,
+        1 + GRAPH_FRAMES, s32GraphY + GRAPH_HEIGHT / 2);
+
+    SDL_SetRenderDrawBlendMode(pstRenderer, stBlendMode);
+    SDL_SetRenderDrawColor(pstRenderer, u8Red, u8Green, u8Blue, u8Alpha);
+
+    return 0;
+}
+
+/**
+ * @brief   Finish measuring the current frame and advance the ring
+ *          buffer.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @ingroup Profiler
+ */
+void EndProfilerFrame(Profiler *pstProfiler)
+{
+    uint64_t u64Ticks = SDL_GetPerformanceCounter() - pstProfiler->u64FrameStart;
+
+    pstProfiler->u32FrameTime[pstProfiler->u16Head] = _ToNanoseconds(pstProfiler, u64Ticks);
+    pstProfiler->u16Head = (pstProfiler->u16Head + 1) % PROFILER_FRAMES;
+
+    // The slot at the head always holds the frame in progress.
+    if (pstProfiler->u16Count < PROFILER_FRAMES - 1)
+    {
+        pstProfiler->u16Count++;
+    }
+}
+
+/**
+ * @brief   Stop measuring a stage of the current frame.  A stage can be
+ *          measured several times per frame, the times add up.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   u8Stage     the stage.  See @ref enum ProfilerStage.
+ * @ingroup Profiler
+ */
+void EndProfilerStage(Profiler *pstProfiler, const uint8_t u8Stage)
+{
+    uint64_t u64Ticks = SDL_GetPerformanceCounter() - pstProfiler->u64StageStart[u8Stage];
+
+    pstProfiler->u32StageTime[pstProfiler->u16Head][u8Stage] += _ToNanoseconds(pstProfiler, u64Ticks);
+}
+
+/**
+ * @brief   Free Profiler from memory.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @ingroup Profiler
+ */
+void FreeProfiler(Profiler *pstProfiler)
+{
+    FreeMemory(pstProfiler);
+}
+
+/**
+ * @brief   Get min, avg and p99 of a stage over the recorded frames.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   u8Stage     the stage or PROFILER_STAGES for the entire
+ *                      frame.  See @ref enum ProfilerStage.
+ * @return  The statistics in nanoseconds.  See @ref struct ProfilerStats.
+ * @ingroup Profiler
+ */
+ProfilerStats GetProfilerStats(const Profiler *pstProfiler, const uint8_t u8Stage)
+{
+    static uint32_t u32Sorted[PROFILER_FRAMES];
+    ProfilerStats   stStats  = { 0, 0, 0 };
+    uint64_t        u64Sum   = 0;
+    uint16_t        u16Count = pstProfiler->u16Count;
+
+    if (0 == u16Count)
+    {
+        return stStats;
+    }
+
+    for (uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+    {
+        uint16_t u16Slot = (pstProfiler->u16Head + PROFILER_FRAMES - 1 - u16Index) % PROFILER_FRAMES;
+
+        u32Sorted[u16Index] = _GetTime(pstProfiler, u16Slot, u8Stage);
+        u64Sum += u32Sorted[u16Index];
+    }
+    qsort(u32Sorted, u16Count, sizeof(uint32_t), _CompareU32);
+
+    stStats.u32Min = u32Sorted[0];
+    stStats.u32Avg = u64Sum / u16Count;
+    stStats.u32P99 = u32Sorted[(u16Count * 99 + 99) / 100 - 1];
+
+    return stStats;
+}
+
+/**
+ * @brief   Get the display name of a stage.
+ * @param   u8Stage the stage or PROFILER_STAGES for the entire frame.
+ *                  See @ref enum ProfilerStage.
+ * @return  The name.
+ * @ingroup Profiler
+ */
+const char *GetProfilerStageName(const uint8_t u8Stage)
+{
+    if (u8Stage > PROFILER_STAGES)
+    {
+        return "";
+    }
+
+    return _pacStageNames[u8Stage];
+}
+
+/**
+ * @brief   Get the time a stage took in the last completed frame.
+ * @param   pstProfiler Profiler.  See @ref struct Profiler.
+ * @param   u8Stage     the stage or PROFILER_STAGES for the entire
+ *                      frame.  See @ref enum ProfilerStage.
+ * @return  The time in nanoseconds, 0 if no frame has been completed.
+ * @ingroup Profiler
+ */
+uint32_t GetProfilerStageTime(const Profiler *pstProfiler, const uint8_t u8Stage)
+{
+    if ((0 == pstProfiler->u16Count) || (u8Stage > PROFILER_STAGES))
+    {
+        return 0;
+    }
+
+    return _GetTime(pstProfiler, (pstProfiler->u16Head + PROFILER_FRAMES - 1) % PROFILER_FRAMES, u8Stage);
+}
+
+/**
+ * @brief   Initialise Profiler.  The overlay is hidden by default.
+ * @return  Profiler on success, NULL on error.  See @ref struct Profiler.
+ * @ingroup Profiler
+ */
+Profiler *InitProfiler()
+{
+    static Profiler *pstProfiler;
+    pstProfiler = CallocMemory(MEMORY_ENGINE, 1, sizeof(struct Profiler_t));
+    if (NULL == pstProfiler)
+    {
+        fprintf(stderr, "InitProfiler(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstProfiler->u64Frequency = SDL_GetPerformanceFrequency();
+
+    return pstProfiler;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file    Profiler.h
+ * @ingroup Profiler
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Trace.h"
+
+/**
+ * @ingroup Profiler
+ */
+enum ProfilerStage
+{
+    PROFILER_INPUT         = 0,
+    PROFILER_CAMERA        = 1,
+    PROFILER_BG_SCROLL     = 2,
+    PROFILER_COLLISION     = 3,
+    PROFILER_ENTITY_UPDATE = 4,
+    PROFILER_DRAW_BG       = 5,
+    PROFILER_DRAW_MAP_BG   = 6,
+    PROFILER_DRAW_ENTITY   = 7,
+    PROFILER_DRAW_MAP_FG   = 8,
+    PROFILER_PRESENT       = 9,
+    PROFILER_STAGES        = 10
+};
+
+/**
+ * @ingroup Profiler
+ */
+enum ProfilerLimits
+{
+    PROFILER_FRAMES = 256
+};
+
+/**
+ * @ingroup Profiler
+ * @brief   Per-stage timings of the recent frames in nanoseconds.
+ *          u16Head is the slot of the frame currently being measured,
+ *          u16Count the number of completed frames before it.  The
+ *          audio counters are set by the caller and only displayed.
+ */
+typedef struct Profiler_t
+{
+    uint64_t u64Frequency;
+    uint64_t u64FrameStart;
+    uint64_t u64StageStart[PROFILER_STAGES];
+    uint32_t u32StageTime[PROFILER_FRAMES][PROFILER_STAGES];
+    uint32_t u32FrameTime[PROFILER_FRAMES];
+    uint16_t u16Head;
+    uint16_t u16Count;
+    uint32_t u32AudioLateCallbacks;
+    uint32_t u32AudioUnderruns;
+    uint8_t  u8IsVisible;
+} Profiler;
+
+/**
+ * @ingroup Profiler
+ * @brief   Statistics of one stage over the recorded frames.
+ */
+typedef struct ProfilerStats_t
+{
+    uint32_t u32Min;
+    uint32_t u32Avg;
+    uint32_t u32P99;
+} ProfilerStats;
+
+/* Stages show up as zones in a trace as well.  See @ref Trace. */
+#define PROFILE_BEGIN(profiler, stage) \
+    do { BeginProfilerStage(profiler, stage); TRACE_BEGIN(GetProfilerStageName(stage)); } while (0)
+#define PROFILE_END(profiler, stage) \
+    do { TRACE_END(GetProfilerStageName(stage)); EndProfilerStage(profiler, stage); } while (0)
+
+void AddProfilerStageTime(
+    Profiler       *pstProfiler,
+    const uint8_t   u8Stage,
+    const uint32_t  u32Time);
+
+void BeginProfilerFrame(Profiler *pstProfiler);
+void BeginProfilerStage(Profiler *pstProfiler, const uint8_t u8Stage);
+
+int8_t DrawProfiler(
+    SDL_Renderer *pstRenderer,
+    Profiler     *pstProfiler,
+    const double  dBudget);
+
+void          EndProfilerFrame(Profiler *pstProfiler);
+void          EndProfilerStage(Profiler *pstProfiler, const uint8_t u8Stage);
+void          FreeProfiler(Profiler *pstProfiler);
+ProfilerStats GetProfilerStats(const Profiler *pstProfiler, const uint8_t u8Stage);
+const char   *GetProfilerStageName(const uint8_t u8Stage);
+uint32_t      GetProfilerStageTime(const Profiler *pstProfiler, const uint8_t u8Stage);
+Profiler     *InitProfiler();
+
+#endif // _PROFILER_H_
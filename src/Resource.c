@@ -0,0 +1,693 @@
+/**
+ * @file      Resource.c
+ * @ingroup   Resource
+ * @defgroup  Resource
+ * @brief     Reference-counted resource manager.  Textures, sound
+ *            effects and music are loaded by filename; requesting a
+ *            file which is already loaded returns a handle to the same
+ *            resource, e.g. all entities using sam.png share one
+ *            texture.  A resource is destroyed as soon as its last
+ *            handle is released.  Music may be acquired by the level
+ *            loader thread, textures only on the thread which owns the
+ *            renderer.  Images which have been packed into a texture
+ *            atlas by `make atlas` resolve to their part of an atlas
+ *            page, see AcquireImage().
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inih/ini.h"
+#include "Audio.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "Trace.h"
+#include "Video.h"
+
+typedef struct ResourceSlot_t
+{
+    char     *pacFilename;
+    void     *pData;
+    uint64_t  u64Bytes;
+    int32_t   s32References;
+    uint16_t  u16Generation;
+    uint8_t   u8Type;
+} ResourceSlot;
+
+typedef struct AtlasEntry_t
+{
+    char     *pacFilename;
+    char     *pacPage;
+    SDL_Rect  stRect;
+} AtlasEntry;
+
+static SDL_mutex     *_pstLock;
+static ResourceSlot   _stSlots[RESOURCE_SLOTS];
+static ResourceStats  _stStats;
+static AtlasEntry     _stAtlas[RESOURCE_ATLAS_IMAGES];
+static uint32_t       _u32AtlasImages;
+
+static const char *_pacTypeNames[RESOURCE_TYPES] = {
+    "texture",
+    "sfx",
+    "music"
+};
+
+static void _Destroy(const uint8_t u8Type, void *pData)
+{
+    switch (u8Type)
+    {
+        case RESOURCE_TEXTURE:
+            DestroyTexture((SDL_Texture *)pData);
+            break;
+        case RESOURCE_SFX:
+            FreeSfx((Sfx *)pData);
+            break;
+        case RESOURCE_MUSIC:
+            FreeMusic((Music *)pData);
+            break;
+    }
+}
+
+static char *_CopyString(const char *pacString)
+{
+    char *pacCopy = AllocMemory(MEMORY_ENGINE, strlen(pacString) + 1);
+
+    if (pacCopy)
+    {
+        memcpy(pacCopy, pacString, strlen(pacString) + 1);
+    }
+
+    return pacCopy;
+}
+
+/* ini_parse() handler of LoadAtlas().  Every section is an image. */
+static int _AtlasHandler(
+    void       *pUser,
+    const char *pacSection,
+    const char *pacName,
+    const char *pacValue)
+{
+    AtlasEntry *pstEntry;
+
+    (void)pUser;
+
+    if ((0 == _u32AtlasImages) ||
+        (0 != strcmp(pacSection, _stAtlas[_u32AtlasImages - 1].pacFilename)))
+    {
+        if (RESOURCE_ATLAS_IMAGES == _u32AtlasImages)
+        {
+            fprintf(stderr, "LoadAtlas(): more than %d images.\n", RESOURCE_ATLAS_IMAGES);
+            return 0;
+        }
+
+        pstEntry              = &_stAtlas[_u32AtlasImages];
+        pstEntry->pacFilename = _CopyString(pacSection);
+        if (NULL == pstEntry->pacFilename)
+        {
+            fprintf(stderr, "LoadAtlas(): error allocating memory.\n");
+            return 0;
+        }
+        _u32AtlasImages++;
+    }
+
+    pstEntry = &_stAtlas[_u32AtlasImages - 1];
+    if (0 == strcmp(pacName, "page"))
+    {
+        FreeMemory(pstEntry->pacPage);
+        pstEntry->pacPage = _CopyString(pacValue);
+        if (NULL == pstEntry->pacPage)
+        {
+            fprintf(stderr, "LoadAtlas(): error allocating memory.\n");
+            return 0;
+        }
+    }
+    else if (0 == strcmp(pacName, "x")) { pstEntry->stRect.x = atoi(pacValue); }
+    else if (0 == strcmp(pacName, "y")) { pstEntry->stRect.y = atoi(pacValue); }
+    else if (0 == strcmp(pacName, "w")) { pstEntry->stRect.w = atoi(pacValue); }
+    else if (0 == strcmp(pacName, "h")) { pstEntry->stRect.h = atoi(pacValue); }
+
+    return 1;
+}
+
+static void _FreeAtlas()
+{
+    for (uint32_t u32Index = 0; u32Index < _u32AtlasImages; u32Index++)
+    {
+        FreeMemory(_stAtlas[u32Index].pacFilename);
+        FreeMemory(_stAtlas[u32Index].pacPage);
+    }
+
+    memset(_stAtlas, 0, sizeof(_stAtlas));
+    _u32AtlasImages = 0;
+}
+
+/* Must be called with the lock held.  Returns the index of the slot
+ * holding the file, -1 if it isn't loaded. */
+static int32_t _Find(const uint8_t u8Type, const char *pacFilename)
+{
+    for (int32_t s32Slot = 0; s32Slot < RESOURCE_SLOTS; s32Slot++)
+    {
+        if ((_stSlots[s32Slot].s32References)        &&
+            (u8Type == _stSlots[s32Slot].u8Type)     &&
+            (0 == strcmp(pacFilename, _stSlots[s32Slot].pacFilename)))
+        {
+            return s32Slot;
+        }
+    }
+
+    return -1;
+}
+
+static uint64_t _GetBytes(const uint8_t u8Type, void *pData)
+{
+    switch (u8Type)
+    {
+        case RESOURCE_TEXTURE:
+            return GetTextureBytes((SDL_Texture *)pData);
+        case RESOURCE_SFX:
+            return ((Sfx *)pData)->pstSfx ? ((Sfx *)pData)->pstSfx->alen : 0;
+        case RESOURCE_MUSIC:
+            return ((Music *)pData)->pstCache ? ((Music *)pData)->pstCache->u64MappingSize : 0;
+    }
+
+    return 0;
+}
+
+/* Must be called with the lock held. */
+static uint32_t _GetId(const int32_t s32Slot)
+{
+    return ((uint32_t)_stSlots[s32Slot].u16Generation << 16) | (uint32_t)(s32Slot + 1);
+}
+
+static void *_Load(
+    const uint8_t  u8Type,
+    SDL_Renderer  *pstRenderer,
+    const char    *pacFilename)
+{
+    SDL_Texture *pstTexture;
+
+    switch (u8Type)
+    {
+        case RESOURCE_TEXTURE:
+            TRACE_BEGIN("LoadTexture");
+            pstTexture = LoadTexture(pstRenderer, pacFilename);
+            TRACE_END("LoadTexture");
+            if (NULL == pstTexture)
+            {
+                fprintf(stderr, "%s\n", SDL_GetError());
+            }
+            return pstTexture;
+        case RESOURCE_SFX:
+            return InitSfx(pacFilename);
+        case RESOURCE_MUSIC:
+            return InitMusic(pacFilename);
+    }
+
+    return NULL;
+}
+
+/* Must be called with the lock held.  Returns the slot a handle refers
+ * to, NULL if the handle is invalid or has already been released. */
+static ResourceSlot *_Resolve(const uint8_t u8Type, const uint32_t u32Id)
+{
+    uint32_t      u32Slot = u32Id & 0xffff;
+    ResourceSlot *pstSlot;
+
+    if ((0 == u32Slot) || (u32Slot > RESOURCE_SLOTS))
+    {
+        return NULL;
+    }
+
+    pstSlot = &_stSlots[u32Slot - 1];
+    if ((0 == pstSlot->s32References)                 ||
+        (u8Type != pstSlot->u8Type)                   ||
+        ((u32Id >> 16) != pstSlot->u16Generation))
+    {
+        return NULL;
+    }
+
+    return pstSlot;
+}
+
+/* Returns the id of the resource, 0 on failure. */
+static uint32_t _Acquire(
+    const uint8_t  u8Type,
+    SDL_Renderer  *pstRenderer,
+    const char    *pacFilename)
+{
+    void     *pData;
+    char     *pacCopy;
+    int32_t   s32Slot;
+    uint32_t  u32Id = 0;
+
+    SDL_LockMutex(_pstLock);
+    s32Slot = _Find(u8Type, pacFilename);
+    if (-1 != s32Slot)
+    {
+        _stSlots[s32Slot].s32References++;
+        _stStats.u32Shared[u8Type]++;
+        u32Id = _GetId(s32Slot);
+    }
+    SDL_UnlockMutex(_pstLock);
+
+    if (u32Id)
+    {
+        return u32Id;
+    }
+
+    // Loading takes long and must not block the other threads.
+    pData   = _Load(u8Type, pstRenderer, pacFilename);
+    pacCopy = AllocMemory(MEMORY_ENGINE, strlen(pacFilename) + 1);
+    if ((NULL == pData) || (NULL == pacCopy))
+    {
+        if (pData)
+        {
+            fprintf(stderr, "_Acquire(): error allocating memory.\n");
+            _Destroy(u8Type, pData);
+        }
+        FreeMemory(pacCopy);
+        return 0;
+    }
+    memcpy(pacCopy, pacFilename, strlen(pacFilename) + 1);
+
+    SDL_LockMutex(_pstLock);
+
+    // Another thread may have loaded the same file in the meantime.
+    s32Slot = _Find(u8Type, pacFilename);
+    if (-1 != s32Slot)
+    {
+        _stSlots[s32Slot].s32References++;
+        _stStats.u32Shared[u8Type]++;
+        u32Id = _GetId(s32Slot);
+        SDL_UnlockMutex(_pstLock);
+
+        _Destroy(u8Type, pData);
+        FreeMemory(pacCopy);
+        return u32Id;
+    }
+
+    for (s32Slot = 0; s32Slot < RESOURCE_SLOTS; s32Slot++)
+    {
+        if (0 == _stSlots[s32Slot].s32References)
+        {
+            break;
+        }
+    }
+
+    if (RESOURCE_SLOTS == s32Slot)
+    {
+        SDL_UnlockMutex(_pstLock);
+        fprintf(stderr, "_Acquire(): no free slot for %s.\n", pacFilename);
+        _Destroy(u8Type, pData);
+        FreeMemory(pacCopy);
+        return 0;
+    }
+
+    _stSlots[s32Slot].pacFilename   = pacCopy;
+    _stSlots[s32Slot].pData         = pData;
+    _stSlots[s32Slot].u64Bytes      = _GetBytes(u8Type, pData);
+    _stSlots[s32Slot].s32References = 1;
+    _stSlots[s32Slot].u8Type        = u8Type;
+
+    _stStats.u64Bytes[u8Type] += _stSlots[s32Slot].u64Bytes;
+    _stStats.u32Live[u8Type]++;
+    _stStats.u32Loads[u8Type]++;
+
+    u32Id = _GetId(s32Slot);
+    SDL_UnlockMutex(_pstLock);
+
+    return u32Id;
+}
+
+static void *_Get(const uint8_t u8Type, const uint32_t u32Id)
+{
+    ResourceSlot *pstSlot;
+    void         *pData = NULL;
+
+    SDL_LockMutex(_pstLock);
+    pstSlot = _Resolve(u8Type, u32Id);
+    if (pstSlot)
+    {
+        pData = pstSlot->pData;
+    }
+    SDL_UnlockMutex(_pstLock);
+
+    return pData;
+}
+
+static void _Release(const uint8_t u8Type, const uint32_t u32Id)
+{
+    ResourceSlot *pstSlot;
+    void         *pData;
+    char         *pacFilename;
+
+    SDL_LockMutex(_pstLock);
+    pstSlot = _Resolve(u8Type, u32Id);
+    if ((NULL == pstSlot) || (0 < --pstSlot->s32References))
+    {
+        SDL_UnlockMutex(_pstLock);
+        return;
+    }
+
+    pData       = pstSlot->pData;
+    pacFilename = pstSlot->pacFilename;
+
+    _stStats.u64Bytes[u8Type] -= pstSlot->u64Bytes;
+    _stStats.u32Live[u8Type]--;
+
+    // Handles which are still around no longer resolve to this slot.
+    pstSlot->u16Generation++;
+    pstSlot->pacFilename = NULL;
+    pstSlot->pData       = NULL;
+    pstSlot->u64Bytes    = 0;
+    SDL_UnlockMutex(_pstLock);
+
+    _Destroy(u8Type, pData);
+    FreeMemory(pacFilename);
+}
+
+/**
+ * @brief   Acquire an image, either its part of an atlas page or, if
+ *          it hasn't been packed, the file itself.  Must be called on
+ *          the thread which owns the renderer.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pacFilename the filename of the image.
+ * @param   pstRect     set to where the image is on the texture.
+ * @return  a handle of the texture, invalid on failure.
+ *          See @ref struct TextureHandle.
+ * @ingroup Resource
+ */
+TextureHandle AcquireImage(
+    SDL_Renderer *pstRenderer,
+    const char   *pacFilename,
+    SDL_Rect     *pstRect)
+{
+    TextureHandle  stHandle;
+    const char    *pacPage;
+
+    if (FindAtlasImage(pacFilename, &pacPage, pstRect))
+    {
+        return AcquireTexture(pstRenderer, pacPage);
+    }
+
+    stHandle = AcquireTexture(pstRenderer, pacFilename);
+    pstRect->x = 0;
+    pstRect->y = 0;
+    if ((stHandle.u32Id) &&
+        (0 != SDL_QueryTexture(GetTexture(stHandle), NULL, NULL, &pstRect->w, &pstRect->h)))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        ReleaseTexture(stHandle);
+        stHandle.u32Id = 0;
+    }
+
+    return stHandle;
+}
+
+/**
+ * @brief   Acquire Music.  Loads the file unless it's already loaded.
+ * @param   pacFilename the filename of the ogg music file.
+ * @return  a handle, invalid on failure.  See @ref struct MusicHandle.
+ * @ingroup Resource
+ */
+MusicHandle AcquireMusic(const char *pacFilename)
+{
+    MusicHandle stHandle;
+
+    stHandle.u32Id = _Acquire(RESOURCE_MUSIC, NULL, pacFilename);
+    return stHandle;
+}
+
+/**
+ * @brief   Acquire a sound effect.  Loads the file unless it's already
+ *          loaded.
+ * @param   pacFilename the filename of the wav file.
+ * @return  a handle, invalid on failure.  See @ref struct SfxHandle.
+ * @ingroup Resource
+ */
+SfxHandle AcquireSfx(const char *pacFilename)
+{
+    SfxHandle stHandle;
+
+    stHandle.u32Id = _Acquire(RESOURCE_SFX, NULL, pacFilename);
+    return stHandle;
+}
+
+/**
+ * @brief   Acquire a texture.  Loads the image unless it's already
+ *          loaded.  Must be called on the thread which owns the
+ *          renderer.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pacFilename the filename of the image.
+ * @return  a handle, invalid on failure.  See @ref struct TextureHandle.
+ * @ingroup Resource
+ */
+TextureHandle AcquireTexture(
+    SDL_Renderer *pstRenderer,
+    const char   *pacFilename)
+{
+    TextureHandle stHandle;
+
+    stHandle.u32Id = _Acquire(RESOURCE_TEXTURE, pstRenderer, pacFilename);
+    return stHandle;
+}
+
+/**
+ * @brief   Look up where an image has been packed.  Can be called from
+ *          any thread.
+ * @param   pacFilename the filename of the image.
+ * @param   ppacPage    set to the filename of the atlas page.
+ * @param   pstRect     set to where the image is on the page.
+ * @return  1 if the image is part of the atlas, 0 if not.
+ * @ingroup Resource
+ */
+uint8_t FindAtlasImage(
+    const char  *pacFilename,
+    const char **ppacPage,
+    SDL_Rect    *pstRect)
+{
+    for (uint32_t u32Index = 0; u32Index < _u32AtlasImages; u32Index++)
+    {
+        if ((_stAtlas[u32Index].pacPage) &&
+            (0 == strcmp(pacFilename, _stAtlas[u32Index].pacFilename)))
+        {
+            *ppacPage = _stAtlas[u32Index].pacPage;
+            *pstRect  = _stAtlas[u32Index].stRect;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Destroy all resources which are still loaded and report
+ *          them, as every handle should have been released by now.
+ *          Has to be called before the mixer and the renderer are
+ *          shut down.
+ * @ingroup Resource
+ */
+void FreeResources()
+{
+    for (uint16_t u16Slot = 0; u16Slot < RESOURCE_SLOTS; u16Slot++)
+    {
+        ResourceSlot *pstSlot = &_stSlots[u16Slot];
+
+        if (0 == pstSlot->s32References)
+        {
+            continue;
+        }
+
+        fprintf(stderr, "FreeResources(): %s %s still has %d reference(s).\n",
+            _pacTypeNames[pstSlot->u8Type],
+            pstSlot->pacFilename,
+            pstSlot->s32References);
+
+        _Destroy(pstSlot->u8Type, pstSlot->pData);
+        FreeMemory(pstSlot->pacFilename);
+    }
+
+    memset(_stSlots, 0, sizeof(_stSlots));
+    memset(&_stStats, 0, sizeof(_stStats));
+    _FreeAtlas();
+
+    if (_pstLock)
+    {
+        SDL_DestroyMutex(_pstLock);
+        _pstLock = NULL;
+    }
+}
+
+/**
+ * @brief   Get Music.
+ * @param   stHandle a handle.  See @ref struct MusicHandle.
+ * @return  the Music, NULL if the handle is invalid.
+ * @ingroup Resource
+ */
+Music *GetMusic(const MusicHandle stHandle)
+{
+    return (Music *)_Get(RESOURCE_MUSIC, stHandle.u32Id);
+}
+
+/**
+ * @brief   Get the name of a resource type.
+ * @param   u8Type the type.  See @ref enum ResourceType.
+ * @return  the name.
+ * @ingroup Resource
+ */
+const char *GetResourceTypeName(const uint8_t u8Type)
+{
+    if (u8Type >= RESOURCE_TYPES)
+    {
+        return "";
+    }
+
+    return _pacTypeNames[u8Type];
+}
+
+/**
+ * @brief   Get the resource statistics.
+ * @return  The statistics.  See @ref struct ResourceStats.
+ * @ingroup Resource
+ */
+ResourceStats GetResourceStats()
+{
+    ResourceStats stStats;
+
+    SDL_LockMutex(_pstLock);
+    stStats = _stStats;
+    SDL_UnlockMutex(_pstLock);
+
+    return stStats;
+}
+
+/**
+ * @brief   Get a sound effect.
+ * @param   stHandle a handle.  See @ref struct SfxHandle.
+ * @return  the Sfx, NULL if the handle is invalid.
+ * @ingroup Resource
+ */
+Sfx *GetSfx(const SfxHandle stHandle)
+{
+    return (Sfx *)_Get(RESOURCE_SFX, stHandle.u32Id);
+}
+
+/**
+ * @brief   Get a texture.
+ * @param   stHandle a handle.  See @ref struct TextureHandle.
+ * @return  the texture, NULL if the handle is invalid.
+ * @ingroup Resource
+ */
+SDL_Texture *GetTexture(const TextureHandle stHandle)
+{
+    return (SDL_Texture *)_Get(RESOURCE_TEXTURE, stHandle.u32Id);
+}
+
+/**
+ * @brief   Initialise the resource manager.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Resource
+ */
+int8_t InitResources()
+{
+    memset(_stSlots, 0, sizeof(_stSlots));
+    memset(&_stStats, 0, sizeof(_stStats));
+
+    _pstLock = SDL_CreateMutex();
+    if (NULL == _pstLock)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Load the table of an atlas written by `make atlas`.  The
+ *          atlas pages are loaded on demand by AcquireImage().  Has to
+ *          be called before any other thread looks up images.
+ * @param   pacFilename the filename of the table.
+ * @return  the number of images in the atlas, 0 if there is no atlas,
+ *          -1 if the table is broken.
+ * @ingroup Resource
+ */
+int32_t LoadAtlas(const char *pacFilename)
+{
+    int32_t s32Status;
+
+    _FreeAtlas();
+
+    s32Status = ini_parse(pacFilename, _AtlasHandler, NULL);
+    if (-1 == s32Status)
+    {
+        // Not generated, every image is loaded on its own.
+        return 0;
+    }
+
+    if (0 != s32Status)
+    {
+        fprintf(stderr, "LoadAtlas(): error in %s, line %d.\n", pacFilename, s32Status);
+        _FreeAtlas();
+        return -1;
+    }
+
+    return _u32AtlasImages;
+}
+
+/**
+ * @brief   Print the resource statistics per type to stdout.
+ * @ingroup Resource
+ */
+void PrintResourceStats()
+{
+    ResourceStats stStats = GetResourceStats();
+
+    printf("\n%-10s %10s %10s %10s %10s\n", "resources", "live", "KiB", "loads", "shared");
+    for (uint8_t u8Type = 0; u8Type < RESOURCE_TYPES; u8Type++)
+    {
+        printf("%-10s %10u %10.1f %10u %10u\n",
+            _pacTypeNames[u8Type],
+            stStats.u32Live[u8Type],
+            stStats.u64Bytes[u8Type] / 1024.0,
+            stStats.u32Loads[u8Type],
+            stStats.u32Shared[u8Type]);
+    }
+}
+
+/**
+ * @brief   Release Music.  It's freed once the last handle is released.
+ * @param   stHandle a handle, may be invalid.  See @ref struct MusicHandle.
+ * @ingroup Resource
+ */
+void ReleaseMusic(const MusicHandle stHandle)
+{
+    _Release(RESOURCE_MUSIC, stHandle.u32Id);
+}
+
+/**
+ * @brief   Release a sound effect.  It's freed once the last handle is
+ *          released.
+ * @param   stHandle a handle, may be invalid.  See @ref struct SfxHandle.
+ * @ingroup Resource
+ */
+void ReleaseSfx(const SfxHandle stHandle)
+{
+    _Release(RESOURCE_SFX, stHandle.u32Id);
+}
+
+/**
+ * @brief   Release a texture.  It's destroyed once the last handle is
+ *          released.
+ * @param   stHandle a handle, may be invalid.  See @ref struct TextureHandle.
+ * @ingroup Resource
+ */
+void ReleaseTexture(const TextureHandle stHandle)
+{
+    _Release(RESOURCE_TEXTURE, stHandle.u32Id);
+}
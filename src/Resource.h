@@ -0,0 +1,108 @@
+/**
+ * @file    Resource.h
+ * @ingroup Resource
+ */
+
+#ifndef _RESOURCE_H_
+#define _RESOURCE_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Audio.h"
+
+/**
+ * @ingroup Resource
+ */
+enum ResourceType
+{
+    RESOURCE_TEXTURE = 0,
+    RESOURCE_SFX     = 1,
+    RESOURCE_MUSIC   = 2,
+    RESOURCE_TYPES   = 3
+};
+
+/**
+ * @ingroup Resource
+ */
+enum ResourceLimits
+{
+    RESOURCE_SLOTS        = 256,
+    RESOURCE_ATLAS_IMAGES = 64
+};
+
+/**
+ * @ingroup Resource
+ * @brief   Handles refer to a slot and the generation it had when the
+ *          resource was loaded, so a handle which has been released
+ *          too often resolves to NULL instead of another resource.  The
+ *          handle types are distinct so they can't be mixed up; a
+ *          zeroed handle is invalid.
+ */
+typedef struct TextureHandle_t
+{
+    uint32_t u32Id;
+} TextureHandle;
+
+/**
+ * @ingroup Resource
+ */
+typedef struct SfxHandle_t
+{
+    uint32_t u32Id;
+} SfxHandle;
+
+/**
+ * @ingroup Resource
+ */
+typedef struct MusicHandle_t
+{
+    uint32_t u32Id;
+} MusicHandle;
+
+/**
+ * @ingroup Resource
+ * @brief   Statistics per resource type.  u32Loads counts the files
+ *          which have actually been loaded, u32Shared the requests
+ *          served by a resource which was already loaded.  Streamed
+ *          music counts as 0 bytes, only mapped PCM caches are
+ *          accounted for.
+ */
+typedef struct ResourceStats_t
+{
+    uint64_t u64Bytes[RESOURCE_TYPES];
+    uint32_t u32Live[RESOURCE_TYPES];
+    uint32_t u32Loads[RESOURCE_TYPES];
+    uint32_t u32Shared[RESOURCE_TYPES];
+} ResourceStats;
+
+TextureHandle AcquireImage(
+    SDL_Renderer *pstRenderer,
+    const char   *pacFilename,
+    SDL_Rect     *pstRect);
+
+MusicHandle AcquireMusic(const char *pacFilename);
+SfxHandle   AcquireSfx(const char *pacFilename);
+
+TextureHandle AcquireTexture(
+    SDL_Renderer *pstRenderer,
+    const char   *pacFilename);
+
+uint8_t FindAtlasImage(
+    const char  *pacFilename,
+    const char **ppacPage,
+    SDL_Rect    *pstRect);
+
+void          FreeResources();
+Music        *GetMusic(const MusicHandle stHandle);
+const char   *GetResourceTypeName(const uint8_t u8Type);
+ResourceStats GetResourceStats();
+Sfx          *GetSfx(const SfxHandle stHandle);
+SDL_Texture  *GetTexture(const TextureHandle stHandle);
+int8_t        InitResources();
+int32_t       LoadAtlas(const char *pacFilename);
+void          PrintResourceStats();
+void          ReleaseMusic(const MusicHandle stHandle);
+void          ReleaseSfx(const SfxHandle stHandle);
+void          ReleaseTexture(const TextureHandle stHandle);
+
+#endif // _RESOURCE_H_
@@ -0,0 +1,435 @@
+/**
+ * @file      SpriteBatch.c
+ * @ingroup   SpriteBatch
+ * @defgroup  SpriteBatch
+ * @brief     Collects the sprites of a frame, sorts them by layer and
+ *            texture and draws all sprites sharing a texture with a
+ *            single SDL_RenderGeometry() call, so the number of draw
+ *            calls depends on the number of textures rather than on
+ *            the number of sprites.  Flipped sprites swap their texture
+ *            coordinates instead of needing a draw call of their own.
+ *            The software renderer blits the sprites one by one instead
+ *            and only redraws those which have changed, along with
+ *            everything beneath them, see MarkChangedSprites().
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Memory.h"
+#include "SpriteBatch.h"
+#include "Video.h"
+
+static uint8_t _IsQuadBefore(const SpriteQuad *pstA, const SpriteQuad *pstB)
+{
+    if (pstA->u8Layer != pstB->u8Layer)
+    {
+        return pstA->u8Layer < pstB->u8Layer;
+    }
+
+    return (uintptr_t)pstA->pstTexture < (uintptr_t)pstB->pstTexture;
+}
+
+static uint8_t _IsSameQuad(const SpriteQuad *pstA, const SpriteQuad *pstB)
+{
+    return (pstA->pstTexture == pstB->pstTexture)          &&
+           (SDL_RectEquals(&pstA->stSrc, &pstB->stSrc))    &&
+           (SDL_RectEquals(&pstA->stDst, &pstB->stDst))    &&
+           (pstA->u8Layer == pstB->u8Layer)                &&
+           (pstA->u8Flip  == pstB->u8Flip);
+}
+
+/* Bottom-up merge sort.  Unlike qsort() it is stable, so sprites of
+ * the same layer and texture keep their order, and it doesn't
+ * allocate, since frames must not. */
+static void _SortQuads(SpriteBatch *pstBatch)
+{
+    SpriteQuad *pstFrom  = pstBatch->pstQuads;
+    SpriteQuad *pstTo    = pstBatch->pstScratch;
+    uint32_t    u32Count = pstBatch->u32Count;
+
+    for (uint32_t u32Width = 1; u32Width < u32Count; u32Width *= 2)
+    {
+        SpriteQuad *pstSwap;
+
+        for (uint32_t u32Begin = 0; u32Begin < u32Count; u32Begin += 2 * u32Width)
+        {
+            uint32_t u32Middle = SDL_min(u32Begin + u32Width, u32Count);
+            uint32_t u32End    = SDL_min(u32Begin + 2 * u32Width, u32Count);
+            uint32_t u32Left   = u32Begin;
+            uint32_t u32Right  = u32Middle;
+
+            for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+            {
+                if ((u32Left < u32Middle) &&
+                    ((u32Right >= u32End) || (0 == _IsQuadBefore(&pstFrom[u32Right], &pstFrom[u32Left]))))
+                {
+                    pstTo[u32Index] = pstFrom[u32Left++];
+                }
+                else
+                {
+                    pstTo[u32Index] = pstFrom[u32Right++];
+                }
+            }
+        }
+
+        pstSwap = pstFrom;
+        pstFrom = pstTo;
+        pstTo   = pstSwap;
+    }
+
+    if (pstFrom != pstBatch->pstQuads)
+    {
+        memcpy(pstBatch->pstQuads, pstFrom, u32Count * sizeof(SpriteQuad));
+    }
+}
+
+/* Draw the sprites u32Begin to u32End - 1 one by one.  Used before SDL
+ * 2.0.18 and by the software renderer, whose draw calls skip sprites
+ * outside the dirty rects. */
+static int8_t _DrawQuads(SpriteBatch *pstBatch, uint32_t u32Begin, uint32_t u32End)
+{
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        const SpriteQuad *pstQuad = &pstBatch->pstQuads[u32Index];
+
+        if (-1 == DrawTexture(
+                pstBatch->pstRenderer,
+                pstQuad->pstTexture,
+                &pstQuad->stSrc,
+                &pstQuad->stDst,
+                pstQuad->u8Flip ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE))
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+static void _SetVertex(SDL_Vertex *pstVertex, float fX, float fY, float fU, float fV)
+{
+    pstVertex->position.x  = fX;
+    pstVertex->position.y  = fY;
+    pstVertex->color.r     = 255;
+    pstVertex->color.g     = 255;
+    pstVertex->color.b     = 255;
+    pstVertex->color.a     = 255;
+    pstVertex->tex_coord.x = fU;
+    pstVertex->tex_coord.y = fV;
+}
+
+/* Draw the sprites u32Begin to u32End - 1, which share a texture.
+ * Indices are relative to the first vertex passed, so the same index
+ * list serves every run. */
+static int8_t _DrawGeometry(SpriteBatch *pstBatch, uint32_t u32Begin, uint32_t u32End)
+{
+    SDL_Texture *pstTexture = pstBatch->pstQuads[u32Begin].pstTexture;
+    SDL_Vertex  *pstVertex  = &pstBatch->pstVertices[u32Begin * 4];
+    int32_t      s32Width;
+    int32_t      s32Height;
+
+    if (0 != SDL_QueryTexture(pstTexture, NULL, NULL, &s32Width, &s32Height))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        const SpriteQuad *pstQuad = &pstBatch->pstQuads[u32Index];
+        float             fLeft   = pstQuad->stDst.x;
+        float             fTop    = pstQuad->stDst.y;
+        float             fRight  = pstQuad->stDst.x + pstQuad->stDst.w;
+        float             fBottom = pstQuad->stDst.y + pstQuad->stDst.h;
+        float             fU0     = (float)pstQuad->stSrc.x / s32Width;
+        float             fV0     = (float)pstQuad->stSrc.y / s32Height;
+        float             fU1     = (float)(pstQuad->stSrc.x + pstQuad->stSrc.w) / s32Width;
+        float             fV1     = (float)(pstQuad->stSrc.y + pstQuad->stSrc.h) / s32Height;
+
+        if (pstQuad->u8Flip)
+        {
+            float fU = fU0;
+
+            fU0 = fU1;
+            fU1 = fU;
+        }
+
+        _SetVertex(&pstVertex[0], fLeft,  fTop,    fU0, fV0);
+        _SetVertex(&pstVertex[1], fRight, fTop,    fU1, fV0);
+        _SetVertex(&pstVertex[2], fLeft,  fBottom, fU0, fV1);
+        _SetVertex(&pstVertex[3], fRight, fBottom, fU1, fV1);
+        pstVertex += 4;
+    }
+
+    if (-1 == DrawGeometry(
+            pstBatch->pstRenderer,
+            pstTexture,
+            &pstBatch->pstVertices[u32Begin * 4],
+            (u32End - u32Begin) * 4,
+            pstBatch->ps32Indices,
+            (u32End - u32Begin) * 6))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+static int8_t _DrawRun(SpriteBatch *pstBatch, uint32_t u32Begin, uint32_t u32End)
+{
+    #if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (NULL == pstBatch->pstPrevious)
+    {
+        return _DrawGeometry(pstBatch, u32Begin, u32End);
+    }
+    #endif
+
+    return _DrawQuads(pstBatch, u32Begin, u32End);
+}
+
+/**
+ * @brief   Add a sprite to SpriteBatch.  If the batch is full, the
+ *          sprites collected so far are drawn first.
+ * @param   pstBatch   the SpriteBatch.  See @ref struct SpriteBatch.
+ * @param   pstTexture the texture.
+ * @param   u8Layer    sprites of lower layers are drawn first.
+ * @param   pstSrc     the source rectangle.
+ * @param   pstDst     the destination rectangle.
+ * @param   u8Flip     boolean value to flip the sprite horizontally.
+ * @return  0 on success, -1 on failure.
+ * @ingroup SpriteBatch
+ */
+int8_t AddSprite(
+    SpriteBatch    *pstBatch,
+    SDL_Texture    *pstTexture,
+    const uint8_t   u8Layer,
+    const SDL_Rect *pstSrc,
+    const SDL_Rect *pstDst,
+    const uint8_t   u8Flip)
+{
+    SpriteQuad *pstQuad;
+
+    if (NULL == pstTexture)
+    {
+        fprintf(stderr, "AddSprite(): texture is NULL.\n");
+        return -1;
+    }
+
+    if (pstBatch->u32Count == pstBatch->u32Capacity)
+    {
+        if (-1 == FlushSpriteBatch(pstBatch))
+        {
+            return -1;
+        }
+    }
+
+    pstQuad             = &pstBatch->pstQuads[pstBatch->u32Count];
+    pstQuad->pstTexture = pstTexture;
+    pstQuad->stSrc      = *pstSrc;
+    pstQuad->stDst      = *pstDst;
+    pstQuad->u8Layer    = u8Layer;
+    pstQuad->u8Flip     = u8Flip;
+
+    if ((pstBatch->u32Count) && (_IsQuadBefore(pstQuad, pstQuad - 1)))
+    {
+        pstBatch->u8IsUnsorted = 1;
+    }
+    pstBatch->u32Count++;
+
+    return 0;
+}
+
+/**
+ * @brief   Draw all sprites added since the last flush and empty
+ *          SpriteBatch.
+ * @param   pstBatch the SpriteBatch.  See @ref struct SpriteBatch.
+ * @return  0 on success, -1 on failure.
+ * @ingroup SpriteBatch
+ */
+int8_t FlushSpriteBatch(SpriteBatch *pstBatch)
+{
+    uint32_t u32Begin = 0;
+    int8_t   s8Status = 0;
+
+    // Sprites usually come in order, e.g. a swarm sharing one texture.
+    if (pstBatch->u8IsUnsorted)
+    {
+        _SortQuads(pstBatch);
+    }
+
+    // Neighbouring layers on the same texture, e.g. an atlas page,
+    // share a draw call; within a run sprites are drawn in order.
+    for (uint32_t u32End = 1; u32End <= pstBatch->u32Count; u32End++)
+    {
+        if ((u32End < pstBatch->u32Count) &&
+            (pstBatch->pstQuads[u32End].pstTexture == pstBatch->pstQuads[u32Begin].pstTexture))
+        {
+            continue;
+        }
+
+        if (-1 == _DrawRun(pstBatch, u32Begin, u32End))
+        {
+            s8Status = -1;
+            break;
+        }
+        u32Begin = u32End;
+    }
+
+    pstBatch->u32Count     = 0;
+    pstBatch->u8IsUnsorted = 0;
+
+    return s8Status;
+}
+
+/**
+ * @brief   Free SpriteBatch from memory.
+ * @param   pstBatch a SpriteBatch, may be NULL.
+ *                   See @ref struct SpriteBatch.
+ * @ingroup SpriteBatch
+ */
+void FreeSpriteBatch(SpriteBatch *pstBatch)
+{
+    if (NULL == pstBatch)
+    {
+        return;
+    }
+
+    FreeMemory(pstBatch->pstQuads);
+    FreeMemory(pstBatch->pstScratch);
+    FreeMemory(pstBatch->pstPrevious);
+    #if SDL_VERSION_ATLEAST(2, 0, 18)
+    FreeMemory(pstBatch->pstVertices);
+    FreeMemory(pstBatch->ps32Indices);
+    #endif
+    FreeMemory(pstBatch);
+}
+
+/**
+ * @brief   Mark where SpriteBatch differs from the last frame as dirty,
+ *          i.e. where sprites have moved, changed their frame, appeared
+ *          or disappeared.  Has to be called once every frame once all
+ *          sprites have been added but before anything is drawn, see
+ *          MarkDirtyRect().  Does nothing unless in software mode.
+ * @param   pstBatch the SpriteBatch.  See @ref struct SpriteBatch.
+ * @ingroup SpriteBatch
+ */
+void MarkChangedSprites(SpriteBatch *pstBatch)
+{
+    uint32_t u32Count = SDL_max(pstBatch->u32Count, pstBatch->u32PreviousCount);
+
+    if (NULL == pstBatch->pstPrevious)
+    {
+        return;
+    }
+
+    // Compared in the order they are drawn in.
+    if (pstBatch->u8IsUnsorted)
+    {
+        _SortQuads(pstBatch);
+        pstBatch->u8IsUnsorted = 0;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        const SpriteQuad *pstNow = u32Index < pstBatch->u32Count         ? &pstBatch->pstQuads[u32Index]    : NULL;
+        const SpriteQuad *pstWas = u32Index < pstBatch->u32PreviousCount ? &pstBatch->pstPrevious[u32Index] : NULL;
+
+        if ((pstNow) && (pstWas) && (_IsSameQuad(pstNow, pstWas)))
+        {
+            continue;
+        }
+
+        if (pstNow)
+        {
+            MarkDirtyRect(&pstNow->stDst);
+        }
+
+        if (pstWas)
+        {
+            MarkDirtyRect(&pstWas->stDst);
+        }
+    }
+
+    memcpy(pstBatch->pstPrevious, pstBatch->pstQuads, pstBatch->u32Count * sizeof(SpriteQuad));
+    pstBatch->u32PreviousCount = pstBatch->u32Count;
+}
+
+/**
+ * @brief   Initialise SpriteBatch.  Nothing is allocated afterwards.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   u32Capacity the number of sprites which can be collected
+ *                      before the batch has to be drawn.
+ * @return  SpriteBatch on success, NULL on failure.
+ *          See @ref struct SpriteBatch.
+ * @ingroup SpriteBatch
+ */
+SpriteBatch *InitSpriteBatch(SDL_Renderer *pstRenderer, const uint32_t u32Capacity)
+{
+    static SpriteBatch *pstBatch;
+
+    pstBatch = CallocMemory(MEMORY_ENTITY, 1, sizeof(struct SpriteBatch_t));
+    if (NULL == pstBatch)
+    {
+        fprintf(stderr, "InitSpriteBatch(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstBatch->pstRenderer = pstRenderer;
+    pstBatch->u32Capacity = u32Capacity ? u32Capacity : 1;
+    pstBatch->pstQuads    = AllocMemory(MEMORY_ENTITY, pstBatch->u32Capacity * sizeof(SpriteQuad));
+    pstBatch->pstScratch  = AllocMemory(MEMORY_ENTITY, pstBatch->u32Capacity * sizeof(SpriteQuad));
+    if ((NULL == pstBatch->pstQuads) || (NULL == pstBatch->pstScratch))
+    {
+        fprintf(stderr, "InitSpriteBatch(): error allocating memory.\n");
+        FreeSpriteBatch(pstBatch);
+        return NULL;
+    }
+
+    // Only the software renderer keeps track of what has changed.
+    if (IsSoftwareVideo())
+    {
+        pstBatch->pstPrevious = AllocMemory(MEMORY_ENTITY, pstBatch->u32Capacity * sizeof(SpriteQuad));
+        if (NULL == pstBatch->pstPrevious)
+        {
+            fprintf(stderr, "InitSpriteBatch(): error allocating memory.\n");
+            FreeSpriteBatch(pstBatch);
+            return NULL;
+        }
+    }
+
+    #if SDL_VERSION_ATLEAST(2, 0, 18)
+    pstBatch->pstVertices = AllocMemory(MEMORY_ENTITY, pstBatch->u32Capacity * 4 * sizeof(SDL_Vertex));
+    pstBatch->ps32Indices = AllocMemory(MEMORY_ENTITY, pstBatch->u32Capacity * 6 * sizeof(int));
+    if ((NULL == pstBatch->pstVertices) || (NULL == pstBatch->ps32Indices))
+    {
+        fprintf(stderr, "InitSpriteBatch(): error allocating memory.\n");
+        FreeSpriteBatch(pstBatch);
+        return NULL;
+    }
+
+    // Two triangles per sprite: top left, top right, bottom left and
+    // bottom right.
+    for (uint32_t u32Index = 0; u32Index < pstBatch->u32Capacity; u32Index++)
+    {
+        int *ps32Index = &pstBatch->ps32Indices[u32Index * 6];
+        int  s32First  = u32Index * 4;
+
+        ps32Index[0] = s32First;
+        ps32Index[1] = s32First + 1;
+        ps32Index[2] = s32First + 2;
+        ps32Index[3] = s32First + 2;
+        ps32Index[4] = s32First + 1;
+        ps32Index[5] = s32First + 3;
+    }
+    #endif
+
+    return pstBatch;
+}
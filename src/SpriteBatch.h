@@ -0,0 +1,63 @@
+/**
+ * @file    SpriteBatch.h
+ * @ingroup SpriteBatch
+ */
+
+#ifndef _SPRITE_BATCH_H_
+#define _SPRITE_BATCH_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup SpriteBatch
+ * @brief   A sprite waiting to be drawn.
+ */
+typedef struct SpriteQuad_t
+{
+    SDL_Texture *pstTexture;
+    SDL_Rect     stSrc;
+    SDL_Rect     stDst;
+    uint8_t      u8Layer;
+    uint8_t      u8Flip;
+} SpriteQuad;
+
+/**
+ * @ingroup SpriteBatch
+ * @brief   Sprites collected for one frame.  pstScratch is used for
+ *          sorting, which is skipped unless u8IsUnsorted is set.
+ *          pstVertices holds four and ps32Indices six entries per
+ *          sprite; both are missing before SDL 2.0.18, which draws the
+ *          sprites one by one.  So does the software renderer, for
+ *          which pstPrevious holds the sprites of the last frame.
+ */
+typedef struct SpriteBatch_t
+{
+    SDL_Renderer *pstRenderer;
+    SpriteQuad   *pstQuads;
+    SpriteQuad   *pstScratch;
+    SpriteQuad   *pstPrevious;
+    #if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex   *pstVertices;
+    int          *ps32Indices;
+    #endif
+    uint32_t      u32Capacity;
+    uint32_t      u32Count;
+    uint32_t      u32PreviousCount;
+    uint8_t       u8IsUnsorted;
+} SpriteBatch;
+
+int8_t AddSprite(
+    SpriteBatch    *pstBatch,
+    SDL_Texture    *pstTexture,
+    const uint8_t   u8Layer,
+    const SDL_Rect *pstSrc,
+    const SDL_Rect *pstDst,
+    const uint8_t   u8Flip);
+
+int8_t       FlushSpriteBatch(SpriteBatch *pstBatch);
+void         FreeSpriteBatch(SpriteBatch *pstBatch);
+SpriteBatch *InitSpriteBatch(SDL_Renderer *pstRenderer, const uint32_t u32Capacity);
+void         MarkChangedSprites(SpriteBatch *pstBatch);
+
+#endif // _SPRITE_BATCH_H_
@@ -0,0 +1,362 @@
+/**
+ * @file      Swarm.c
+ * @ingroup   Swarm
+ * @defgroup  Swarm
+ * @brief     A swarm of scripted entities for stress testing.  Every
+ *            entity gets random input and goes through the same steps
+ *            as the player: sprite animation, UpdateEntity(), the
+ *            floor check and drawing through a SpriteBatch.  The steps
+ *            are run stage by stage over all entities so that each one
+ *            can be timed; every stage but the input is split into
+ *            jobs.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Entity.h"
+#include "Job.h"
+#include "Macros.h"
+#include "Map.h"
+#include "Memory.h"
+#include "Resource.h"
+#include "Swarm.h"
+
+// The minimum number of entities per job.
+#define SWARM_GRAIN 64
+
+/* What the jobs of UpdateSwarm() work on. */
+typedef struct SwarmStep_t
+{
+    Swarm     *pstSwarm;
+    const Map *pstMap;
+    double     dDeltaTime;
+} SwarmStep;
+
+static const char *_pacStageNames[SWARM_STAGES] = {
+    "input",
+    "animation",
+    "update",
+    "collision",
+    "draw"
+};
+
+static uint32_t _Random(Swarm *pstSwarm)
+{
+    pstSwarm->u32Seed = pstSwarm->u32Seed * 1103515245 + 12345;
+    return pstSwarm->u32Seed >> 8;
+}
+
+static void _ApplyInput(Swarm *pstSwarm, const Map *pstMap)
+{
+    for (uint32_t u32Index = 0; u32Index < pstSwarm->u32Count; u32Index++)
+    {
+        Entity *pstEntity = &pstSwarm->pstEntities[u32Index];
+
+        // The map might have been swapped.
+        pstEntity->u32MapWidth  = pstMap->u32Width;
+        pstEntity->u32MapHeight = pstMap->u32Height;
+
+        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_DEAD))
+        {
+            ResurrectEntity(pstEntity);
+        }
+
+        // Change what to do about twice a second at 60 FPS.
+        if (0 == _Random(pstSwarm) % 32)
+        {
+            pstSwarm->pu8Action[u32Index] = _Random(pstSwarm) % 4;
+        }
+
+        FLAG_CLEAR(pstEntity->u16Flags, ENTITY_IS_TRAVELING);
+
+        switch (pstSwarm->pu8Action[u32Index])
+        {
+            case SWARM_LEFT:
+                FLAG_SET(pstEntity->u16Flags, ENTITY_IS_TRAVELING);
+                FLAG_SET(pstEntity->u16Flags, ENTITY_DIRECTION);
+                break;
+            case SWARM_RIGHT:
+                FLAG_SET(pstEntity->u16Flags,   ENTITY_IS_TRAVELING);
+                FLAG_CLEAR(pstEntity->u16Flags, ENTITY_DIRECTION);
+                break;
+            case SWARM_JUMP:
+                if ((FLAG_IS_NOT_SET(pstEntity->u16Flags, ENTITY_IS_JUMPING)) &&
+                    (FLAG_IS_NOT_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR)))
+                {
+                    FLAG_SET(pstEntity->u16Flags, ENTITY_IS_JUMPING);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void _SetAnimations(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    SwarmStep *pstStep = (SwarmStep *)pData;
+
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        Entity *pstEntity = &pstStep->pstSwarm->pstEntities[u32Index];
+
+        SetEntitySpriteAnimation(pstEntity, 0, 11, 0, 10);
+
+        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_TRAVELING))
+        {
+            SetEntitySpriteAnimation(pstEntity, 0, 7, 1, 20);
+        }
+
+        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR))
+        {
+            if (IsEntityJumping(pstEntity))
+            {
+                SetEntitySpriteAnimation(pstEntity, 14, 14, 0, 20);
+            }
+            else
+            {
+                SetEntitySpriteAnimation(pstEntity, 14, 14, 1, 20);
+            }
+        }
+    }
+}
+
+static void _CheckFloor(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    SwarmStep *pstStep = (SwarmStep *)pData;
+
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        Entity *pstEntity = &pstStep->pstSwarm->pstEntities[u32Index];
+
+        if (IsMapCoordOfType(
+                pstStep->pstMap,
+                "Floor",
+                pstEntity->dWorldPosX + (pstEntity->u8Width / 1.5),
+                pstEntity->dWorldPosY + pstEntity->u8Height))
+        {
+            FLAG_CLEAR(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR);
+        }
+        else
+        {
+            FLAG_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR);
+        }
+    }
+}
+
+static void _UpdateEntities(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    SwarmStep *pstStep = (SwarmStep *)pData;
+
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        UpdateEntity(&pstStep->pstSwarm->pstEntities[u32Index], pstStep->dDeltaTime);
+    }
+}
+
+/**
+ * @brief   Copy what is needed to draw the entities of a Swarm.
+ * @param   pstSwarm   the Swarm.  See @ref struct Swarm.
+ * @param   pstSprites u32Count copies.  See @ref struct EntitySprite.
+ * @ingroup Swarm
+ */
+void CopySwarmSprites(const Swarm *pstSwarm, EntitySprite *pstSprites)
+{
+    for (uint32_t u32Index = 0; u32Index < pstSwarm->u32Count; u32Index++)
+    {
+        CopyEntitySprite(&pstSwarm->pstEntities[u32Index], &pstSprites[u32Index]);
+    }
+}
+
+/**
+ * @brief   Add all entities of a Swarm to a SpriteBatch, from copies
+ *          made with CopySwarmSprites().  They are drawn on the next
+ *          FlushSpriteBatch().
+ * @param   pstBatch    the SpriteBatch.  See @ref struct SpriteBatch.
+ * @param   pstSwarm    the Swarm.  See @ref struct Swarm.
+ * @param   pstSprites  the copies.  See @ref struct EntitySprite.
+ * @param   dCameraPosX camera position along the x-axis.
+ * @param   dCameraPosY camera position along the y-axis.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Swarm
+ */
+int8_t DrawSwarm(
+    SpriteBatch        *pstBatch,
+    Swarm              *pstSwarm,
+    const EntitySprite *pstSprites,
+    const double        dCameraPosX,
+    const double        dCameraPosY)
+{
+    uint64_t u64Start = SDL_GetPerformanceCounter();
+    int8_t   s8Status = 0;
+
+    for (uint32_t u32Index = 0; u32Index < pstSwarm->u32Count; u32Index++)
+    {
+        if (-1 == BatchEntitySprite(
+                pstBatch,
+                &pstSprites[u32Index],
+                0,
+                dCameraPosX,
+                dCameraPosY))
+        {
+            s8Status = -1;
+            break;
+        }
+    }
+
+    pstSwarm->u64Ticks[SWARM_DRAW] += SDL_GetPerformanceCounter() - u64Start;
+    pstSwarm->u64Draws++;
+
+    return s8Status;
+}
+
+/**
+ * @brief   Free Swarm and release the shared sprite.
+ * @param   pstSwarm the Swarm.  See @ref struct Swarm.
+ * @ingroup Swarm
+ */
+void FreeSwarm(Swarm *pstSwarm)
+{
+    if (NULL == pstSwarm)
+    {
+        return;
+    }
+
+    ReleaseTexture(pstSwarm->stSprite);
+    FreeMemory(pstSwarm->pstEntities);
+    FreeMemory(pstSwarm->pu8Action);
+    FreeMemory(pstSwarm);
+}
+
+/**
+ * @brief   Get the name of a stage.
+ * @param   u8Stage the stage.  See @ref enum SwarmStage.
+ * @return  the name.
+ * @ingroup Swarm
+ */
+const char *GetSwarmStageName(const uint8_t u8Stage)
+{
+    if (u8Stage >= SWARM_STAGES)
+    {
+        return "";
+    }
+
+    return _pacStageNames[u8Stage];
+}
+
+/**
+ * @brief   Initialise Swarm.  The entities are spread randomly across
+ *          the upper half of the map and share one sprite, which is
+ *          also shared with other entities using the same image.
+ * @param   u32Count          the number of entities.
+ * @param   pstMap            the Map.  See @ref struct Map.
+ * @param   pstRenderer       a SDL rendering context.  See @ref struct Video.
+ * @param   pacSpriteFilename the filename of the sprite image, e.g. the
+ *                            player's, or NULL to draw nothing.
+ * @return  a Swarm on success, NULL on failure.
+ * @ingroup Swarm
+ */
+Swarm *InitSwarm(
+    const uint32_t  u32Count,
+    const Map      *pstMap,
+    SDL_Renderer   *pstRenderer,
+    const char     *pacSpriteFilename)
+{
+    Entity       *pstTemplate;
+    static Swarm *pstSwarm;
+
+    pstSwarm = CallocMemory(MEMORY_ENTITY, 1, sizeof(struct Swarm_t));
+    if (NULL == pstSwarm)
+    {
+        fprintf(stderr, "InitSwarm(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstSwarm->pstEntities = AllocMemory(MEMORY_ENTITY, u32Count * sizeof(struct Entity_t));
+    pstSwarm->pu8Action   = CallocMemory(MEMORY_ENTITY, u32Count, sizeof(uint8_t));
+    pstTemplate           = InitEntity(24, 40, 0, 0, pstMap->u32Width, pstMap->u32Height);
+
+    if ((NULL == pstSwarm->pstEntities) || (NULL == pstSwarm->pu8Action) || (NULL == pstTemplate))
+    {
+        fprintf(stderr, "InitSwarm(): error allocating memory.\n");
+        FreeMemory(pstTemplate);
+        FreeSwarm(pstSwarm);
+        return NULL;
+    }
+
+    if ((pacSpriteFilename) && (-1 == LoadEntitySprite(pstTemplate, pstRenderer, pacSpriteFilename)))
+    {
+        FreeEntity(pstTemplate);
+        FreeSwarm(pstSwarm);
+        return NULL;
+    }
+
+    // The entities are copies of the template and share its handle.
+    pstSwarm->u32Count = u32Count;
+    pstSwarm->u32Seed  = 1;
+    pstSwarm->stSprite = pstTemplate->stSprite;
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        Entity *pstEntity = &pstSwarm->pstEntities[u32Index];
+
+        *pstEntity                   = *pstTemplate;
+        pstEntity->dWorldPosX        = _Random(pstSwarm) % (pstMap->u32Width - pstEntity->u8Width);
+        pstEntity->dWorldPosY        = _Random(pstSwarm) % (pstMap->u32Height / 2);
+        pstEntity->dInitialWorldPosX = pstEntity->dWorldPosX;
+        pstEntity->dInitialWorldPosY = pstEntity->dWorldPosY;
+    }
+    FreeMemory(pstTemplate);
+
+    return pstSwarm;
+}
+
+/**
+ * @brief   Update Swarm.  This function has to be called every frame.
+ *          The input is applied in order, since every entity draws from
+ *          the same random numbers; the other stages are spread across
+ *          the workers of a JobSystem.  The result doesn't depend on
+ *          the number of workers.
+ * @param   pstSwarm   the Swarm.  See @ref struct Swarm.
+ * @param   pstMap     the Map.  See @ref struct Map.
+ * @param   pstJobs    a JobSystem, NULL to update everything on the
+ *                     calling thread.  See @ref struct JobSystem.
+ * @param   dDeltaTime time since last frame in seconds.
+ * @ingroup Swarm
+ */
+void UpdateSwarm(
+    Swarm        *pstSwarm,
+    const Map    *pstMap,
+    JobSystem    *pstJobs,
+    const double  dDeltaTime)
+{
+    uint64_t  u64Time[SWARM_STAGES];
+    SwarmStep stStep;
+
+    stStep.pstSwarm   = pstSwarm;
+    stStep.pstMap     = pstMap;
+    stStep.dDeltaTime = dDeltaTime;
+
+    u64Time[SWARM_INPUT] = SDL_GetPerformanceCounter();
+    _ApplyInput(pstSwarm, pstMap);
+
+    u64Time[SWARM_ANIMATION] = SDL_GetPerformanceCounter();
+    ParallelFor(pstJobs, pstSwarm->u32Count, SWARM_GRAIN, _SetAnimations, &stStep);
+
+    u64Time[SWARM_UPDATE] = SDL_GetPerformanceCounter();
+    ParallelFor(pstJobs, pstSwarm->u32Count, SWARM_GRAIN, _UpdateEntities, &stStep);
+
+    u64Time[SWARM_COLLISION] = SDL_GetPerformanceCounter();
+    ParallelFor(pstJobs, pstSwarm->u32Count, SWARM_GRAIN, _CheckFloor, &stStep);
+
+    u64Time[SWARM_DRAW] = SDL_GetPerformanceCounter();
+    for (uint8_t u8Stage = SWARM_INPUT; u8Stage < SWARM_DRAW; u8Stage++)
+    {
+        pstSwarm->u64Ticks[u8Stage] += u64Time[u8Stage + 1] - u64Time[u8Stage];
+    }
+    pstSwarm->u64Frames++;
+}
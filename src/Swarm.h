@@ -0,0 +1,82 @@
+/**
+ * @file    Swarm.h
+ * @ingroup Swarm
+ */
+
+#ifndef _SWARM_H_
+#define _SWARM_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Entity.h"
+#include "Job.h"
+#include "Map.h"
+#include "SpriteBatch.h"
+
+/**
+ * @ingroup Swarm
+ */
+enum SwarmStage
+{
+    SWARM_INPUT     = 0,
+    SWARM_ANIMATION = 1,
+    SWARM_UPDATE    = 2,
+    SWARM_COLLISION = 3,
+    SWARM_DRAW      = 4,
+    SWARM_STAGES    = 5
+};
+
+/**
+ * @ingroup Swarm
+ */
+enum SwarmAction
+{
+    SWARM_IDLE  = 0,
+    SWARM_LEFT  = 1,
+    SWARM_RIGHT = 2,
+    SWARM_JUMP  = 3
+};
+
+/**
+ * @ingroup Swarm
+ * @brief   Scripted entities which are handled like the player, to
+ *          measure how the entity code scales.  u64Ticks holds the
+ *          accumulated time per stage in performance counter ticks.
+ */
+typedef struct Swarm_t
+{
+    Entity        *pstEntities;
+    uint8_t       *pu8Action;
+    TextureHandle  stSprite;
+    uint32_t       u32Count;
+    uint32_t       u32Seed;
+    uint64_t       u64Ticks[SWARM_STAGES];
+    uint64_t       u64Frames;
+    uint64_t       u64Draws;
+} Swarm;
+
+void CopySwarmSprites(const Swarm *pstSwarm, EntitySprite *pstSprites);
+
+int8_t DrawSwarm(
+    SpriteBatch        *pstBatch,
+    Swarm              *pstSwarm,
+    const EntitySprite *pstSprites,
+    const double        dCameraPosX,
+    const double        dCameraPosY);
+
+void        FreeSwarm(Swarm *pstSwarm);
+const char *GetSwarmStageName(const uint8_t u8Stage);
+
+Swarm *InitSwarm(
+    const uint32_t  u32Count,
+    const Map      *pstMap,
+    SDL_Renderer   *pstRenderer,
+    const char     *pacSpriteFilename);
+
+void UpdateSwarm(
+    Swarm        *pstSwarm,
+    const Map    *pstMap,
+    JobSystem    *pstJobs,
+    const double  dDeltaTime);
+
+#endif // _SWARM_H_
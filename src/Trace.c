@@ -0,0 +1,279 @@
+/**
+ * @file      Trace.c
+ * @ingroup   Trace
+ * @defgroup  Trace
+ * @brief     Trace recorder.  Begin and end events of named zones are
+ *            recorded into a buffer per thread and written as Chrome
+ *            trace event JSON on exit, to be opened in Perfetto or
+ *            chrome://tracing.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Memory.h"
+#include "Trace.h"
+#include "tmx/tmx.h"
+
+/* Remark: pacName has to stay valid until the trace has been written,
+ * e.g. a string literal. */
+typedef struct TraceEvent_t
+{
+    const char *pacName;
+    uint64_t    u64Time;
+    char        cPhase;
+} TraceEvent;
+
+/* Every buffer is only ever written by the thread which owns it, so no
+ * locking is required.  They are read after all threads are joined. */
+typedef struct TraceBuffer_t
+{
+    char         acName[TRACE_NAME_LENGTH];
+    uint32_t     u32Count;
+    uint32_t     u32Dropped;
+    TraceEvent   astEvents[TRACE_MAX_EVENTS];
+} TraceBuffer;
+
+static uint8_t       _u8Enabled;
+static char         *_pacFilename;
+static uint64_t      _u64Start;
+static SDL_TLSID     _stTls;
+static SDL_atomic_t  _stSlot;
+static TraceBuffer  *_pstBuffers[TRACE_MAX_THREADS];
+static uint8_t       _u8Overflow;
+
+static TraceBuffer *_GetBuffer()
+{
+    TraceBuffer *pstBuffer = SDL_TLSGet(_stTls);
+    int32_t      s32Slot;
+
+    if (pstBuffer)
+    {
+        return (void *)pstBuffer == (void *)&_u8Overflow ? NULL : pstBuffer;
+    }
+
+    // First event on this thread: claim a slot.
+    s32Slot = SDL_AtomicAdd(&_stSlot, 1);
+    if (s32Slot < TRACE_MAX_THREADS)
+    {
+        pstBuffer = AllocMemory(MEMORY_ENGINE, sizeof(struct TraceBuffer_t));
+    }
+
+    if (NULL == pstBuffer)
+    {
+        SDL_TLSSet(_stTls, &_u8Overflow, NULL);
+        return NULL;
+    }
+
+    // Threads which weren't named by TraceThread().
+    snprintf(pstBuffer->acName, sizeof(pstBuffer->acName), "Thread %d", s32Slot);
+    pstBuffer->u32Count   = 0;
+    pstBuffer->u32Dropped = 0;
+    _pstBuffers[s32Slot]  = pstBuffer;
+    SDL_TLSSet(_stTls, pstBuffer, NULL);
+
+    return pstBuffer;
+}
+
+static void _Record(const char *pacName, char cPhase)
+{
+    TraceBuffer *pstBuffer;
+
+    if (0 == _u8Enabled)
+    {
+        return;
+    }
+
+    pstBuffer = _GetBuffer();
+    if (NULL == pstBuffer)
+    {
+        return;
+    }
+
+    if (pstBuffer->u32Count >= TRACE_MAX_EVENTS)
+    {
+        pstBuffer->u32Dropped++;
+        return;
+    }
+
+    pstBuffer->astEvents[pstBuffer->u32Count].pacName = pacName;
+    pstBuffer->astEvents[pstBuffer->u32Count].u64Time = SDL_GetPerformanceCounter();
+    pstBuffer->astEvents[pstBuffer->u32Count].cPhase  = cPhase;
+    pstBuffer->u32Count++;
+}
+
+static int8_t _WriteTrace()
+{
+    FILE    *pstFile    = fopen(_pacFilename, "w");
+    double   dFrequency = SDL_GetPerformanceFrequency();
+    uint8_t  u8First    = 1;
+    int32_t  s32Slots   = SDL_AtomicGet(&_stSlot);
+
+    if (NULL == pstFile)
+    {
+        fprintf(stderr, "Couldn't write trace: %s\n", _pacFilename);
+        return -1;
+    }
+
+    if (s32Slots > TRACE_MAX_THREADS)
+    {
+        fprintf(stderr, "Trace: %d threads not traced, limit is %d.\n",
+            s32Slots - TRACE_MAX_THREADS, TRACE_MAX_THREADS);
+        s32Slots = TRACE_MAX_THREADS;
+    }
+
+    fprintf(pstFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (int32_t s32Slot = 0; s32Slot < s32Slots; s32Slot++)
+    {
+        TraceBuffer *pstBuffer = _pstBuffers[s32Slot];
+
+        if (NULL == pstBuffer)
+        {
+            continue;
+        }
+
+        fprintf(pstFile,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            u8First ? "" : ",\n",
+            s32Slot,
+            pstBuffer->acName);
+        u8First = 0;
+
+        for (uint32_t u32Index = 0; u32Index < pstBuffer->u32Count; u32Index++)
+        {
+            TraceEvent *pstEvent = &pstBuffer->astEvents[u32Index];
+
+            fprintf(pstFile,
+                ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                pstEvent->pacName,
+                pstEvent->cPhase,
+                (pstEvent->u64Time - _u64Start) * 1000000.0 / dFrequency,
+                s32Slot);
+        }
+
+        if (pstBuffer->u32Dropped)
+        {
+            fprintf(stderr, "Trace: %u events dropped on thread %d.\n",
+                pstBuffer->u32Dropped, s32Slot);
+        }
+    }
+
+    fprintf(pstFile, "\n]}\n");
+    fclose(pstFile);
+
+    return 0;
+}
+
+/**
+ * @brief   Write the recorded trace and free all trace buffers.  All
+ *          threads which recorded events must have been joined.
+ * @ingroup Trace
+ */
+void FreeTrace()
+{
+    if (0 == _u8Enabled)
+    {
+        return;
+    }
+
+    _u8Enabled           = 0;
+    tmx_trace_begin_func = NULL;
+    tmx_trace_end_func   = NULL;
+
+    _WriteTrace();
+
+    for (uint8_t u8Slot = 0; u8Slot < TRACE_MAX_THREADS; u8Slot++)
+    {
+        FreeMemory(_pstBuffers[u8Slot]);
+        _pstBuffers[u8Slot] = NULL;
+    }
+    FreeMemory(_pacFilename);
+    _pacFilename = NULL;
+}
+
+/**
+ * @brief   Start recording a trace.  Until then, all trace events are
+ *          ignored.
+ * @param   pacFilename the filename of the JSON file to write on exit.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Trace
+ */
+int8_t InitTrace(const char *pacFilename)
+{
+    _pacFilename = AllocMemory(MEMORY_ENGINE, strlen(pacFilename) + 1);
+    if (NULL == _pacFilename)
+    {
+        fprintf(stderr, "InitTrace(): error allocating memory.\n");
+        return -1;
+    }
+    memcpy(_pacFilename, pacFilename, strlen(pacFilename) + 1);
+
+    _stTls = SDL_TLSCreate();
+    if (0 == _stTls)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        FreeMemory(_pacFilename);
+        _pacFilename = NULL;
+        return -1;
+    }
+
+    SDL_AtomicSet(&_stSlot, 0);
+    _u64Start            = SDL_GetPerformanceCounter();
+    tmx_trace_begin_func = TraceBegin;
+    tmx_trace_end_func   = TraceEnd;
+    _u8Enabled           = 1;
+
+    TraceThread("Main");
+
+    return 0;
+}
+
+/**
+ * @brief   Record the beginning of a zone on the calling thread.
+ * @param   pacName the name of the zone, e.g. a string literal.
+ * @ingroup Trace
+ */
+void TraceBegin(const char *pacName)
+{
+    _Record(pacName, 'B');
+}
+
+/**
+ * @brief   Record the end of a zone on the calling thread.
+ * @param   pacName the name of the zone, e.g. a string literal.
+ * @ingroup Trace
+ */
+void TraceEnd(const char *pacName)
+{
+    _Record(pacName, 'E');
+}
+
+/**
+ * @brief   Name the calling thread in the trace.  Also claims its
+ *          buffer, so call it when the thread starts rather than having
+ *          the first event allocate it in the middle of a frame.
+ * @param   pacName the name of the thread, cut off after
+ *          TRACE_NAME_LENGTH - 1 characters.
+ * @ingroup Trace
+ */
+void TraceThread(const char *pacName)
+{
+    TraceBuffer *pstBuffer;
+
+    if (0 == _u8Enabled)
+    {
+        return;
+    }
+
+    pstBuffer = _GetBuffer();
+    if (pstBuffer)
+    {
+        snprintf(pstBuffer->acName, sizeof(pstBuffer->acName), "%s", pacName);
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ * @file    Trace.h
+ * @ingroup Trace
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include "Job.h"
+
+/**
+ * @ingroup Trace
+ * @brief   Every job worker plus the main, simulation and level loader
+ *          threads.
+ */
+enum TraceLimits
+{
+    TRACE_MAX_THREADS = JOB_WORKERS_MAX + 3,
+    TRACE_MAX_EVENTS  = 262144,
+    TRACE_NAME_LENGTH = 24
+};
+
+#define TRACE_BEGIN(name)  TraceBegin(name)
+#define TRACE_END(name)    TraceEnd(name)
+#define TRACE_THREAD(name) TraceThread(name)
+
+void   FreeTrace();
+int8_t InitTrace(const char *pacFilename);
+void   TraceBegin(const char *pacName);
+void   TraceEnd(const char *pacName);
+void   TraceThread(const char *pacName);
+
+#endif // _TRACE_H_
@@ -0,0 +1,133 @@
+/**
+ * @file      TripleBuffer.c
+ * @ingroup   TripleBuffer
+ * @defgroup  TripleBuffer
+ * @brief     Lock-free triple buffer to hand the latest state from one
+ *            thread to another.  The writer fills its back buffer and
+ *            swaps it with the middle one; the reader swaps the middle
+ *            buffer with its front buffer whenever a new one has been
+ *            published.  Neither side ever waits, and the reader always
+ *            gets the most recent complete buffer.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "Memory.h"
+#include "TripleBuffer.h"
+
+// Set in stMiddle when the middle buffer hasn't been read yet.
+#define TRIPLE_BUFFER_NEW 4
+
+/**
+ * @brief   Free TripleBuffer from memory.  The buffers are owned by
+ *          the caller.
+ * @param   pstTripleBuffer a TripleBuffer, may be NULL.
+ *                          See @ref struct TripleBuffer.
+ * @ingroup TripleBuffer
+ */
+void FreeTripleBuffer(TripleBuffer *pstTripleBuffer)
+{
+    FreeMemory(pstTripleBuffer);
+}
+
+/**
+ * @brief   Get the most recently published buffer.  Must only be
+ *          called by the reader.  The buffer stays valid until the
+ *          next call.
+ * @param   pstTripleBuffer a TripleBuffer.  See @ref struct TripleBuffer.
+ * @param   pu8IsNew        set to 1 if the buffer hasn't been returned
+ *                          before, to 0 otherwise.  May be NULL.
+ * @return  the buffer, NULL if nothing has been published yet.
+ * @ingroup TripleBuffer
+ */
+void *GetReadBuffer(TripleBuffer *pstTripleBuffer, uint8_t *pu8IsNew)
+{
+    uint8_t u8IsNew = 0;
+
+    if (SDL_AtomicGet(&pstTripleBuffer->stMiddle) & TRIPLE_BUFFER_NEW)
+    {
+        // The writer may reuse the front buffer from now on.
+        SDL_MemoryBarrierRelease();
+        pstTripleBuffer->u8Front = SDL_AtomicSet(
+            &pstTripleBuffer->stMiddle,
+            pstTripleBuffer->u8Front) & ~TRIPLE_BUFFER_NEW;
+        SDL_MemoryBarrierAcquire();
+
+        pstTripleBuffer->u8HasFront = 1;
+        u8IsNew                     = 1;
+    }
+
+    if (pu8IsNew)
+    {
+        *pu8IsNew = u8IsNew;
+    }
+
+    if (0 == pstTripleBuffer->u8HasFront)
+    {
+        return NULL;
+    }
+
+    return pstTripleBuffer->pBuffers[pstTripleBuffer->u8Front];
+}
+
+/**
+ * @brief   Get the buffer to fill.  Must only be called by the writer.
+ * @param   pstTripleBuffer a TripleBuffer.  See @ref struct TripleBuffer.
+ * @return  the buffer.  It may hold any of the previously published
+ *          states, so everything in it has to be written.
+ * @ingroup TripleBuffer
+ */
+void *GetWriteBuffer(TripleBuffer *pstTripleBuffer)
+{
+    return pstTripleBuffer->pBuffers[pstTripleBuffer->u8Back];
+}
+
+/**
+ * @brief   Initialise TripleBuffer.
+ * @param   pBuffer0 the first buffer.
+ * @param   pBuffer1 the second buffer.
+ * @param   pBuffer2 the third buffer.
+ * @return  a TripleBuffer on success, NULL on failure.
+ *          See @ref struct TripleBuffer.
+ * @ingroup TripleBuffer
+ */
+TripleBuffer *InitTripleBuffer(void *pBuffer0, void *pBuffer1, void *pBuffer2)
+{
+    static TripleBuffer *pstTripleBuffer;
+    pstTripleBuffer = AllocMemory(MEMORY_ENGINE, sizeof(struct TripleBuffer_t));
+    if (NULL == pstTripleBuffer)
+    {
+        fprintf(stderr, "InitTripleBuffer(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstTripleBuffer->pBuffers[0] = pBuffer0;
+    pstTripleBuffer->pBuffers[1] = pBuffer1;
+    pstTripleBuffer->pBuffers[2] = pBuffer2;
+    pstTripleBuffer->u8Front     = 0;
+    pstTripleBuffer->u8Back      = 1;
+    pstTripleBuffer->u8HasFront  = 0;
+    SDL_AtomicSet(&pstTripleBuffer->stMiddle, 2);
+
+    return pstTripleBuffer;
+}
+
+/**
+ * @brief   Publish the buffer returned by GetWriteBuffer().  Must only
+ *          be called by the writer.  A buffer which has been published
+ *          but not read yet is overwritten by the next one.
+ * @param   pstTripleBuffer a TripleBuffer.  See @ref struct TripleBuffer.
+ * @ingroup TripleBuffer
+ */
+void PublishWriteBuffer(TripleBuffer *pstTripleBuffer)
+{
+    // The contents have to be visible before the index is.
+    SDL_MemoryBarrierRelease();
+    pstTripleBuffer->u8Back = SDL_AtomicSet(
+        &pstTripleBuffer->stMiddle,
+        pstTripleBuffer->u8Back | TRIPLE_BUFFER_NEW) & ~TRIPLE_BUFFER_NEW;
+    SDL_MemoryBarrierAcquire();
+}
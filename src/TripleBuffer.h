@@ -0,0 +1,34 @@
+/**
+ * @file    TripleBuffer.h
+ * @ingroup TripleBuffer
+ */
+
+#ifndef _TRIPLE_BUFFER_H_
+#define _TRIPLE_BUFFER_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup TripleBuffer
+ * @brief   Three buffers passed between one writer and one reader
+ *          without locking.  The writer owns u8Back, the reader
+ *          u8Front; stMiddle holds the index of the third buffer and
+ *          whether it has been published since the reader last looked.
+ */
+typedef struct TripleBuffer_t
+{
+    void         *pBuffers[3];
+    SDL_atomic_t  stMiddle;
+    uint8_t       u8Back;
+    uint8_t       u8Front;
+    uint8_t       u8HasFront;
+} TripleBuffer;
+
+void          FreeTripleBuffer(TripleBuffer *pstTripleBuffer);
+void         *GetReadBuffer(TripleBuffer *pstTripleBuffer, uint8_t *pu8IsNew);
+void         *GetWriteBuffer(TripleBuffer *pstTripleBuffer);
+TripleBuffer *InitTripleBuffer(void *pBuffer0, void *pBuffer1, void *pBuffer2);
+void          PublishWriteBuffer(TripleBuffer *pstTripleBuffer);
+
+#endif // _TRIPLE_BUFFER_H_
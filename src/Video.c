@@ -2,24 +2,847 @@
  * @file      Video.c
  * @ingroup   Video
  * @defgroup  Video
- * @brief     Video subsystem.
+ * @brief     Video subsystem.  Falls back to software rendering if
+ *            there is no accelerated renderer.  Textures are then blitted
+ *            straight into a frame at the logical resolution, which is
+ *            scaled up to the window surface on present.  Only what has
+ *            changed since the last frame is redrawn and presented, see
+ *            MarkDirtyRect().  The blits are recorded and run in
+ *            horizontal bands spread over the job system, so the fill
+ *            rate scales with the number of cores.  With an accelerated
+ *            renderer, the scene can be drawn into a texture at native
+ *            resolution instead, which is scaled up once on present.
  * @author    Michael Fitzmayer
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
 
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "Blit.h"
+#include "Memory.h"
 #include "Video.h"
 
+static uint8_t       _u8Headless;
+static uint32_t      _u32DrawCalls;
+static VideoStats    _stStats;
+static SDL_Window   *_pstSoftwareWindow;
+static SDL_Surface  *_pstWindowSurface;
+static SDL_Surface  *_pstFrame;
+static Pixels        _stFrame;
+static SDL_Texture  *_pstTarget;
+static Pixels        _stTarget;
+static int32_t      *_ps32Columns;
+static SDL_Texture  *_pstScene;
+static double        _dZoomLevelMin = VIDEO_MIN_ZOOMLEVEL;
+static JobSystem    *_pstJobs;
+static VideoCommand *_pstCommands;
+static uint32_t      _u32Commands;
+static SDL_Rect      _stWindowRects[VIDEO_DIRTY_RECTS];
+static uint8_t       _u8WindowRects;
+static SDL_Rect      _stScreen;
+static SDL_Color     _stClearColour;
+static SDL_Rect      _stDirty[VIDEO_DIRTY_RECTS];
+static uint8_t       _u8DirtyRects;
+static uint8_t       _u8IsAllDirty = 1;
+static int32_t       _s32Clip      = -1;
+
+/* Whether draw calls have to be clipped to the dirty rects, i.e. they
+ * go to the frame in software mode and not everything is redrawn. */
+static uint8_t _IsClipped(SDL_Renderer *pstRenderer)
+{
+    if ((NULL == _pstSoftwareWindow) || (_u8IsAllDirty))
+    {
+        return 0;
+    }
+
+    return NULL == SDL_GetRenderTarget(pstRenderer);
+}
+
+static void _SetClip(SDL_Renderer *pstRenderer, const int32_t s32Clip)
+{
+    if (_s32Clip == s32Clip)
+    {
+        return;
+    }
+
+    SDL_RenderSetClipRect(pstRenderer, -1 == s32Clip ? NULL : &_stDirty[s32Clip]);
+    _s32Clip = s32Clip;
+}
+
+static int _Copy(
+    SDL_Renderer           *pstRenderer,
+    SDL_Texture            *pstTexture,
+    const SDL_Rect         *pstSrc,
+    const SDL_Rect         *pstDst,
+    const SDL_RendererFlip  s8Flip)
+{
+    if (SDL_FLIP_NONE == s8Flip)
+    {
+        return SDL_RenderCopy(pstRenderer, pstTexture, pstSrc, pstDst);
+    }
+
+    return SDL_RenderCopyEx(pstRenderer, pstTexture, pstSrc, pstDst, 0, NULL, s8Flip);
+}
+
+/* Run the queued draw calls of SDL's software renderer, so they don't
+ * end up on top of what is blitted into the frame afterwards. */
+static void _Flush(SDL_Renderer *pstRenderer)
+{
+    #if SDL_VERSION_ATLEAST(2, 0, 10)
+    if (_pstFrame)
+    {
+        SDL_RenderFlush(pstRenderer);
+    }
+    #else
+    (void)pstRenderer;
+    #endif
+}
+
+/* Lock a streaming ARGB8888 texture.  The software renderer keeps its
+ * textures in memory, so the pixels are the current content. */
+static int8_t _LockPixels(SDL_Texture *pstTexture, Pixels *pstPixels)
+{
+    uint32_t u32Format;
+    void    *pPixels;
+    int      s32Pitch;
+
+    if (0 != SDL_QueryTexture(
+            pstTexture,
+            &u32Format,
+            NULL,
+            &pstPixels->s32Width,
+            &pstPixels->s32Height))
+    {
+        return -1;
+    }
+
+    if (SDL_PIXELFORMAT_ARGB8888 != u32Format)
+    {
+        SDL_SetError("Texture isn't ARGB8888");
+        return -1;
+    }
+
+    if (0 != SDL_LockTexture(pstTexture, NULL, &pPixels, &s32Pitch))
+    {
+        return -1;
+    }
+
+    pstPixels->pu32Pixels = pPixels;
+    pstPixels->s32Pitch   = s32Pitch / sizeof(uint32_t);
+
+    return 0;
+}
+
+/* Run the recorded commands on the rows u32Begin to u32End - 1 of the
+ * frame.  Every band runs all of them in the order they were recorded,
+ * so the result is the same as running them one after another. */
+static void _RunBand(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    SDL_Rect stBand = { 0, u32Begin, _stFrame.s32Width, u32End - u32Begin };
+    SDL_Rect stClip;
+
+    (void)pData;
+
+    for (uint32_t u32Index = 0; u32Index < _u32Commands; u32Index++)
+    {
+        const VideoCommand *pstCommand = &_pstCommands[u32Index];
+
+        if (SDL_FALSE == SDL_IntersectRect(&pstCommand->stClip, &stBand, &stClip))
+        {
+            continue;
+        }
+
+        if (NULL == pstCommand->stSrc.pu32Pixels)
+        {
+            FillPixels(&_stFrame, &stClip, pstCommand->u32Colour);
+            continue;
+        }
+
+        BlitPixels(
+            &_stFrame,
+            &stClip,
+            &pstCommand->stSrc,
+            &pstCommand->stSrcRect,
+            pstCommand->s32X,
+            pstCommand->s32Y,
+            pstCommand->u8Blend,
+            pstCommand->u8Flip);
+    }
+}
+
+/* Run the recorded commands in bands of the frame, one job each, and
+ * wait for all of them.  Has to happen before anything else draws into
+ * the frame, e.g. SDL's renderer. */
+static void _RunCommands()
+{
+    if (0 == _u32Commands)
+    {
+        return;
+    }
+
+    ParallelFor(_pstJobs, _stFrame.s32Height, VIDEO_BAND_ROWS, _RunBand, NULL);
+    _u32Commands = 0;
+}
+
+/* Record a command, running the recorded ones first if there is no
+ * room left. */
+static void _AddCommand(const VideoCommand *pstCommand)
+{
+    if (VIDEO_COMMANDS == _u32Commands)
+    {
+        _RunCommands();
+    }
+
+    _pstCommands[_u32Commands] = *pstCommand;
+    _u32Commands++;
+}
+
+/* Blit a texture into the draw target or record the blit into the
+ * frame in software mode, clipped to the dirty rects.  The software
+ * renderer keeps its textures where they are, so the pixels stay valid
+ * after unlocking.  Fails if the texture can't be locked, would have to
+ * be scaled or the source rect is out of bounds, which is left to
+ * SDL. */
+static int8_t _Blit(
+    SDL_Texture            *pstTexture,
+    const SDL_Rect         *pstSrc,
+    const SDL_Rect         *pstDst,
+    const SDL_RendererFlip  s8Flip)
+{
+    const Pixels  *pstPixels = _pstTarget ? &_stTarget : &_stFrame;
+    SDL_BlendMode  stBlendMode;
+    VideoCommand   stCommand;
+    Pixels         stSrc;
+    SDL_Rect       stSrcRect;
+    SDL_Rect       stDstRect;
+    uint8_t        u8Blend;
+    uint8_t        u8Flip;
+
+    if ((SDL_FLIP_VERTICAL & s8Flip) ||
+        (0 != SDL_GetTextureBlendMode(pstTexture, &stBlendMode)) ||
+        ((SDL_BLENDMODE_NONE != stBlendMode) && (SDL_BLENDMODE_BLEND != stBlendMode)) ||
+        (0 != _LockPixels(pstTexture, &stSrc)))
+    {
+        return -1;
+    }
+
+    stSrcRect = pstSrc ? *pstSrc : (SDL_Rect){ 0, 0, stSrc.s32Width, stSrc.s32Height };
+    stDstRect = pstDst ? *pstDst : (SDL_Rect){ 0, 0, pstPixels->s32Width, pstPixels->s32Height };
+    u8Blend   = SDL_BLENDMODE_BLEND == stBlendMode;
+    u8Flip    = SDL_FLIP_HORIZONTAL == s8Flip;
+
+    if ((stSrcRect.w != stDstRect.w) || (stSrcRect.h != stDstRect.h) ||
+        (stSrcRect.x < 0) || (stSrcRect.x + stSrcRect.w > stSrc.s32Width) ||
+        (stSrcRect.y < 0) || (stSrcRect.y + stSrcRect.h > stSrc.s32Height))
+    {
+        SDL_UnlockTexture(pstTexture);
+        return -1;
+    }
+
+    if (_pstTarget)
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        BlitPixels(pstPixels, NULL, &stSrc, &stSrcRect, stDstRect.x, stDstRect.y, u8Blend, u8Flip);
+        SDL_UnlockTexture(pstTexture);
+        return 0;
+    }
+
+    stCommand.stSrc     = stSrc;
+    stCommand.stSrcRect = stSrcRect;
+    stCommand.s32X      = stDstRect.x;
+    stCommand.s32Y      = stDstRect.y;
+    stCommand.u32Colour = 0;
+    stCommand.u8Blend   = u8Blend;
+    stCommand.u8Flip    = u8Flip;
+
+    if (_u8IsAllDirty)
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        stCommand.stClip = _stScreen;
+        _AddCommand(&stCommand);
+    }
+    else
+    {
+        for (uint8_t u8Index = 0; u8Index < _u8DirtyRects; u8Index++)
+        {
+            if (SDL_FALSE == SDL_HasIntersection(&stDstRect, &_stDirty[u8Index]))
+            {
+                continue;
+            }
+
+            _stStats.u64DrawCalls++;
+            _u32DrawCalls++;
+            stCommand.stClip = _stDirty[u8Index];
+            _AddCommand(&stCommand);
+        }
+    }
+
+    SDL_UnlockTexture(pstTexture);
+
+    return 0;
+}
+
+/* Scale the parts of the window rects on the rows u32Begin to
+ * u32End - 1 up from the frame. */
+static void _ScaleBand(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    const Pixels *pstWindow = pData;
+
+    for (uint8_t u8Index = 0; u8Index < _u8WindowRects; u8Index++)
+    {
+        SDL_Rect stRect = _stWindowRects[u8Index];
+        int32_t  s32Y0  = SDL_max(stRect.y, (int32_t)u32Begin);
+        int32_t  s32Y1  = SDL_min(stRect.y + stRect.h, (int32_t)u32End);
+
+        if (s32Y0 >= s32Y1)
+        {
+            continue;
+        }
+
+        stRect.y = s32Y0;
+        stRect.h = s32Y1 - s32Y0;
+        ScalePixels(pstWindow, &stRect, &_stFrame, _ps32Columns, _stScreen.h);
+    }
+}
+
+/* Scale the dirty parts of the frame up to the window surface, in bands
+ * like _RunCommands(), and update them.  A dirty rect covers the window
+ * pixels which map into it, see _SetScreen(). */
+static void _PresentDirtyRects()
+{
+    const SDL_Rect *pstDirty  = _stDirty;
+    uint8_t         u8Rects   = _u8DirtyRects;
+    int32_t         s32Width  = _pstWindowSurface->w;
+    int32_t         s32Height = _pstWindowSurface->h;
+    uint32_t        u32Format = _pstWindowSurface->format->format;
+    Pixels          stWindow  =
+    {
+        _pstWindowSurface->pixels,
+        _pstWindowSurface->pitch / sizeof(uint32_t),
+        s32Width,
+        s32Height
+    };
+
+    if (_u8IsAllDirty)
+    {
+        pstDirty = &_stScreen;
+        u8Rects  = 1;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < u8Rects; u8Index++)
+    {
+        int32_t s32X0 = ((int64_t)pstDirty[u8Index].x * s32Width + _stScreen.w - 1) / _stScreen.w;
+        int32_t s32Y0 = ((int64_t)pstDirty[u8Index].y * s32Height + _stScreen.h - 1) / _stScreen.h;
+        int32_t s32X1 = ((int64_t)(pstDirty[u8Index].x + pstDirty[u8Index].w) * s32Width + _stScreen.w - 1) / _stScreen.w;
+        int32_t s32Y1 = ((int64_t)(pstDirty[u8Index].y + pstDirty[u8Index].h) * s32Height + _stScreen.h - 1) / _stScreen.h;
+
+        _stWindowRects[u8Index].x = s32X0;
+        _stWindowRects[u8Index].y = s32Y0;
+        _stWindowRects[u8Index].w = s32X1 - s32X0;
+        _stWindowRects[u8Index].h = s32Y1 - s32Y0;
+    }
+    _u8WindowRects = u8Rects;
+
+    if (SDL_MUSTLOCK(_pstWindowSurface))
+    {
+        SDL_LockSurface(_pstWindowSurface);
+        stWindow.pu32Pixels = _pstWindowSurface->pixels;
+    }
+
+    if ((SDL_PIXELFORMAT_ARGB8888 == u32Format) || (SDL_PIXELFORMAT_RGB888 == u32Format))
+    {
+        if (u8Rects)
+        {
+            ParallelFor(_pstJobs, s32Height, VIDEO_BAND_ROWS, _ScaleBand, &stWindow);
+        }
+    }
+    else
+    {
+        for (uint8_t u8Index = 0; u8Index < u8Rects; u8Index++)
+        {
+            SDL_BlitScaled(_pstFrame, &pstDirty[u8Index], _pstWindowSurface, &_stWindowRects[u8Index]);
+        }
+    }
+
+    if (SDL_MUSTLOCK(_pstWindowSurface))
+    {
+        SDL_UnlockSurface(_pstWindowSurface);
+    }
+
+    if (_u8IsAllDirty)
+    {
+        SDL_UpdateWindowSurface(_pstSoftwareWindow);
+    }
+    else if (u8Rects)
+    {
+        SDL_UpdateWindowSurfaceRects(_pstSoftwareWindow, _stWindowRects, u8Rects);
+    }
+}
+
+/* Set the logical size of the screen.  In software mode it's drawn at
+ * that size into the top left of the frame, as it is into the scene
+ * texture at native resolution; otherwise SDL scales it. */
+static int8_t _SetScreen(Video *pstVideo, const double dZoomLevel)
+{
+    _stScreen.w = pstVideo->s32WindowWidth  / dZoomLevel;
+    _stScreen.h = pstVideo->s32WindowHeight / dZoomLevel;
+
+    if (_pstScene)
+    {
+        return 0;
+    }
+
+    if (NULL == _pstFrame)
+    {
+        if (0 != SDL_RenderSetLogicalSize(pstVideo->pstRenderer, _stScreen.w, _stScreen.h))
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    _RunCommands();
+    _stFrame.s32Width  = _stScreen.w;
+    _stFrame.s32Height = _stScreen.h;
+
+    for (int32_t s32X = 0; s32X < _pstWindowSurface->w; s32X++)
+    {
+        _ps32Columns[s32X] = (int64_t)s32X * _stScreen.w / _pstWindowSurface->w;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Clear what is going to be drawn this frame.  In software
+ *          mode these are the dirty rects, which therefore have to be
+ *          marked beforehand; otherwise UpdateVideo() has already
+ *          cleared the frame.  Uses the current draw colour.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @ingroup Video
+ */
+void ClearVideo(SDL_Renderer *pstRenderer)
+{
+    VideoCommand stCommand;
+    SDL_Color    stColour;
+
+    if ((NULL == _pstFrame) || (_u8Headless))
+    {
+        return;
+    }
+
+    // A different colour has to be cleared everywhere.
+    SDL_GetRenderDrawColor(pstRenderer, &stColour.r, &stColour.g, &stColour.b, &stColour.a);
+    if (0 != memcmp(&stColour, &_stClearColour, sizeof(SDL_Color)))
+    {
+        _stClearColour = stColour;
+        _u8IsAllDirty  = 1;
+    }
+
+    memset(&stCommand, 0, sizeof(VideoCommand));
+    stCommand.u32Colour =
+        ((uint32_t)stColour.a << 24) |
+        ((uint32_t)stColour.r << 16) |
+        ((uint32_t)stColour.g <<  8) |
+        stColour.b;
+
+    if (_u8IsAllDirty)
+    {
+        stCommand.stClip = _stScreen;
+        _AddCommand(&stCommand);
+        return;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < _u8DirtyRects; u8Index++)
+    {
+        stCommand.stClip = _stDirty[u8Index];
+        _AddCommand(&stCommand);
+    }
+}
+
+/**
+ * @brief   Create a texture to draw into using SetDrawTarget(), cleared
+ *          to transparent black.  In software mode it's a streaming
+ *          texture which is blitted into like the frame.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   s32Width    the width of the texture.
+ * @param   s32Height   the height of the texture.
+ * @return  The tracked texture on success, NULL on failure.  Destroy it
+ *          using DestroyTexture().
+ * @ingroup Video
+ */
+SDL_Texture *CreateTargetTexture(
+    SDL_Renderer  *pstRenderer,
+    const int32_t  s32Width,
+    const int32_t  s32Height)
+{
+    SDL_Texture *pstTexture;
+    Pixels       stPixels;
+
+    if (NULL == _pstFrame)
+    {
+        return TrackTexture(SDL_CreateTexture(
+            pstRenderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET,
+            s32Width,
+            s32Height));
+    }
+
+    pstTexture = SDL_CreateTexture(
+        pstRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        s32Width,
+        s32Height);
+
+    if ((pstTexture) && (0 != _LockPixels(pstTexture, &stPixels)))
+    {
+        SDL_DestroyTexture(pstTexture);
+        return NULL;
+    }
+
+    if (pstTexture)
+    {
+        FillPixels(&stPixels, NULL, 0);
+        SDL_UnlockTexture(pstTexture);
+    }
+
+    return TrackTexture(pstTexture);
+}
+
+/**
+ * @brief   Create a texture from a surface like
+ *          SDL_CreateTextureFromSurface().  In software mode it's a
+ *          streaming ARGB8888 texture, so it can be blitted.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstSurface  the surface, which is left untouched.
+ * @return  The tracked texture on success, NULL on failure.  Destroy it
+ *          using DestroyTexture().
+ * @ingroup Video
+ */
+SDL_Texture *CreateTextureFromSurface(SDL_Renderer *pstRenderer, SDL_Surface *pstSurface)
+{
+    SDL_Surface *pstImage;
+    SDL_Texture *pstTexture;
+    Pixels       stPixels;
+    uint32_t     u32Key;
+
+    if (NULL == _pstFrame)
+    {
+        return TrackTexture(SDL_CreateTextureFromSurface(pstRenderer, pstSurface));
+    }
+
+    pstImage = SDL_ConvertSurfaceFormat(pstSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (NULL == pstImage)
+    {
+        return NULL;
+    }
+
+    pstTexture = SDL_CreateTexture(
+        pstRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        pstImage->w,
+        pstImage->h);
+
+    if ((pstTexture) && (0 == _LockPixels(pstTexture, &stPixels)))
+    {
+        Pixels stImage =
+        {
+            pstImage->pixels,
+            pstImage->pitch / sizeof(uint32_t),
+            pstImage->w,
+            pstImage->h
+        };
+
+        BlitPixels(&stPixels, NULL, &stImage, NULL, 0, 0, 0, 0);
+        SDL_UnlockTexture(pstTexture);
+    }
+    else if (pstTexture)
+    {
+        SDL_DestroyTexture(pstTexture);
+        pstTexture = NULL;
+    }
+
+    // Same as SDL, which blends if there is transparency.
+    if ((pstTexture) &&
+        ((SDL_ISPIXELFORMAT_ALPHA(pstSurface->format->format)) ||
+         (0 == SDL_GetColorKey(pstSurface, &u32Key))))
+    {
+        SDL_SetTextureBlendMode(pstTexture, SDL_BLENDMODE_BLEND);
+    }
+
+    SDL_FreeSurface(pstImage);
+
+    return TrackTexture(pstTexture);
+}
+
+/**
+ * @brief   Destroy a texture which has been passed to TrackTexture().
+ * @param   pstTexture the texture, may be NULL.
+ * @ingroup Video
+ */
+void DestroyTexture(SDL_Texture *pstTexture)
+{
+    if (NULL == pstTexture)
+    {
+        return;
+    }
+
+    // A recorded blit may still read from it.
+    _RunCommands();
+
+    _stStats.u64TextureBytes -= GetTextureBytes(pstTexture);
+    _stStats.u32Textures--;
+    SDL_DestroyTexture(pstTexture);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+/**
+ * @brief   Draw triangles textured with the same texture in a single
+ *          draw call.  Counted like DrawTexture().
+ * @param   pstRenderer  a SDL rendering context.
+ * @param   pstTexture   the texture.
+ * @param   pstVertices  the vertices.
+ * @param   s32Vertices  the number of vertices.
+ * @param   ps32Indices  three indices into pstVertices per triangle.
+ * @param   s32Indices   the number of indices.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Video
+ */
+int8_t DrawGeometry(
+    SDL_Renderer     *pstRenderer,
+    SDL_Texture      *pstTexture,
+    const SDL_Vertex *pstVertices,
+    const int32_t     s32Vertices,
+    const int        *ps32Indices,
+    const int32_t     s32Indices)
+{
+    int8_t s8Status = 0;
+
+    if (_u8Headless)
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        return 0;
+    }
+
+    _RunCommands();
+    if (0 == _IsClipped(pstRenderer))
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        s8Status = SDL_RenderGeometry(
+            pstRenderer,
+            pstTexture,
+            pstVertices,
+            s32Vertices,
+            ps32Indices,
+            s32Indices);
+        _Flush(pstRenderer);
+        return s8Status;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < _u8DirtyRects; u8Index++)
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        _SetClip(pstRenderer, u8Index);
+        if (0 != SDL_RenderGeometry(
+                pstRenderer,
+                pstTexture,
+                pstVertices,
+                s32Vertices,
+                ps32Indices,
+                s32Indices))
+        {
+            s8Status = -1;
+        }
+    }
+    _Flush(pstRenderer);
+
+    return s8Status;
+}
+#endif
+
+/**
+ * @brief   Draw (a part of) a texture.  All draw calls go through here
+ *          so they can be counted; in headless mode they are counted
+ *          but not executed.  In software mode they are issued once
+ *          for every dirty rect they touch, clipped to it, and unscaled
+ *          streaming textures are blitted without SDL; these blits are
+ *          recorded and run in bands before the frame is presented.
+ * @param   pstRenderer a SDL rendering context.
+ * @param   pstTexture  the texture to draw.
+ * @param   pstSrc      the source rectangle, NULL for the entire texture.
+ * @param   pstDst      the destination rectangle, NULL for the entire target.
+ * @param   s8Flip      SDL_FLIP_NONE or SDL_FLIP_HORIZONTAL.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Video
+ */
+int8_t DrawTexture(
+    SDL_Renderer           *pstRenderer,
+    SDL_Texture            *pstTexture,
+    const SDL_Rect         *pstSrc,
+    const SDL_Rect         *pstDst,
+    const SDL_RendererFlip  s8Flip)
+{
+    int8_t s8Status = 0;
+
+    if (_u8Headless)
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        return 0;
+    }
+
+    if (_pstFrame)
+    {
+        if (0 == _Blit(pstTexture, pstSrc, pstDst, s8Flip))
+        {
+            return 0;
+        }
+
+        if (_pstTarget)
+        {
+            SDL_SetError("Texture can't be drawn into a software draw target");
+            return -1;
+        }
+
+        // SDL draws into the frame right away.
+        _RunCommands();
+    }
+
+    if (0 == _IsClipped(pstRenderer))
+    {
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        s8Status = _Copy(pstRenderer, pstTexture, pstSrc, pstDst, s8Flip);
+        _Flush(pstRenderer);
+        return s8Status;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < _u8DirtyRects; u8Index++)
+    {
+        if ((pstDst) && (SDL_FALSE == SDL_HasIntersection(pstDst, &_stDirty[u8Index])))
+        {
+            continue;
+        }
+
+        _stStats.u64DrawCalls++;
+        _u32DrawCalls++;
+        _SetClip(pstRenderer, u8Index);
+        if (0 != _Copy(pstRenderer, pstTexture, pstSrc, pstDst, s8Flip))
+        {
+            s8Status = -1;
+        }
+    }
+    _Flush(pstRenderer);
+
+    return s8Status;
+}
+
+/**
+ * @brief   Clear a part of the current draw target to transparent
+ *          black, see SetDrawTarget().
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstRect     the part to clear.
+ * @ingroup Video
+ */
+void EraseRect(SDL_Renderer *pstRenderer, const SDL_Rect *pstRect)
+{
+    VideoCommand stCommand;
+    uint8_t      u8R, u8G, u8B, u8A;
+
+    if (_pstTarget)
+    {
+        FillPixels(&_stTarget, pstRect, 0);
+        return;
+    }
+
+    if (_pstFrame)
+    {
+        memset(&stCommand, 0, sizeof(VideoCommand));
+        stCommand.stClip = pstRect ? *pstRect : _stScreen;
+        _AddCommand(&stCommand);
+        return;
+    }
+
+    SDL_GetRenderDrawColor(pstRenderer, &u8R, &u8G, &u8B, &u8A);
+    SDL_SetRenderDrawBlendMode(pstRenderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(pstRenderer, 0, 0, 0, 0);
+    SDL_RenderFillRect(pstRenderer, pstRect);
+    SDL_SetRenderDrawColor(pstRenderer, u8R, u8G, u8B, u8A);
+}
+
+/**
+ * @brief   Run the draw calls recorded in software mode.  Has to be
+ *          called before drawing with SDL's renderer directly, e.g. the
+ *          profiler overlay, so it ends up on top.  UpdateVideo() does
+ *          so before presenting.
+ * @ingroup Video
+ */
+void FlushVideo()
+{
+    _RunCommands();
+}
+
+/**
+ * @brief   Estimate the size of a texture, as the driver's internal
+ *          layout is unknown.
+ * @param   pstTexture the texture.
+ * @return  The size in bytes, 0 on failure.
+ * @ingroup Video
+ */
+uint64_t GetTextureBytes(SDL_Texture *pstTexture)
+{
+    uint32_t u32Format;
+    int32_t  s32Width;
+    int32_t  s32Height;
+
+    if (0 != SDL_QueryTexture(pstTexture, &u32Format, NULL, &s32Width, &s32Height))
+    {
+        return 0;
+    }
+
+    return (uint64_t)s32Width * s32Height * SDL_BYTESPERPIXEL(u32Format);
+}
+
+/**
+ * @brief   Get the draw call and texture memory statistics.
+ * @return  The statistics.  u32FrameDrawCalls holds the draw calls of
+ *          the last completed frame, u64TextureBytes the estimated size
+ *          of all tracked textures.  See @ref struct VideoStats.
+ * @ingroup Video
+ */
+VideoStats GetVideoStats()
+{
+    return _stStats;
+}
+
 /**
  * @brief   Initialise Video subsystem.
  * @param   pacTitle     the name of the window.
  * @param   s32Width     window width.
  * @param   s32Height    window height.
  * @param   u8Fullscreen boolean value to set fullscreen state.
+ * @param   u8Software   boolean value to use the software renderer even
+ *                       if there is an accelerated one.
+ * @param   u8Native     boolean value to draw the scene at native
+ *                       resolution, at most VIDEO_NATIVE_HEIGHT rows, and
+ *                       scale it up once on present.  Limits zooming out.
  * @param   dZoomLevel   the initial zoom level.
+ * @param   u8Headless   boolean value to use SDL's dummy video driver
+ *                       and skip all draw calls.
  * @return  Video on success, NULL on failure.  See @ref struct Video.
  * @ingroup Video
  */
@@ -28,12 +851,25 @@ Video *InitVideo(
     const int32_t  s32Width,
     const int32_t  s32Height,
     const uint8_t  u8Fullscreen,
-    const double   dZoomLevel)
+    const uint8_t  u8Software,
+    const uint8_t  u8Native,
+    const double   dZoomLevel,
+    const uint8_t  u8Headless)
 {
     uint32_t      u32Flags;
+    uint32_t      u32RendererFlags;
+    int32_t       s32SceneWidth;
+    int32_t       s32SceneHeight;
     static Video *pstVideo;
 
-    pstVideo = malloc(sizeof(struct Video_t));
+    _u8Headless = u8Headless;
+    if (u8Headless)
+    {
+        // Neither a display nor a GPU is required.
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    }
+
+    pstVideo = AllocMemory(MEMORY_ENGINE, sizeof(struct Video_t));
 
     if (NULL == pstVideo)
     {
@@ -44,22 +880,30 @@ Video *InitVideo(
     if (0 != SDL_Init(SDL_INIT_VIDEO))
     {
         fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        FreeMemory(pstVideo);
         return NULL;
     }
 
+    pstVideo->pstSurface        = NULL;
     pstVideo->s32WindowHeight   = s32Height;
     pstVideo->s32WindowWidth    = s32Width;
     pstVideo->dZoomLevel        = dZoomLevel;
     pstVideo->dZoomLevelInitial = dZoomLevel;
 
-    if (u8Fullscreen)
+    if (u8Headless)
     {
-        u32Flags = SDL_WINDOW_FULLSCREEN_DESKTOP;
+        u32Flags         = SDL_WINDOW_HIDDEN;
+        u32RendererFlags = SDL_RENDERER_SOFTWARE;
+    }
+    else if (u8Fullscreen)
+    {
+        u32Flags         = SDL_WINDOW_FULLSCREEN_DESKTOP;
+        u32RendererFlags = SDL_RENDERER_ACCELERATED;
     }
     else
     {
-        u32Flags = 0;
+        u32Flags         = 0;
+        u32RendererFlags = SDL_RENDERER_ACCELERATED;
     }
 
     pstVideo->pstWindow = SDL_CreateWindow(
@@ -73,11 +917,11 @@ Video *InitVideo(
     if (NULL == pstVideo->pstWindow)
     {
         fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        FreeMemory(pstVideo);
         return NULL;
     }
 
-    if (u8Fullscreen)
+    if ((u8Fullscreen) && (0 == u8Headless))
     {
         SDL_GetWindowSize(
             pstVideo->pstWindow,
@@ -87,38 +931,272 @@ Video *InitVideo(
         if (0 > SDL_ShowCursor(SDL_DISABLE))
         {
             fprintf(stderr, "%s\n", SDL_GetError());
-            free(pstVideo);
+            FreeMemory(pstVideo);
             return NULL;
         }
     }
 
-    pstVideo->pstRenderer = SDL_CreateRenderer(
-        pstVideo->pstWindow,
-        -1,
-        SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+    // Zooming out further would show more than the scene holds.
+    if ((u8Native) && (0 == u8Headless))
+    {
+        _dZoomLevelMin = SDL_max(
+            (double)VIDEO_MIN_ZOOMLEVEL,
+            (double)pstVideo->s32WindowHeight / VIDEO_NATIVE_HEIGHT);
+    }
+    s32SceneWidth  = pstVideo->s32WindowWidth  / _dZoomLevelMin;
+    s32SceneHeight = pstVideo->s32WindowHeight / _dZoomLevelMin;
+
+    if (pstVideo->dZoomLevel < _dZoomLevelMin)
+    {
+        pstVideo->dZoomLevel        = _dZoomLevelMin;
+        pstVideo->dZoomLevelInitial = _dZoomLevelMin;
+    }
+
+    pstVideo->pstRenderer = NULL;
+    if ((0 == u8Software) || (u8Headless))
+    {
+        pstVideo->pstRenderer = SDL_CreateRenderer(
+            pstVideo->pstWindow,
+            -1,
+            u32RendererFlags | SDL_RENDERER_TARGETTEXTURE);
+    }
+
+    if ((NULL == pstVideo->pstRenderer) && (0 == u8Headless))
+    {
+        if (0 == u8Software)
+        {
+            fprintf(stderr, "%s, falling back to software rendering.\n", SDL_GetError());
+        }
+
+        /* Textures are blitted into the frame, which is scaled up to
+         * the window surface, see UpdateVideo().  SDL's renderer only
+         * draws what can't be blitted. */
+        pstVideo->pstSurface = SDL_GetWindowSurface(pstVideo->pstWindow);
+        if (pstVideo->pstSurface)
+        {
+            _pstFrame = SDL_CreateRGBSurfaceWithFormat(
+                0,
+                u8Native ? s32SceneWidth  : pstVideo->pstSurface->w,
+                u8Native ? s32SceneHeight : pstVideo->pstSurface->h,
+                32,
+                SDL_PIXELFORMAT_ARGB8888);
+            _ps32Columns = AllocMemory(MEMORY_ENGINE, pstVideo->pstSurface->w * sizeof(int32_t));
+            _pstCommands = AllocMemory(MEMORY_ENGINE, VIDEO_COMMANDS * sizeof(VideoCommand));
+        }
+
+        if ((_pstFrame) && (_ps32Columns) && (_pstCommands))
+        {
+            SDL_SetSurfaceBlendMode(_pstFrame, SDL_BLENDMODE_NONE);
+            pstVideo->pstRenderer = SDL_CreateSoftwareRenderer(_pstFrame);
+            _stFrame.pu32Pixels   = _pstFrame->pixels;
+            _stFrame.s32Pitch     = _pstFrame->pitch / sizeof(uint32_t);
+
+            // Before the workers blit anything.
+            GetBlitKernelName();
+        }
+
+        if (NULL == pstVideo->pstRenderer)
+        {
+            SDL_FreeSurface(_pstFrame);
+            FreeMemory(_ps32Columns);
+            FreeMemory(_pstCommands);
+            _pstFrame    = NULL;
+            _ps32Columns = NULL;
+            _pstCommands = NULL;
+        }
+        _pstSoftwareWindow = pstVideo->pstWindow;
+        _pstWindowSurface  = pstVideo->pstSurface;
+    }
 
     if (NULL == pstVideo->pstRenderer)
     {
         fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        FreeMemory(pstVideo);
         return NULL;
     }
 
-    if (0 != SDL_RenderSetLogicalSize(
-            pstVideo->pstRenderer,
-            pstVideo->s32WindowWidth  / dZoomLevel,
-            pstVideo->s32WindowHeight / dZoomLevel))
+    /* Everything is drawn into the scene, see SetDrawTarget(), and it's
+     * scaled up to the window in UpdateVideo(). */
+    if ((u8Native) && (NULL == _pstFrame) && (0 == u8Headless))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        _pstScene = CreateTargetTexture(pstVideo->pstRenderer, s32SceneWidth, s32SceneHeight);
+        if ((NULL == _pstScene) || (0 != SDL_SetRenderTarget(pstVideo->pstRenderer, _pstScene)))
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            DestroyTexture(_pstScene);
+            FreeMemory(pstVideo);
+            _pstScene = NULL;
+            return NULL;
+        }
+
+        SDL_SetTextureBlendMode(_pstScene, SDL_BLENDMODE_NONE);
+        #if SDL_VERSION_ATLEAST(2, 0, 12)
+        SDL_SetTextureScaleMode(_pstScene, SDL_ScaleModeNearest);
+        #endif
+    }
+
+    if (-1 == _SetScreen(pstVideo, pstVideo->dZoomLevel))
+    {
+        FreeMemory(pstVideo);
         return NULL;
     }
 
+    _u8IsAllDirty = 1;
+
     return pstVideo;
 }
 
 /**
- * @brief   Set Video zoom level.
+ * @brief   Check whether textures are blitted into a frame kept from
+ *          the last one, so it pays off to mark what has changed.
+ * @return  1 if it does, 0 if not.
+ * @ingroup Video
+ */
+uint8_t IsSoftwareVideo()
+{
+    return NULL != _pstSoftwareWindow;
+}
+
+/**
+ * @brief   Load an image into a texture like IMG_LoadTexture().  In
+ *          software mode it's a streaming ARGB8888 texture, so it can be
+ *          blitted.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pacFilename the image file.
+ * @return  The tracked texture on success, NULL on failure.  Destroy it
+ *          using DestroyTexture().
+ * @ingroup Video
+ */
+SDL_Texture *LoadTexture(SDL_Renderer *pstRenderer, const char *pacFilename)
+{
+    SDL_Surface *pstImage;
+    SDL_Texture *pstTexture;
+
+    if (NULL == _pstFrame)
+    {
+        return TrackTexture(IMG_LoadTexture(pstRenderer, pacFilename));
+    }
+
+    pstImage = IMG_Load(pacFilename);
+    if (NULL == pstImage)
+    {
+        return NULL;
+    }
+
+    pstTexture = CreateTextureFromSurface(pstRenderer, pstImage);
+    SDL_FreeSurface(pstImage);
+
+    return pstTexture;
+}
+
+/**
+ * @brief   Mark a part of the screen to be redrawn and presented this
+ *          frame, e.g. where a sprite is now and where it was before.
+ *          Has to happen before the first draw call of the frame.  Does
+ *          nothing unless in software mode, where everything outside
+ *          the dirty rects is kept from the last frame.
+ * @param   pstRect the rect in logical coordinates, NULL for the entire
+ *                  screen.
+ * @ingroup Video
+ */
+void MarkDirtyRect(const SDL_Rect *pstRect)
+{
+    SDL_Rect stRect;
+
+    if ((NULL == _pstSoftwareWindow) || (_u8IsAllDirty))
+    {
+        return;
+    }
+
+    if (NULL == pstRect)
+    {
+        _u8IsAllDirty = 1;
+        return;
+    }
+
+    if (SDL_FALSE == SDL_IntersectRect(pstRect, &_stScreen, &stRect))
+    {
+        return;
+    }
+
+    // Keep the rects disjoint, so no pixel is blended twice.
+    for (uint8_t u8Index = 0; u8Index < _u8DirtyRects; )
+    {
+        if (SDL_HasIntersection(&stRect, &_stDirty[u8Index]))
+        {
+            SDL_UnionRect(&stRect, &_stDirty[u8Index], &stRect);
+            _u8DirtyRects--;
+            _stDirty[u8Index] = _stDirty[_u8DirtyRects];
+            u8Index           = 0;
+        }
+        else
+        {
+            u8Index++;
+        }
+    }
+
+    if (VIDEO_DIRTY_RECTS == _u8DirtyRects)
+    {
+        _u8IsAllDirty = 1;
+        return;
+    }
+
+    _stDirty[_u8DirtyRects] = stRect;
+    _u8DirtyRects++;
+}
+
+/**
+ * @brief   Set the texture to draw into, like SDL_SetRenderTarget().
+ *          The texture has to be created using CreateTargetTexture().
+ *          In software mode it stays locked until the target is reset.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstTexture  the texture, NULL to draw to the screen, or the
+ *                      scene at native resolution, again.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Video
+ */
+int8_t SetDrawTarget(SDL_Renderer *pstRenderer, SDL_Texture *pstTexture)
+{
+    if (NULL == _pstFrame)
+    {
+        return 0 == SDL_SetRenderTarget(pstRenderer, pstTexture ? pstTexture : _pstScene) ? 0 : -1;
+    }
+
+    // The texture may be read by a recorded blit.
+    _RunCommands();
+
+    if (_pstTarget)
+    {
+        SDL_UnlockTexture(_pstTarget);
+        _pstTarget = NULL;
+    }
+
+    if ((pstTexture) && (0 != _LockPixels(pstTexture, &_stTarget)))
+    {
+        return -1;
+    }
+
+    _pstTarget = pstTexture;
+
+    return 0;
+}
+
+/**
+ * @brief   Set the job system the software renderer spreads its work
+ *          over.  Without one, everything runs on the calling thread.
+ * @param   pstJobs the job system, NULL to stop using it before it's
+ *                  freed.  See @ref struct JobSystem.
+ * @ingroup Video
+ */
+void SetVideoJobSystem(JobSystem *pstJobs)
+{
+    _RunCommands();
+    _pstJobs = pstJobs;
+}
+
+/**
+ * @brief   Set Video zoom level.  At native resolution only the visible
+ *          part of the scene changes, the renderer is left as it is.
  * @param   pstVideo   Video.  See @ref struct Video.
  * @param   dZoomLevel the zoom level.
  * @ingroup Video
@@ -128,17 +1206,15 @@ int8_t SetVideoZoomLevel(Video *pstVideo, double dZoomLevel)
 {
     if (dZoomLevel <= VIDEO_MIN_ZOOMLEVEL) dZoomLevel = VIDEO_MIN_ZOOMLEVEL;
     if (dZoomLevel >= VIDEO_MAX_ZOOMLEVEL) dZoomLevel = VIDEO_MAX_ZOOMLEVEL;
+    if (dZoomLevel <  _dZoomLevelMin)      dZoomLevel = _dZoomLevelMin;
 
-    if (0 != SDL_RenderSetLogicalSize(
-            pstVideo->pstRenderer,
-            pstVideo->s32WindowWidth  / dZoomLevel,
-            pstVideo->s32WindowHeight / dZoomLevel))
+    if (-1 == _SetScreen(pstVideo, dZoomLevel))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
     pstVideo->dZoomLevel = dZoomLevel;
+    MarkDirtyRect(NULL);
 
     return 0;
 }
@@ -155,14 +1231,88 @@ void TerminateVideo(Video *pstVideo)
         fprintf(stderr, "%s\n", SDL_GetError());
     }
 
+    DestroyTexture(_pstScene);
     SDL_DestroyRenderer(pstVideo->pstRenderer);
+    SDL_FreeSurface(_pstFrame);
     SDL_DestroyWindow(pstVideo->pstWindow);
-    free(pstVideo);
+    FreeMemory(_ps32Columns);
+    FreeMemory(_pstCommands);
+    FreeMemory(pstVideo);
+    _pstSoftwareWindow = NULL;
+    _pstWindowSurface  = NULL;
+    _pstFrame          = NULL;
+    _ps32Columns       = NULL;
+    _pstCommands       = NULL;
+    _u32Commands       = 0;
+    _pstJobs           = NULL;
+    _pstScene          = NULL;
+    _dZoomLevelMin     = VIDEO_MIN_ZOOMLEVEL;
+}
+
+/**
+ * @brief   Account a newly created texture in the texture memory
+ *          statistics.  Destroy it using DestroyTexture().
+ * @param   pstTexture the texture, may be NULL.
+ * @return  pstTexture, so calls to SDL_CreateTexture() and the like can
+ *          be wrapped.
+ * @ingroup Video
+ */
+SDL_Texture *TrackTexture(SDL_Texture *pstTexture)
+{
+    if (pstTexture)
+    {
+        _stStats.u64TextureBytes += GetTextureBytes(pstTexture);
+        _stStats.u32Textures++;
+    }
+
+    return pstTexture;
 }
 
+/**
+ * @brief   Present the rendered frame.  This function has to be called
+ *          every frame.  In software mode the recorded draw calls are
+ *          run first, then only the dirty rects are presented and the
+ *          frame is kept as it is, so the next one only has to redraw
+ *          what changes.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @ingroup Video
+ */
 void UpdateVideo(SDL_Renderer *pstRenderer)
 {
-    SDL_RenderPresent(pstRenderer);
+    _stStats.u64Frames++;
+    _stStats.u32FrameDrawCalls = _u32DrawCalls;
+    _u32DrawCalls              = 0;
+
+    if (_u8Headless)
+    {
+        return;
+    }
+
+    if (_pstSoftwareWindow)
+    {
+        // Runs the recorded and queued draw calls before the frame is
+        // scaled up.
+        _RunCommands();
+        SDL_RenderPresent(pstRenderer);
+        _PresentDirtyRects();
+        _SetClip(pstRenderer, -1);
+        _u8DirtyRects = 0;
+        _u8IsAllDirty = 0;
+        return;
+    }
+
+    if (_pstScene)
+    {
+        // A single draw call scales the scene up to the window.
+        SDL_SetRenderTarget(pstRenderer, NULL);
+        SDL_RenderCopy(pstRenderer, _pstScene, &_stScreen, NULL);
+        SDL_RenderPresent(pstRenderer);
+        SDL_SetRenderTarget(pstRenderer, _pstScene);
+    }
+    else
+    {
+        SDL_RenderPresent(pstRenderer);
+    }
     #ifndef __EMSCRIPTEN__
     SDL_RenderClear(pstRenderer);
     #endif
@@ -8,6 +8,8 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include "Blit.h"
+#include "Job.h"
 
 /**
  * @ingroup Video
@@ -15,31 +17,111 @@
 enum VideoLimits
 {
     VIDEO_MIN_ZOOMLEVEL = 1,
-    VIDEO_MAX_ZOOMLEVEL = 4
+    VIDEO_MAX_ZOOMLEVEL = 4,
+    VIDEO_DIRTY_RECTS   = 32,
+    VIDEO_COMMANDS      = 4096,
+    VIDEO_BAND_ROWS     = 16,
+    VIDEO_NATIVE_HEIGHT = 216 // The height of the backgrounds.
 };
 
 /**
  * @ingroup Video
+ * @brief   The window and its renderer.  pstSurface is set to the
+ *          window surface in software mode, in which case only the
+ *          dirty rects are redrawn and presented.  See MarkDirtyRect().
  */
 typedef struct Video_t
 {
     SDL_Renderer *pstRenderer;
     SDL_Window   *pstWindow;
+    SDL_Surface  *pstSurface;
     int32_t       s32WindowHeight;
     int32_t       s32WindowWidth;
     double        dZoomLevel;
     double        dZoomLevelInitial;
 } Video;
 
+/**
+ * @ingroup Video
+ * @brief   A blit into the frame in software mode, clipped to stClip,
+ *          or a fill of stClip with u32Colour if stSrc has no pixels.
+ *          Commands are recorded during the frame and run band by band
+ *          before it's presented.
+ */
+typedef struct VideoCommand_t
+{
+    Pixels   stSrc;
+    SDL_Rect stSrcRect;
+    SDL_Rect stClip;
+    int32_t  s32X;
+    int32_t  s32Y;
+    uint32_t u32Colour;
+    uint8_t  u8Blend;
+    uint8_t  u8Flip;
+} VideoCommand;
+
+/**
+ * @ingroup Video
+ */
+typedef struct VideoStats_t
+{
+    uint64_t u64Frames;
+    uint64_t u64DrawCalls;
+    uint64_t u64TextureBytes;
+    uint32_t u32FrameDrawCalls;
+    uint32_t u32Textures;
+} VideoStats;
+
+void ClearVideo(SDL_Renderer *pstRenderer);
+
+SDL_Texture *CreateTargetTexture(
+    SDL_Renderer  *pstRenderer,
+    const int32_t  s32Width,
+    const int32_t  s32Height);
+
+SDL_Texture *CreateTextureFromSurface(SDL_Renderer *pstRenderer, SDL_Surface *pstSurface);
+void         DestroyTexture(SDL_Texture *pstTexture);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+int8_t DrawGeometry(
+    SDL_Renderer     *pstRenderer,
+    SDL_Texture      *pstTexture,
+    const SDL_Vertex *pstVertices,
+    const int32_t     s32Vertices,
+    const int        *ps32Indices,
+    const int32_t     s32Indices);
+#endif
+
+int8_t DrawTexture(
+    SDL_Renderer           *pstRenderer,
+    SDL_Texture            *pstTexture,
+    const SDL_Rect         *pstSrc,
+    const SDL_Rect         *pstDst,
+    const SDL_RendererFlip  s8Flip);
+
+void       EraseRect(SDL_Renderer *pstRenderer, const SDL_Rect *pstRect);
+void       FlushVideo();
+uint64_t   GetTextureBytes(SDL_Texture *pstTexture);
+VideoStats GetVideoStats();
+
 Video *InitVideo(
     const char    *pacTitle,
     const int32_t  s32Width,
     const int32_t  s32Height,
     const uint8_t  u8Fullscreen,
-    const double   dZoomLevel);
+    const uint8_t  u8Software,
+    const uint8_t  u8Native,
+    const double   dZoomLevel,
+    const uint8_t  u8Headless);
 
-int8_t SetVideoZoomLevel(Video *pstVideo, double dZoomLevel);
-void   TerminateVideo(Video *pstVideo);
-void   UpdateVideo(SDL_Renderer *pstRenderer);
+uint8_t      IsSoftwareVideo();
+SDL_Texture *LoadTexture(SDL_Renderer *pstRenderer, const char *pacFilename);
+void         MarkDirtyRect(const SDL_Rect *pstRect);
+int8_t       SetDrawTarget(SDL_Renderer *pstRenderer, SDL_Texture *pstTexture);
+void         SetVideoJobSystem(JobSystem *pstJobs);
+int8_t       SetVideoZoomLevel(Video *pstVideo, double dZoomLevel);
+void         TerminateVideo(Video *pstVideo);
+SDL_Texture *TrackTexture(SDL_Texture *pstTexture);
+void         UpdateVideo(SDL_Renderer *pstRenderer);
 
 #endif // _VIDEO_H_
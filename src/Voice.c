@@ -0,0 +1,536 @@
+/**
+ * @file      Voice.c
+ * @ingroup   Voice
+ * @defgroup  Voice
+ * @brief     Engine-side mixer for many overlapping sound effects.
+ *            Voices are mixed into the output of SDL_mixer on the audio
+ *            thread: every voice is scaled by its left and right gain
+ *            and accumulated in floating point, the sum is added to the
+ *            stream with saturation.  The accumulation uses AVX2 or
+ *            SSE2 where available.  When all voices are busy, the
+ *            oldest one of the lowest priority is stolen.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "Memory.h"
+#include "Voice.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define VOICE_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+#include <immintrin.h>
+#define VOICE_AVX2
+#endif
+
+typedef void (*AccumulateFunc)(
+    float         *pfMix,
+    const int16_t *ps16Samples,
+    uint32_t       u32Samples,
+    float          fGainLeft,
+    float          fGainRight);
+
+typedef void (*ResolveFunc)(
+    int16_t     *ps16Stream,
+    const float *pfMix,
+    uint32_t     u32Samples);
+
+static AccumulateFunc _pfnAccumulate;
+static ResolveFunc    _pfnResolve;
+static const char    *_pacMixerName;
+
+/* Interleaved samples alternate between the left and the right gain;
+ * with one channel both gains are the same.  u32Samples may be odd
+ * only at the end of a mono buffer. */
+static void _AccumulateScalar(
+    float         *pfMix,
+    const int16_t *ps16Samples,
+    uint32_t       u32Samples,
+    float          fGainLeft,
+    float          fGainRight)
+{
+    uint32_t u32Index = 0;
+
+    for (; u32Index + 2 <= u32Samples; u32Index += 2)
+    {
+        pfMix[u32Index]     += ps16Samples[u32Index]     * fGainLeft;
+        pfMix[u32Index + 1] += ps16Samples[u32Index + 1] * fGainRight;
+    }
+
+    if (u32Index < u32Samples)
+    {
+        pfMix[u32Index] += ps16Samples[u32Index] * fGainLeft;
+    }
+}
+
+static void _ResolveScalar(
+    int16_t     *ps16Stream,
+    const float *pfMix,
+    uint32_t     u32Samples)
+{
+    for (uint32_t u32Index = 0; u32Index < u32Samples; u32Index++)
+    {
+        float fSample = ps16Stream[u32Index] + pfMix[u32Index];
+
+        if (fSample >  32767.0f) { fSample =  32767.0f; }
+        if (fSample < -32768.0f) { fSample = -32768.0f; }
+        ps16Stream[u32Index] = (int16_t)fSample;
+    }
+}
+
+#ifdef VOICE_SSE2
+static void _AccumulateSSE2(
+    float         *pfMix,
+    const int16_t *ps16Samples,
+    uint32_t       u32Samples,
+    float          fGainLeft,
+    float          fGainRight)
+{
+    __m128   stGain   = _mm_setr_ps(fGainLeft, fGainRight, fGainLeft, fGainRight);
+    uint32_t u32Index = 0;
+
+    for (; u32Index + 8 <= u32Samples; u32Index += 8)
+    {
+        __m128i stIn = _mm_loadu_si128((const __m128i *)(ps16Samples + u32Index));
+        // Sign-extend by placing each sample in the upper half.
+        __m128  stLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(stIn, stIn), 16));
+        __m128  stHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(stIn, stIn), 16));
+
+        _mm_storeu_ps(pfMix + u32Index,
+            _mm_add_ps(_mm_loadu_ps(pfMix + u32Index), _mm_mul_ps(stLo, stGain)));
+        _mm_storeu_ps(pfMix + u32Index + 4,
+            _mm_add_ps(_mm_loadu_ps(pfMix + u32Index + 4), _mm_mul_ps(stHi, stGain)));
+    }
+
+    _AccumulateScalar(
+        pfMix + u32Index,
+        ps16Samples + u32Index,
+        u32Samples - u32Index,
+        fGainLeft,
+        fGainRight);
+}
+
+static void _ResolveSSE2(
+    int16_t     *ps16Stream,
+    const float *pfMix,
+    uint32_t     u32Samples)
+{
+    uint32_t u32Index = 0;
+
+    for (; u32Index + 8 <= u32Samples; u32Index += 8)
+    {
+        __m128i stIn = _mm_loadu_si128((const __m128i *)(ps16Stream + u32Index));
+        __m128  stLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(stIn, stIn), 16));
+        __m128  stHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(stIn, stIn), 16));
+
+        stLo = _mm_add_ps(stLo, _mm_loadu_ps(pfMix + u32Index));
+        stHi = _mm_add_ps(stHi, _mm_loadu_ps(pfMix + u32Index + 4));
+
+        // Packing saturates.
+        _mm_storeu_si128((__m128i *)(ps16Stream + u32Index),
+            _mm_packs_epi32(_mm_cvtps_epi32(stLo), _mm_cvtps_epi32(stHi)));
+    }
+
+    _ResolveScalar(ps16Stream + u32Index, pfMix + u32Index, u32Samples - u32Index);
+}
+#endif
+
+#ifdef VOICE_AVX2
+__attribute__((target("avx2")))
+static void _AccumulateAVX2(
+    float         *pfMix,
+    const int16_t *ps16Samples,
+    uint32_t       u32Samples,
+    float          fGainLeft,
+    float          fGainRight)
+{
+    __m256 stGain = _mm256_setr_ps(
+        fGainLeft, fGainRight, fGainLeft, fGainRight,
+        fGainLeft, fGainRight, fGainLeft, fGainRight);
+    uint32_t u32Index = 0;
+
+    for (; u32Index + 16 <= u32Samples; u32Index += 16)
+    {
+        __m256 stLo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(ps16Samples + u32Index))));
+        __m256 stHi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(ps16Samples + u32Index + 8))));
+
+        _mm256_storeu_ps(pfMix + u32Index,
+            _mm256_add_ps(_mm256_loadu_ps(pfMix + u32Index), _mm256_mul_ps(stLo, stGain)));
+        _mm256_storeu_ps(pfMix + u32Index + 8,
+            _mm256_add_ps(_mm256_loadu_ps(pfMix + u32Index + 8), _mm256_mul_ps(stHi, stGain)));
+    }
+
+    _AccumulateScalar(
+        pfMix + u32Index,
+        ps16Samples + u32Index,
+        u32Samples - u32Index,
+        fGainLeft,
+        fGainRight);
+}
+#endif
+
+static void _SelectKernels()
+{
+    _pfnAccumulate = _AccumulateScalar;
+    _pfnResolve    = _ResolveScalar;
+    _pacMixerName  = "scalar";
+
+    #ifdef VOICE_SSE2
+    _pfnAccumulate = _AccumulateSSE2;
+    _pfnResolve    = _ResolveSSE2;
+    _pacMixerName  = "SSE2";
+    #endif
+
+    #ifdef VOICE_AVX2
+    if (SDL_HasAVX2())
+    {
+        _pfnAccumulate = _AccumulateAVX2;
+        _pacMixerName  = "AVX2";
+    }
+    #endif
+}
+
+/* Returns a free voice or the one to steal: the oldest of the lowest
+ * priority, but never one which is more important than the new one. */
+static Voice *_FindVoice(VoicePool *pstPool, uint8_t u8Priority)
+{
+    Voice *pstVictim = NULL;
+
+    if (pstPool->u16Active < pstPool->u16Voices)
+    {
+        return &pstPool->pstVoices[pstPool->u16Active++];
+    }
+
+    for (uint16_t u16Index = 0; u16Index < pstPool->u16Active; u16Index++)
+    {
+        Voice *pstVoice = &pstPool->pstVoices[u16Index];
+
+        if (pstVoice->u8Priority > u8Priority)
+        {
+            continue;
+        }
+
+        if ((NULL == pstVictim) ||
+            (pstVoice->u8Priority < pstVictim->u8Priority) ||
+            ((pstVoice->u8Priority == pstVictim->u8Priority) &&
+             ((int32_t)(pstVoice->u32Started - pstVictim->u32Started) < 0)))
+        {
+            pstVictim = pstVoice;
+        }
+    }
+
+    if (pstVictim)
+    {
+        SDL_AtomicAdd(&pstPool->stStolen, 1);
+    }
+
+    return pstVictim;
+}
+
+static void _StartQueuedVoices(VoicePool *pstPool)
+{
+    uint32_t u32Head = SDL_AtomicGet(&pstPool->stHead);
+    uint32_t u32Tail = SDL_AtomicGet(&pstPool->stTail);
+
+    SDL_MemoryBarrierAcquire();
+
+    for (; u32Tail != u32Head; u32Tail++)
+    {
+        const VoiceCommand *pstCommand = &pstPool->stQueue[u32Tail & (VOICE_QUEUE - 1)];
+        Voice              *pstVoice   = _FindVoice(pstPool, pstCommand->u8Priority);
+
+        if (NULL == pstVoice)
+        {
+            SDL_AtomicAdd(&pstPool->stDropped, 1);
+            continue;
+        }
+
+        pstVoice->ps16Samples = pstCommand->ps16Samples;
+        pstVoice->u32Frames   = pstCommand->u32Frames;
+        pstVoice->u32Position = 0;
+        pstVoice->u32Started  = pstPool->u32Serial++;
+        pstVoice->fGain[0]    = pstCommand->fGain[0];
+        pstVoice->fGain[1]    = pstCommand->fGain[1];
+        pstVoice->s8Loops     = pstCommand->s8Loops;
+        pstVoice->u8Priority  = pstCommand->u8Priority;
+    }
+
+    // The slots have been read before they are handed back.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&pstPool->stTail, u32Tail);
+}
+
+/* Returns 0 once the voice has finished. */
+static uint8_t _MixVoice(VoicePool *pstPool, Voice *pstVoice, uint32_t u32Frames)
+{
+    float   *pfMix      = pstPool->pfMix;
+    uint8_t  u8Channels = pstPool->u8Channels;
+
+    while (u32Frames)
+    {
+        uint32_t u32Count = pstVoice->u32Frames - pstVoice->u32Position;
+
+        if (u32Count > u32Frames)
+        {
+            u32Count = u32Frames;
+        }
+
+        _pfnAccumulate(
+            pfMix,
+            pstVoice->ps16Samples + pstVoice->u32Position * u8Channels,
+            u32Count * u8Channels,
+            pstVoice->fGain[0],
+            pstVoice->fGain[1]);
+
+        pfMix                 += u32Count * u8Channels;
+        u32Frames             -= u32Count;
+        pstVoice->u32Position += u32Count;
+
+        if (pstVoice->u32Position == pstVoice->u32Frames)
+        {
+            if (0 == pstVoice->s8Loops)
+            {
+                return 0;
+            }
+            if (0 < pstVoice->s8Loops)
+            {
+                pstVoice->s8Loops--;
+            }
+            pstVoice->u32Position = 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief   Free VoicePool from memory.  The audio callback must not use
+ *          it anymore.
+ * @param   pstPool the VoicePool.  See @ref struct VoicePool.
+ * @ingroup Voice
+ */
+void FreeVoicePool(VoicePool *pstPool)
+{
+    if (NULL == pstPool)
+    {
+        return;
+    }
+
+    FreeMemory(pstPool->pfMix);
+    FreeMemory(pstPool->pstVoices);
+    FreeMemory(pstPool);
+}
+
+/**
+ * @brief   Get the name of the mixing kernel in use.
+ * @return  "AVX2", "SSE2" or "scalar".
+ * @ingroup Voice
+ */
+const char *GetVoiceMixerName()
+{
+    if (NULL == _pacMixerName)
+    {
+        _SelectKernels();
+    }
+
+    return _pacMixerName;
+}
+
+/**
+ * @brief   Initialise VoicePool.  Everything the audio thread needs is
+ *          allocated up front.
+ * @param   u16Voices  the number of voices which can play at once.
+ * @param   u8Channels the number of output channels, 1 or 2.
+ * @return  VoicePool on success, NULL on error.
+ *          See @ref struct VoicePool.
+ * @ingroup Voice
+ */
+VoicePool *InitVoicePool(const uint16_t u16Voices, const uint8_t u8Channels)
+{
+    static VoicePool *pstPool;
+
+    if ((0 == u16Voices) || (1 > u8Channels) || (2 < u8Channels))
+    {
+        fprintf(stderr, "InitVoicePool(): unsupported configuration.\n");
+        return NULL;
+    }
+
+    pstPool = CallocMemory(MEMORY_AUDIO, 1, sizeof(struct VoicePool_t));
+    if (NULL == pstPool)
+    {
+        fprintf(stderr, "InitVoicePool(): error allocating memory.\n");
+        return NULL;
+    }
+
+    pstPool->pstVoices = CallocMemory(MEMORY_AUDIO, u16Voices, sizeof(struct Voice_t));
+    pstPool->pfMix     = AllocMemory(MEMORY_AUDIO, VOICE_BLOCK_FRAMES * u8Channels * sizeof(float));
+    if ((NULL == pstPool->pstVoices) || (NULL == pstPool->pfMix))
+    {
+        fprintf(stderr, "InitVoicePool(): error allocating memory.\n");
+        FreeVoicePool(pstPool);
+        return NULL;
+    }
+
+    pstPool->u16Voices  = u16Voices;
+    pstPool->u8Channels = u8Channels;
+
+    if (NULL == _pacMixerName)
+    {
+        _SelectKernels();
+    }
+
+    return pstPool;
+}
+
+/**
+ * @brief   Start queued voices and add all voices to an audio stream.
+ *          Called on the audio thread, e.g. from a post-mix callback.
+ * @param   pstPool   the VoicePool.  See @ref struct VoicePool.
+ * @param   pu8Stream signed 16-bit interleaved samples.
+ * @param   s32Length the length of the stream in bytes.
+ * @ingroup Voice
+ */
+void MixVoices(
+    VoicePool *pstPool,
+    uint8_t   *pu8Stream,
+    int32_t    s32Length)
+{
+    int16_t  *ps16Stream = (int16_t *)pu8Stream;
+    uint32_t  u32Frames  = s32Length / (sizeof(int16_t) * pstPool->u8Channels);
+
+    _StartQueuedVoices(pstPool);
+
+    while (u32Frames && pstPool->u16Active)
+    {
+        uint32_t u32Block   = u32Frames < VOICE_BLOCK_FRAMES ? u32Frames : VOICE_BLOCK_FRAMES;
+        uint32_t u32Samples = u32Block * pstPool->u8Channels;
+        uint16_t u16Index   = 0;
+
+        memset(pstPool->pfMix, 0, u32Samples * sizeof(float));
+
+        while (u16Index < pstPool->u16Active)
+        {
+            if (_MixVoice(pstPool, &pstPool->pstVoices[u16Index], u32Block))
+            {
+                u16Index++;
+                continue;
+            }
+
+            // Keep the playing voices packed at the front.
+            pstPool->u16Active--;
+            pstPool->pstVoices[u16Index] = pstPool->pstVoices[pstPool->u16Active];
+        }
+
+        _pfnResolve(ps16Stream, pstPool->pfMix, u32Samples);
+
+        ps16Stream += u32Samples;
+        u32Frames  -= u32Block;
+    }
+
+    SDL_AtomicSet(&pstPool->stActive, pstPool->u16Active);
+}
+
+/**
+ * @brief   Queue a voice.  Must always be called from the same thread.
+ * @param   pstPool     the VoicePool.  See @ref struct VoicePool.
+ * @param   ps16Samples interleaved samples in the format of the device.
+ *                      Must stay valid while the voice is playing.
+ * @param   u32Frames   the number of frames.
+ * @param   fGain       the volume, 1.0 plays the samples unchanged.
+ * @param   fPan        -1.0 is left, 0.0 is centre and 1.0 is right.
+ * @param   u8Priority  voices of a lower priority are stolen first.
+ * @param   s8Loops     number of loops, -1 plays the voice forever.
+ * @return  0 on success, -1 if the queue is full.
+ * @ingroup Voice
+ */
+int8_t PlayVoice(
+    VoicePool     *pstPool,
+    const int16_t *ps16Samples,
+    const uint32_t u32Frames,
+    const float    fGain,
+    const float    fPan,
+    const uint8_t  u8Priority,
+    const int8_t   s8Loops)
+{
+    uint32_t      u32Head  = SDL_AtomicGet(&pstPool->stHead);
+    uint32_t      u32Tail  = SDL_AtomicGet(&pstPool->stTail);
+    float         fClamped = fPan;
+    VoiceCommand *pstCommand;
+
+    if ((NULL == ps16Samples) || (0 == u32Frames))
+    {
+        return 0;
+    }
+
+    if (VOICE_QUEUE <= u32Head - u32Tail)
+    {
+        SDL_AtomicAdd(&pstPool->stDropped, 1);
+        return -1;
+    }
+
+    if (fClamped < -1.0f) { fClamped = -1.0f; }
+    if (fClamped >  1.0f) { fClamped =  1.0f; }
+
+    pstCommand              = &pstPool->stQueue[u32Head & (VOICE_QUEUE - 1)];
+    pstCommand->ps16Samples = ps16Samples;
+    pstCommand->u32Frames   = u32Frames;
+    pstCommand->s8Loops     = s8Loops;
+    pstCommand->u8Priority  = u8Priority;
+
+    // Linear panning, a centred voice plays at full volume on both sides.
+    if (1 == pstPool->u8Channels)
+    {
+        pstCommand->fGain[0] = fGain;
+        pstCommand->fGain[1] = fGain;
+    }
+    else
+    {
+        pstCommand->fGain[0] = fGain * (fClamped > 0.0f ? 1.0f - fClamped : 1.0f);
+        pstCommand->fGain[1] = fGain * (fClamped < 0.0f ? 1.0f + fClamped : 1.0f);
+    }
+
+    // The slot is written before it is handed to the audio thread.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&pstPool->stHead, 1);
+
+    return 0;
+}
+
+/**
+ * @brief   Stop all voices playing the given samples, including the
+ *          ones which are still queued, e.g. before the samples are
+ *          freed.  Must not run concurrently with MixVoices(), i.e.
+ *          the audio device has to be locked.
+ * @param   pstPool     the VoicePool.  See @ref struct VoicePool.
+ * @param   ps16Samples the samples.
+ * @ingroup Voice
+ */
+void StopVoices(VoicePool *pstPool, const int16_t *ps16Samples)
+{
+    uint16_t u16Index = 0;
+
+    _StartQueuedVoices(pstPool);
+
+    while (u16Index < pstPool->u16Active)
+    {
+        if (ps16Samples != pstPool->pstVoices[u16Index].ps16Samples)
+        {
+            u16Index++;
+            continue;
+        }
+
+        pstPool->u16Active--;
+        pstPool->pstVoices[u16Index] = pstPool->pstVoices[pstPool->u16Active];
+    }
+
+    SDL_AtomicSet(&pstPool->stActive, pstPool->u16Active);
+}
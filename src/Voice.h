@@ -0,0 +1,94 @@
+/**
+ * @file    Voice.h
+ * @ingroup Voice
+ */
+
+#ifndef _VOICE_H_
+#define _VOICE_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Voice
+ */
+enum VoiceLimits
+{
+    VOICE_QUEUE        = 64,   // Power of two.
+    VOICE_BLOCK_FRAMES = 1024
+};
+
+/**
+ * @ingroup Voice
+ * @brief   A sound which is playing.  ps16Samples holds u32Frames
+ *          frames of interleaved signed 16-bit samples in the format of
+ *          the audio device.
+ */
+typedef struct Voice_t
+{
+    const int16_t *ps16Samples;
+    uint32_t       u32Frames;
+    uint32_t       u32Position;
+    uint32_t       u32Started;
+    float          fGain[2];
+    int8_t         s8Loops;
+    uint8_t        u8Priority;
+} Voice;
+
+/**
+ * @ingroup Voice
+ * @brief   A request to start a voice, passed to the audio thread.
+ */
+typedef struct VoiceCommand_t
+{
+    const int16_t *ps16Samples;
+    uint32_t       u32Frames;
+    float          fGain[2];
+    int8_t         s8Loops;
+    uint8_t        u8Priority;
+} VoiceCommand;
+
+/**
+ * @ingroup Voice
+ * @brief   Voices mixed by the engine on the audio thread.  The first
+ *          u16Active entries of pstVoices are playing.  New voices are
+ *          queued by one thread, e.g. the main loop, without locking
+ *          and started by the next callback.
+ */
+typedef struct VoicePool_t
+{
+    Voice        *pstVoices;
+    float        *pfMix;
+    VoiceCommand  stQueue[VOICE_QUEUE];
+    SDL_atomic_t  stHead;
+    SDL_atomic_t  stTail;
+    SDL_atomic_t  stStolen;
+    SDL_atomic_t  stDropped;
+    SDL_atomic_t  stActive;
+    uint32_t      u32Serial;
+    uint16_t      u16Voices;
+    uint16_t      u16Active;
+    uint8_t       u8Channels;
+} VoicePool;
+
+void        FreeVoicePool(VoicePool *pstPool);
+const char *GetVoiceMixerName();
+VoicePool  *InitVoicePool(const uint16_t u16Voices, const uint8_t u8Channels);
+
+void MixVoices(
+    VoicePool *pstPool,
+    uint8_t   *pu8Stream,
+    int32_t    s32Length);
+
+int8_t PlayVoice(
+    VoicePool     *pstPool,
+    const int16_t *ps16Samples,
+    const uint32_t u32Frames,
+    const float    fGain,
+    const float    fPan,
+    const uint8_t  u8Priority,
+    const int8_t   s8Loops);
+
+void StopVoices(VoicePool *pstPool, const int16_t *ps16Samples);
+
+#endif // _VOICE_H_
@@ -0,0 +1,887 @@
+/**
+ * @file      Bench.c
+ * @ingroup   Bench
+ * @defgroup  Bench
+ * @brief     Map loader microbenchmarks.  Maps of increasing size are
+ *            generated in every layer encoding supported by Tiled, the
+ *            results are written to stdout as JSON.  The voice mixer and
+ *            the software renderer's blitters are measured as well, the
+ *            latter next to SDL_BlitSurface().  With --counters,
+ *            every case is also wrapped in hardware performance
+ *            counters.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Blit.h"
+#include "../Job.h"
+#include "../Map.h"
+#include "../Swarm.h"
+#include "../Video.h"
+#include "../Voice.h"
+#include "../tmx/tmx.h"
+#include "../tmx/tsx.h"
+#include "../tmx/tmx_utils.h"
+#include "PerfCounters.h"
+#include "StressMap.h"
+
+#define BENCH_MIN_TIME  0.25
+#define BENCH_MAX_ITER  1000000
+#define BENCH_QUERIES   65536
+#define BENCH_TILECOUNT 64
+#define BENCH_ENTITIES  4096
+#define BENCH_CHUNK     1024
+#define BENCH_SFX       44100
+#define BENCH_FRAME_W   640
+#define BENCH_FRAME_H   360
+#define BENCH_SPRITES   256
+#define BENCH_STRIP_H   216
+#define BENCH_LAYERS    7
+
+/**
+ * @ingroup Bench
+ * @brief   Everything a benchmark case needs.  Which fields are used
+ *          depends on the case.
+ */
+typedef struct BenchCase_t
+{
+    const char    *pacSource;
+    uint32_t       u32SourceLength;
+    uint32_t       u32Gids;
+    uint32_t       u32RawLength;
+    enum enccmp_t  eType;
+    const char    *pacFilename;
+    Map           *pstMap;
+    Swarm         *pstSwarm;
+    VoicePool     *pstVoices;
+    int16_t       *ps16Stream;
+    SDL_Surface   *pstImage;
+    SDL_Surface   *pstFrame;
+    SDL_Surface   *pstStrip;
+    SDL_Surface   *pstWindow;
+    int32_t       *ps32Columns;
+    uint64_t       u64Sink;
+    uint8_t        u8Flip;
+    uint8_t        u8Jobs;
+    uint8_t        u8Failed;
+} BenchCase;
+
+typedef void (*BenchFunc)(BenchCase *pstCase);
+
+static const uint32_t _u32Sizes[][2] = {
+    {   70,   50 },
+    {  256,  256 },
+    { 1024, 1024 },
+    { 2048, 2048 },
+    { 4096, 4096 }
+};
+#define SIZE_COUNT (sizeof(_u32Sizes) / sizeof(_u32Sizes[0]))
+
+static uint8_t  _u8First       = 1;
+static uint32_t _u32Seed       = 1;
+static uint32_t _u32CsvMaxSize = 512;
+
+static PerfCounters *_pstCounters = NULL;
+static JobSystem    *_pstJobs     = NULL;
+
+static uint32_t _Random()
+{
+    _u32Seed = _u32Seed * 1103515245 + 12345;
+    return _u32Seed >> 8;
+}
+
+static int32_t *_MakeGids(uint32_t u32Width, uint32_t u32Height)
+{
+    int32_t *ps32Gids = malloc((size_t)u32Width * u32Height * sizeof(int32_t));
+    if (NULL == ps32Gids)
+    {
+        return NULL;
+    }
+
+    // A pattern which doesn't compress too well; 0 is an empty tile.
+    for (uint32_t u32Y = 0; u32Y < u32Height; u32Y++)
+    {
+        for (uint32_t u32X = 0; u32X < u32Width; u32X++)
+        {
+            ps32Gids[u32Y * u32Width + u32X] = (u32X * 7 + u32Y * 13) % (BENCH_TILECOUNT + 1);
+        }
+    }
+
+    return ps32Gids;
+}
+
+static int8_t _WriteMap(
+    const char *pacFilename,
+    const char *pacData,
+    uint32_t    u32Width,
+    uint32_t    u32Height,
+    uint8_t     u8Encoding)
+{
+    FILE *pstFile = fopen(pacFilename, "w");
+
+    if (NULL == pstFile)
+    {
+        return -1;
+    }
+
+    fprintf(pstFile,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<map version=\"1.0\" orientation=\"orthogonal\" renderorder=\"right-down\""
+        " width=\"%u\" height=\"%u\" tilewidth=\"16\" tileheight=\"16\" infinite=\"0\">\n"
+        " <tileset firstgid=\"1\" name=\"bench\" tilewidth=\"16\" tileheight=\"16\""
+        " tilecount=\"%u\" columns=\"8\">\n"
+        "  <image source=\"bench.png\" width=\"128\" height=\"128\"/>\n",
+        u32Width, u32Height, BENCH_TILECOUNT);
+
+    for (uint8_t u8Tile = 0; u8Tile < 8; u8Tile++)
+    {
+        fprintf(pstFile, "  <tile id=\"%u\" type=\"Floor\"/>\n", u8Tile);
+    }
+
+    fprintf(pstFile,
+        " </tileset>\n"
+        " <layer name=\"Background\" width=\"%u\" height=\"%u\">\n"
+        "  <data %s>\n%s\n  </data>\n"
+        " </layer>\n"
+        "</map>\n",
+        u32Width, u32Height, GetStressMapEncodingAttributes(u8Encoding), pacData);
+
+    fclose(pstFile);
+
+    return 0;
+}
+
+static void _BenchDataDecode(BenchCase *pstCase)
+{
+    int32_t *ps32Gids = NULL;
+
+    if (data_decode(pstCase->pacSource, pstCase->eType, pstCase->u32Gids, &ps32Gids))
+    {
+        free(ps32Gids);
+    }
+    else
+    {
+        pstCase->u8Failed = 1;
+    }
+}
+
+static void _BenchB64Decode(BenchCase *pstCase)
+{
+    unsigned int uLength;
+
+    free(b64_decode(pstCase->pacSource, &uLength));
+}
+
+static void _BenchZlibDecompress(BenchCase *pstCase)
+{
+    free(zlib_decompress(pstCase->pacSource, pstCase->u32SourceLength, pstCase->u32RawLength));
+}
+
+static void _BenchTmxLoad(BenchCase *pstCase)
+{
+    tmx_map *pstTmxMap = tmx_load(pstCase->pacFilename);
+
+    if (NULL == pstTmxMap)
+    {
+        pstCase->u8Failed = 1;
+    }
+    tmx_map_free(pstTmxMap);
+}
+
+static void _BenchMkMapTileArray(BenchCase *pstCase)
+{
+    tmx_map *pstTmxMap = pstCase->pstMap->pstTmxMap;
+
+    free(pstTmxMap->tiles);
+    pstTmxMap->tiles = NULL;
+    mk_map_tile_array(pstTmxMap);
+}
+
+static void _BenchIsMapCoordOfType(BenchCase *pstCase)
+{
+    double   dMaxX   = pstCase->pstMap->u32Width;
+    double   dMaxY   = pstCase->pstMap->u32Height;
+    uint32_t u32Hits = 0;
+
+    _u32Seed = 1;
+    for (uint32_t u32Query = 0; u32Query < BENCH_QUERIES; u32Query++)
+    {
+        double dX = (_Random() % 65536) / 65536.0 * dMaxX;
+        double dY = (_Random() % 65536) / 65536.0 * dMaxY;
+
+        u32Hits += IsMapCoordOfType(pstCase->pstMap, "Floor", dX, dY);
+    }
+
+    // Keep the compiler from dropping the loop.
+    pstCase->u64Sink += u32Hits;
+}
+
+static void _BenchUpdateSwarm(BenchCase *pstCase)
+{
+    UpdateSwarm(pstCase->pstSwarm, pstCase->pstMap, NULL, 1.0 / 60.0);
+}
+
+static void _BenchUpdateSwarmJobs(BenchCase *pstCase)
+{
+    UpdateSwarm(pstCase->pstSwarm, pstCase->pstMap, _pstJobs, 1.0 / 60.0);
+}
+
+static void _BenchMixVoices(BenchCase *pstCase)
+{
+    MixVoices(pstCase->pstVoices, (uint8_t *)pstCase->ps16Stream, BENCH_CHUNK * 2 * sizeof(int16_t));
+}
+
+static Pixels _GetPixels(SDL_Surface *pstSurface)
+{
+    Pixels stPixels =
+    {
+        pstSurface->pixels,
+        pstSurface->pitch / sizeof(uint32_t),
+        pstSurface->w,
+        pstSurface->h
+    };
+
+    return stPixels;
+}
+
+/* A 16x16 tile at every position of the frame, as when a map layer is
+ * baked. */
+static void _BenchBlitTiles(BenchCase *pstCase)
+{
+    Pixels stFrame = _GetPixels(pstCase->pstFrame);
+    Pixels stImage = _GetPixels(pstCase->pstImage);
+
+    for (int32_t s32Y = 0; s32Y < BENCH_FRAME_H; s32Y += 16)
+    {
+        for (int32_t s32X = 0; s32X < BENCH_FRAME_W; s32X += 16)
+        {
+            SDL_Rect stSrc = { (s32X + s32Y) % 128, s32Y % 128, 16, 16 };
+            BlitPixels(&stFrame, NULL, &stImage, &stSrc, s32X, s32Y, 1, 0);
+        }
+    }
+}
+
+static void _BenchBlitSurfaceTiles(BenchCase *pstCase)
+{
+    for (int32_t s32Y = 0; s32Y < BENCH_FRAME_H; s32Y += 16)
+    {
+        for (int32_t s32X = 0; s32X < BENCH_FRAME_W; s32X += 16)
+        {
+            SDL_Rect stSrc = { (s32X + s32Y) % 128, s32Y % 128, 16, 16 };
+            SDL_Rect stDst = { s32X, s32Y, 16, 16 };
+            SDL_BlitSurface(pstCase->pstImage, &stSrc, pstCase->pstFrame, &stDst);
+        }
+    }
+}
+
+/* 32x32 sprites spread over the frame, some of them clipped. */
+static void _BenchBlitSprites(BenchCase *pstCase)
+{
+    Pixels stFrame = _GetPixels(pstCase->pstFrame);
+    Pixels stImage = _GetPixels(pstCase->pstImage);
+
+    for (int32_t s32Index = 0; s32Index < BENCH_SPRITES; s32Index++)
+    {
+        SDL_Rect stSrc = { (s32Index % 4) * 32, (s32Index % 3) * 32, 32, 32 };
+
+        BlitPixels(
+            &stFrame,
+            NULL,
+            &stImage,
+            &stSrc,
+            (s32Index * 97) % (BENCH_FRAME_W + 32) - 16,
+            (s32Index * 61) % (BENCH_FRAME_H + 32) - 16,
+            1,
+            pstCase->u8Flip);
+    }
+}
+
+static void _BenchBlitSurfaceSprites(BenchCase *pstCase)
+{
+    for (int32_t s32Index = 0; s32Index < BENCH_SPRITES; s32Index++)
+    {
+        SDL_Rect stSrc = { (s32Index % 4) * 32, (s32Index % 3) * 32, 32, 32 };
+        SDL_Rect stDst =
+        {
+            (s32Index * 97) % (BENCH_FRAME_W + 32) - 16,
+            (s32Index * 61) % (BENCH_FRAME_H + 32) - 16,
+            32,
+            32
+        };
+
+        SDL_BlitSurface(pstCase->pstImage, &stSrc, pstCase->pstFrame, &stDst);
+    }
+}
+
+/* A parallax strip across the frame, opaque apart from the sky. */
+static void _BenchBlitStrip(BenchCase *pstCase)
+{
+    Pixels stFrame = _GetPixels(pstCase->pstFrame);
+    Pixels stStrip = _GetPixels(pstCase->pstStrip);
+
+    BlitPixels(&stFrame, NULL, &stStrip, NULL, 0, BENCH_FRAME_H - BENCH_STRIP_H, 1, 0);
+}
+
+static void _BenchBlitSurfaceStrip(BenchCase *pstCase)
+{
+    SDL_Rect stDst = { 0, BENCH_FRAME_H - BENCH_STRIP_H, BENCH_FRAME_W, BENCH_STRIP_H };
+
+    SDL_BlitSurface(pstCase->pstStrip, NULL, pstCase->pstFrame, &stDst);
+}
+
+/* The frame scaled up to a 1920x1080 window. */
+static void _BenchScaleFrame(BenchCase *pstCase)
+{
+    Pixels   stWindow = _GetPixels(pstCase->pstWindow);
+    Pixels   stFrame  = _GetPixels(pstCase->pstFrame);
+    SDL_Rect stRect   = { 0, 0, stWindow.s32Width, stWindow.s32Height };
+
+    ScalePixels(&stWindow, &stRect, &stFrame, pstCase->ps32Columns, BENCH_FRAME_H);
+}
+
+static void _BenchBlitScaledFrame(BenchCase *pstCase)
+{
+    SDL_BlitScaled(pstCase->pstFrame, NULL, pstCase->pstWindow, NULL);
+}
+
+/* The rows u32Begin to u32End - 1 of seven layers of strips covering a
+ * 1920x1080 window, like the five parallax layers and the two map
+ * layers, drawn the way the software renderer runs its bands. */
+static void _BlitBand(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    BenchCase *pstCase  = pData;
+    Pixels     stWindow = _GetPixels(pstCase->pstWindow);
+    Pixels     stStrip  = _GetPixels(pstCase->pstStrip);
+    SDL_Rect   stBand   = { 0, u32Begin, stWindow.s32Width, u32End - u32Begin };
+
+    for (uint8_t u8Layer = 0; u8Layer < BENCH_LAYERS; u8Layer++)
+    {
+        for (int32_t s32Y = 0; s32Y < stWindow.s32Height; s32Y += BENCH_STRIP_H)
+        {
+            for (int32_t s32X = 0; s32X < stWindow.s32Width; s32X += BENCH_FRAME_W)
+            {
+                BlitPixels(&stWindow, &stBand, &stStrip, NULL, s32X, s32Y, 1, 0);
+            }
+        }
+    }
+}
+
+static void _BenchBlitBands(BenchCase *pstCase)
+{
+    ParallelFor(NULL, pstCase->pstWindow->h, VIDEO_BAND_ROWS, _BlitBand, pstCase);
+}
+
+static void _BenchBlitBandsJobs(BenchCase *pstCase)
+{
+    ParallelFor(_pstJobs, pstCase->pstWindow->h, VIDEO_BAND_ROWS, _BlitBand, pstCase);
+}
+
+static void _PrintCounters(double dOps, uint8_t u8Jobs)
+{
+    if (NULL == _pstCounters)
+    {
+        return;
+    }
+
+    /* The counters only see the calling thread, not the workers, so
+     * they would leave out most of the work. */
+    if ((u8Jobs) && (_pstJobs->u8Workers))
+    {
+        printf(", \"counters\": null");
+        fprintf(stderr, "%44s counters n/a (main thread only)\n", "");
+        return;
+    }
+
+    printf(", \"counters\": {");
+    for (uint8_t u8Counter = 0; u8Counter < PERF_COUNTERS; u8Counter++)
+    {
+        printf("%s\"%s\": ", u8Counter ? ", " : "", GetPerfCounterName(u8Counter));
+        if (IsPerfCounterAvailable(_pstCounters, u8Counter))
+        {
+            printf("%.2f", _pstCounters->u64Value[u8Counter] / dOps);
+        }
+        else
+        {
+            printf("null");
+        }
+    }
+    printf("}");
+
+    if (IsPerfCounterAvailable(_pstCounters, PERF_CYCLES) &&
+        IsPerfCounterAvailable(_pstCounters, PERF_INSTRUCTIONS) &&
+        _pstCounters->u64Value[PERF_CYCLES])
+    {
+        fprintf(stderr, "%44s %.1f cycles/op, %.2f IPC, %.2f L1d / %.2f LLC / %.2f branch misses per op\n", "",
+            _pstCounters->u64Value[PERF_CYCLES] / dOps,
+            (double)_pstCounters->u64Value[PERF_INSTRUCTIONS] / _pstCounters->u64Value[PERF_CYCLES],
+            _pstCounters->u64Value[PERF_L1D_MISSES] / dOps,
+            _pstCounters->u64Value[PERF_LLC_MISSES] / dOps,
+            _pstCounters->u64Value[PERF_BRANCH_MISSES] / dOps);
+    }
+}
+
+static void _Run(
+    const char *pacName,
+    const char *pacEncoding,
+    uint32_t    u32Width,
+    uint32_t    u32Height,
+    uint64_t    u64Bytes,
+    uint32_t    u32OpsPerCall,
+    BenchFunc   pfnBench,
+    BenchCase  *pstCase)
+{
+    double   dFrequency = SDL_GetPerformanceFrequency();
+    uint64_t u64Start;
+    uint64_t u64Ticks   = 0;
+    uint32_t u32Iter    = 0;
+    double   dSeconds;
+    double   dNsPerOp;
+
+    fprintf(stderr, "%-20s %-12s %4ux%-4u ", pacName, pacEncoding, u32Width, u32Height);
+
+    // Warm up the caches and the allocator.
+    pstCase->u8Failed = 0;
+    pfnBench(pstCase);
+
+    if (pstCase->u8Failed)
+    {
+        fprintf(stderr, "failed: %s\n", tmx_strerr());
+        printf("%s    {\"name\": \"%s\", \"encoding\": \"%s\", \"width\": %u, \"height\": %u, "
+            "\"failed\": true}",
+            _u8First ? "" : ",\n",
+            pacName, pacEncoding, u32Width, u32Height);
+        _u8First = 0;
+        return;
+    }
+
+    if (_pstCounters)
+    {
+        StartPerfCounters(_pstCounters);
+    }
+
+    while ((u64Ticks / dFrequency < BENCH_MIN_TIME) && (u32Iter < BENCH_MAX_ITER))
+    {
+        u64Start  = SDL_GetPerformanceCounter();
+        pfnBench(pstCase);
+        u64Ticks += SDL_GetPerformanceCounter() - u64Start;
+        u32Iter++;
+    }
+
+    if (_pstCounters)
+    {
+        StopPerfCounters(_pstCounters);
+    }
+
+    dSeconds = u64Ticks / dFrequency;
+    dNsPerOp = dSeconds * 1e9 / ((double)u32Iter * u32OpsPerCall);
+    fprintf(stderr, "%14.1f ns/op\n", dNsPerOp);
+
+    printf("%s    {\"name\": \"%s\", \"encoding\": \"%s\", \"width\": %u, \"height\": %u, "
+        "\"iterations\": %u, \"ns_per_op\": %.1f, ",
+        _u8First ? "" : ",\n",
+        pacName, pacEncoding, u32Width, u32Height, u32Iter, dNsPerOp);
+
+    if (u64Bytes)
+    {
+        printf("\"bytes\": %llu, \"mb_per_s\": %.2f",
+            (unsigned long long)u64Bytes,
+            u64Bytes * (double)u32Iter / dSeconds / (1024.0 * 1024.0));
+    }
+    else
+    {
+        printf("\"bytes\": 0, \"mb_per_s\": null");
+    }
+    _PrintCounters((double)u32Iter * u32OpsPerCall, pstCase->u8Jobs);
+    printf("}");
+    fflush(stdout);
+
+    _u8First = 0;
+}
+
+static void _BenchVoices(uint16_t u16Voices)
+{
+    int16_t  *ps16Sfx = malloc(BENCH_SFX * 2 * sizeof(int16_t));
+    BenchCase stCase;
+
+    memset(&stCase, 0, sizeof(stCase));
+    stCase.pstVoices  = InitVoicePool(u16Voices, 2);
+    stCase.ps16Stream = calloc(BENCH_CHUNK * 2, sizeof(int16_t));
+
+    if ((NULL == ps16Sfx) || (NULL == stCase.pstVoices) || (NULL == stCase.ps16Stream))
+    {
+        fprintf(stderr, "Bench: error allocating memory.\n");
+    }
+    else
+    {
+        for (uint32_t u32Index = 0; u32Index < BENCH_SFX * 2; u32Index++)
+        {
+            ps16Sfx[u32Index] = (int16_t)(_Random() & 0xffff) / 8;
+        }
+
+        // Looping voices at different offsets and positions.  The queue
+        // only holds VOICE_QUEUE voices, mixing starts them.
+        for (uint16_t u16Voice = 0; u16Voice < u16Voices; u16Voice++)
+        {
+            uint32_t u32Offset = _Random() % (BENCH_SFX / 2);
+            float    fPan      = (u16Voice % 9) / 4.0f - 1.0f;
+
+            if (0 == u16Voice % VOICE_QUEUE)
+            {
+                _BenchMixVoices(&stCase);
+            }
+            PlayVoice(stCase.pstVoices, ps16Sfx + u32Offset * 2, BENCH_SFX - u32Offset, 0.5f, fPan, 0, -1);
+        }
+        _BenchMixVoices(&stCase);
+
+        // Nanoseconds per voice and chunk.
+        _Run("MixVoices", GetVoiceMixerName(), u16Voices, BENCH_CHUNK,
+            (uint64_t)u16Voices * BENCH_CHUNK * 2 * sizeof(int16_t),
+            u16Voices, _BenchMixVoices, &stCase);
+    }
+
+    FreeVoicePool(stCase.pstVoices);
+    free(stCase.ps16Stream);
+    free(ps16Sfx);
+}
+
+/* Fill a surface with pixels of which a quarter is transparent, half is
+ * opaque and the rest translucent, unless u8Opaque is set; then only the
+ * top quarter has transparent and translucent pixels. */
+static void _FillSurface(SDL_Surface *pstSurface, uint8_t u8Opaque)
+{
+    for (int32_t s32Y = 0; s32Y < pstSurface->h; s32Y++)
+    {
+        uint32_t *pu32Row = (uint32_t *)((uint8_t *)pstSurface->pixels + s32Y * pstSurface->pitch);
+
+        for (int32_t s32X = 0; s32X < pstSurface->w; s32X++)
+        {
+            uint32_t u32Random = _Random();
+            uint32_t u32Alpha  = 255;
+
+            if ((0 == u8Opaque) || (s32Y < pstSurface->h / 4))
+            {
+                switch (u32Random & 3)
+                {
+                    case 0:
+                        u32Alpha = 0;
+                        break;
+                    case 3:
+                        u32Alpha = (u32Random >> 2) & 0xff;
+                        break;
+                }
+            }
+            pu32Row[s32X] = (u32Alpha << 24) | (_Random() & 0xffffff);
+        }
+    }
+}
+
+static void _BenchBlits(const char *pacFilter)
+{
+    const char *pacKernel = GetBlitKernelName();
+    BenchCase   stCase;
+    uint64_t    u64Tiles  = (BENCH_FRAME_W / 16) * ((BENCH_FRAME_H + 15) / 16);
+
+    memset(&stCase, 0, sizeof(stCase));
+    stCase.pstImage    = SDL_CreateRGBSurfaceWithFormat(0, 128, 128, 32, SDL_PIXELFORMAT_ARGB8888);
+    stCase.pstFrame    = SDL_CreateRGBSurfaceWithFormat(0, BENCH_FRAME_W, BENCH_FRAME_H, 32, SDL_PIXELFORMAT_ARGB8888);
+    stCase.pstStrip    = SDL_CreateRGBSurfaceWithFormat(0, BENCH_FRAME_W, BENCH_STRIP_H, 32, SDL_PIXELFORMAT_ARGB8888);
+    stCase.pstWindow   = SDL_CreateRGBSurfaceWithFormat(0, 1920, 1080, 32, SDL_PIXELFORMAT_ARGB8888);
+    stCase.ps32Columns = malloc(1920 * sizeof(int32_t));
+
+    if ((NULL == stCase.pstImage) || (NULL == stCase.pstFrame) || (NULL == stCase.pstStrip) ||
+        (NULL == stCase.pstWindow) || (NULL == stCase.ps32Columns))
+    {
+        fprintf(stderr, "Bench: error allocating memory.\n");
+    }
+    else
+    {
+        _FillSurface(stCase.pstImage, 0);
+        _FillSurface(stCase.pstFrame, 0);
+        _FillSurface(stCase.pstStrip, 1);
+        SDL_SetSurfaceBlendMode(stCase.pstImage, SDL_BLENDMODE_BLEND);
+        SDL_SetSurfaceBlendMode(stCase.pstStrip, SDL_BLENDMODE_BLEND);
+
+        if ((NULL == pacFilter) || strstr("BlitTiles", pacFilter))
+        {
+            _Run("BlitTiles", pacKernel, 16, 16, u64Tiles * 16 * 16 * 4,
+                u64Tiles, _BenchBlitTiles, &stCase);
+            _Run("BlitTiles", "SDL", 16, 16, u64Tiles * 16 * 16 * 4,
+                u64Tiles, _BenchBlitSurfaceTiles, &stCase);
+        }
+
+        if ((NULL == pacFilter) || strstr("BlitSprites", pacFilter))
+        {
+            _Run("BlitSprites", pacKernel, 32, 32, BENCH_SPRITES * 32 * 32 * 4,
+                BENCH_SPRITES, _BenchBlitSprites, &stCase);
+            // SDL_BlitSurface() can't flip.
+            stCase.u8Flip = 1;
+            _Run("BlitSprites_flip", pacKernel, 32, 32, BENCH_SPRITES * 32 * 32 * 4,
+                BENCH_SPRITES, _BenchBlitSprites, &stCase);
+            stCase.u8Flip = 0;
+            _Run("BlitSprites", "SDL", 32, 32, BENCH_SPRITES * 32 * 32 * 4,
+                BENCH_SPRITES, _BenchBlitSurfaceSprites, &stCase);
+        }
+
+        if ((NULL == pacFilter) || strstr("BlitStrip", pacFilter))
+        {
+            _Run("BlitStrip", pacKernel, BENCH_FRAME_W, BENCH_STRIP_H, BENCH_FRAME_W * BENCH_STRIP_H * 4,
+                1, _BenchBlitStrip, &stCase);
+            _Run("BlitStrip", "SDL", BENCH_FRAME_W, BENCH_STRIP_H, BENCH_FRAME_W * BENCH_STRIP_H * 4,
+                1, _BenchBlitSurfaceStrip, &stCase);
+        }
+
+        if ((NULL == pacFilter) || strstr("ScaleFrame", pacFilter))
+        {
+            for (int32_t s32X = 0; s32X < 1920; s32X++)
+            {
+                stCase.ps32Columns[s32X] = s32X * BENCH_FRAME_W / 1920;
+            }
+            SDL_SetSurfaceBlendMode(stCase.pstFrame, SDL_BLENDMODE_NONE);
+            _Run("ScaleFrame", "-", 1920, 1080, 1920 * 1080 * 4,
+                1, _BenchScaleFrame, &stCase);
+            _Run("ScaleFrame", "SDL", 1920, 1080, 1920 * 1080 * 4,
+                1, _BenchBlitScaledFrame, &stCase);
+        }
+
+        // Nanoseconds per layer.
+        if ((NULL == pacFilter) || strstr("BlitBands_jobs", pacFilter))
+        {
+            if ((NULL == pacFilter) || strstr("BlitBands", pacFilter))
+            {
+                _Run("BlitBands", pacKernel, 1920, 1080, BENCH_LAYERS * 1920 * 1080 * 4,
+                    BENCH_LAYERS, _BenchBlitBands, &stCase);
+            }
+            stCase.u8Jobs = 1;
+            _Run("BlitBands_jobs", pacKernel, 1920, 1080, BENCH_LAYERS * 1920 * 1080 * 4,
+                BENCH_LAYERS, _BenchBlitBandsJobs, &stCase);
+            stCase.u8Jobs = 0;
+        }
+    }
+
+    SDL_FreeSurface(stCase.pstImage);
+    SDL_FreeSurface(stCase.pstFrame);
+    SDL_FreeSurface(stCase.pstStrip);
+    SDL_FreeSurface(stCase.pstWindow);
+    free(stCase.ps32Columns);
+}
+
+static void _BenchSize(uint32_t u32Width, uint32_t u32Height, const char *pacFilter)
+{
+    uint32_t  u32Gids   = u32Width * u32Height;
+    uint32_t  u32Length = u32Gids * sizeof(int32_t);
+    int32_t  *ps32Gids  = _MakeGids(u32Width, u32Height);
+    BenchCase stCase;
+
+    if (NULL == ps32Gids)
+    {
+        fprintf(stderr, "Bench: error allocating memory.\n");
+        return;
+    }
+
+    memset(&stCase, 0, sizeof(stCase));
+    stCase.u32Gids      = u32Gids;
+    stCase.u32RawLength = u32Length;
+
+    for (uint8_t u8Encoding = 0; u8Encoding < STRESS_MAP_ENCODINGS; u8Encoding++)
+    {
+        const char *pacEncoding = GetStressMapEncodingName(u8Encoding);
+        char        acFilename[64];
+        char       *pacData;
+
+        /* The CSV decoder calls sscanf() on the remaining layer data for
+         * every tile, which is quadratic in the size of the map. */
+        if ((STRESS_MAP_CSV == u8Encoding) &&
+            ((u32Width > _u32CsvMaxSize) || (u32Height > _u32CsvMaxSize)))
+        {
+            fprintf(stderr, "%-20s %-12s %4ux%-4u skipped, see --csv-max-size\n",
+                "(all cases)", pacEncoding, u32Width, u32Height);
+            continue;
+        }
+
+        pacData = EncodeStressMapLayer(ps32Gids, u32Width, u32Height, u8Encoding);
+        if (NULL == pacData)
+        {
+            fprintf(stderr, "Bench: couldn't encode %s.\n", pacEncoding);
+            continue;
+        }
+
+        stCase.pacSource       = pacData;
+        stCase.u32SourceLength = strlen(pacData);
+        stCase.eType           = STRESS_MAP_CSV == u8Encoding ? CSV : (STRESS_MAP_B64 == u8Encoding ? B64 : B64Z);
+
+        if ((NULL == pacFilter) || strstr("data_decode", pacFilter))
+        {
+            _Run("data_decode", pacEncoding, u32Width, u32Height,
+                stCase.u32SourceLength, 1, _BenchDataDecode, &stCase);
+        }
+
+        if ((STRESS_MAP_B64 == u8Encoding) && ((NULL == pacFilter) || strstr("b64_decode", pacFilter)))
+        {
+            _Run("b64_decode", pacEncoding, u32Width, u32Height,
+                stCase.u32SourceLength, 1, _BenchB64Decode, &stCase);
+        }
+
+        if ((STRESS_MAP_B64_Z <= u8Encoding) && ((NULL == pacFilter) || strstr("zlib_decompress", pacFilter)))
+        {
+            unsigned int uCompressed;
+            char        *pacCompressed = b64_decode(pacData, &uCompressed);
+
+            if (pacCompressed)
+            {
+                stCase.pacSource       = pacCompressed;
+                stCase.u32SourceLength = uCompressed;
+                // Throughput of the decompressed output.
+                _Run("zlib_decompress", pacEncoding, u32Width, u32Height,
+                    u32Length, 1, _BenchZlibDecompress, &stCase);
+                free(pacCompressed);
+            }
+        }
+
+        snprintf(acFilename, sizeof(acFilename), "bench_%ux%u_%u.tmx", u32Width, u32Height, u8Encoding);
+        if (-1 == _WriteMap(acFilename, pacData, u32Width, u32Height, u8Encoding))
+        {
+            fprintf(stderr, "Bench: couldn't write %s.\n", acFilename);
+            tmx_free_func(pacData);
+            continue;
+        }
+        tmx_free_func(pacData);
+
+        stCase.pacFilename = acFilename;
+
+        if ((NULL == pacFilter) || strstr("tmx_load", pacFilter))
+        {
+            FILE *pstFile = fopen(acFilename, "r");
+            long  lSize   = 0;
+
+            if (pstFile)
+            {
+                fseek(pstFile, 0, SEEK_END);
+                lSize = ftell(pstFile);
+                fclose(pstFile);
+            }
+
+            _Run("tmx_load", pacEncoding, u32Width, u32Height,
+                lSize, 1, _BenchTmxLoad, &stCase);
+        }
+
+        // The remaining cases don't depend on the encoding.
+        if (STRESS_MAP_B64_Z == u8Encoding)
+        {
+            stCase.pstMap = InitMap(acFilename, "bench.png");
+            if (stCase.pstMap)
+            {
+                if ((NULL == pacFilter) || strstr("mk_map_tile_array", pacFilter))
+                {
+                    _Run("mk_map_tile_array", "-", u32Width, u32Height,
+                        stCase.pstMap->pstTmxMap->tilecount * sizeof(void *),
+                        1, _BenchMkMapTileArray, &stCase);
+                }
+
+                if ((NULL == pacFilter) || strstr("IsMapCoordOfType", pacFilter))
+                {
+                    _Run("IsMapCoordOfType", "-", u32Width, u32Height,
+                        0, BENCH_QUERIES, _BenchIsMapCoordOfType, &stCase);
+                }
+
+                if ((NULL == pacFilter) || strstr("UpdateSwarm_jobs", pacFilter))
+                {
+                    stCase.pstSwarm = InitSwarm(BENCH_ENTITIES, stCase.pstMap, NULL, NULL);
+                    if (stCase.pstSwarm)
+                    {
+                        if ((NULL == pacFilter) || strstr("UpdateSwarm", pacFilter))
+                        {
+                            _Run("UpdateSwarm", "-", u32Width, u32Height,
+                                0, BENCH_ENTITIES, _BenchUpdateSwarm, &stCase);
+                        }
+                        stCase.u8Jobs = 1;
+                        _Run("UpdateSwarm_jobs", "-", u32Width, u32Height,
+                            0, BENCH_ENTITIES, _BenchUpdateSwarmJobs, &stCase);
+                        stCase.u8Jobs = 0;
+                        FreeSwarm(stCase.pstSwarm);
+                        stCase.pstSwarm = NULL;
+                    }
+                }
+
+                FreeMap(stCase.pstMap);
+                stCase.pstMap = NULL;
+            }
+        }
+
+        remove(acFilename);
+    }
+
+    free(ps32Gids);
+}
+
+int32_t main(int32_t s32ArgC, char *pacArgV[])
+{
+    const char *pacFilter  = NULL;
+    uint32_t    u32MaxSize = 4096;
+
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        if ((0 == strcmp(pacArgV[s32Index], "--max-size")) && (s32Index + 1 < s32ArgC))
+        {
+            u32MaxSize = strtoul(pacArgV[++s32Index], NULL, 10);
+        }
+        else if ((0 == strcmp(pacArgV[s32Index], "--csv-max-size")) && (s32Index + 1 < s32ArgC))
+        {
+            _u32CsvMaxSize = strtoul(pacArgV[++s32Index], NULL, 10);
+        }
+        else if (0 == strcmp(pacArgV[s32Index], "--counters"))
+        {
+            // Timings only if the kernel doesn't allow counters.
+            _pstCounters = InitPerfCounters();
+        }
+        else if ('-' != pacArgV[s32Index][0])
+        {
+            pacFilter = pacArgV[s32Index];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--max-size N] [--csv-max-size N] [--counters] [case]\n", pacArgV[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // One worker per additional core for the _jobs cases.
+    _pstJobs = InitJobSystem(-1);
+    if (NULL == _pstJobs)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // data_decode() and friends are called without tmx_load().
+    tmx_alloc_func = realloc;
+    tmx_free_func  = free;
+
+    printf("{\n  \"benchmarks\": [\n");
+    for (uint8_t u8Size = 0; u8Size < SIZE_COUNT; u8Size++)
+    {
+        if ((_u32Sizes[u8Size][0] > u32MaxSize) || (_u32Sizes[u8Size][1] > u32MaxSize))
+        {
+            continue;
+        }
+        _BenchSize(_u32Sizes[u8Size][0], _u32Sizes[u8Size][1], pacFilter);
+    }
+
+    if ((NULL == pacFilter) || strstr("MixVoices", pacFilter))
+    {
+        _BenchVoices(16);
+        _BenchVoices(256);
+        _BenchVoices(1024);
+    }
+
+    _BenchBlits(pacFilter);
+    printf("\n  ]\n}\n");
+
+    FreePerfCounters(_pstCounters);
+    FreeJobSystem(_pstJobs);
+
+    return EXIT_SUCCESS;
+}
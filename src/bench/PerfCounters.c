@@ -0,0 +1,253 @@
+/**
+ * @file      PerfCounters.c
+ * @ingroup   PerfCounters
+ * @defgroup  PerfCounters
+ * @brief     Hardware performance counters using perf_event_open(2).
+ *            Linux only; elsewhere, or if the kernel doesn't allow
+ *            counters (see /proc/sys/kernel/perf_event_paranoid), no
+ *            counter is available and the benchmarks report timings
+ *            only.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_COUNTERS_SUPPORTED
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PerfCounters.h"
+
+static const char *_pacCounterNames[PERF_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "branch_misses"
+};
+
+#ifdef PERF_COUNTERS_SUPPORTED
+
+static int32_t _OpenCounter(uint8_t u8Counter)
+{
+    struct perf_event_attr stAttr;
+
+    memset(&stAttr, 0, sizeof(stAttr));
+    stAttr.size           = sizeof(stAttr);
+    stAttr.disabled       = 1;
+    stAttr.exclude_kernel = 1;
+    stAttr.exclude_hv     = 1;
+    // Counters are multiplexed if there are more than the PMU has.
+    stAttr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (u8Counter)
+    {
+        case PERF_CYCLES:
+            stAttr.type   = PERF_TYPE_HARDWARE;
+            stAttr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            stAttr.type   = PERF_TYPE_HARDWARE;
+            stAttr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            stAttr.type   = PERF_TYPE_HW_CACHE;
+            stAttr.config =
+                PERF_COUNT_HW_CACHE_L1D
+                | (PERF_COUNT_HW_CACHE_OP_READ     <<  8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_LLC_MISSES:
+            stAttr.type   = PERF_TYPE_HW_CACHE;
+            stAttr.config =
+                PERF_COUNT_HW_CACHE_LL
+                | (PERF_COUNT_HW_CACHE_OP_READ     <<  8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            stAttr.type   = PERF_TYPE_HARDWARE;
+            stAttr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+
+    // Calling thread, any CPU.
+    return syscall(SYS_perf_event_open, &stAttr, 0, -1, -1, 0);
+}
+
+#endif
+
+/**
+ * @brief   Close all counters and free PerfCounters.
+ * @param   pstCounters PerfCounters.  See @ref struct PerfCounters.
+ * @ingroup PerfCounters
+ */
+void FreePerfCounters(PerfCounters *pstCounters)
+{
+    if (NULL == pstCounters)
+    {
+        return;
+    }
+
+    #ifdef PERF_COUNTERS_SUPPORTED
+    for (uint8_t u8Counter = 0; u8Counter < PERF_COUNTERS; u8Counter++)
+    {
+        if (-1 != pstCounters->s32Fd[u8Counter])
+        {
+            close(pstCounters->s32Fd[u8Counter]);
+        }
+    }
+    #endif
+
+    free(pstCounters);
+}
+
+/**
+ * @brief   Get the name of a counter.
+ * @param   u8Counter the counter.  See @ref enum PerfCounter.
+ * @return  the name, e.g. cycles.
+ * @ingroup PerfCounters
+ */
+const char *GetPerfCounterName(const uint8_t u8Counter)
+{
+    if (u8Counter >= PERF_COUNTERS)
+    {
+        return "";
+    }
+
+    return _pacCounterNames[u8Counter];
+}
+
+/**
+ * @brief   Open the counters of the calling thread.  Counters which
+ *          can't be opened are marked as unavailable.
+ * @return  PerfCounters if at least one counter is available, NULL
+ *          otherwise.  See @ref struct PerfCounters.
+ * @ingroup PerfCounters
+ */
+PerfCounters *InitPerfCounters()
+{
+    #ifdef PERF_COUNTERS_SUPPORTED
+    static PerfCounters *pstCounters;
+    uint8_t              u8Available = 0;
+    int32_t              s32Error    = 0;
+
+    pstCounters = malloc(sizeof(struct PerfCounters_t));
+    if (NULL == pstCounters)
+    {
+        fprintf(stderr, "InitPerfCounters(): error allocating memory.\n");
+        return NULL;
+    }
+
+    for (uint8_t u8Counter = 0; u8Counter < PERF_COUNTERS; u8Counter++)
+    {
+        pstCounters->s32Fd[u8Counter]    = _OpenCounter(u8Counter);
+        pstCounters->u64Value[u8Counter] = 0;
+
+        if (-1 == pstCounters->s32Fd[u8Counter])
+        {
+            s32Error = errno;
+            continue;
+        }
+        u8Available++;
+    }
+
+    if (0 == u8Available)
+    {
+        fprintf(stderr, "Performance counters unavailable: %s\n", strerror(s32Error));
+        if ((EACCES == s32Error) || (EPERM == s32Error))
+        {
+            fprintf(stderr, "Check /proc/sys/kernel/perf_event_paranoid.\n");
+        }
+        free(pstCounters);
+        return NULL;
+    }
+
+    return pstCounters;
+    #else
+    fprintf(stderr, "Performance counters are only supported on Linux.\n");
+    return NULL;
+    #endif
+}
+
+/**
+ * @brief   Check whether a counter is available.
+ * @param   pstCounters PerfCounters.  See @ref struct PerfCounters.
+ * @param   u8Counter   the counter.  See @ref enum PerfCounter.
+ * @return  1 if the counter is available, 0 if not.
+ * @ingroup PerfCounters
+ */
+uint8_t IsPerfCounterAvailable(const PerfCounters *pstCounters, const uint8_t u8Counter)
+{
+    if ((NULL == pstCounters) || (u8Counter >= PERF_COUNTERS))
+    {
+        return 0;
+    }
+
+    return -1 != pstCounters->s32Fd[u8Counter];
+}
+
+/**
+ * @brief   Reset and start all available counters.
+ * @param   pstCounters PerfCounters.  See @ref struct PerfCounters.
+ * @ingroup PerfCounters
+ */
+void StartPerfCounters(PerfCounters *pstCounters)
+{
+    #ifdef PERF_COUNTERS_SUPPORTED
+    for (uint8_t u8Counter = 0; u8Counter < PERF_COUNTERS; u8Counter++)
+    {
+        if (-1 != pstCounters->s32Fd[u8Counter])
+        {
+            ioctl(pstCounters->s32Fd[u8Counter], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pstCounters->s32Fd[u8Counter], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    #else
+    (void)pstCounters;
+    #endif
+}
+
+/**
+ * @brief   Stop all available counters and read their values into
+ *          u64Value.  Values are scaled if the kernel had to multiplex
+ *          the counters.
+ * @param   pstCounters PerfCounters.  See @ref struct PerfCounters.
+ * @ingroup PerfCounters
+ */
+void StopPerfCounters(PerfCounters *pstCounters)
+{
+    #ifdef PERF_COUNTERS_SUPPORTED
+    for (uint8_t u8Counter = 0; u8Counter < PERF_COUNTERS; u8Counter++)
+    {
+        // Value, time enabled, time running.
+        uint64_t u64Read[3] = { 0, 0, 0 };
+
+        if (-1 == pstCounters->s32Fd[u8Counter])
+        {
+            continue;
+        }
+
+        ioctl(pstCounters->s32Fd[u8Counter], PERF_EVENT_IOC_DISABLE, 0);
+        if (((ssize_t)sizeof(u64Read) != read(pstCounters->s32Fd[u8Counter], u64Read, sizeof(u64Read))) ||
+            (0 == u64Read[2]))
+        {
+            pstCounters->u64Value[u8Counter] = 0;
+            continue;
+        }
+
+        pstCounters->u64Value[u8Counter] =
+            (double)u64Read[0] * u64Read[1] / u64Read[2];
+    }
+    #else
+    (void)pstCounters;
+    #endif
+}
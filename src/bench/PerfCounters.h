@@ -0,0 +1,42 @@
+/**
+ * @file    PerfCounters.h
+ * @ingroup PerfCounters
+ */
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+/**
+ * @ingroup PerfCounters
+ */
+enum PerfCounter
+{
+    PERF_CYCLES        = 0,
+    PERF_INSTRUCTIONS  = 1,
+    PERF_L1D_MISSES    = 2,
+    PERF_LLC_MISSES    = 3,
+    PERF_BRANCH_MISSES = 4,
+    PERF_COUNTERS      = 5
+};
+
+/**
+ * @ingroup PerfCounters
+ * @brief   Hardware counters of the calling thread.  s32Fd is -1 for
+ *          counters which aren't available; their u64Value stays 0.
+ */
+typedef struct PerfCounters_t
+{
+    int32_t  s32Fd[PERF_COUNTERS];
+    uint64_t u64Value[PERF_COUNTERS];
+} PerfCounters;
+
+void          FreePerfCounters(PerfCounters *pstCounters);
+const char   *GetPerfCounterName(const uint8_t u8Counter);
+PerfCounters *InitPerfCounters();
+uint8_t       IsPerfCounterAvailable(const PerfCounters *pstCounters, const uint8_t u8Counter);
+void          StartPerfCounters(PerfCounters *pstCounters);
+void          StopPerfCounters(PerfCounters *pstCounters);
+
+#endif // _PERF_COUNTERS_H_
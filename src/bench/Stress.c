@@ -0,0 +1,417 @@
+/**
+ * @file      Stress.c
+ * @ingroup   Stress
+ * @defgroup  Stress
+ * @brief     Render benchmark.  A generated (or given) map is drawn
+ *            along with the backgrounds and the player sprite while a
+ *            scripted camera pans across it.  Load time, bake time,
+ *            texture memory and frame times are written to stdout as
+ *            JSON.  Uses SDL's dummy video driver and the software
+ *            renderer unless --window is given.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Background.h"
+#include "../Entity.h"
+#include "../Map.h"
+#include "../Profiler.h"
+#include "../Resource.h"
+#include "../SpriteBatch.h"
+#include "../Video.h"
+#include "StressMap.h"
+
+#define STRESS_MAP_FILENAME "stress.tmx"
+#define STRESS_PI           3.14159265358979323846
+
+static const char *_pacBackgroundList[5] = {
+    "res/backgrounds/plx-1.png",
+    "res/backgrounds/plx-2.png",
+    "res/backgrounds/plx-3.png",
+    "res/backgrounds/plx-4.png",
+    "res/backgrounds/plx-5.png"
+};
+
+static int _CompareFrameTime(const void *pA, const void *pB)
+{
+    double dA = *(const double *)pA;
+    double dB = *(const double *)pB;
+
+    return (dA > dB) - (dA < dB);
+}
+
+static double _Milliseconds(uint64_t u64Ticks)
+{
+    return u64Ticks * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+/* Forth and back along the x-axis once, up and down the y-axis twice. */
+static void _MoveCamera(
+    uint32_t  u32Frame,
+    uint32_t  u32Frames,
+    double    dMaxPosX,
+    double    dMaxPosY,
+    double   *pdPosX,
+    double   *pdPosY)
+{
+    double dT = u32Frames > 1 ? (double)u32Frame / (u32Frames - 1) : 0;
+
+    *pdPosX = dMaxPosX * (1.0 - fabs(2.0 * dT - 1.0));
+    *pdPosY = dMaxPosY * (0.5 - 0.5 * cos(4.0 * STRESS_PI * dT));
+}
+
+static void _Usage(const char *pacName)
+{
+    fprintf(stderr,
+        "Usage: %s [--width N] [--height N] [--layers N] [--tilesets N]\n"
+        "       [--density PERCENT] [--encoding csv|base64|base64+zlib|base64+gzip]\n"
+        "       [--animated N] [--seed N] [--write FILE | --map FILE]\n"
+        "       [--frames N] [--resolution WxH] [--window]\n",
+        pacName);
+}
+
+int32_t main(int32_t s32ArgC, char *pacArgV[])
+{
+    StressMapConfig   stConfig       = GetDefaultStressMapConfig();
+    const char       *pacWrite       = NULL;
+    const char       *pacMapFilename = NULL;
+    uint32_t          u32Frames      = 600;
+    int32_t           s32Width       = 800;
+    int32_t           s32Height      = 600;
+    uint8_t           u8Window       = 0;
+    int32_t           s32Status      = EXIT_FAILURE;
+    SDL_Window       *pstWindow      = NULL;
+    SDL_Renderer     *pstRenderer    = NULL;
+    Map              *pstMap         = NULL;
+    Entity           *pstSam         = NULL;
+    Background       *pstBG[5]       = { NULL };
+    Profiler         *pstProfiler    = NULL;
+    SpriteBatch      *pstSprites     = NULL;
+    uint32_t          u32Sprites     = 0;
+    double           *pdFrameTime    = NULL;
+    uint32_t          u32TmxLayers   = 0;
+    double            dFrameSum      = 0;
+    SDL_RendererInfo  stInfo;
+    int32_t           s32LogicalWidth;
+    int32_t           s32LogicalHeight;
+    uint64_t          u64Start;
+    double            dLoadTime;
+    double            dBakeTime[2];
+    double            dMaxPosX;
+    double            dMaxPosY;
+    VideoStats        stVideo;
+
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        const char *pacArg   = pacArgV[s32Index];
+        const char *pacValue = s32Index + 1 < s32ArgC ? pacArgV[s32Index + 1] : NULL;
+
+        if (0 == strcmp(pacArg, "--window"))
+        {
+            u8Window = 1;
+            continue;
+        }
+
+        if (NULL == pacValue)
+        {
+            _Usage(pacArgV[0]);
+            return EXIT_FAILURE;
+        }
+        s32Index++;
+
+        if      (0 == strcmp(pacArg, "--width"))    { stConfig.u32Width         = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--height"))   { stConfig.u32Height        = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--layers"))   { stConfig.u8Layers         = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--tilesets")) { stConfig.u8Tilesets       = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--density"))  { stConfig.u8Density        = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--animated")) { stConfig.u16AnimatedTiles = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--seed"))     { stConfig.u32Seed          = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--frames"))   { u32Frames                 = strtoul(pacValue, NULL, 10); }
+        else if (0 == strcmp(pacArg, "--write"))    { pacWrite                  = pacValue; }
+        else if (0 == strcmp(pacArg, "--map"))      { pacMapFilename            = pacValue; }
+        else if (0 == strcmp(pacArg, "--encoding"))
+        {
+            if (-1 == ParseStressMapEncoding(pacValue, &stConfig.u8Encoding))
+            {
+                _Usage(pacArgV[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (0 == strcmp(pacArg, "--resolution"))
+        {
+            if (2 != sscanf(pacValue, "%dx%d", &s32Width, &s32Height))
+            {
+                _Usage(pacArgV[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            _Usage(pacArgV[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((0 == stConfig.u32Width) || (0 == stConfig.u32Height) ||
+        (0 == stConfig.u8Layers) || (0 == u32Frames) ||
+        (s32Width <= 0) || (s32Height <= 0))
+    {
+        _Usage(pacArgV[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (pacWrite)
+    {
+        return 0 == WriteStressMap(pacWrite, &stConfig) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (NULL == pacMapFilename)
+    {
+        fprintf(stderr, "Generating %ux%u map with %u layer(s)...\n",
+            stConfig.u32Width, stConfig.u32Height, stConfig.u8Layers);
+        if (-1 == WriteStressMap(STRESS_MAP_FILENAME, &stConfig))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (0 == u8Window)
+    {
+        // Unlike the game's headless mode, everything is drawn.
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    }
+
+    if ((0 != SDL_Init(SDL_INIT_VIDEO)) ||
+        (-1 == InitResources())          ||
+        (-1 == LoadAtlas("res/atlas/atlas.ini")))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        goto quit;
+    }
+
+    pstWindow = SDL_CreateWindow(
+        "Boondock Sam stress test",
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        s32Width,
+        s32Height,
+        u8Window ? 0 : SDL_WINDOW_HIDDEN);
+
+    if (NULL == pstWindow)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        goto quit;
+    }
+
+    pstRenderer = SDL_CreateRenderer(
+        pstWindow,
+        -1,
+        (u8Window ? SDL_RENDERER_ACCELERATED : SDL_RENDERER_SOFTWARE) | SDL_RENDERER_TARGETTEXTURE);
+
+    if ((NULL == pstRenderer) || (0 != SDL_GetRendererInfo(pstRenderer, &stInfo)))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        goto quit;
+    }
+
+    // Same zoom level as the game.  216 = Background height.
+    s32LogicalWidth  = s32Width  / (1 + s32Height / 216);
+    s32LogicalHeight = s32Height / (1 + s32Height / 216);
+    if (0 != SDL_RenderSetLogicalSize(pstRenderer, s32LogicalWidth, s32LogicalHeight))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        goto quit;
+    }
+
+    u64Start  = SDL_GetPerformanceCounter();
+    pstMap    = InitMap(
+        pacMapFilename ? pacMapFilename : STRESS_MAP_FILENAME,
+        "res/tilesets/jungle.png");
+    dLoadTime = _Milliseconds(SDL_GetPerformanceCounter() - u64Start);
+    if (NULL == pstMap)
+    {
+        goto quit;
+    }
+
+    for (tmx_layer *pstLayer = pstMap->pstTmxMap->ly_head; pstLayer; pstLayer = pstLayer->next)
+    {
+        u32TmxLayers++;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        pstBG[u8Index] = InitBackground(pstRenderer, _pacBackgroundList[u8Index], s32Width);
+        if (NULL == pstBG[u8Index])
+        {
+            goto quit;
+        }
+        pstBG[u8Index]->dWorldPosY = pstMap->u32Height - pstBG[u8Index]->s32Height;
+        pstBG[u8Index]->dVelocity  = (u8Index + 1) / 5.0;
+        u32Sprites                += 2 * pstBG[u8Index]->u8WidthFactor;
+    }
+
+    pstSprites = InitSpriteBatch(pstRenderer, u32Sprites);
+    if (NULL == pstSprites)
+    {
+        goto quit;
+    }
+
+    pstSam = InitEntity(24, 40, 0, 0, pstMap->u32Width, pstMap->u32Height);
+    if ((NULL == pstSam) ||
+        (-1 == LoadEntitySprite(pstSam, pstRenderer, "res/sprites/sam.png")))
+    {
+        goto quit;
+    }
+
+    pstProfiler = InitProfiler();
+    pdFrameTime = malloc(u32Frames * sizeof(double));
+    if ((NULL == pstProfiler) || (NULL == pdFrameTime))
+    {
+        fprintf(stderr, "Stress: error allocating memory.\n");
+        goto quit;
+    }
+
+    // The first DrawMap() call of every layer renders it into a texture.
+    u64Start = SDL_GetPerformanceCounter();
+    if (-1 == DrawMap(pstRenderer, pstMap, "Background", 1, 0, 0, 0))
+    {
+        fprintf(stderr, "Couldn't bake the background layers.\n");
+        goto quit;
+    }
+    dBakeTime[0] = _Milliseconds(SDL_GetPerformanceCounter() - u64Start);
+
+    u64Start = SDL_GetPerformanceCounter();
+    if (-1 == DrawMap(pstRenderer, pstMap, "Foreground", 0, 2, 0, 0))
+    {
+        fprintf(stderr, "Couldn't bake the foreground layers.\n");
+        goto quit;
+    }
+    dBakeTime[1] = _Milliseconds(SDL_GetPerformanceCounter() - u64Start);
+
+    dMaxPosX = (double)pstMap->u32Width  - s32LogicalWidth;
+    dMaxPosY = (double)pstMap->u32Height - s32LogicalHeight;
+    if (dMaxPosX < 0) { dMaxPosX = 0; }
+    if (dMaxPosY < 0) { dMaxPosY = 0; }
+
+    UpdateVideo(pstRenderer);
+    for (uint32_t u32Frame = 0; u32Frame < u32Frames; u32Frame++)
+    {
+        double dCameraPosX;
+        double dCameraPosY;
+
+        _MoveCamera(u32Frame, u32Frames, dMaxPosX, dMaxPosY, &dCameraPosX, &dCameraPosY);
+        pstSam->dWorldPosX = dCameraPosX + (s32LogicalWidth  - pstSam->u8Width)  / 2.0;
+        pstSam->dWorldPosY = dCameraPosY + (s32LogicalHeight - pstSam->u8Height) / 2.0;
+
+        u64Start = SDL_GetPerformanceCounter();
+        BeginProfilerFrame(pstProfiler);
+
+        PROFILE_BEGIN(pstProfiler, PROFILER_DRAW_BG);
+        for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+        {
+            UpdateBackground(pstBG[u8Index]);
+            DrawBackground(pstSprites, pstBG[u8Index], u8Index, dCameraPosY);
+        }
+        FlushSpriteBatch(pstSprites);
+        PROFILE_END(pstProfiler, PROFILER_DRAW_BG);
+
+        PROFILE_BEGIN(pstProfiler, PROFILER_DRAW_MAP_BG);
+        DrawMap(pstRenderer, pstMap, "Background", 1, 0, dCameraPosX, dCameraPosY);
+        PROFILE_END(pstProfiler, PROFILER_DRAW_MAP_BG);
+
+        PROFILE_BEGIN(pstProfiler, PROFILER_DRAW_ENTITY);
+        DrawEntity(pstRenderer, pstSam, dCameraPosX, dCameraPosY);
+        PROFILE_END(pstProfiler, PROFILER_DRAW_ENTITY);
+
+        PROFILE_BEGIN(pstProfiler, PROFILER_DRAW_MAP_FG);
+        DrawMap(pstRenderer, pstMap, "Foreground", 0, 2, dCameraPosX, dCameraPosY);
+        PROFILE_END(pstProfiler, PROFILER_DRAW_MAP_FG);
+
+        PROFILE_BEGIN(pstProfiler, PROFILER_PRESENT);
+        UpdateVideo(pstRenderer);
+        PROFILE_END(pstProfiler, PROFILER_PRESENT);
+
+        EndProfilerFrame(pstProfiler);
+        pdFrameTime[u32Frame] = _Milliseconds(SDL_GetPerformanceCounter() - u64Start);
+        dFrameSum            += pdFrameTime[u32Frame];
+    }
+
+    stVideo = GetVideoStats();
+    qsort(pdFrameTime, u32Frames, sizeof(double), _CompareFrameTime);
+
+    printf("{\n");
+    printf("  \"map\": {\"file\": \"%s\", \"width\": %u, \"height\": %u, \"layers\": %u",
+        pacMapFilename ? pacMapFilename : STRESS_MAP_FILENAME,
+        pstMap->pstTmxMap->width, pstMap->pstTmxMap->height, u32TmxLayers);
+    if (NULL == pacMapFilename)
+    {
+        printf(", \"tilesets\": %u, \"density\": %u, \"encoding\": \"%s\", \"animated_tiles\": %u, \"seed\": %u",
+            stConfig.u8Tilesets, stConfig.u8Density,
+            GetStressMapEncodingName(stConfig.u8Encoding),
+            stConfig.u16AnimatedTiles, stConfig.u32Seed);
+    }
+    printf("},\n");
+    printf("  \"renderer\": \"%s\",\n", stInfo.name);
+    printf("  \"max_texture_size\": [%d, %d],\n", stInfo.max_texture_width, stInfo.max_texture_height);
+    printf("  \"resolution\": [%d, %d],\n", s32Width, s32Height);
+    printf("  \"logical_size\": [%d, %d],\n", s32LogicalWidth, s32LogicalHeight);
+    printf("  \"load_ms\": %.3f,\n", dLoadTime);
+    printf("  \"bake_ms\": {\"background\": %.3f, \"foreground\": %.3f},\n", dBakeTime[0], dBakeTime[1]);
+    printf("  \"textures\": %u,\n", stVideo.u32Textures);
+    printf("  \"texture_bytes\": %llu,\n", (unsigned long long)stVideo.u64TextureBytes);
+    printf("  \"frames\": %u,\n", u32Frames);
+    printf("  \"draw_calls_per_frame\": %u,\n", stVideo.u32FrameDrawCalls);
+    printf("  \"frame_ms\": {\"min\": %.4f, \"avg\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+        pdFrameTime[0],
+        dFrameSum / u32Frames,
+        pdFrameTime[(u32Frames - 1) * 99 / 100],
+        pdFrameTime[u32Frames - 1]);
+
+    // Per-stage timings only cover the profiler's window.
+    printf("  \"stages_ms\": {\"frames\": %u", pstProfiler->u16Count);
+    for (uint8_t u8Stage = PROFILER_DRAW_BG; u8Stage <= PROFILER_PRESENT; u8Stage++)
+    {
+        ProfilerStats stStats = GetProfilerStats(pstProfiler, u8Stage);
+
+        printf(", \"%s\": {\"min\": %.4f, \"avg\": %.4f, \"p99\": %.4f}",
+            GetProfilerStageName(u8Stage),
+            stStats.u32Min / 1e6, stStats.u32Avg / 1e6, stStats.u32P99 / 1e6);
+    }
+    printf("}\n}\n");
+
+    s32Status = EXIT_SUCCESS;
+
+quit:
+    free(pdFrameTime);
+    FreeSpriteBatch(pstSprites);
+    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    {
+        FreeBackground(pstBG[u8Index]);
+    }
+    FreeEntity(pstSam);
+    FreeProfiler(pstProfiler);
+    FreeMap(pstMap);
+    // Everything has been released, so this only reports leaks.
+    FreeResources();
+    if (NULL == pacMapFilename)
+    {
+        remove(STRESS_MAP_FILENAME);
+    }
+    if (pstRenderer)
+    {
+        SDL_DestroyRenderer(pstRenderer);
+    }
+    if (pstWindow)
+    {
+        SDL_DestroyWindow(pstWindow);
+    }
+    SDL_Quit();
+
+    return s32Status;
+}
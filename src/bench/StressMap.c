@@ -0,0 +1,353 @@
+/**
+ * @file      StressMap.c
+ * @ingroup   StressMap
+ * @defgroup  StressMap
+ * @brief     Generator for TMX maps of arbitrary size, layer count,
+ *            density and encoding, to benchmark the map loader and the
+ *            renderer with something bigger than the demo level.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "StressMap.h"
+#include "../tmx/tmx.h"
+#include "../tmx/tsx.h"
+#include "../tmx/tmx_utils.h"
+
+static const char *_pacEncodingNames[STRESS_MAP_ENCODINGS] = {
+    "csv",
+    "base64",
+    "base64+zlib",
+    "base64+gzip"
+};
+
+static const char *_pacEncodingAttributes[STRESS_MAP_ENCODINGS] = {
+    "encoding=\"csv\"",
+    "encoding=\"base64\"",
+    "encoding=\"base64\" compression=\"zlib\"",
+    "encoding=\"base64\" compression=\"gzip\""
+};
+
+static uint32_t _u32Seed;
+
+static uint32_t _Random()
+{
+    _u32Seed = _u32Seed * 1103515245 + 12345;
+    return _u32Seed >> 8;
+}
+
+static char *_MakeCsv(const int32_t *ps32Gids, uint32_t u32Width, uint32_t u32Height)
+{
+    size_t sCount = (size_t)u32Width * u32Height;
+    char  *pacCsv = tmx_alloc_func(NULL, sCount * 7 + u32Height + 1);
+    char  *pacPos = pacCsv;
+
+    if (NULL == pacCsv)
+    {
+        return NULL;
+    }
+
+    for (size_t sIndex = 0; sIndex < sCount; sIndex++)
+    {
+        pacPos += sprintf(pacPos, "%d", ps32Gids[sIndex]);
+        if (sIndex + 1 < sCount)
+        {
+            *pacPos++ = ',';
+        }
+        if (0 == (sIndex + 1) % u32Width)
+        {
+            *pacPos++ = '\n';
+        }
+    }
+    *pacPos = '\0';
+
+    return pacCsv;
+}
+
+static char *_Compress(const char *pacRaw, uint32_t u32Length, uint8_t u8Gzip, uint32_t *pu32Length)
+{
+    z_stream stStream;
+    uLong    ulBound = compressBound(u32Length) + 32;
+    char    *pacOut  = malloc(ulBound);
+
+    if (NULL == pacOut)
+    {
+        return NULL;
+    }
+
+    memset(&stStream, 0, sizeof(stStream));
+    if (Z_OK != deflateInit2(&stStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+            u8Gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY))
+    {
+        free(pacOut);
+        return NULL;
+    }
+
+    stStream.next_in   = (Bytef *)pacRaw;
+    stStream.avail_in  = u32Length;
+    stStream.next_out  = (Bytef *)pacOut;
+    stStream.avail_out = ulBound;
+
+    if (Z_STREAM_END != deflate(&stStream, Z_FINISH))
+    {
+        deflateEnd(&stStream);
+        free(pacOut);
+        return NULL;
+    }
+    *pu32Length = stStream.total_out;
+    deflateEnd(&stStream);
+
+    return pacOut;
+}
+
+/**
+ * @brief   Encode the GIDs of a layer.
+ * @param   ps32Gids   the GIDs, row by row.
+ * @param   u32Width   the width of the layer in tiles.
+ * @param   u32Height  the height of the layer in tiles.
+ * @param   u8Encoding the encoding.  See @ref enum StressMapEncoding.
+ * @return  the layer data as it appears between the <data> tags on
+ *          success, NULL on failure.  Has to be freed by the caller
+ *          using tmx_free_func.
+ * @ingroup StressMap
+ */
+char *EncodeStressMapLayer(
+    const int32_t *ps32Gids,
+    const uint32_t u32Width,
+    const uint32_t u32Height,
+    const uint8_t  u8Encoding)
+{
+    uint32_t u32Length = u32Width * u32Height * sizeof(int32_t);
+    uint32_t u32Compressed;
+    char    *pacCompressed;
+    char    *pacEncoded;
+
+    // Same defaults as tmx_load(), b64_encode() allocates through them.
+    if (NULL == tmx_alloc_func) { tmx_alloc_func = realloc; }
+    if (NULL == tmx_free_func)  { tmx_free_func  = free;    }
+
+    switch (u8Encoding)
+    {
+        case STRESS_MAP_CSV:
+            return _MakeCsv(ps32Gids, u32Width, u32Height);
+        case STRESS_MAP_B64:
+            return b64_encode((const char *)ps32Gids, u32Length);
+        default:
+            pacCompressed = _Compress(
+                (const char *)ps32Gids,
+                u32Length,
+                STRESS_MAP_B64_GZ == u8Encoding,
+                &u32Compressed);
+            if (NULL == pacCompressed)
+            {
+                return NULL;
+            }
+            pacEncoded = b64_encode(pacCompressed, u32Compressed);
+            free(pacCompressed);
+            return pacEncoded;
+    }
+}
+
+/**
+ * @brief   Get the attributes of the <data> element for an encoding.
+ * @param   u8Encoding the encoding.  See @ref enum StressMapEncoding.
+ * @return  the attributes, e.g. encoding="base64" compression="zlib".
+ * @ingroup StressMap
+ */
+const char *GetStressMapEncodingAttributes(const uint8_t u8Encoding)
+{
+    return _pacEncodingAttributes[u8Encoding % STRESS_MAP_ENCODINGS];
+}
+
+/**
+ * @brief   Get the name of an encoding.
+ * @param   u8Encoding the encoding.  See @ref enum StressMapEncoding.
+ * @return  the name, e.g. base64+zlib.
+ * @ingroup StressMap
+ */
+const char *GetStressMapEncodingName(const uint8_t u8Encoding)
+{
+    return _pacEncodingNames[u8Encoding % STRESS_MAP_ENCODINGS];
+}
+
+/**
+ * @brief   Get the default parameters: a map roughly the size of ten
+ *          demo levels.
+ * @return  the parameters.  See @ref struct StressMapConfig.
+ * @ingroup StressMap
+ */
+StressMapConfig GetDefaultStressMapConfig()
+{
+    StressMapConfig stConfig;
+
+    stConfig.u32Width         = 512;
+    stConfig.u32Height        = 128;
+    stConfig.u8Layers         = 3;
+    stConfig.u8Tilesets       = 1;
+    stConfig.u8Density        = 60;
+    stConfig.u8Encoding       = STRESS_MAP_B64_Z;
+    stConfig.u16AnimatedTiles = 0;
+    stConfig.u32Seed          = 1;
+
+    return stConfig;
+}
+
+/**
+ * @brief   Look up an encoding by name.
+ * @param   pacName     the name, e.g. base64+zlib.
+ * @param   pu8Encoding the encoding.  See @ref enum StressMapEncoding.
+ * @return  0 on success, -1 if the name is unknown.
+ * @ingroup StressMap
+ */
+int8_t ParseStressMapEncoding(const char *pacName, uint8_t *pu8Encoding)
+{
+    for (uint8_t u8Encoding = 0; u8Encoding < STRESS_MAP_ENCODINGS; u8Encoding++)
+    {
+        if (0 == strcmp(pacName, _pacEncodingNames[u8Encoding]))
+        {
+            *pu8Encoding = u8Encoding;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief   Generate a map and write it to a TMX file.  Layers are named
+ *          "Background n" and every third one "Foreground n", so they
+ *          are picked up by DrawMap().  All tilesets refer to the jungle
+ *          tileset image, relative to res/maps.
+ * @param   pacFilename the filename of the TMX file.
+ * @param   pstConfig   the parameters.  See @ref struct StressMapConfig.
+ * @return  0 on success, -1 on failure.
+ * @ingroup StressMap
+ */
+int8_t WriteStressMap(const char *pacFilename, const StressMapConfig *pstConfig)
+{
+    uint32_t  u32Count    = pstConfig->u32Width * pstConfig->u32Height;
+    uint16_t  u16Animated = pstConfig->u16AnimatedTiles;
+    uint8_t   u8Tilesets  = pstConfig->u8Tilesets ? pstConfig->u8Tilesets : 1;
+    int32_t  *ps32Gids;
+    FILE     *pstFile;
+
+    if (u16Animated > STRESS_MAP_TILE_COUNT)
+    {
+        u16Animated = STRESS_MAP_TILE_COUNT;
+    }
+
+    ps32Gids = malloc((size_t)u32Count * sizeof(int32_t));
+    if (NULL == ps32Gids)
+    {
+        fprintf(stderr, "WriteStressMap(): error allocating memory.\n");
+        return -1;
+    }
+
+    pstFile = fopen(pacFilename, "w");
+    if (NULL == pstFile)
+    {
+        fprintf(stderr, "Couldn't write map: %s\n", pacFilename);
+        free(ps32Gids);
+        return -1;
+    }
+
+    fprintf(pstFile,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<map version=\"1.0\" orientation=\"orthogonal\" renderorder=\"right-down\""
+        " width=\"%u\" height=\"%u\" tilewidth=\"%u\" tileheight=\"%u\" infinite=\"0\""
+        " backgroundcolor=\"#2b5754\">\n",
+        pstConfig->u32Width, pstConfig->u32Height,
+        STRESS_MAP_TILE_SIZE, STRESS_MAP_TILE_SIZE);
+
+    for (uint8_t u8Tileset = 0; u8Tileset < u8Tilesets; u8Tileset++)
+    {
+        fprintf(pstFile,
+            " <tileset firstgid=\"%u\" name=\"stress-%u\" tilewidth=\"%u\" tileheight=\"%u\""
+            " tilecount=\"%u\" columns=\"%u\">\n"
+            "  <image source=\"../tilesets/jungle.png\" width=\"%u\" height=\"%u\"/>\n",
+            1 + u8Tileset * STRESS_MAP_TILE_COUNT, u8Tileset,
+            STRESS_MAP_TILE_SIZE, STRESS_MAP_TILE_SIZE,
+            STRESS_MAP_TILE_COUNT, STRESS_MAP_TILE_COLUMNS,
+            STRESS_MAP_IMAGE_WIDTH, STRESS_MAP_IMAGE_HEIGHT);
+
+        for (uint16_t u16Tile = 0; (0 == u8Tileset) && (u16Tile < u16Animated); u16Tile++)
+        {
+            fprintf(pstFile, "  <tile id=\"%u\">\n   <animation>\n", u16Tile);
+            for (uint8_t u8Frame = 0; u8Frame < STRESS_MAP_ANIM_FRAMES; u8Frame++)
+            {
+                fprintf(pstFile, "    <frame tileid=\"%u\" duration=\"100\"/>\n",
+                    (u16Tile + u8Frame) % STRESS_MAP_TILE_COUNT);
+            }
+            fprintf(pstFile, "   </animation>\n  </tile>\n");
+        }
+
+        fprintf(pstFile, " </tileset>\n");
+    }
+
+    _u32Seed = pstConfig->u32Seed;
+    for (uint8_t u8Layer = 0; u8Layer < pstConfig->u8Layers; u8Layer++)
+    {
+        char *pacData;
+
+        for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+        {
+            uint8_t  u8Tileset = _Random() % u8Tilesets;
+            uint32_t u32Tile   = _Random() % STRESS_MAP_TILE_COUNT;
+
+            if (_Random() % 100 >= pstConfig->u8Density)
+            {
+                ps32Gids[u32Index] = 0;
+                continue;
+            }
+
+            // Every eighth tile of the first tileset is animated.
+            if ((0 == u8Tileset) && (u16Animated) && (0 == _Random() % 8))
+            {
+                u32Tile = _Random() % u16Animated;
+            }
+
+            ps32Gids[u32Index] = 1 + u8Tileset * STRESS_MAP_TILE_COUNT + u32Tile;
+        }
+
+        pacData = EncodeStressMapLayer(
+            ps32Gids,
+            pstConfig->u32Width,
+            pstConfig->u32Height,
+            pstConfig->u8Encoding);
+
+        if (NULL == pacData)
+        {
+            fprintf(stderr, "WriteStressMap(): couldn't encode layer %u.\n", u8Layer);
+            fclose(pstFile);
+            free(ps32Gids);
+            remove(pacFilename);
+            return -1;
+        }
+
+        fprintf(pstFile,
+            " <layer name=\"%s %u\" width=\"%u\" height=\"%u\">\n"
+            "  <data %s>\n%s\n  </data>\n"
+            " </layer>\n",
+            2 == u8Layer % 3 ? "Foreground" : "Background", u8Layer,
+            pstConfig->u32Width, pstConfig->u32Height,
+            GetStressMapEncodingAttributes(pstConfig->u8Encoding), pacData);
+
+        tmx_free_func(pacData);
+    }
+
+    fprintf(pstFile, "</map>\n");
+    free(ps32Gids);
+
+    if (0 != fclose(pstFile))
+    {
+        fprintf(stderr, "Couldn't write map: %s\n", pacFilename);
+        return -1;
+    }
+
+    return 0;
+}
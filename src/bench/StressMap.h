@@ -0,0 +1,67 @@
+/**
+ * @file    StressMap.h
+ * @ingroup StressMap
+ */
+
+#ifndef _STRESS_MAP_H_
+#define _STRESS_MAP_H_
+
+#include <stdint.h>
+
+/**
+ * @ingroup StressMap
+ */
+enum StressMapEncoding
+{
+    STRESS_MAP_CSV    = 0,
+    STRESS_MAP_B64    = 1,
+    STRESS_MAP_B64_Z  = 2,
+    STRESS_MAP_B64_GZ = 3,
+    STRESS_MAP_ENCODINGS
+};
+
+/**
+ * @ingroup StressMap
+ * @brief   The tileset image every generated tileset refers to.
+ */
+enum StressMapTileset
+{
+    STRESS_MAP_TILE_SIZE     = 16,
+    STRESS_MAP_TILE_COLUMNS  = 39,
+    STRESS_MAP_TILE_COUNT    = 741,
+    STRESS_MAP_IMAGE_WIDTH   = 624,
+    STRESS_MAP_IMAGE_HEIGHT  = 304,
+    STRESS_MAP_ANIM_FRAMES   = 4
+};
+
+/**
+ * @ingroup StressMap
+ * @brief   Parameters of a generated map.  u8Density is the percentage
+ *          of non-empty tiles per layer, u16AnimatedTiles the number of
+ *          animated tiles in the first tileset.
+ */
+typedef struct StressMapConfig_t
+{
+    uint32_t u32Width;
+    uint32_t u32Height;
+    uint8_t  u8Layers;
+    uint8_t  u8Tilesets;
+    uint8_t  u8Density;
+    uint8_t  u8Encoding;
+    uint16_t u16AnimatedTiles;
+    uint32_t u32Seed;
+} StressMapConfig;
+
+char *EncodeStressMapLayer(
+    const int32_t *ps32Gids,
+    const uint32_t u32Width,
+    const uint32_t u32Height,
+    const uint8_t  u8Encoding);
+
+const char     *GetStressMapEncodingAttributes(const uint8_t u8Encoding);
+const char     *GetStressMapEncodingName(const uint8_t u8Encoding);
+StressMapConfig GetDefaultStressMapConfig();
+int8_t          ParseStressMapEncoding(const char *pacName, uint8_t *pu8Encoding);
+int8_t          WriteStressMap(const char *pacFilename, const StressMapConfig *pstConfig);
+
+#endif // _STRESS_MAP_H_
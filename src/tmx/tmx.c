@@ -14,8 +14,11 @@
 
 void* (*tmx_alloc_func) (void *address, size_t len) = NULL;
 void  (*tmx_free_func ) (void *address) = NULL;
+int     tmx_keep_libxml_mem = 0;
 void* (*tmx_img_load_func) (const char *p) = NULL;
 void  (*tmx_img_free_func) (void *address) = NULL;
+void  (*tmx_trace_begin_func) (const char *phase) = NULL;
+void  (*tmx_trace_end_func)   (const char *phase) = NULL;
 
 /*
 	Public functions
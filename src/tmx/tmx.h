@@ -37,11 +37,22 @@ extern "C" {
 TMXEXPORT extern void* (*tmx_alloc_func) (void *address, size_t len); /* realloc */
 TMXEXPORT extern void  (*tmx_free_func ) (void *address);             /* free */
 
+/* Set to non-zero if the application sets up libxml2's memory functions
+   itself, otherwise they are set to tmx_alloc_func and tmx_free_func
+   before every load */
+TMXEXPORT extern int tmx_keep_libxml_mem;
+
 /* load/free tmx_image->resource_image, you should set this if you want
    the library to load/free images */
 TMXEXPORT extern void* (*tmx_img_load_func) (const char *path);
 TMXEXPORT extern void  (*tmx_img_free_func) (void *address);
 
+/* Called when entering/leaving a loading phase (XML parsing, base64
+   decoding, inflating, building the tile array), for profiling purposes.
+   `phase` is a string literal */
+TMXEXPORT extern void (*tmx_trace_begin_func) (const char *phase);
+TMXEXPORT extern void (*tmx_trace_end_func)   (const char *phase);
+
 /*
 	Data Structures
 */
@@ -20,6 +20,7 @@ static void* tmx_malloc(size_t len) {
 }
 
 void setup_libxml_mem() {
+	if (tmx_keep_libxml_mem) return;
 	xmlMemSetup((xmlFreeFunc)tmx_free_func, (xmlMallocFunc)tmx_malloc, (xmlReallocFunc)tmx_alloc_func, (xmlStrdupFunc)tmx_strdup);
 }
 
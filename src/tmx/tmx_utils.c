@@ -223,30 +223,42 @@ int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32
 	unsigned int b64_len, i;
 
 	if (type==CSV) {
+		TMX_TRACE_BEGIN("csv_decode");
 		if (!(*gids = (int32_t*)tmx_alloc_func(NULL, gids_count * sizeof(int32_t)))) {
 			tmx_errno = E_ALLOC;
+			TMX_TRACE_END("csv_decode");
 			return 0;
 		}
 		for (i=0; i<gids_count; i++) {
 			if (sscanf(source, "%d", (*gids)+i) != 1) {
 				tmx_err(E_CDATA, "error in CVS while reading tile #%d", i);
+				TMX_TRACE_END("csv_decode");
 				return 0;
 			}
 			if (!(source = strchr(source, ',')) && i!=gids_count-1) {
 				tmx_err(E_CDATA, "error in CVS after reading tile #%d", i);
+				TMX_TRACE_END("csv_decode");
 				return 0;
 			}
 			source++;
 		}
+		TMX_TRACE_END("csv_decode");
 	}
 	else if (type==B64Z) {
-		if (!(b64dec = b64_decode(source, &b64_len))) return 0;
+		TMX_TRACE_BEGIN("b64_decode");
+		b64dec = b64_decode(source, &b64_len);
+		TMX_TRACE_END("b64_decode");
+		if (!b64dec) return 0;
+		TMX_TRACE_BEGIN("inflate");
 		*gids = (int32_t*)zlib_decompress(b64dec, b64_len, (unsigned int)(gids_count*sizeof(int32_t)));
+		TMX_TRACE_END("inflate");
 		tmx_free_func(b64dec);
 		if (!(*gids)) return 0;
 	}
 	else if (type==B64) {
+		TMX_TRACE_BEGIN("b64_decode");
 		*gids = (int32_t*)b64_decode(source, &b64_len);
+		TMX_TRACE_END("b64_decode");
 		if (!(*gids)) return 0;
 	}
 
@@ -259,7 +271,11 @@ int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32
 
 void map_post_parsing(tmx_map **map) {
 	if (*map) {
-		if (!mk_map_tile_array(*map)) {
+		int ok;
+		TMX_TRACE_BEGIN("mk_map_tile_array");
+		ok = mk_map_tile_array(*map);
+		TMX_TRACE_END("mk_map_tile_array");
+		if (!ok) {
 			tmx_map_free(*map);
 			*map = NULL;
 		}
@@ -62,6 +62,13 @@ void free_ts_list(tmx_tileset_list *tsl);
 */
 #define MAX(a,b) (a<b) ? b: a;
 
+#define TMX_TRACE_BEGIN(phase) do { if (tmx_trace_begin_func) tmx_trace_begin_func(phase); } while (0)
+#define TMX_TRACE_END(phase)   do { if (tmx_trace_end_func)   tmx_trace_end_func(phase);   } while (0)
+
+char* b64_encode(const char *source, unsigned int length);
+char* b64_decode(const char *source, unsigned int *rlength);
+char* zlib_decompress(const char *source, unsigned int slength, unsigned int rlength);
+
 enum enccmp_t {CSV, B64Z, B64};
 int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32_t **gids);
 
@@ -112,7 +119,7 @@ void tileset_deallocator(void *val, const char *key);
 #define snprintf _snprintf
 #endif
 
-char custom_msg[256];
+extern char custom_msg[256];
 #define tmx_err(code, ...) tmx_errno = code; snprintf(custom_msg, 256, __VA_ARGS__)
 
 #endif /* TMXUTILS_H */
@@ -984,6 +984,7 @@ tmx_map *parse_xml(tmx_tileset_manager *ts_mgr, const char *filename) {
 
 	setup_libxml_mem();
 
+	TMX_TRACE_BEGIN("xml_parse");
 	if ((reader = xmlReaderForFile(filename, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_map(reader, ts_mgr, filename);
@@ -992,6 +993,7 @@ tmx_map *parse_xml(tmx_tileset_manager *ts_mgr, const char *filename) {
 	} else {
 		tmx_err(E_UNKN, "xml parser: unable to open %s", filename);
 	}
+	TMX_TRACE_END("xml_parse");
 
 	return res;
 }
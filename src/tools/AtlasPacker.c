@@ -0,0 +1,327 @@
+/**
+ * @file      AtlasPacker.c
+ * @ingroup   AtlasPacker
+ * @defgroup  AtlasPacker
+ * @brief     Packs images into as few texture atlases as possible and
+ *            writes them as PNG files along with a table of where each
+ *            image ended up.  The game looks images up in this table by
+ *            their filename, see LoadAtlas().  Run by `make atlas`.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Transparent pixels between two images, so filtering doesn't bleed.
+#define ATLAS_PADDING    1
+#define ATLAS_IMAGES_MAX 64
+#define ATLAS_PAGES_MAX  16
+
+typedef struct AtlasImage_t
+{
+    const char  *pacFilename;
+    SDL_Surface *pstImage;
+    SDL_Rect     stRect;
+    int32_t      s32Page;
+} AtlasImage;
+
+static int _CompareImages(const void *pA, const void *pB)
+{
+    const AtlasImage *pstA = (const AtlasImage *)pA;
+    const AtlasImage *pstB = (const AtlasImage *)pB;
+
+    if (pstA->stRect.h != pstB->stRect.h)
+    {
+        return pstB->stRect.h - pstA->stRect.h;
+    }
+
+    return pstB->stRect.w - pstA->stRect.w;
+}
+
+static int32_t _NextPowerOfTwo(int32_t s32Value)
+{
+    int32_t s32Power = 1;
+
+    while (s32Power < s32Value)
+    {
+        s32Power *= 2;
+    }
+
+    return s32Power;
+}
+
+/* Place as many of the images which haven't been placed yet on a page
+ * as fit, shelf by shelf, tallest first.  Returns the number placed
+ * and the size the page needs. */
+static uint32_t _FillPage(
+    AtlasImage *pstImages,
+    uint32_t    u32Count,
+    int32_t     s32Page,
+    int32_t     s32MaxSize,
+    int32_t    *ps32Width,
+    int32_t    *ps32Height)
+{
+    int32_t  s32X           = 0;
+    int32_t  s32Y           = 0;
+    int32_t  s32ShelfHeight = 0;
+    uint32_t u32Placed      = 0;
+
+    *ps32Width  = 0;
+    *ps32Height = 0;
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        AtlasImage *pstImage = &pstImages[u32Index];
+
+        if (-1 != pstImage->s32Page)
+        {
+            continue;
+        }
+
+        if (s32X + pstImage->stRect.w > s32MaxSize)
+        {
+            s32X            = 0;
+            s32Y           += s32ShelfHeight;
+            s32ShelfHeight  = 0;
+        }
+
+        if (s32Y + pstImage->stRect.h > s32MaxSize)
+        {
+            // A smaller one might still fit on the current shelf.
+            continue;
+        }
+
+        pstImage->s32Page  = s32Page;
+        pstImage->stRect.x = s32X;
+        pstImage->stRect.y = s32Y;
+
+        s32X          += pstImage->stRect.w + ATLAS_PADDING;
+        s32ShelfHeight = SDL_max(s32ShelfHeight, pstImage->stRect.h + ATLAS_PADDING);
+        *ps32Width     = SDL_max(*ps32Width,  pstImage->stRect.x + pstImage->stRect.w);
+        *ps32Height    = SDL_max(*ps32Height, pstImage->stRect.y + pstImage->stRect.h);
+        u32Placed++;
+    }
+
+    return u32Placed;
+}
+
+static int8_t _WritePage(
+    const char *pacFilename,
+    AtlasImage *pstImages,
+    uint32_t    u32Count,
+    int32_t     s32Page,
+    int32_t     s32Width,
+    int32_t     s32Height)
+{
+    SDL_Surface *pstPage;
+    int8_t       s8Status = 0;
+
+    // New surfaces are cleared, i.e. fully transparent.
+    pstPage = SDL_CreateRGBSurfaceWithFormat(
+        0,
+        _NextPowerOfTwo(s32Width),
+        _NextPowerOfTwo(s32Height),
+        32,
+        SDL_PIXELFORMAT_ARGB8888);
+    if (NULL == pstPage)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        if (s32Page != pstImages[u32Index].s32Page)
+        {
+            continue;
+        }
+
+        // Copy the alpha channel as it is instead of blending.
+        SDL_SetSurfaceBlendMode(pstImages[u32Index].pstImage, SDL_BLENDMODE_NONE);
+        if (0 != SDL_BlitSurface(pstImages[u32Index].pstImage, NULL, pstPage, &pstImages[u32Index].stRect))
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            s8Status = -1;
+            break;
+        }
+    }
+
+    if ((0 == s8Status) && (0 != IMG_SavePNG(pstPage, pacFilename)))
+    {
+        fprintf(stderr, "%s\n", IMG_GetError());
+        s8Status = -1;
+    }
+
+    SDL_FreeSurface(pstPage);
+
+    return s8Status;
+}
+
+static int8_t _WriteTable(
+    const char       *pacFilename,
+    const char       *pacOutDir,
+    const AtlasImage *pstImages,
+    uint32_t          u32Count)
+{
+    FILE *pstFile = fopen(pacFilename, "w");
+
+    if (NULL == pstFile)
+    {
+        fprintf(stderr, "Couldn't write %s.\n", pacFilename);
+        return -1;
+    }
+
+    fprintf(pstFile, "; Generated by `make atlas`, do not edit.\n");
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        const AtlasImage *pstImage = &pstImages[u32Index];
+
+        fprintf(pstFile, "\n[%s]\n", pstImage->pacFilename);
+        fprintf(pstFile, "page = %s/atlas-%d.png\n", pacOutDir, pstImage->s32Page);
+        fprintf(pstFile, "x    = %d\n", pstImage->stRect.x);
+        fprintf(pstFile, "y    = %d\n", pstImage->stRect.y);
+        fprintf(pstFile, "w    = %d\n", pstImage->stRect.w);
+        fprintf(pstFile, "h    = %d\n", pstImage->stRect.h);
+    }
+
+    fclose(pstFile);
+
+    return 0;
+}
+
+int32_t main(int32_t s32ArgC, char *pacArgV[])
+{
+    AtlasImage  stImages[ATLAS_IMAGES_MAX];
+    const char *pacOutDir   = NULL;
+    char        acFilename[512];
+    int32_t     s32MaxSize  = 2048;
+    int32_t     s32Pages    = 0;
+    int32_t     s32Status   = EXIT_SUCCESS;
+    uint32_t    u32Count    = 0;
+    uint32_t    u32Placed   = 0;
+
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        if ((0 == strcmp(pacArgV[s32Index], "--max-size")) && (s32Index + 1 < s32ArgC))
+        {
+            s32MaxSize = _NextPowerOfTwo(atoi(pacArgV[++s32Index]));
+        }
+        else if (NULL == pacOutDir)
+        {
+            pacOutDir = pacArgV[s32Index];
+        }
+        else if (u32Count < ATLAS_IMAGES_MAX)
+        {
+            stImages[u32Count].pacFilename = pacArgV[s32Index];
+            stImages[u32Count].pstImage    = NULL;
+            stImages[u32Count].s32Page     = -1;
+            u32Count++;
+        }
+        else
+        {
+            fprintf(stderr, "More than %d images.\n", ATLAS_IMAGES_MAX);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((NULL == pacOutDir) || (0 == u32Count))
+    {
+        fprintf(stderr, "Usage: %s [--max-size N] OUTDIR IMAGE...\n", pacArgV[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        AtlasImage *pstImage = &stImages[u32Index];
+
+        pstImage->pstImage = IMG_Load(pstImage->pacFilename);
+        if (NULL == pstImage->pstImage)
+        {
+            fprintf(stderr, "%s\n", IMG_GetError());
+            s32Status = EXIT_FAILURE;
+            goto quit;
+        }
+
+        pstImage->stRect.w = pstImage->pstImage->w;
+        pstImage->stRect.h = pstImage->pstImage->h;
+        if ((pstImage->stRect.w > s32MaxSize) || (pstImage->stRect.h > s32MaxSize))
+        {
+            fprintf(stderr, "%s is larger than %dx%d.\n", pstImage->pacFilename, s32MaxSize, s32MaxSize);
+            s32Status = EXIT_FAILURE;
+            goto quit;
+        }
+    }
+
+    qsort(stImages, u32Count, sizeof(AtlasImage), _CompareImages);
+
+    while (u32Placed < u32Count)
+    {
+        int32_t s32Width;
+        int32_t s32Height;
+
+        if (ATLAS_PAGES_MAX == s32Pages)
+        {
+            fprintf(stderr, "More than %d pages.\n", ATLAS_PAGES_MAX);
+            s32Status = EXIT_FAILURE;
+            goto quit;
+        }
+
+        // The smallest page which takes all remaining images, if any.
+        for (int32_t s32Size = 64; ; s32Size *= 2)
+        {
+            uint32_t u32OnPage = _FillPage(
+                stImages,
+                u32Count,
+                s32Pages,
+                SDL_min(s32Size, s32MaxSize),
+                &s32Width,
+                &s32Height);
+
+            if ((u32Placed + u32OnPage == u32Count) || (s32Size >= s32MaxSize))
+            {
+                u32Placed += u32OnPage;
+                break;
+            }
+
+            for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+            {
+                if (s32Pages == stImages[u32Index].s32Page)
+                {
+                    stImages[u32Index].s32Page = -1;
+                }
+            }
+        }
+
+        snprintf(acFilename, sizeof(acFilename), "%s/atlas-%d.png", pacOutDir, s32Pages);
+        if (-1 == _WritePage(acFilename, stImages, u32Count, s32Pages, s32Width, s32Height))
+        {
+            s32Status = EXIT_FAILURE;
+            goto quit;
+        }
+
+        fprintf(stderr, "%s: %dx%d\n", acFilename, _NextPowerOfTwo(s32Width), _NextPowerOfTwo(s32Height));
+        s32Pages++;
+    }
+
+    snprintf(acFilename, sizeof(acFilename), "%s/atlas.ini", pacOutDir);
+    if (-1 == _WriteTable(acFilename, pacOutDir, stImages, u32Count))
+    {
+        s32Status = EXIT_FAILURE;
+        goto quit;
+    }
+
+    fprintf(stderr, "%s: %u images on %d page(s)\n", acFilename, u32Count, s32Pages);
+
+quit:
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        SDL_FreeSurface(stImages[u32Index].pstImage);
+    }
+
+    return s32Status;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file      MetricsCli.c
+ * @ingroup   MetricsCli
+ * @defgroup  MetricsCli
+ * @brief     Reads the live metrics a running game publishes with
+ *            --metrics and prints them, either readable or in the
+ *            Prometheus text exposition format.  Reading never slows
+ *            the game down.  See @ref Metrics.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#define METRICS_CLI_SUPPORTED
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Metrics.h"
+
+#define PREFIX "boondock_sam_"
+
+static uint8_t _IsRunning(uint32_t u32Pid)
+{
+    #ifdef METRICS_CLI_SUPPORTED
+    return (0 == kill(u32Pid, 0)) || (EPERM == errno);
+    #else
+    (void)u32Pid;
+    return 1;
+    #endif
+}
+
+static void _PrintText(const MetricsBlock *pstMetrics)
+{
+    uint64_t u64Count = 0;
+
+    printf("pid:             %u%s\n", pstMetrics->u32Pid,
+        _IsRunning(pstMetrics->u32Pid) ? "" : " (not running)");
+    printf("frames:          %llu\n", (unsigned long long)pstMetrics->u64Frames);
+    printf("frame time:      %.3f ms\n", pstMetrics->u64FrameTimeNs / 1e6);
+    printf("frames/s:        %.1f\n", pstMetrics->u64FpsMilli / 1000.0);
+    printf("entities:        %u\n", pstMetrics->u32Entities);
+    printf("textures:        %u (%.1f MiB)\n",
+        pstMetrics->u32Textures,
+        pstMetrics->u64TextureBytes / (1024.0 * 1024.0));
+    printf("audio underruns: %u\n", pstMetrics->u32AudioUnderruns);
+
+    printf("\n%10s %10s\n", "<= ms", "frames");
+    for (uint8_t u8Bucket = 0; u8Bucket < METRICS_BUCKETS; u8Bucket++)
+    {
+        u64Count += pstMetrics->u64Histogram[u8Bucket];
+        if (UINT32_MAX == pstMetrics->u32BucketUs[u8Bucket])
+        {
+            printf("%10s %10llu\n", "inf", (unsigned long long)pstMetrics->u64Histogram[u8Bucket]);
+        }
+        else
+        {
+            printf("%10.3f %10llu\n",
+                pstMetrics->u32BucketUs[u8Bucket] / 1000.0,
+                (unsigned long long)pstMetrics->u64Histogram[u8Bucket]);
+        }
+    }
+    printf("%10s %10llu\n", "total", (unsigned long long)u64Count);
+}
+
+static void _PrintPrometheus(const MetricsBlock *pstMetrics)
+{
+    uint64_t u64Count = 0;
+
+    printf("# HELP " PREFIX "frames_total Frames run since start.\n");
+    printf("# TYPE " PREFIX "frames_total counter\n");
+    printf(PREFIX "frames_total %llu\n", (unsigned long long)pstMetrics->u64Frames);
+
+    printf("# HELP " PREFIX "frame_time_seconds Duration of the last frame.\n");
+    printf("# TYPE " PREFIX "frame_time_seconds gauge\n");
+    printf(PREFIX "frame_time_seconds %.9f\n", pstMetrics->u64FrameTimeNs / 1e9);
+
+    printf("# HELP " PREFIX "fps Frames per second, smoothed.\n");
+    printf("# TYPE " PREFIX "fps gauge\n");
+    printf(PREFIX "fps %.3f\n", pstMetrics->u64FpsMilli / 1000.0);
+
+    printf("# HELP " PREFIX "entities Entities being simulated.\n");
+    printf("# TYPE " PREFIX "entities gauge\n");
+    printf(PREFIX "entities %u\n", pstMetrics->u32Entities);
+
+    printf("# HELP " PREFIX "textures Live textures.\n");
+    printf("# TYPE " PREFIX "textures gauge\n");
+    printf(PREFIX "textures %u\n", pstMetrics->u32Textures);
+
+    printf("# HELP " PREFIX "texture_bytes Estimated memory of the live textures.\n");
+    printf("# TYPE " PREFIX "texture_bytes gauge\n");
+    printf(PREFIX "texture_bytes %llu\n", (unsigned long long)pstMetrics->u64TextureBytes);
+
+    printf("# HELP " PREFIX "audio_underruns_total Times the audio device ran out of samples.\n");
+    printf("# TYPE " PREFIX "audio_underruns_total counter\n");
+    printf(PREFIX "audio_underruns_total %u\n", pstMetrics->u32AudioUnderruns);
+
+    printf("# HELP " PREFIX "up Whether the game which published the metrics is running.\n");
+    printf("# TYPE " PREFIX "up gauge\n");
+    printf(PREFIX "up %u\n", _IsRunning(pstMetrics->u32Pid));
+
+    // Prometheus histograms are cumulative.
+    printf("# HELP " PREFIX "frame_duration_seconds Frame times.\n");
+    printf("# TYPE " PREFIX "frame_duration_seconds histogram\n");
+    for (uint8_t u8Bucket = 0; u8Bucket < METRICS_BUCKETS; u8Bucket++)
+    {
+        u64Count += pstMetrics->u64Histogram[u8Bucket];
+        if (UINT32_MAX == pstMetrics->u32BucketUs[u8Bucket])
+        {
+            printf(PREFIX "frame_duration_seconds_bucket{le=\"+Inf\"} %llu\n",
+                (unsigned long long)u64Count);
+        }
+        else
+        {
+            printf(PREFIX "frame_duration_seconds_bucket{le=\"%g\"} %llu\n",
+                pstMetrics->u32BucketUs[u8Bucket] / 1e6,
+                (unsigned long long)u64Count);
+        }
+    }
+    printf(PREFIX "frame_duration_seconds_sum %.9f\n", pstMetrics->u64HistogramSumNs / 1e9);
+    printf(PREFIX "frame_duration_seconds_count %llu\n", (unsigned long long)u64Count);
+}
+
+static void _Sleep(uint32_t u32Milliseconds)
+{
+    #ifdef METRICS_CLI_SUPPORTED
+    struct timespec stTime;
+
+    stTime.tv_sec  = u32Milliseconds / 1000;
+    stTime.tv_nsec = (u32Milliseconds % 1000) * 1000000L;
+    nanosleep(&stTime, NULL);
+    #else
+    (void)u32Milliseconds;
+    #endif
+}
+
+int32_t main(int32_t s32ArgC, char *pacArgV[])
+{
+    MetricsBlock *pstMetrics;
+    MetricsBlock  stCopy;
+    uint8_t       u8Prometheus = 0;
+    uint32_t      u32Interval  = 0;
+
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
+    {
+        if (0 == strcmp(pacArgV[s32Index], "--prometheus"))
+        {
+            u8Prometheus = 1;
+        }
+        else if ((0 == strcmp(pacArgV[s32Index], "--watch")) && (s32Index + 1 < s32ArgC))
+        {
+            u32Interval = strtoul(pacArgV[++s32Index], NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--prometheus] [--watch MS]\n", pacArgV[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    pstMetrics = OpenMetrics();
+    if (NULL == pstMetrics)
+    {
+        fprintf(stderr, "Is the game running with --metrics?\n");
+        return EXIT_FAILURE;
+    }
+
+    do
+    {
+        if (-1 == ReadMetrics(pstMetrics, &stCopy))
+        {
+            fprintf(stderr, "Couldn't get a consistent copy of the metrics.\n");
+            CloseMetrics(pstMetrics);
+            return EXIT_FAILURE;
+        }
+
+        if (u8Prometheus)
+        {
+            _PrintPrometheus(&stCopy);
+        }
+        else
+        {
+            _PrintText(&stCopy);
+        }
+
+        if (u32Interval)
+        {
+            printf("\n");
+            fflush(stdout);
+            _Sleep(u32Interval);
+        }
+    }
+    while (u32Interval);
+
+    CloseMetrics(pstMetrics);
+
+    return EXIT_SUCCESS;
+}